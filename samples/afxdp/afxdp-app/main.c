@@ -0,0 +1,282 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Sample application that parses packets received on AF_XDP sockets. There
+ * is one socket and one thread per queue, packets are parsed in place in
+ * the UMEM of the socket by the receive function panda-compiler generates
+ * (see Makefile)
+ */
+
+#include <arpa/inet.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/types.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "panda/afxdp.h"
+#include "panda/parser.h"
+#include "panda/parser_metadata.h"
+
+/* Define protocol nodes that are used below */
+#include "panda/proto_nodes_def.h"
+
+#define MAX_QUEUES 64
+
+/* Metadata structure with addresses and port numbers. Metadata templates
+ * are used to define standard fields in the structure
+ */
+struct metadata {
+	PANDA_METADATA_addr_type __aligned(8);
+	PANDA_METADATA_ip_proto;
+
+	__u16 rsvd; /* For packing */
+
+	PANDA_METADATA_ports;
+	PANDA_METADATA_addrs;
+};
+
+PANDA_METADATA_TEMP_ipv4_addrs(ipv4_metadata, metadata)
+PANDA_METADATA_TEMP_ipv6_addrs(ipv6_metadata, metadata)
+PANDA_METADATA_TEMP_ports(ports_metadata, metadata)
+
+/* Parse nodes */
+PANDA_MAKE_PARSE_NODE(ether_node, panda_parse_ether, NULL, NULL,
+		      ether_table);
+PANDA_MAKE_PARSE_NODE(ipv4_node, panda_parse_ipv4, ipv4_metadata,
+		      NULL, ip_table);
+PANDA_MAKE_PARSE_NODE(ipv6_node, panda_parse_ipv6, ipv6_metadata,
+		      NULL, ip_table);
+PANDA_MAKE_LEAF_PARSE_NODE(ports_node, panda_parse_ports, ports_metadata,
+			   NULL);
+
+/* Protocol tables */
+
+PANDA_MAKE_PROTO_TABLE(ether_table,
+	{ __cpu_to_be16(ETH_P_IP), &ipv4_node },
+	{ __cpu_to_be16(ETH_P_IPV6), &ipv6_node },
+);
+
+PANDA_MAKE_PROTO_TABLE(ip_table,
+	{ IPPROTO_TCP, &ports_node },
+	{ IPPROTO_UDP, &ports_node },
+);
+
+/* Make the parser */
+PANDA_PARSER(parser, "AF_XDP parser example", &ether_node);
+
+/* The receive function for the parser is generated by panda-compiler,
+ * which includes this file in the source file it generates. Provide a
+ * forward reference since it is defined after this file is included
+ */
+PANDA_AFXDP_RX_DECL(parser);
+
+struct pmetadata {
+	struct panda_metadata panda_metadata; /* Must be first */
+	struct metadata metadata;
+};
+
+struct queue {
+	struct panda_afxdp_sock sock;
+	pthread_t thread;
+	__u32 queue_id;
+	__u64 packets;
+	__u64 bytes;
+	__u64 fails;
+};
+
+static struct queue queues[MAX_QUEUES];
+static volatile bool stop;
+static unsigned long count;
+static unsigned long total;
+static bool verbose;
+
+static void print_packet(const struct metadata *metadata, __u32 queue_id)
+{
+	char sbuf[INET6_ADDRSTRLEN];
+	char dbuf[INET6_ADDRSTRLEN];
+
+	switch (metadata->addr_type) {
+	case PANDA_ADDR_TYPE_IPV4:
+		inet_ntop(AF_INET, &metadata->addrs.v4.saddr,
+			  sbuf, sizeof(sbuf));
+		inet_ntop(AF_INET, &metadata->addrs.v4.daddr,
+			  dbuf, sizeof(dbuf));
+		break;
+	case PANDA_ADDR_TYPE_IPV6:
+		inet_ntop(AF_INET6, &metadata->addrs.v6.saddr,
+			  sbuf, sizeof(sbuf));
+		inet_ntop(AF_INET6, &metadata->addrs.v6.daddr,
+			  dbuf, sizeof(dbuf));
+		break;
+	default:
+		return;
+	}
+
+	printf("queue %u: IPv%u proto %u: %s:%u->%s:%u\n", queue_id,
+	       metadata->addr_type == PANDA_ADDR_TYPE_IPV4 ? 4 : 6,
+	       metadata->ip_proto, sbuf, ntohs(metadata->src_port), dbuf,
+	       ntohs(metadata->dst_port));
+}
+
+static void process(void *arg, const void *hdr, size_t len,
+		    struct panda_metadata *panda_metadata, int ret)
+{
+	struct pmetadata *pmetadata = (struct pmetadata *)panda_metadata;
+	struct queue *q = arg;
+
+	q->packets++;
+	q->bytes += len;
+
+	if (ret != PANDA_OKAY && ret != PANDA_STOP_OKAY) {
+		q->fails++;
+		return;
+	}
+
+	if (verbose)
+		print_packet(&pmetadata->metadata, q->queue_id);
+}
+
+static void *rx_thread(void *arg)
+{
+	struct pmetadata pmetadatas[PANDA_AFXDP_BATCH];
+	struct panda_metadata *metadatas[PANDA_AFXDP_BATCH];
+	struct queue *q = arg;
+	unsigned int i, num;
+
+	for (i = 0; i < PANDA_AFXDP_BATCH; i++)
+		metadatas[i] = &pmetadatas[i].panda_metadata;
+
+	while (!stop) {
+		num = PANDA_AFXDP_RX(parser, &q->sock, metadatas,
+				     sizeof(pmetadatas[0]), 0, 0, process, q);
+		if (!num) {
+			panda_afxdp_poll(&q->sock, 100);
+			continue;
+		}
+
+		if (count && __atomic_add_fetch(&total, num,
+						__ATOMIC_RELAXED) >= count)
+			stop = true;
+	}
+
+	return NULL;
+}
+
+static void sig_handler(int sig)
+{
+	stop = true;
+}
+
+static void usage(char *prog)
+{
+	fprintf(stderr, "%s [-q <queue>] [-n <num_queues>] [-c <count>] "
+		"[-S] [-z] [-v] <ifname>\n", prog);
+	exit(-1);
+}
+
+#define ARGS "q:n:c:Szv"
+
+int main(int argc, char *argv[])
+{
+	__u32 xdp_flags = 0;
+	unsigned int queue = 0, num_queues = 1, i;
+	__u64 packets = 0, bytes = 0, fails = 0;
+	__u16 bind_flags = 0;
+	const char *ifname;
+	int c, err;
+
+	while ((c = getopt(argc, argv, ARGS)) != -1) {
+		switch (c) {
+		case 'q':
+			queue = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			num_queues = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			/* Generic XDP, packets are copied to the UMEM */
+			xdp_flags |= XDP_FLAGS_SKB_MODE;
+			bind_flags = XDP_COPY;
+			break;
+		case 'z':
+			bind_flags = XDP_ZEROCOPY;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !num_queues || num_queues > MAX_QUEUES)
+		usage(argv[0]);
+	ifname = argv[optind];
+
+	signal(SIGINT, sig_handler);
+	signal(SIGTERM, sig_handler);
+
+	for (i = 0; i < num_queues; i++) {
+		queues[i].queue_id = queue + i;
+		err = panda_afxdp_sock_create(&queues[i].sock, ifname,
+					      queue + i, xdp_flags,
+					      bind_flags);
+		if (err) {
+			fprintf(stderr, "AF_XDP socket on %s queue %u: %s\n",
+				ifname, queue + i, strerror(-err));
+			num_queues = i;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < num_queues; i++)
+		pthread_create(&queues[i].thread, NULL, rx_thread,
+			       &queues[i]);
+	for (i = 0; i < num_queues; i++)
+		pthread_join(queues[i].thread, NULL);
+
+	for (i = 0; i < num_queues; i++) {
+		packets += queues[i].packets;
+		bytes += queues[i].bytes;
+		fails += queues[i].fails;
+	}
+	printf("%llu packets, %llu bytes, %llu parse failures\n",
+	       packets, bytes, fails);
+
+out:
+	for (i = 0; i < num_queues; i++)
+		panda_afxdp_sock_destroy(&queues[i].sock);
+
+	return err ? -1 : 0;
+}
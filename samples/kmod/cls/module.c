@@ -41,33 +41,33 @@ struct panda_parser_big_metadata_one {
 	struct panda_metadata_all frame;
 };
 
-static int do_parse(struct sk_buff *skb)
+static int do_parse(struct sk_buff *skb, struct tc_cls_panda_key *key,
+		    struct tc_cls_panda_info *info)
 {
 	int err;
 	struct panda_parser_big_metadata_one mdata;
-	void *data;
-	size_t pktlen;
 
 	memset(&mdata, 0, sizeof(mdata));
 
-	err = skb_linearize(skb);
-	if (err < 0)
-		return err;
-
-	BUG_ON(skb->data_len);
-
-	data = skb_mac_header(skb);
-	pktlen = skb_mac_header_len(skb) + skb->len;
-
-	err = panda_parse(PANDA_PARSER_KMOD_NAME(panda_parser_big_ether), data,
-			  pktlen, &mdata.panda_data, 0, 1);
+	/* Parse from the Ethernet header, headers in paged data are copied
+	 * by the parser so the skb isn't linearized
+	 */
+	err = panda_parse_skb(PANDA_PARSER_KMOD_NAME(panda_parser_big_ether),
+			      skb, skb_mac_offset(skb), &mdata.panda_data, 0,
+			      1);
 	if (err != PANDA_STOP_OKAY) {
                 pr_debug("Failed to parse packet! (%d)", err);
-		return -1;
+		return err < 0 ? err : -1;
         }
 
         pr_debug("Parsed packet!");
 
+	/* The packet is parsed once, the classifier matches all filters on
+	 * the key
+	 */
+	PANDA_TC_SET_KEY(key, &mdata.frame);
+	PANDA_TC_SET_INFO(info, &mdata.frame);
+
 	return 0;
 }
 
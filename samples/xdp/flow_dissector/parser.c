@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Parse graph of the flow dissector sample. The graph starts at Ethernet
+ * but the flow dissector starts at the node for the EtherType of the skb,
+ * and it parses VLANs, IP in IP, and GRE tunnels to the inner flow
+ */
+
+#include <arpa/inet.h>
+#include <linux/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Define protocol nodes that are used below */
+#include "panda/proto_nodes_def.h"
+
+/* Meta data functions for parser nodes. Use the canned templates
+ * for common metadata, the flow dissector needs the l3_off and l4_off
+ * offsets
+ */
+PANDA_METADATA_TEMP_ether_off(ether_metadata, panda_metadata_all)
+PANDA_METADATA_TEMP_ipv4(ipv4_metadata, panda_metadata_all)
+PANDA_METADATA_TEMP_ipv6(ipv6_metadata, panda_metadata_all)
+PANDA_METADATA_TEMP_ipv6_eh(ipv6_eh_metadata, panda_metadata_all)
+PANDA_METADATA_TEMP_ipv6_frag(ipv6_frag_metadata, panda_metadata_all)
+PANDA_METADATA_TEMP_ports_off(ports_metadata, panda_metadata_all)
+PANDA_METADATA_TEMP_vlan_8021AD(e8021AD_metadata, panda_metadata_all)
+PANDA_METADATA_TEMP_vlan_8021Q(e8021Q_metadata, panda_metadata_all)
+PANDA_METADATA_TEMP_gre(gre_metadata, panda_metadata_all)
+PANDA_METADATA_TEMP_gre_keyid(gre_keyid_metadata, panda_metadata_all)
+
+/* Parse nodes. Parse nodes are composed of the common PANDA Parser protocol
+ * nodes, metadata functions defined above, and protocol tables defined
+ * below
+ */
+
+PANDA_MAKE_PARSE_NODE(ether_node, panda_parse_ether, ether_metadata, NULL,
+		      ether_table);
+PANDA_MAKE_PARSE_NODE(e8021AD_node, panda_parse_vlan, e8021AD_metadata,
+		      NULL, ether_table);
+PANDA_MAKE_PARSE_NODE(e8021Q_node, panda_parse_vlan, e8021Q_metadata, NULL,
+		      ether_table);
+PANDA_MAKE_PARSE_NODE(ipv4_check_node, panda_parse_ipv4_check, ipv4_metadata,
+		      NULL, ipv4_table);
+PANDA_MAKE_PARSE_NODE(ipv6_check_node, panda_parse_ipv6_check, ipv6_metadata,
+		      NULL, ipv6_table);
+PANDA_MAKE_PARSE_NODE(ipv4_node, panda_parse_ipv4, ipv4_metadata, NULL,
+		      ipv4_table);
+PANDA_MAKE_PARSE_NODE(ipv6_node, panda_parse_ipv6, ipv6_metadata, NULL,
+		      ipv6_table);
+PANDA_MAKE_PARSE_NODE(ipv6_eh_node, panda_parse_ipv6_eh, ipv6_eh_metadata,
+		      NULL, ipv6_table);
+PANDA_MAKE_PARSE_NODE(ipv6_frag_node, panda_parse_ipv6_frag_eh,
+		      ipv6_frag_metadata, NULL, ipv6_table);
+PANDA_MAKE_OVERLAY_PARSE_NODE(ipv4ip_node, panda_parse_ipv4ip, NULL, NULL,
+			      &ipv4_node);
+PANDA_MAKE_OVERLAY_PARSE_NODE(ipv6ip_node, panda_parse_ipv6ip, NULL, NULL,
+			      &ipv6_node);
+PANDA_MAKE_PARSE_NODE(gre_base_node, panda_parse_gre_base, NULL, NULL,
+		      gre_base_table);
+PANDA_MAKE_FLAG_FIELDS_PARSE_NODE(gre_v0_node, panda_parse_gre_v0,
+				  gre_metadata, NULL, gre_v0_table,
+				  gre_v0_flag_fields_table);
+
+PANDA_MAKE_LEAF_PARSE_NODE(ports_node, panda_parse_ports, ports_metadata,
+			   NULL);
+
+PANDA_MAKE_FLAG_FIELD_PARSE_NODE(gre_flag_csum_node, NULL, NULL);
+PANDA_MAKE_FLAG_FIELD_PARSE_NODE(gre_flag_key_node, gre_keyid_metadata, NULL);
+PANDA_MAKE_FLAG_FIELD_PARSE_NODE(gre_flag_seq_node, NULL, NULL);
+
+/* Protocol tables */
+
+PANDA_MAKE_PROTO_TABLE(ether_table,
+	{ __cpu_to_be16(ETH_P_IP), &ipv4_check_node },
+	{ __cpu_to_be16(ETH_P_IPV6), &ipv6_check_node },
+	{ __cpu_to_be16(ETH_P_8021AD), &e8021AD_node },
+	{ __cpu_to_be16(ETH_P_8021Q), &e8021Q_node },
+);
+
+PANDA_MAKE_PROTO_TABLE(ipv4_table,
+	{ IPPROTO_TCP, &ports_node },
+	{ IPPROTO_UDP, &ports_node },
+	{ IPPROTO_SCTP, &ports_node },
+	{ IPPROTO_DCCP, &ports_node },
+	{ IPPROTO_GRE, &gre_base_node },
+	{ IPPROTO_IPIP, &ipv4ip_node },
+	{ IPPROTO_IPV6, &ipv6ip_node },
+);
+
+PANDA_MAKE_PROTO_TABLE(ipv6_table,
+	{ IPPROTO_HOPOPTS, &ipv6_eh_node },
+	{ IPPROTO_ROUTING, &ipv6_eh_node },
+	{ IPPROTO_DSTOPTS, &ipv6_eh_node },
+	{ IPPROTO_FRAGMENT, &ipv6_frag_node },
+	{ IPPROTO_TCP, &ports_node },
+	{ IPPROTO_UDP, &ports_node },
+	{ IPPROTO_SCTP, &ports_node },
+	{ IPPROTO_DCCP, &ports_node },
+	{ IPPROTO_GRE, &gre_base_node },
+	{ IPPROTO_IPIP, &ipv4ip_node },
+	{ IPPROTO_IPV6, &ipv6ip_node },
+);
+
+PANDA_MAKE_PROTO_TABLE(gre_base_table,
+	{ 0, &gre_v0_node.parse_node },
+);
+
+PANDA_MAKE_PROTO_TABLE(gre_v0_table,
+	{ __cpu_to_be16(ETH_P_IP), &ipv4_check_node },
+	{ __cpu_to_be16(ETH_P_IPV6), &ipv6_check_node },
+	{ __cpu_to_be16(ETH_P_TEB), &ether_node },
+);
+
+PANDA_MAKE_FLAG_FIELDS_TABLE(gre_v0_flag_fields_table,
+	{ GRE_FLAGS_CSUM_IDX, &gre_flag_csum_node },
+	{ GRE_FLAGS_KEY_IDX, &gre_flag_key_node },
+	{ GRE_FLAGS_SEQ_IDX, &gre_flag_seq_node }
+);
+
+PANDA_PARSER(panda_parser_flowdis, "PANDA flow dissector parser",
+	     &ether_node);
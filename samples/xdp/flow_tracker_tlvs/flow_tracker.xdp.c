@@ -29,112 +29,38 @@
 
 #include "flow_tracker.h"
 #include "panda/parser.h"
+#include "panda/xdp_tmpl.h"
 #include "parser.xdp.h"
 
-#define PROG_MAP_ID 0xcafe
-
 struct flow_tracker_ctx {
 	struct panda_ctx ctx;
 	struct panda_metadata_all frame[1];
 };
 
-struct bpf_elf_map SEC("maps") ctx_map = {
-	.type = BPF_MAP_TYPE_PERCPU_ARRAY,
-	.size_key = sizeof(__u32),
-	.size_value = sizeof(struct flow_tracker_ctx),
-	.max_elem = 2,
-	.pinning = PIN_GLOBAL_NS,
-};
-struct bpf_elf_map SEC("maps") parsers = {
-	.type = BPF_MAP_TYPE_PROG_ARRAY,
-	.size_key = sizeof(__u32),
-	.size_value = sizeof(__u32),
-	.max_elem = 1,
-	.pinning = PIN_GLOBAL_NS,
-	.id = PROG_MAP_ID,
-};
-
-static __always_inline struct flow_tracker_ctx *panda_get_ctx(void)
+static __always_inline int process(struct xdp_md *xdp_ctx,
+				   struct flow_tracker_ctx *ctx)
 {
-	/* clang-10 has a bug if key == 0,
-	 * it generates bogus bytecodes.
-	 */
-	__u32 key = 1;
-
-	return bpf_map_lookup_elem(&ctx_map, &key);
-}
-
-SEC("0xcafe/0")
-int parser_prog(struct xdp_md *ctx)
-{
-	struct flow_tracker_ctx *parser_ctx = panda_get_ctx();
-	void *data_end = (void *)(long)ctx->data_end;
-	void *data = (void *)(long)ctx->data;
-	void *original = data;
-	int rc = PANDA_OKAY;
-
-	if (!parser_ctx)
-		return XDP_ABORTED;
-
-	/* >>> Invoke the specific panda parser */
-	rc = PANDA_PARSE_XDP(panda_parser_simple_tuple, &parser_ctx->ctx,
-			     (const void **)&data, data_end, true);
-
-	if (rc != PANDA_OKAY && rc != PANDA_STOP_OKAY) {
-		flow_track_error(parser_ctx->frame);
-		bpf_xdp_adjust_head(ctx, -parser_ctx->ctx.offset);
-		return XDP_PASS;
-	}
-	if (parser_ctx->ctx.next != CODE_IGNORE) {
-		parser_ctx->ctx.offset += data - original;
-		bpf_xdp_adjust_head(ctx, data - original);
-		bpf_tail_call(ctx, &parsers, 0);
-	}
+	flow_track(ctx->frame);
 
-	/* >>> Call processing user function here */
-	flow_track(parser_ctx->frame);
-
-	bpf_xdp_adjust_head(ctx, -parser_ctx->ctx.offset);
 	return XDP_PASS;
 }
 
-SEC("prog")
-int xdp_prog(struct xdp_md *ctx)
+static __always_inline int parser_fail(int rc, struct xdp_md *xdp_ctx,
+				       struct flow_tracker_ctx *ctx)
 {
-	struct flow_tracker_ctx *parser_ctx = panda_get_ctx();
-	void *data_end = (void *)(long)ctx->data_end;
-	void *data = (void *)(long)ctx->data;
-	void *original = data;
-	int rc = PANDA_OKAY;
-
-	if (!parser_ctx)
-		return XDP_ABORTED;
-
-	parser_ctx->ctx.metadata.frame_size = sizeof(parser_ctx->frame[0]);
-	parser_ctx->ctx.metadata.max_frame_num = 0;
-	parser_ctx->ctx.frame_num = 0;
-	parser_ctx->ctx.next = CODE_IGNORE;
-
-	/* >>> Invoke the specific panda parser */
-	rc = PANDA_PARSE_XDP(panda_parser_simple_tuple, &parser_ctx->ctx,
-			     (const void **)&data, data_end, false);
-
-	if (rc != PANDA_OKAY && rc != PANDA_STOP_OKAY) {
-		flow_track_error(parser_ctx->frame);
-
-		return XDP_PASS;
-	}
-
-	if (parser_ctx->ctx.next != CODE_IGNORE) {
-		parser_ctx->ctx.offset = data - original;
-		bpf_xdp_adjust_head(ctx, parser_ctx->ctx.offset);
-		bpf_tail_call(ctx, &parsers, 0);
-	}
-
-	/* >>> Call processing user function here */
-	flow_track(parser_ctx->frame);
+	if (ctx)
+		flow_track_error(ctx->frame);
 
 	return XDP_PASS;
 }
 
+/* The parser is generated with panda-compiler --xdp-loop, so the TCP
+ * options are parsed with bpf_loop and the parser may be split in several
+ * tail called programs
+ */
+PANDA_XDP_MAKE_PARSER_PROGRAM(panda_parser_simple_tuple,
+			      struct flow_tracker_ctx,
+			      sizeof(struct panda_metadata_all),
+			      process, parser_fail)
+
 char __license[] SEC("license") = "GPL";
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* TC classifier made from the PANDA parser in parser.c, the parser is
+ * generated by panda-compiler in parser.tc.h. Packets are put in class
+ * 1:<IP protocol>, the flow is exported in skb->cb, and packets and bytes
+ * are counted per IP protocol in a per-CPU map
+ */
+
+#include <linux/bpf.h>
+#include <linux/pkt_cls.h>
+#include <bpf/bpf_helpers.h>
+
+#include "panda/bpf.h"
+#include "panda/parser_metadata.h"
+#include "parser.tc.h"
+#include "panda/tc_bpf_tmpl.h"
+
+struct tc_classifier_ctx {
+	struct panda_ctx ctx;
+	struct panda_metadata_all frame[1];
+};
+
+struct tc_classifier_stats {
+	__u64 packets;
+	__u64 bytes;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 256);
+	__type(key, __u32);
+	__type(value, struct tc_classifier_stats);
+} tc_classifier_stats SEC(".maps");
+
+static __always_inline int process(struct __sk_buff *skb,
+				   struct tc_classifier_ctx *ctx)
+{
+	struct panda_metadata_all *frame = ctx->frame;
+	struct tc_classifier_stats *stats;
+	__u32 key = frame->ip_proto;
+
+	stats = bpf_map_lookup_elem(&tc_classifier_stats, &key);
+	if (stats) {
+		stats->packets++;
+		stats->bytes += skb->len;
+	}
+
+	skb->tc_classid = TC_H_MAKE(1 << 16, frame->ip_proto);
+	PANDA_TC_SET_CB(skb, frame);
+
+	return TC_ACT_OK;
+}
+
+static __always_inline int parser_fail(int rc, struct __sk_buff *skb,
+				       struct tc_classifier_ctx *ctx)
+{
+	/* Packets that aren't parsed are not classified */
+	return TC_ACT_UNSPEC;
+}
+
+PANDA_TC_MAKE_BPF_PROGRAM(panda_parser_tc, struct tc_classifier_ctx,
+			  sizeof(struct panda_metadata_all), process,
+			  parser_fail)
+
+char __license[] SEC("license") = "GPL";
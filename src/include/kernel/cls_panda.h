@@ -29,29 +29,124 @@
 
 #ifdef __KERNEL__
 
+#include <linux/in6.h>
 #include <linux/list.h>
 #include <linux/skbuff.h>
 
 #define TCA_PANDA_MAX (__TCA_PANDA_MAX - 1)
 
+/* Address types of a match key, the same as PANDA_ADDR_TYPE_* */
+#define TC_CLS_PANDA_ADDR_IPV4	1
+#define TC_CLS_PANDA_ADDR_IPV6	2
+
+/* Fields of a packet that filters match on. The parse function of a parser
+ * module sets the key from its metadata, fields that aren't in the packet
+ * are left zero. Filters match on the key under a mask
+ */
+struct tc_cls_panda_key {
+	__u8 addr_type;
+	__u8 ip_proto;
+	__be16 eth_proto;
+	__be16 src_port;
+	__be16 dst_port;
+	__u16 vlan_id;
+	__u16 rsvd;
+	__be32 keyid;
+	union {
+		struct {
+			__be32 saddr;
+			__be32 daddr;
+		} v4;
+		struct {
+			struct in6_addr saddr;
+			struct in6_addr daddr;
+		} v6;
+	} addrs;
+} __aligned(sizeof(long));
+
+/* Header offsets of a packet from its MAC header, zero if the header isn't
+ * in the packet. The parse function sets them with the key and they are
+ * published into the skb by filters with the publish flag
+ */
+struct tc_cls_panda_info {
+	__u16 l3_off;
+	__u16 l4_off;
+};
+
 struct tc_cls_panda_ops {
 	const char *name;
 	struct list_head list;
-	int (*parse)(struct sk_buff *pkt);
+	/* Parse the packet once from the MAC header and set the match key
+	 * and header offsets. If the parse fails the PANDA_STOP_* code is
+	 * returned, which is counted in the parse errors, any value < 0
+	 * means that the packet doesn't match any filter
+	 */
+	int (*parse)(struct sk_buff *pkt, struct tc_cls_panda_key *key,
+		     struct tc_cls_panda_info *info);
 	struct module *owner;
 };
 
 int register_panda_ops(struct tc_cls_panda_ops *ops);
 int unregister_panda_ops(struct tc_cls_panda_ops *ops);
 
+/* Get the key of a packet published by the classifier. The key is kept per
+ * CPU for the last published packet so this only works in the same softirq
+ * run, and returns false if the packet isn't the last one
+ */
+bool tc_cls_panda_flow_key(const struct sk_buff *skb,
+			   struct tc_cls_panda_key *key);
+
 #endif /* __KERNEL__ */
 
 /* UAPI */
+#include <linux/types.h>
+
 enum {
 	TCA_PANDA_UNSPEC,
 	TCA_PANDA_CLASSID,
 	TCA_PANDA_PARSER,
+	TCA_PANDA_KEY_ETH_PROTO,	/* be16 */
+	TCA_PANDA_KEY_IP_PROTO,		/* u8 */
+	TCA_PANDA_KEY_IPV4_SRC,		/* be32 */
+	TCA_PANDA_KEY_IPV4_SRC_MASK,	/* be32 */
+	TCA_PANDA_KEY_IPV4_DST,		/* be32 */
+	TCA_PANDA_KEY_IPV4_DST_MASK,	/* be32 */
+	TCA_PANDA_KEY_IPV6_SRC,		/* struct in6_addr */
+	TCA_PANDA_KEY_IPV6_SRC_MASK,	/* struct in6_addr */
+	TCA_PANDA_KEY_IPV6_DST,		/* struct in6_addr */
+	TCA_PANDA_KEY_IPV6_DST_MASK,	/* struct in6_addr */
+	TCA_PANDA_KEY_SRC_PORT,		/* be16 */
+	TCA_PANDA_KEY_DST_PORT,		/* be16 */
+	TCA_PANDA_KEY_VLAN_ID,		/* u16 */
+	TCA_PANDA_KEY_KEYID,		/* be32 */
+	TCA_PANDA_PUBLISH,		/* flag */
+	TCA_PANDA_HIST,			/* flag */
+	TCA_PANDA_PAD,
+	TCA_PANDA_STATS,		/* struct tc_cls_panda_stats */
+	TCA_PANDA_MATCHES,		/* u64 */
+	TCA_PANDA_LATENCY,		/* u64[TC_CLS_PANDA_NUM_HIST] */
 	__TCA_PANDA_MAX,
 };
 
+/* Parse errors are counted by the negated PANDA_STOP_* code, codes out of
+ * range are counted in errors[0]
+ */
+#define TC_CLS_PANDA_NUM_STOP	16
+
+/* Parse times are counted in log2 buckets, bucket 0 is for zero ns and
+ * bucket i for [2^(i - 1), 2^i) ns. The last bucket is for all larger times
+ */
+#define TC_CLS_PANDA_NUM_HIST	32
+
+/* Statistics of the parser of a classifier instance, dumped with each filter.
+ * The number of matches of a filter is dumped in TCA_PANDA_MATCHES, and the
+ * histogram of parse times in TCA_PANDA_LATENCY for filters with the
+ * TCA_PANDA_HIST flag
+ */
+struct tc_cls_panda_stats {
+	__u64 packets;		/* Packets parsed */
+	__u64 nomatch;		/* Packets parsed that didn't match a filter */
+	__u64 errors[TC_CLS_PANDA_NUM_STOP];
+};
+
 #endif /* __CLS_PANDA_H__ */
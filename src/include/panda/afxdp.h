@@ -0,0 +1,228 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2020,2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __PANDA_AFXDP_H__
+#define __PANDA_AFXDP_H__
+
+/* AF_XDP sockets for parsers generated by panda-compiler in a .afxdp.c file.
+ * Each socket is bound to one queue of a device and has its own UMEM, the
+ * packets received are parsed in place in the UMEM frames, in batches, and
+ * the frames are then given back to the kernel. This needs libxdp
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <xdp/xsk.h>
+
+#include "panda/parser.h"
+
+/* Number of frames in the UMEM of a socket, a power of two */
+#ifndef PANDA_AFXDP_NUM_FRAMES
+#define PANDA_AFXDP_NUM_FRAMES 4096
+#endif
+
+#ifndef PANDA_AFXDP_FRAME_SIZE
+#define PANDA_AFXDP_FRAME_SIZE XSK_UMEM__DEFAULT_FRAME_SIZE
+#endif
+
+/* Maximum number of RX descriptors processed at a time */
+#ifndef PANDA_AFXDP_BATCH
+#define PANDA_AFXDP_BATCH 64
+#endif
+
+struct panda_afxdp_sock {
+	struct xsk_ring_prod fq;
+	struct xsk_ring_cons cq;
+	struct xsk_ring_cons rx;
+	struct xsk_umem *umem;
+	struct xsk_socket *xsk;
+	void *area;
+};
+
+/* Called for each packet with its return code from the parser */
+typedef void (*panda_afxdp_process_t)(void *arg, const void *hdr,
+				      size_t len,
+				      struct panda_metadata *metadata,
+				      int ret);
+
+/* Create an RX socket on queue QUEUE of IFNAME. XDP_FLAGS is the mode of
+ * the XDP program that redirects packets to the socket (for instance
+ * XDP_FLAGS_SKB_MODE), BIND_FLAGS is XDP_ZEROCOPY, XDP_COPY, or zero to
+ * use zero copy if the driver supports it. All the frames of the UMEM are
+ * put in the fill ring
+ */
+static inline int panda_afxdp_sock_create(struct panda_afxdp_sock *s,
+					  const char *ifname, __u32 queue,
+					  __u32 xdp_flags, __u16 bind_flags)
+{
+	struct xsk_umem_config ucfg = {
+		.fill_size = PANDA_AFXDP_NUM_FRAMES,
+		.comp_size = XSK_RING_CONS__DEFAULT_NUM_DESCS,
+		.frame_size = PANDA_AFXDP_FRAME_SIZE,
+		.frame_headroom = XSK_UMEM__DEFAULT_FRAME_HEADROOM,
+	};
+	struct xsk_socket_config cfg = {
+		.rx_size = XSK_RING_CONS__DEFAULT_NUM_DESCS,
+		.xdp_flags = xdp_flags,
+		.bind_flags = bind_flags,
+	};
+	size_t size = (size_t)PANDA_AFXDP_NUM_FRAMES * PANDA_AFXDP_FRAME_SIZE;
+	__u32 idx, i;
+	int err;
+
+	memset(s, 0, sizeof(*s));
+
+	s->area = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (s->area == MAP_FAILED)
+		return -errno;
+
+	err = xsk_umem__create(&s->umem, s->area, size, &s->fq, &s->cq,
+			       &ucfg);
+	if (err)
+		goto out_unmap;
+
+	err = xsk_socket__create(&s->xsk, ifname, queue, s->umem, &s->rx,
+				 NULL, &cfg);
+	if (err)
+		goto out_umem;
+
+	if (xsk_ring_prod__reserve(&s->fq, PANDA_AFXDP_NUM_FRAMES, &idx) !=
+	    PANDA_AFXDP_NUM_FRAMES) {
+		err = -ENOMEM;
+		goto out_sock;
+	}
+	for (i = 0; i < PANDA_AFXDP_NUM_FRAMES; i++)
+		*xsk_ring_prod__fill_addr(&s->fq, idx + i) =
+					(__u64)i * PANDA_AFXDP_FRAME_SIZE;
+	xsk_ring_prod__submit(&s->fq, PANDA_AFXDP_NUM_FRAMES);
+
+	return 0;
+
+out_sock:
+	xsk_socket__delete(s->xsk);
+out_umem:
+	xsk_umem__delete(s->umem);
+out_unmap:
+	munmap(s->area, size);
+	s->area = NULL;
+
+	return err;
+}
+
+static inline void panda_afxdp_sock_destroy(struct panda_afxdp_sock *s)
+{
+	if (!s->area)
+		return;
+
+	xsk_socket__delete(s->xsk);
+	xsk_umem__delete(s->umem);
+	munmap(s->area, (size_t)PANDA_AFXDP_NUM_FRAMES *
+						PANDA_AFXDP_FRAME_SIZE);
+	s->area = NULL;
+}
+
+/* Wait up to TIMEOUT milliseconds for packets on a socket */
+static inline int panda_afxdp_poll(struct panda_afxdp_sock *s, int timeout)
+{
+	struct pollfd pfd = {
+		.fd = xsk_socket__fd(s->xsk),
+		.events = POLLIN,
+	};
+
+	return poll(&pfd, 1, timeout);
+}
+
+/* Get up to PANDA_AFXDP_BATCH received packets, hdrs are pointers to the
+ * packets in the UMEM. Returns the number of packets and their first
+ * descriptor in idx
+ */
+static inline unsigned int panda_afxdp_rx_peek(struct panda_afxdp_sock *s,
+					       const void *hdrs[],
+					       size_t lens[], __u32 *idx)
+{
+	const struct xdp_desc *desc;
+	unsigned int i, num;
+
+	num = xsk_ring_cons__peek(&s->rx, PANDA_AFXDP_BATCH, idx);
+	for (i = 0; i < num; i++) {
+		desc = xsk_ring_cons__rx_desc(&s->rx, *idx + i);
+		hdrs[i] = xsk_umem__get_data(s->area, desc->addr);
+		lens[i] = desc->len;
+	}
+
+	return num;
+}
+
+/* Give the frames of num packets from panda_afxdp_rx_peek back to the
+ * kernel. The fill ring has room for all the frames of the UMEM, so the
+ * frames always fit
+ */
+static inline void panda_afxdp_rx_release(struct panda_afxdp_sock *s,
+					  __u32 idx, unsigned int num)
+{
+	unsigned int i;
+	__u32 fidx;
+
+	xsk_ring_prod__reserve(&s->fq, num, &fidx);
+	for (i = 0; i < num; i++)
+		*xsk_ring_prod__fill_addr(&s->fq, fidx + i) =
+			xsk_ring_cons__rx_desc(&s->rx, idx + i)->addr;
+	xsk_ring_prod__submit(&s->fq, num);
+	xsk_ring_cons__release(&s->rx, num);
+
+	if (xsk_ring_prod__needs_wakeup(&s->fq))
+		recvfrom(xsk_socket__fd(s->xsk), NULL, 0, MSG_DONTWAIT,
+			 NULL, NULL);
+}
+
+/* Parse up to PANDA_AFXDP_BATCH packets received on a socket with a parser
+ * generated in a .afxdp.c file, and call PROCESS for each packet. The
+ * metadata structures are zeroed before parsing. Returns the number of
+ * packets
+ */
+#define PANDA_AFXDP_RX(PARSER, S, METADATAS, METADATA_LEN, FLAGS,	\
+		       MAX_ENCAPS, PROCESS, ARG)			\
+	panda_afxdp_rx_##PARSER(S, METADATAS, METADATA_LEN, FLAGS,	\
+				MAX_ENCAPS, PROCESS, ARG)
+
+/* Forward declaration of the receive function of a parser, for a source
+ * file that is included by the file panda-compiler generates
+ */
+#define PANDA_AFXDP_RX_DECL(PARSER)					\
+static inline unsigned int panda_afxdp_rx_##PARSER(			\
+		struct panda_afxdp_sock *s,				\
+		struct panda_metadata *const metadatas[],		\
+		size_t metadata_len, unsigned int flags,		\
+		unsigned int max_encaps, panda_afxdp_process_t process,	\
+		void *arg)
+
+#endif /* __PANDA_AFXDP_H__ */
@@ -0,0 +1,261 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2020,2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __PANDA_BYTECODE_H__
+#define __PANDA_BYTECODE_H__
+
+/* Bytecode parsers
+ *
+ * panda-compiler can compile a parse graph into a bytecode program (output
+ * file with a .bc.c extension) that is run by the interpreter in the PANDA
+ * library instead of generated or generic C code. A program is a flat array
+ * of fixed size instructions without pointers, so it can be saved to a
+ * buffer or file and loaded on another system without a C compiler.
+ *
+ * The interpreter has three registers: the accumulator, the current header
+ * length, and the minimum length of the current header. Each parse node
+ * starts with a NODE instruction that checks the minimum length of the
+ * protocol node. Loads read fields of the current
+ * header, TABLE instructions dispatch on the accumulator, and EXTRACT
+ * instructions run one of the canned metadata templates of parser_metadata.h
+ * on a struct panda_metadata_all frame. There are no function pointers in a
+ * program.
+ *
+ * Values are loaded in host byte order, the same as the next protocol
+ * functions of the protocol nodes. A saved program can only be loaded on a
+ * system with the same byte order.
+ */
+
+#include <stddef.h>
+#include <linux/types.h>
+
+#include "panda/parser_types.h"
+
+/* Instruction opcodes. k, off, and size are the fields of
+ * struct panda_bc_insn
+ */
+enum panda_bc_op {
+	/* Start of a parse node. If fewer than k bytes remain return
+	 * PANDA_STOP_LENGTH, else set the header length and minimum
+	 * length to k
+	 */
+	PANDA_BC_OP_NODE,
+
+	/* Set the header length to the accumulator. Return
+	 * PANDA_STOP_LENGTH if the length is greater than the remaining
+	 * bytes or less than the minimum length
+	 */
+	PANDA_BC_OP_LEN,
+
+	/* Load size (1, 2, or 4) bytes at offset k of the header */
+	PANDA_BC_OP_LD,
+
+	/* Load the immediate k */
+	PANDA_BC_OP_LDI,
+
+	/* Arithmetic on the accumulator with the immediate k */
+	PANDA_BC_OP_AND,
+	PANDA_BC_OP_ADD,
+	PANDA_BC_OP_SHL,
+	PANDA_BC_OP_SHR,
+
+	/* Jump to off if the accumulator is equal to k, not equal to k,
+	 * greater than or equal to k, or has any bit of k set. Jumps
+	 * within a node only go forward
+	 */
+	PANDA_BC_OP_JEQ,
+	PANDA_BC_OP_JNE,
+	PANDA_BC_OP_JGE,
+	PANDA_BC_OP_JSET,
+
+	/* Return k (a PANDA_STOP_* code) */
+	PANDA_BC_OP_RET,
+
+	/* Run built in metadata extractor k (enum panda_bc_extract) */
+	PANDA_BC_OP_EXTRACT,
+
+	/* New encapsulation layer */
+	PANDA_BC_OP_ENCAP,
+
+	/* Look up the accumulator in the following k CASE instructions. If
+	 * not found continue after the last CASE
+	 */
+	PANDA_BC_OP_TABLE,
+
+	/* Table entry. If selected move over the current header, unless
+	 * size is non-zero (overlay node), and go to the node at off
+	 */
+	PANDA_BC_OP_CASE,
+
+	/* Move over the current header, unless size is non-zero, and go to
+	 * the node at off
+	 */
+	PANDA_BC_OP_NEXT,
+
+	PANDA_BC_OP_NUM
+};
+
+struct panda_bc_insn {
+	__u8 op;
+	__u8 size;
+	__u16 off;
+	__u32 k;
+};
+
+/* Built in metadata extractors, one for each canned metadata template
+ * instantiated for struct panda_metadata_all
+ */
+enum panda_bc_extract {
+	PANDA_BC_EXTRACT_ether,
+	PANDA_BC_EXTRACT_ether_off,
+	PANDA_BC_EXTRACT_ether_noaddrs,
+	PANDA_BC_EXTRACT_ipv4,
+	PANDA_BC_EXTRACT_ipv4_addrs,
+	PANDA_BC_EXTRACT_ipv6,
+	PANDA_BC_EXTRACT_ipv6_addrs,
+	PANDA_BC_EXTRACT_ports,
+	PANDA_BC_EXTRACT_ports_off,
+	PANDA_BC_EXTRACT_ip_overlay,
+	PANDA_BC_EXTRACT_ipv6_eh,
+	PANDA_BC_EXTRACT_ipv6_frag,
+	PANDA_BC_EXTRACT_ipv6_frag_noinfo,
+	PANDA_BC_EXTRACT_arp_rarp,
+	PANDA_BC_EXTRACT_vlan_8021AD,
+	PANDA_BC_EXTRACT_vlan_8021Q,
+	PANDA_BC_EXTRACT_icmp,
+	PANDA_BC_EXTRACT_mpls,
+	PANDA_BC_EXTRACT_tipc,
+
+	PANDA_BC_EXTRACT_NUM
+};
+
+/* Helpers to build instructions, used by the code generated by
+ * panda-compiler
+ */
+#define PANDA_BC_INSN(OP, SIZE, OFF, K)					\
+	{ .op = PANDA_BC_OP_##OP, .size = SIZE, .off = OFF, .k = K }
+
+#define PANDA_BC_NODE(MIN_LEN)		PANDA_BC_INSN(NODE, 0, 0, MIN_LEN)
+#define PANDA_BC_LEN()			PANDA_BC_INSN(LEN, 0, 0, 0)
+#define PANDA_BC_LD(SIZE, OFFSET)	PANDA_BC_INSN(LD, SIZE, 0, OFFSET)
+#define PANDA_BC_LDI(K)			PANDA_BC_INSN(LDI, 0, 0, K)
+#define PANDA_BC_AND(K)			PANDA_BC_INSN(AND, 0, 0, K)
+#define PANDA_BC_ADD(K)			PANDA_BC_INSN(ADD, 0, 0, K)
+#define PANDA_BC_SHL(K)			PANDA_BC_INSN(SHL, 0, 0, K)
+#define PANDA_BC_SHR(K)			PANDA_BC_INSN(SHR, 0, 0, K)
+#define PANDA_BC_JEQ(K, TARGET)		PANDA_BC_INSN(JEQ, 0, TARGET, K)
+#define PANDA_BC_JNE(K, TARGET)		PANDA_BC_INSN(JNE, 0, TARGET, K)
+#define PANDA_BC_JGE(K, TARGET)		PANDA_BC_INSN(JGE, 0, TARGET, K)
+#define PANDA_BC_JSET(K, TARGET)	PANDA_BC_INSN(JSET, 0, TARGET, K)
+#define PANDA_BC_RET(CODE)		PANDA_BC_INSN(RET, 0, 0, (__u32)(CODE))
+#define PANDA_BC_EXTRACT(TEMP)						\
+	PANDA_BC_INSN(EXTRACT, 0, 0, PANDA_BC_EXTRACT_##TEMP)
+#define PANDA_BC_ENCAP()		PANDA_BC_INSN(ENCAP, 0, 0, 0)
+#define PANDA_BC_TABLE(NUM)		PANDA_BC_INSN(TABLE, 0, 0, NUM)
+#define PANDA_BC_CASE(VALUE, OVERLAY, TARGET)				\
+	PANDA_BC_INSN(CASE, OVERLAY, TARGET, (__u32)(VALUE))
+#define PANDA_BC_NEXT(OVERLAY, TARGET)	PANDA_BC_INSN(NEXT, OVERLAY, TARGET, 0)
+
+/* A bytecode program. The root node is at instruction zero */
+struct panda_bc_prog {
+	const char *name;
+	const struct panda_bc_insn *insns;
+	unsigned int num_insns;
+};
+
+#define PANDA_BC_PROG(NAME, INSNS)					\
+	const struct panda_bc_prog NAME = {				\
+		.name = #NAME,						\
+		.insns = INSNS,						\
+		.num_insns = sizeof(INSNS) / sizeof(INSNS[0]),		\
+	}
+
+#define PANDA_BC_PROG_DECL(NAME)					\
+	extern const struct panda_bc_prog NAME
+
+/* Saved program image: this header followed by the instructions */
+#define PANDA_BC_MAGIC		0x43424e50	/* "PNBC" */
+#define PANDA_BC_VERSION	1
+
+#define PANDA_BC_F_BIG_ENDIAN	(1 << 0)
+
+#define PANDA_BC_NAME_LEN	32
+
+struct panda_bc_image_hdr {
+	__u32 magic;
+	__u16 version;
+	__u16 flags;
+	__u32 num_insns;
+	__u32 rsvd;
+	char name[PANDA_BC_NAME_LEN];	/* NUL padded */
+};
+
+/* Maximum number of nodes visited in a parse. Nodes that don't move over
+ * their header (overlay or zero length nodes) can loop, the parse fails
+ * with PANDA_STOP_FAIL when the limit is reached
+ */
+#ifndef PANDA_BC_MAX_NODES
+#define PANDA_BC_MAX_NODES	256
+#endif
+
+/* Parse a packet with a bytecode program. Arguments and return codes are
+ * the same as for panda_parse. The metadata frames are struct
+ * panda_metadata_all. The encapsulation summaries have no protocol node
+ */
+int panda_bc_parse(const struct panda_bc_prog *prog, const void *hdr,
+		   size_t len, struct panda_metadata *metadata,
+		   unsigned int flags, unsigned int max_encaps);
+
+/* Check that a program is well formed: opcodes, jump and node targets,
+ * and that loads and the headers read by extractors are within the minimum
+ * length of the node. Returns zero if the program is valid
+ */
+int panda_bc_validate(const struct panda_bc_prog *prog);
+
+/* Size of the saved image of a program */
+size_t panda_bc_image_size(const struct panda_bc_prog *prog);
+
+/* Save a program to buf, which has size bytes. Returns the size of the
+ * image or -1 if buf is too small
+ */
+ssize_t panda_bc_save(const struct panda_bc_prog *prog, void *buf,
+		      size_t size);
+
+/* Load and validate a program image. Returns a program to be released with
+ * panda_bc_free, or NULL if the image is malformed, has a different byte
+ * order, or memory allocation failed
+ */
+struct panda_bc_prog *panda_bc_load(const void *buf, size_t size);
+
+/* Release a program returned by panda_bc_load */
+void panda_bc_free(struct panda_bc_prog *prog);
+
+/* Save a program to, or load a program from, a file */
+int panda_bc_save_file(const struct panda_bc_prog *prog,
+		       const char *path);
+struct panda_bc_prog *panda_bc_load_file(const char *path);
+
+#endif /* __PANDA_BYTECODE_H__ */
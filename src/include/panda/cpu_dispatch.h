@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2020,2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __PANDA_CPU_DISPATCH_H__
+#define __PANDA_CPU_DISPATCH_H__
+
+/* Runtime CPU feature dispatch for hot kernels in the PANDA library
+ *
+ * The library is compiled for the baseline target. Kernels that benefit from
+ * newer instructions are also compiled for higher CPU levels, and the best
+ * variant supported by the running CPU is selected by panda_parser_init().
+ * The level can be forced (lowered) for testing by setting the
+ * PANDA_CPU_LEVEL environment variable to a level number or name, or by
+ * calling panda_cpu_dispatch_init with a level.
+ */
+
+#include <stddef.h>
+
+#include <linux/types.h>
+
+/* CPU levels. On x86-64 these correspond to microarchitecture levels, on
+ * other architectures only the baseline is available
+ */
+enum panda_cpu_level {
+	PANDA_CPU_LEVEL_BASELINE = 0,
+	PANDA_CPU_LEVEL_V2 = 1,		/* SSE4.2, POPCNT */
+	PANDA_CPU_LEVEL_V3 = 2,		/* AVX2, BMI2 */
+	PANDA_CPU_LEVEL_V4 = 3,		/* AVX-512 */
+
+	PANDA_CPU_LEVEL_NUM
+};
+
+#define PANDA_CPU_LEVEL_ENV	"PANDA_CPU_LEVEL"
+
+/* Dispatched kernels:
+ *
+ * tlv_skip_pad: Return the number of leading bytes in cp, up to len, that
+ *	are equal to pad (e.g. TCP NOP options)
+ */
+struct panda_cpu_ops {
+	size_t (*tlv_skip_pad)(const __u8 *cp, size_t len, __u8 pad);
+};
+
+extern struct panda_cpu_ops panda_cpu_ops;
+
+/* Select kernel variants. If level is less than zero the level is taken from
+ * the PANDA_CPU_LEVEL environment variable if it is set, else the highest
+ * level supported by the CPU is used. A level higher than what the CPU
+ * supports is lowered. Returns the selected level
+ */
+enum panda_cpu_level panda_cpu_dispatch_init(int level);
+
+/* Return the highest level supported by the CPU */
+enum panda_cpu_level panda_cpu_level_detect(void);
+
+/* Return the currently selected level */
+enum panda_cpu_level panda_cpu_level_get(void);
+
+/* Return the text name of a level */
+const char *panda_cpu_level_name(enum panda_cpu_level level);
+
+#endif /* __PANDA_CPU_DISPATCH_H__ */
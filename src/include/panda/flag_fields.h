@@ -309,6 +309,7 @@ struct panda_proto_flag_fields_node {
 				&PROTO_FLAG_FIELDS_NODE.proto_node,	\
 		.parse_node.ops.extract_metadata = EXTRACT_METADATA,	\
 		.parse_node.ops.handle_proto = HANDLER,			\
+		.parse_node.unknown_ret = PANDA_STOP_UNKNOWN_PROTO,	\
 		.parse_node.wildcard_node = WILDCARD_NODE,		\
 		.parse_node.proto_table = PROTO_TABLE,			\
 	}
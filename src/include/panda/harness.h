@@ -0,0 +1,638 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2020,2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __PANDA_HARNESS_H__
+#define __PANDA_HARNESS_H__
+
+/* Benchmark and fuzz harness for parsers compiled by panda-compiler (see
+ * --harness). The generic parser and the optimized parser of the same parse
+ * graph parse the same packets: their results must be the same, and the
+ * cycles each one takes are counted per path of parse nodes. Packets are read
+ * from a pcap file, or synthesized to take each edge of the parse graph
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "panda/parser.h"
+
+/* Maximum number of parse nodes in a path */
+#ifndef PANDA_HARNESS_MAX_PATH
+#define PANDA_HARNESS_MAX_PATH 16
+#endif
+
+#ifndef PANDA_HARNESS_MAX_PATHS
+#define PANDA_HARNESS_MAX_PATHS 1024
+#endif
+
+#ifndef PANDA_HARNESS_MAX_EDGES
+#define PANDA_HARNESS_MAX_EDGES 1024
+#endif
+
+/* Length of the synthesized packets */
+#ifndef PANDA_HARNESS_SYNTH_LEN
+#define PANDA_HARNESS_SYNTH_LEN 256
+#endif
+
+/* Length of the metadata of a parser, with struct panda_metadata */
+#ifndef PANDA_HARNESS_METADATA_LEN
+#define PANDA_HARNESS_METADATA_LEN 4096
+#endif
+
+#ifndef PANDA_HARNESS_MAX_ENCAPS
+#define PANDA_HARNESS_MAX_ENCAPS 4
+#endif
+
+/* Name of a parse node in the reports */
+struct panda_harness_node {
+	const struct panda_parse_node *node;
+	const char *name;
+};
+
+/* Parse nodes a packet goes through, their offsets and header lengths. next
+ * is the node that failed its length check, if any
+ */
+struct panda_harness_walk {
+	unsigned int num;
+	const struct panda_parse_node *nodes[PANDA_HARNESS_MAX_PATH];
+	size_t offsets[PANDA_HARNESS_MAX_PATH];
+	size_t lens[PANDA_HARNESS_MAX_PATH];
+	const struct panda_parse_node *next;
+	size_t next_offset;
+};
+
+struct panda_harness_path {
+	unsigned int num;
+	const struct panda_parse_node *nodes[PANDA_HARNESS_MAX_PATH];
+	unsigned long packets;
+	unsigned long long generic_cycles;
+	unsigned long long opt_cycles;
+};
+
+struct panda_harness_edge {
+	const struct panda_parse_node *from;
+	const struct panda_parse_node *to;
+	int value;
+	bool wildcard;
+	bool taken;
+};
+
+struct panda_harness {
+	const struct panda_harness_node *names;
+	unsigned int num_names;
+	unsigned int repeat;
+	bool verbose;
+
+	unsigned long packets;
+	unsigned long mismatches;
+
+	unsigned int num_paths;
+	struct panda_harness_path paths[PANDA_HARNESS_MAX_PATHS];
+	unsigned int num_edges;
+	struct panda_harness_edge edges[PANDA_HARNESS_MAX_EDGES];
+
+	union {
+		struct panda_metadata metadata;
+		__u8 buf[PANDA_HARNESS_METADATA_LEN];
+	} generic_md, opt_md;
+};
+
+/* Cycle counter of the CPU, or nanoseconds if there is none */
+static inline unsigned long long panda_harness_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+	unsigned long long v;
+
+	asm volatile("mrs %0, cntvct_el0" : "=r" (v));
+
+	return v;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline const char *panda_harness_name(const struct panda_harness *h,
+					     const struct panda_parse_node *node)
+{
+	unsigned int i;
+
+	for (i = 0; i < h->num_names; i++)
+		if (h->names[i].node == node)
+			return h->names[i].name;
+
+	return node->proto_node->name;
+}
+
+/* Walk the parse graph from ROOT as the generic parser does, without
+ * metadata, TLVs, or flag fields
+ */
+static inline void panda_harness_walk(const struct panda_parse_node *root,
+				      const void *hdr, size_t len,
+				      struct panda_harness_walk *w)
+{
+	const struct panda_parse_node *node = root, *next;
+	size_t offset = 0;
+	ssize_t hlen;
+	int i, type;
+
+	w->num = 0;
+	w->next = NULL;
+
+	while (w->num < PANDA_HARNESS_MAX_PATH) {
+		const struct panda_proto_node *proto_node = node->proto_node;
+
+		hlen = proto_node->min_len;
+		if (len < hlen)
+			goto len_fail;
+		if (proto_node->ops.len) {
+			hlen = proto_node->ops.len(hdr + offset);
+			if (hlen < (ssize_t)proto_node->min_len || len < hlen)
+				goto len_fail;
+		}
+
+		w->nodes[w->num] = node;
+		w->offsets[w->num] = offset;
+		w->lens[w->num] = hlen;
+		w->num++;
+
+		next = NULL;
+		if (proto_node->ops.next_proto && node->proto_table) {
+			type = proto_node->ops.next_proto(hdr + offset);
+			if (type < 0)
+				return;
+			for (i = 0; i < node->proto_table->num_ents; i++)
+				if (node->proto_table->entries[i].value ==
+								type) {
+					next = node->proto_table->entries[i].node;
+					break;
+				}
+		}
+		if (!next)
+			next = node->wildcard_node;
+		if (!next)
+			return;
+
+		if (!proto_node->overlay) {
+			offset += hlen;
+			len -= hlen;
+		}
+		node = next;
+	}
+
+	return;
+
+len_fail:
+	w->next = node;
+	w->next_offset = offset;
+}
+
+static inline void panda_harness_add_edge(struct panda_harness *h,
+					  const struct panda_parse_node *from,
+					  const struct panda_parse_node *to,
+					  int value, bool wildcard)
+{
+	unsigned int i;
+
+	for (i = 0; i < h->num_edges; i++)
+		if (h->edges[i].from == from && h->edges[i].to == to)
+			return;
+
+	if (h->num_edges == PANDA_HARNESS_MAX_EDGES)
+		return;
+
+	h->edges[h->num_edges].from = from;
+	h->edges[h->num_edges].to = to;
+	h->edges[h->num_edges].value = value;
+	h->edges[h->num_edges].wildcard = wildcard;
+	h->edges[h->num_edges].taken = false;
+	h->num_edges++;
+}
+
+static inline void panda_harness_add_node(
+		const struct panda_parse_node **nodes, unsigned int *num,
+		const struct panda_parse_node *node)
+{
+	unsigned int i;
+
+	for (i = 0; i < *num; i++)
+		if (nodes[i] == node)
+			return;
+
+	if (*num <= PANDA_HARNESS_MAX_EDGES)
+		nodes[(*num)++] = node;
+}
+
+/* Find the edges of the parse graph from ROOT */
+static inline void panda_harness_edges(struct panda_harness *h,
+				       const struct panda_parse_node *root)
+{
+	const struct panda_parse_node *nodes[PANDA_HARNESS_MAX_EDGES + 1];
+	const struct panda_proto_table *table;
+	unsigned int i, num = 0;
+	int j;
+
+	h->num_edges = 0;
+	panda_harness_add_node(nodes, &num, root);
+
+	for (i = 0; i < num; i++) {
+		table = nodes[i]->proto_table;
+		for (j = 0; table && j < table->num_ents; j++) {
+			panda_harness_add_edge(h, nodes[i],
+					       table->entries[j].node,
+					       table->entries[j].value, false);
+			panda_harness_add_node(nodes, &num,
+					       table->entries[j].node);
+		}
+		if (nodes[i]->wildcard_node) {
+			panda_harness_add_edge(h, nodes[i],
+					       nodes[i]->wildcard_node, 0,
+					       true);
+			panda_harness_add_node(nodes, &num,
+					       nodes[i]->wildcard_node);
+		}
+	}
+}
+
+/* Mark the edges of a walk as taken */
+static inline void panda_harness_take(struct panda_harness *h,
+				      const struct panda_harness_walk *w)
+{
+	unsigned int i, j;
+
+	for (i = 0; i + 1 < w->num; i++)
+		for (j = 0; j < h->num_edges; j++)
+			if (h->edges[j].from == w->nodes[i] &&
+			    h->edges[j].to == w->nodes[i + 1])
+				h->edges[j].taken = true;
+}
+
+/* Parse a packet with the generic and the optimized parser, returns true if
+ * the return codes and the metadata are the same
+ */
+static inline bool panda_harness_compare(struct panda_harness *h,
+					 const struct panda_parser *parser,
+					 const struct panda_parser *opt,
+					 const void *hdr, size_t len,
+					 int *generic_ret, int *opt_ret)
+{
+	memset(&h->generic_md, 0, sizeof(h->generic_md));
+	memset(&h->opt_md, 0, sizeof(h->opt_md));
+
+	*generic_ret = panda_parse(parser, hdr, len, &h->generic_md.metadata,
+				   0, PANDA_HARNESS_MAX_ENCAPS);
+	*opt_ret = panda_parse(opt, hdr, len, &h->opt_md.metadata,
+			       0, PANDA_HARNESS_MAX_ENCAPS);
+
+	return *generic_ret == *opt_ret &&
+	       !memcmp(&h->generic_md, &h->opt_md, sizeof(h->generic_md));
+}
+
+static inline struct panda_harness_path *panda_harness_path(
+		struct panda_harness *h, const struct panda_harness_walk *w)
+{
+	struct panda_harness_path *path;
+	unsigned int i;
+
+	for (i = 0; i < h->num_paths; i++) {
+		path = &h->paths[i];
+		if (path->num == w->num &&
+		    !memcmp(path->nodes, w->nodes,
+			    w->num * sizeof(w->nodes[0])))
+			return path;
+	}
+
+	if (h->num_paths == PANDA_HARNESS_MAX_PATHS)
+		return NULL;
+
+	path = &h->paths[h->num_paths++];
+	memset(path, 0, sizeof(*path));
+	path->num = w->num;
+	memcpy(path->nodes, w->nodes, w->num * sizeof(w->nodes[0]));
+
+	return path;
+}
+
+static inline void panda_harness_print_path(const struct panda_harness *h,
+					    const struct panda_parse_node
+							*const nodes[],
+					    unsigned int num, FILE *f)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++)
+		fprintf(f, "%s%s", i ? "," : "", panda_harness_name(h, nodes[i]));
+}
+
+/* Compare the parsers on a packet, then time each one h->repeat times */
+static inline void panda_harness_run(struct panda_harness *h,
+				     const struct panda_parser *parser,
+				     const struct panda_parser *opt,
+				     const void *hdr, size_t len)
+{
+	struct panda_harness_path *path;
+	struct panda_harness_walk w;
+	int generic_ret, opt_ret;
+	unsigned long long start;
+	unsigned int i;
+
+	panda_harness_walk(parser->root_node, hdr, len, &w);
+	panda_harness_take(h, &w);
+	h->packets++;
+
+	if (!panda_harness_compare(h, parser, opt, hdr, len, &generic_ret,
+				   &opt_ret)) {
+		h->mismatches++;
+		if (h->verbose) {
+			printf("mismatch on packet %lu (", h->packets);
+			panda_harness_print_path(h, w.nodes, w.num, stdout);
+			printf("): generic parser %d, optimized parser %d%s\n",
+			       generic_ret, opt_ret,
+			       generic_ret == opt_ret ? ", metadata differs" :
+							"");
+		}
+	}
+
+	path = panda_harness_path(h, &w);
+	if (!path)
+		return;
+	path->packets++;
+
+	start = panda_harness_cycles();
+	for (i = 0; i < h->repeat; i++)
+		panda_parse(parser, hdr, len, &h->generic_md.metadata, 0,
+			    PANDA_HARNESS_MAX_ENCAPS);
+	path->generic_cycles += panda_harness_cycles() - start;
+
+	start = panda_harness_cycles();
+	for (i = 0; i < h->repeat; i++)
+		panda_parse(opt, hdr, len, &h->opt_md.metadata, 0,
+			    PANDA_HARNESS_MAX_ENCAPS);
+	path->opt_cycles += panda_harness_cycles() - start;
+}
+
+/* True if a walk goes through the first DEPTH nodes of W and then NODE */
+static inline bool panda_harness_reaches(const struct panda_harness_walk *w,
+					 const struct panda_harness_walk *walk,
+					 unsigned int depth,
+					 const struct panda_parse_node *node)
+{
+	return walk->num > depth && walk->nodes[depth] == node &&
+	       !memcmp(walk->nodes, w->nodes, depth * sizeof(w->nodes[0]));
+}
+
+/* Set a byte of the header of NODE, which fails its length check, so that
+ * the packet reaches it at DEPTH
+ */
+static inline bool panda_harness_synth_len(const struct panda_parse_node *root,
+					   __u8 *pkt,
+					   const struct panda_harness_walk *w,
+					   unsigned int depth,
+					   const struct panda_parse_node *node,
+					   size_t offset)
+{
+	struct panda_harness_walk walk;
+	size_t i;
+	int v;
+
+	for (i = offset; i < offset + node->proto_node->min_len &&
+			 i < PANDA_HARNESS_SYNTH_LEN; i++) {
+		__u8 save = pkt[i];
+
+		for (v = 1; v < 256; v++) {
+			pkt[i] = v;
+			panda_harness_walk(root, pkt, PANDA_HARNESS_SYNTH_LEN,
+					   &walk);
+			if (panda_harness_reaches(w, &walk, depth, node))
+				return true;
+		}
+		pkt[i] = save;
+	}
+
+	return false;
+}
+
+/* Set the next protocol of the node at DEPTH - 1 to the value of an edge to
+ * NODE, as a sixteen bit field in network or host byte order, a byte, or
+ * either half of a byte, and make the header of NODE valid
+ */
+static inline bool panda_harness_synth_edge(const struct panda_parse_node *root,
+					    __u8 *pkt,
+					    const struct panda_harness_walk *w,
+					    unsigned int depth,
+					    const struct panda_harness_edge *e)
+{
+	size_t offset = w->offsets[depth - 1], i;
+	struct panda_harness_walk walk;
+	unsigned int form;
+	__u8 save[2];
+	__u16 v16;
+
+	if (e->wildcard) {
+		/* The wildcard is taken if the next protocol isn't in the
+		 * table
+		 */
+		panda_harness_walk(root, pkt, PANDA_HARNESS_SYNTH_LEN, &walk);
+		if (panda_harness_reaches(w, &walk, depth, e->to))
+			return true;
+		return walk.num == depth && walk.next == e->to &&
+		       panda_harness_synth_len(root, pkt, w, depth, e->to,
+					       walk.next_offset);
+	}
+
+	for (i = offset; i < offset + w->lens[depth - 1]; i++) {
+		memcpy(save, &pkt[i], sizeof(save));
+
+		for (form = 0; form < 5; form++) {
+			switch (form) {
+			case 0:
+				if (i + 1 >= offset + w->lens[depth - 1] ||
+				    e->value > 0xffff)
+					continue;
+				pkt[i] = e->value >> 8;
+				pkt[i + 1] = e->value;
+				break;
+			case 1:
+				/* Tables of EtherTypes and the like hold
+				 * values in network byte order
+				 */
+				if (i + 1 >= offset + w->lens[depth - 1] ||
+				    e->value > 0xffff)
+					continue;
+				v16 = e->value;
+				memcpy(&pkt[i], &v16, sizeof(v16));
+				break;
+			case 2:
+				if (e->value > 0xff)
+					continue;
+				pkt[i] = e->value;
+				break;
+			case 3:
+				if (e->value > 0xf)
+					continue;
+				pkt[i] = (save[0] & 0x0f) | e->value << 4;
+				break;
+			case 4:
+				if (e->value > 0xf)
+					continue;
+				pkt[i] = (save[0] & 0xf0) | e->value;
+				break;
+			}
+
+			panda_harness_walk(root, pkt, PANDA_HARNESS_SYNTH_LEN,
+					   &walk);
+			if (panda_harness_reaches(w, &walk, depth, e->to))
+				return true;
+			if (walk.num == depth && walk.next == e->to &&
+			    !memcmp(walk.nodes, w->nodes,
+				    depth * sizeof(w->nodes[0])) &&
+			    panda_harness_synth_len(root, pkt, w, depth,
+						    e->to, walk.next_offset))
+				return true;
+
+			memcpy(&pkt[i], save, sizeof(save));
+		}
+	}
+
+	return false;
+}
+
+/* Synthesize up to MAX packets of PANDA_HARNESS_SYNTH_LEN bytes that take
+ * the edges of the parse graph from ROOT. Each packet branches off the path
+ * of an earlier packet by one edge that no earlier packet takes. Edges that
+ * depend on more than one field of a header may not be taken. Returns the
+ * number of packets
+ */
+static inline unsigned int panda_harness_synth(struct panda_harness *h,
+				const struct panda_parse_node *root,
+				__u8 (*pkts)[PANDA_HARNESS_SYNTH_LEN],
+				unsigned int max)
+{
+	struct panda_harness_walk w, walk;
+	unsigned int i, j, depth, n = 1;
+
+	panda_harness_edges(h, root);
+
+	memset(pkts[0], 0, PANDA_HARNESS_SYNTH_LEN);
+	panda_harness_walk(root, pkts[0], PANDA_HARNESS_SYNTH_LEN, &w);
+	if (!w.num && !panda_harness_synth_len(root, pkts[0], &w, 0, root, 0))
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		panda_harness_walk(root, pkts[i], PANDA_HARNESS_SYNTH_LEN, &w);
+		panda_harness_take(h, &w);
+		if (!w.num)
+			continue;
+
+		for (j = 0; j < h->num_edges && n < max; j++) {
+			const struct panda_harness_edge *e = &h->edges[j];
+
+			if (e->taken)
+				continue;
+
+			for (depth = 1; depth <= w.num; depth++)
+				if (w.nodes[depth - 1] == e->from)
+					break;
+			if (depth > w.num)
+				continue;
+
+			memcpy(pkts[n], pkts[i], PANDA_HARNESS_SYNTH_LEN);
+			if (!panda_harness_synth_edge(root, pkts[n], &w, depth,
+						      e))
+				continue;
+
+			panda_harness_walk(root, pkts[n],
+					   PANDA_HARNESS_SYNTH_LEN, &walk);
+			panda_harness_take(h, &walk);
+			n++;
+		}
+	}
+
+	return n;
+}
+
+/* Print the packets, cycles per packet of each parser, and path of each
+ * path, and the edges that weren't taken
+ */
+static inline void panda_harness_report(const struct panda_harness *h,
+					const char *name, FILE *f)
+{
+	unsigned int i, taken = 0;
+
+	for (i = 0; i < h->num_edges; i++)
+		taken += h->edges[i].taken;
+
+	fprintf(f, "Parser %s: %lu packets, %lu mismatches, %u of %u edges "
+		"taken\n", name, h->packets, h->mismatches, taken,
+		h->num_edges);
+	fprintf(f, "%10s %10s %10s  %s\n", "packets", "generic", "optimized",
+		"path");
+
+	for (i = 0; i < h->num_paths; i++) {
+		const struct panda_harness_path *path = &h->paths[i];
+		unsigned long long n = (unsigned long long)path->packets *
+								h->repeat;
+
+		fprintf(f, "%10lu %10.1f %10.1f  ", path->packets,
+			n ? (double)path->generic_cycles / n : 0,
+			n ? (double)path->opt_cycles / n : 0);
+		panda_harness_print_path(h, path->nodes, path->num, f);
+		fprintf(f, "\n");
+	}
+
+	for (i = 0; i < h->num_edges; i++)
+		if (!h->edges[i].taken)
+			fprintf(f, "edge not taken: %s -> %s\n",
+				panda_harness_name(h, h->edges[i].from),
+				panda_harness_name(h, h->edges[i].to));
+}
+
+/* Write the packet count of each path as a profile for --hot-profile */
+static inline void panda_harness_profile(const struct panda_harness *h,
+					 FILE *f)
+{
+	unsigned int i;
+
+	for (i = 0; i < h->num_paths; i++) {
+		/* A hot path has at least two nodes */
+		if (h->paths[i].num < 2)
+			continue;
+		fprintf(f, "%lu ", h->paths[i].packets);
+		panda_harness_print_path(h, h->paths[i].nodes,
+					 h->paths[i].num, f);
+		fprintf(f, "\n");
+	}
+}
+
+#endif /* __PANDA_HARNESS_H__ */
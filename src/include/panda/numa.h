@@ -0,0 +1,147 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2020,2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef __PANDA_NUMA_H__
+#define __PANDA_NUMA_H__
+
+/* NUMA replication of parser graphs and the hash key
+ *
+ * When panda_parser_init_flags() is called with PANDA_PARSER_INIT_F_NUMA,
+ * the parse graph of each generic parser (parse nodes, protocol nodes,
+ * protocol tables, TLV and flag-field tables) and the hash key are copied
+ * into memory local to each NUMA node on which the process may run. The
+ * replicated graphs are read only. panda_parse() and panda_compute_hash()
+ * then use the replica for the node of the calling thread. The node of a
+ * thread is looked up once on first use, so threads should be bound to
+ * CPUs of one node.
+ *
+ * Only generic parsers (PANDA_GENERIC) are replicated. The code of an
+ * optimized parser made by panda-compiler refers to its parse nodes
+ * directly, so optimized parsers always use the single global graph.
+ *
+ * On a single node system, or if the NUMA topology can't be read, there is
+ * one replica that is used by all threads.
+ */
+
+#include <linux/types.h>
+
+#include "panda/parser_types.h"
+#include "siphash/siphash.h"
+
+#ifdef __bpf__
+
+/* No replication in BPF programs */
+
+static inline const struct panda_parser *panda_parser_numa_local(
+					const struct panda_parser *parser)
+{
+	return parser;
+}
+
+static inline const siphash_key_t *panda_numa_hash_key(
+					const siphash_key_t *key)
+{
+	return key;
+}
+
+#else
+
+/* Number of entries in per node arrays, zero if replication is not enabled */
+extern unsigned int __panda_numa_num_nodes;
+
+/* Node local hash keys indexed by node */
+extern siphash_key_t **__panda_numa_hash_keys;
+
+/* NUMA node of the calling thread, -1 if not yet looked up */
+extern __thread int __panda_numa_node;
+
+/* Look up the node of the calling thread and set __panda_numa_node */
+int __panda_numa_node_lookup(void);
+
+/* Return true if replication is enabled. Replication is off by default so
+ * the check is marked unlikely to keep it cheap in the per packet path
+ */
+static inline bool panda_numa_enabled(void)
+{
+	return __builtin_expect(!!__panda_numa_num_nodes, 0);
+}
+
+/* Return the NUMA node of the calling thread as an index into the per
+ * node arrays
+ */
+static inline unsigned int panda_numa_node(void)
+{
+	int node = __panda_numa_node;
+
+	if (node < 0)
+		node = __panda_numa_node_lookup();
+
+	return node;
+}
+
+/* Return the replica of a parser for the node of the calling thread, or
+ * the parser itself if it is not replicated
+ */
+static inline const struct panda_parser *panda_parser_numa_local(
+					const struct panda_parser *parser)
+{
+	if (!panda_numa_enabled() || !parser->numa_replicas)
+		return parser;
+
+	return parser->numa_replicas[panda_numa_node()];
+}
+
+/* Return the hash key for the node of the calling thread */
+static inline const siphash_key_t *panda_numa_hash_key(
+					const siphash_key_t *key)
+{
+	if (!panda_numa_enabled() || !__panda_numa_hash_keys)
+		return key;
+
+	return __panda_numa_hash_keys[panda_numa_node()];
+}
+
+/* Discover the NUMA nodes in use and allocate the node local hash keys.
+ * Returns zero on success
+ */
+int panda_numa_init(const siphash_key_t *key);
+
+/* Replicate the parse graph of a parser to each node in use. Optimized
+ * parsers are left as is. Returns zero on success, on failure nothing is
+ * left allocated for the parser
+ */
+int panda_numa_replicate_parser(struct panda_parser *parser);
+
+/* Make the replicated graphs read only */
+void panda_numa_freeze(void);
+
+/* Copy a new hash key to all the node local replicas */
+void panda_numa_set_hash_key(const siphash_key_t *key);
+
+#endif /* __bpf__ */
+
+#endif /* __PANDA_NUMA_H__ */
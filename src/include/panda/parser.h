@@ -41,24 +41,15 @@
 #include "panda/utility.h"
 
 #ifndef __KERNEL__
+#include <string.h>
+
+#include "panda/cpu_dispatch.h"
 #include "siphash/siphash.h"
+#include "panda/numa.h"
+#else
+#include <linux/string.h>
 #endif
 
-/* Panda parser return codes */
-enum {
-	PANDA_OKAY = 0,			/* Okay and continue */
-	PANDA_STOP_OKAY = -1,		/* Okay and stop parsing */
-
-	/* Parser failure */
-	PANDA_STOP_FAIL = -2,
-	PANDA_STOP_LENGTH = -3,
-	PANDA_STOP_UNKNOWN_PROTO = -4,
-	PANDA_STOP_ENCAP_DEPTH = -5,
-	PANDA_STOP_UNKNOWN_TLV = -6,
-	PANDA_STOP_TLV_LENGTH = -7,
-	PANDA_STOP_BAD_FLAG = -8,
-};
-
 /* Helper to create a parser */
 #define __PANDA_PARSER(PARSER, NAME, ROOT_NODE)				\
 static const struct panda_parser __##PARSER = {				\
@@ -86,17 +77,20 @@ static const struct panda_parser __##PARSER = {				\
 	.parser_entry_point = FUNC					\
 };
 
-/* Helpers to create and use Kmod parser vairant */
-#define __PANDA_PARSER_KMOD(PARSER, NAME, ROOT_NODE, FUNC)		\
+/* Helpers to create and use Kmod parser vairant. SKB_FUNC parses the packet
+ * of an skb (see panda_parse_skb)
+ */
+#define __PANDA_PARSER_KMOD(PARSER, NAME, ROOT_NODE, FUNC, SKB_FUNC)	\
 const struct panda_parser __##PARSER##_kmod = {				\
 	.name = NAME,							\
 	.root_node = ROOT_NODE,						\
 	.parser_type = PANDA_KMOD,					\
-	.parser_entry_point = FUNC					\
+	.parser_entry_point = FUNC,					\
+	.parser_skb_entry_point = SKB_FUNC				\
 };
 
-#define PANDA_PARSER_KMOD(PARSER, NAME, ROOT_NODE, FUNC)		\
-	__PANDA_PARSER_KMOD(PARSER, NAME, ROOT_NODE, FUNC)		\
+#define PANDA_PARSER_KMOD(PARSER, NAME, ROOT_NODE, FUNC, SKB_FUNC)	\
+	__PANDA_PARSER_KMOD(PARSER, NAME, ROOT_NODE, FUNC, SKB_FUNC)	\
 	const struct panda_parser *PARSER##_kmod = &__##PARSER##_kmod;
 
 #define PANDA_PARSER_KMOD_EXTERN(NAME)					\
@@ -202,8 +196,49 @@ static const struct panda_parser __##PARSER = {				\
 
 /* Parsing functions */
 
-/* Flags to Panda parser functions */
-#define PANDA_F_DEBUG			(1 << 0)
+/* Set the offset of the keyid field in a metadata frame structure so that
+ * the tunnel key is reported in encapsulation summaries
+ */
+#define PANDA_METADATA_SET_KEYID_OFFSET(METADATA, STRUCT)		\
+	((METADATA)->keyid_offset = offsetof(struct STRUCT, keyid) + 1)
+
+/* Process a new encapsulation layer. Check against number of encap layers
+ * allowed, record the summary of the layer, and set up the metadata frame
+ * for the next layer per the frame policy
+ */
+static inline __attribute__((always_inline)) int panda_parse_encap_layer(
+		struct panda_metadata *metadata, unsigned int max_encaps,
+		void **frame, unsigned int *frame_num,
+		const struct panda_proto_node *proto_node, size_t offset,
+		unsigned int flags)
+{
+	if (++metadata->encaps > max_encaps)
+		return PANDA_STOP_ENCAP_DEPTH;
+
+	if (metadata->encap_summary &&
+	    metadata->encaps <= metadata->max_encap_summary) {
+		struct panda_encap_summary *summary =
+			&metadata->encap_summary[metadata->encaps - 1];
+
+		summary->proto_node = proto_node;
+		summary->offset = offset;
+		summary->keyid = metadata->keyid_offset ?
+			*(__be32 *)(*frame + metadata->keyid_offset - 1) : 0;
+	}
+
+	if (flags & PANDA_F_OUTER_INNER) {
+		if (*frame_num == 0 && metadata->max_frame_num) {
+			*frame += metadata->frame_size;
+			*frame_num = 1;
+		}
+		memset(*frame, 0, metadata->frame_size);
+	} else if (metadata->max_frame_num > *frame_num) {
+		*frame += metadata->frame_size;
+		*frame_num = (*frame_num) + 1;
+	}
+
+	return PANDA_OKAY;
+}
 
 #ifndef __KERNEL__
 /* Parse starting at the provided root node */
@@ -236,6 +271,10 @@ static inline int panda_parse(const struct panda_parser *parser,
 			      struct panda_metadata *metadata,
 			      unsigned int flags, unsigned int max_encaps)
 {
+#ifndef __KERNEL__
+	parser = panda_parser_numa_local(parser);
+#endif
+
 	switch (parser->parser_type) {
 	case PANDA_GENERIC:
 		return __panda_parse(parser, hdr, len, metadata, flags,
@@ -249,6 +288,26 @@ static inline int panda_parse(const struct panda_parser *parser,
 	}
 }
 
+#ifdef __KERNEL__
+/* Parse the packet of an skb starting at offset from skb->data, for instance
+ * skb_mac_offset(skb) to parse from the Ethernet header. Kernel module parsers
+ * access the headers in place with skb_header_pointer, so the skb doesn't
+ * need to be linearized. Returns PANDA_STOP_FAIL for other parsers
+ */
+static inline int panda_parse_skb(const struct panda_parser *parser,
+				  const struct sk_buff *skb, int offset,
+				  struct panda_metadata *metadata,
+				  unsigned int flags, unsigned int max_encaps)
+{
+	if (parser->parser_type != PANDA_KMOD ||
+	    !parser->parser_skb_entry_point)
+		return PANDA_STOP_FAIL;
+
+	return (parser->parser_skb_entry_point)(parser, skb, offset, metadata,
+						flags, max_encaps);
+}
+#endif
+
 static inline const struct panda_parser *panda_lookup_parser_table(
 				const struct panda_parser_table *table,
 				int key)
@@ -290,6 +349,29 @@ static inline int panda_parse_xdp(const struct panda_parser *parser,
 #define PANDA_PARSE_XDP(PARSER, CTX, HDR, HDR_END, TAILCALL)		\
 	panda_xdp_parser_##PARSER(CTX, HDR, HDR_END, TAILCALL)
 
+/* An XDP parser may be split in several programs that tail call each other
+ * (panda-compiler --xdp-loop). PANDA_PARSE_XDP_PROG continues parsing at
+ * ctx->next in program PROG, PANDA_XDP_PROG is the program to tail call for
+ * ctx->next, and PANDA_XDP_FOR_EACH_PROG expands M(PROG, ...) for each
+ * program
+ */
+#define PANDA_PARSE_XDP_PROG(PARSER, PROG, CTX, HDR, HDR_END)		\
+	panda_xdp_parser_##PARSER##_prog(PROG, CTX, HDR, HDR_END)
+
+#define PANDA_XDP_PROG(PARSER, NEXT) panda_xdp_prog_##PARSER(NEXT)
+
+#define PANDA_XDP_NUM_PROGS(PARSER) PANDA_XDP_NUM_PROGS_##PARSER
+
+#define PANDA_XDP_FOR_EACH_PROG(PARSER, M, ...)				\
+	PANDA_XDP_FOR_EACH_PROG_##PARSER(M, __VA_ARGS__)
+
+/* Parse the packet of an skb in a TC BPF program (panda-compiler .tc.h
+ * output), BUF is a buffer of 2 * PANDA_TC_HDR_LEN bytes for headers that
+ * aren't in the linear data
+ */
+#define PANDA_PARSE_TC(PARSER, SKB, CTX, BUF)				\
+	panda_tc_parser_##PARSER(SKB, CTX, BUF)
+
 /* Helper to make an extern for a parser */
 #define PANDA_PARSER_EXTERN(NAME)					\
 	extern struct panda_parser *NAME
@@ -339,7 +421,14 @@ struct panda_parser *panda_parser_create(const char *name,
 					 const struct panda_parse_node
 								*root_node);
 void panda_parser_destroy(struct panda_parser *parser);
+
+/* Flags for panda_parser_init_flags */
+
+/* Replicate parse graphs and the hash key to each NUMA node in use */
+#define PANDA_PARSER_INIT_F_NUMA	(1 << 0)
+
 int panda_parser_init(void);
+int panda_parser_init_flags(unsigned int flags);
 
 #ifndef __KERNEL__
 
@@ -351,9 +440,10 @@ extern siphash_key_t __panda_hash_key;
  */
 static inline __u32 panda_compute_hash(const void *start, size_t len)
 {
+	const siphash_key_t *key = panda_numa_hash_key(&__panda_hash_key);
 	__u32 hash;
 
-	hash = siphash(start, len, &__panda_hash_key);
+	hash = siphash(start, len, key);
 	if (!hash)
 		hash = 1;
 
@@ -0,0 +1,439 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2020,2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __PANDA_PARSER_HPP__
+#define __PANDA_PARSER_HPP__
+
+/* C++ parsers
+ *
+ * panda-compiler can compile a parse graph into a header only C++20 parser
+ * (output file with a .hpp extension). Each parser is a type whose program,
+ * the same one as for the bytecode interpreter (see panda/bytecode.h), is a
+ * constexpr array of instructions. The instructions are instantiated as
+ * templates: every opcode and operand is a compile time constant, a node is
+ * a function, protocol tables are folded into a chain of comparisons, and
+ * nothing of the program is left at run time.
+ *
+ * The metadata frame is a structure of the caller given as a template
+ * parameter. The extractors set the fields of parser_metadata.h that the
+ * frame has, with the same names and types, and skip the others, so the
+ * loads for metadata that isn't used are not compiled in. For instance:
+ *
+ *	struct my_frame {
+ *		__u8 ip_proto;
+ *		__be32 ports;
+ *	};
+ *
+ *	panda::metadata<my_frame> md = {};
+ *
+ *	ret = panda::parse<my_parser_cxx>(hdr, len, md, 0, 4);
+ *
+ * Return codes and flags are the same as for panda_parse. Encapsulation
+ * summaries are not recorded.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <asm/byteorder.h>
+#include <linux/types.h>
+
+#include "panda/bytecode.h"
+#include "panda/proto_nodes.h"
+
+namespace panda {
+
+/* Metadata of a parse: the number of encapsulations and N frames. One frame
+ * is used for each level of encapsulation, when the number of layers
+ * exceeds N the last frame is reused. With PANDA_F_OUTER_INNER N must be
+ * two
+ */
+template <typename Frame, unsigned int N = 1>
+struct metadata {
+	unsigned int encaps;
+	Frame frame[N];
+};
+
+namespace detail {
+
+template <typename Frame, unsigned int N>
+struct state {
+	static constexpr unsigned int num_frames = N;
+
+	const __u8 *hdr;
+	size_t len;
+	size_t hlen, min_len;
+	__u32 acc;
+
+	const __u8 *base;
+	metadata<Frame, N> *md;
+	Frame *frame;
+	unsigned int frame_num;
+	unsigned int flags;
+	unsigned int max_encaps;
+};
+
+template <typename T>
+inline __attribute__((always_inline)) T load(const __u8 *p)
+{
+	T v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+/* Set FIELD of the frame if the frame has it. VALUE is only evaluated if
+ * the field is set
+ */
+#define PANDA_CXX_SET(FRAME, FIELD, VALUE) do {				\
+	if constexpr (requires { FRAME.FIELD; })			\
+		FRAME.FIELD = VALUE;					\
+} while (0)
+
+#define PANDA_CXX_COPY(FRAME, FIELD, SRC) do {				\
+	if constexpr (requires { FRAME.FIELD; })			\
+		memcpy(&FRAME.FIELD, SRC, sizeof(FRAME.FIELD));		\
+} while (0)
+
+/* Built in metadata extractors, the canned metadata templates of
+ * parser_metadata.h (enum panda_bc_extract)
+ */
+template <unsigned int E, typename Frame>
+inline __attribute__((always_inline)) void extract(const __u8 *hdr,
+						   Frame &f, size_t offset)
+{
+	if constexpr (E == PANDA_BC_EXTRACT_ether ||
+		      E == PANDA_BC_EXTRACT_ether_off ||
+		      E == PANDA_BC_EXTRACT_ether_noaddrs) {
+		if constexpr (E == PANDA_BC_EXTRACT_ether_off)
+			PANDA_CXX_SET(f, l2_off, offset);
+		PANDA_CXX_SET(f, eth_proto, load<__be16>(hdr +
+				offsetof(struct ethhdr, h_proto)));
+		if constexpr (E != PANDA_BC_EXTRACT_ether_noaddrs)
+			PANDA_CXX_COPY(f, eth_addrs,
+				       hdr + offsetof(struct ethhdr, h_dest));
+	} else if constexpr (E == PANDA_BC_EXTRACT_ipv4 ||
+			     E == PANDA_BC_EXTRACT_ipv4_addrs) {
+		if constexpr (E == PANDA_BC_EXTRACT_ipv4) {
+			__be16 frag_off = load<__be16>(hdr +
+					offsetof(struct iphdr, frag_off));
+
+			if (frag_off & htons(IP_MF | IP_OFFSET)) {
+				PANDA_CXX_SET(f, is_fragment, 1);
+				PANDA_CXX_SET(f, first_frag,
+					      !(frag_off & htons(IP_OFFSET)));
+			}
+			PANDA_CXX_SET(f, l3_off, offset);
+		}
+		PANDA_CXX_SET(f, addr_type, PANDA_ADDR_TYPE_IPV4);
+		PANDA_CXX_SET(f, ip_proto,
+			      hdr[offsetof(struct iphdr, protocol)]);
+		PANDA_CXX_COPY(f, addrs.v4_addrs,
+			       hdr + offsetof(struct iphdr, saddr));
+	} else if constexpr (E == PANDA_BC_EXTRACT_ipv6 ||
+			     E == PANDA_BC_EXTRACT_ipv6_addrs) {
+		if constexpr (E == PANDA_BC_EXTRACT_ipv6) {
+			PANDA_CXX_SET(f, l3_off, offset);
+			PANDA_CXX_SET(f, flow_label, ntohl(load<__be32>(hdr) &
+						htonl(0x000fffff)));
+		}
+		PANDA_CXX_SET(f, ip_proto,
+			      hdr[offsetof(struct ipv6hdr, nexthdr)]);
+		PANDA_CXX_SET(f, addr_type, PANDA_ADDR_TYPE_IPV6);
+		PANDA_CXX_COPY(f, addrs.v6_addrs,
+			       hdr + offsetof(struct ipv6hdr, saddr));
+	} else if constexpr (E == PANDA_BC_EXTRACT_ports ||
+			     E == PANDA_BC_EXTRACT_ports_off) {
+		PANDA_CXX_SET(f, ports, load<__be32>(hdr));
+		if constexpr (E == PANDA_BC_EXTRACT_ports_off)
+			PANDA_CXX_SET(f, l4_off, offset);
+	} else if constexpr (E == PANDA_BC_EXTRACT_ip_overlay) {
+		if constexpr (requires { f.eth_proto; }) {
+			switch (hdr[0] >> 4) {
+			case 4:
+				f.eth_proto = __cpu_to_be16(ETH_P_IP);
+				break;
+			case 6:
+				f.eth_proto = __cpu_to_be16(ETH_P_IPV6);
+				break;
+			}
+		}
+	} else if constexpr (E == PANDA_BC_EXTRACT_ipv6_eh) {
+		PANDA_CXX_SET(f, ip_proto,
+			      hdr[offsetof(struct ipv6_opt_hdr, nexthdr)]);
+	} else if constexpr (E == PANDA_BC_EXTRACT_ipv6_frag ||
+			     E == PANDA_BC_EXTRACT_ipv6_frag_noinfo) {
+		PANDA_CXX_SET(f, ip_proto,
+			      hdr[offsetof(struct ipv6_frag_hdr, nexthdr)]);
+		if constexpr (E == PANDA_BC_EXTRACT_ipv6_frag) {
+			PANDA_CXX_SET(f, is_fragment, 1);
+			PANDA_CXX_SET(f, first_frag, !(load<__be16>(hdr +
+				offsetof(struct ipv6_frag_hdr, frag_off)) &
+				htons(IP6_OFFSET)));
+		}
+	} else if constexpr (E == PANDA_BC_EXTRACT_arp_rarp) {
+		PANDA_CXX_SET(f, arp.op, ntohs(load<__be16>(hdr +
+				offsetof(struct arphdr, ar_op))) & 0xff);
+		PANDA_CXX_COPY(f, arp.sha,
+			       hdr + offsetof(struct earphdr, ar_sha));
+		PANDA_CXX_COPY(f, arp.tha,
+			       hdr + offsetof(struct earphdr, ar_tha));
+		PANDA_CXX_COPY(f, arp.sip,
+			       hdr + offsetof(struct earphdr, ar_sip));
+		PANDA_CXX_COPY(f, arp.tip,
+			       hdr + offsetof(struct earphdr, ar_tip));
+	} else if constexpr (E == PANDA_BC_EXTRACT_vlan_8021AD ||
+			     E == PANDA_BC_EXTRACT_vlan_8021Q) {
+		if constexpr (requires { f.vlan_count; f.vlan[0]; }) {
+			__u16 tci = ntohs(load<__be16>(hdr +
+					offsetof(struct vlan_hdr, h_vlan_TCI)));
+			constexpr int max = sizeof(f.vlan) / sizeof(f.vlan[0]);
+			int index = f.vlan_count < max ? f.vlan_count++ :
+							 max - 1;
+
+			PANDA_CXX_SET(f, vlan[index].id, tci & VLAN_VID_MASK);
+			PANDA_CXX_SET(f, vlan[index].priority,
+				      (tci & VLAN_PRIO_MASK) >>
+							VLAN_PRIO_SHIFT);
+			PANDA_CXX_SET(f, vlan[index].tpid,
+				      E == PANDA_BC_EXTRACT_vlan_8021AD ?
+						ETH_P_8021AD : ETH_P_8021Q);
+		}
+	} else if constexpr (E == PANDA_BC_EXTRACT_icmp) {
+		__u8 type = hdr[offsetof(struct icmphdr, type)];
+
+		PANDA_CXX_SET(f, icmp.type, type);
+		PANDA_CXX_SET(f, icmp.code, hdr[offsetof(struct icmphdr,
+							 code)]);
+		if constexpr (requires { f.icmp.id; }) {
+			switch (type) {
+			case ICMP_ECHO:
+			case ICMP_ECHOREPLY:
+			case ICMP_TIMESTAMP:
+			case ICMP_TIMESTAMPREPLY:
+			case ICMPV6_ECHO_REQUEST:
+			case ICMPV6_ECHO_REPLY:
+				f.icmp.id = load<__u16>(hdr + offsetof(
+						struct icmphdr, un.echo.id)) ? : 1;
+				break;
+			default:
+				f.icmp.id = 0;
+				break;
+			}
+		}
+	} else if constexpr (E == PANDA_BC_EXTRACT_mpls) {
+		__u32 entry = ntohl(load<__be32>(hdr));
+		__u32 label = (entry & MPLS_LS_LABEL_MASK) >>
+							MPLS_LS_LABEL_SHIFT;
+
+		PANDA_CXX_SET(f, mpls.label, label);
+		PANDA_CXX_SET(f, mpls.ttl,
+			      (entry & MPLS_LS_TTL_MASK) >> MPLS_LS_TTL_SHIFT);
+		PANDA_CXX_SET(f, mpls.tc,
+			      (entry & MPLS_LS_TC_MASK) >> MPLS_LS_TC_SHIFT);
+		PANDA_CXX_SET(f, mpls.bos,
+			      (entry & MPLS_LS_S_MASK) >> MPLS_LS_S_SHIFT);
+		if (label == MPLS_LABEL_ENTROPY)
+			PANDA_CXX_SET(f, keyid, load<__be32>(hdr +
+					sizeof(struct mpls_label)) &
+					htonl(MPLS_LS_LABEL_MASK));
+	} else if constexpr (E == PANDA_BC_EXTRACT_tipc) {
+		__u32 w0 = ntohl(load<__be32>(hdr));
+		bool keepalive_msg = (w0 & TIPC_KEEPALIVE_MSG_MASK) ==
+						TIPC_KEEPALIVE_MSG_MASK;
+
+		PANDA_CXX_SET(f, addrs.tipckey, keepalive_msg ? 0 :
+			      load<__be32>(hdr + 3 * sizeof(__be32)));
+		PANDA_CXX_SET(f, addr_type, PANDA_ADDR_TYPE_TIPC);
+	} else {
+		static_assert(!sizeof(Frame), "Unknown metadata extractor");
+	}
+}
+
+#undef PANDA_CXX_SET
+#undef PANDA_CXX_COPY
+
+/* New encapsulation layer, the frame policy of panda_parse_encap_layer */
+template <typename S>
+inline __attribute__((always_inline)) int encap(S &s)
+{
+	if (++s.md->encaps > s.max_encaps)
+		return PANDA_STOP_ENCAP_DEPTH;
+
+	if (s.flags & PANDA_F_OUTER_INNER) {
+		if (s.frame_num == 0 && S::num_frames > 1) {
+			s.frame++;
+			s.frame_num = 1;
+		}
+		memset((void *)s.frame, 0, sizeof(*s.frame));
+	} else if (S::num_frames - 1 > s.frame_num) {
+		s.frame++;
+		s.frame_num++;
+	}
+
+	return PANDA_OKAY;
+}
+
+template <typename Prog, unsigned int PC, typename S>
+int node(S &s);
+
+/* Run the instructions from PC up to the end of the node or a jump. The
+ * instructions of a node are inlined into one function
+ */
+template <typename Prog, unsigned int PC, typename S>
+inline __attribute__((always_inline)) int exec(S &s);
+
+/* Protocol table of the TABLE instruction at PC. The CASE instructions are
+ * folded into a chain of comparisons of constants
+ */
+template <typename Prog, unsigned int PC, typename S, size_t... I>
+inline __attribute__((always_inline)) int table(S &s,
+						std::index_sequence<I...>)
+{
+	int ret = PANDA_OKAY;
+
+	if (((s.acc == Prog::insns[PC + 1 + I].k &&
+	      (ret = exec<Prog, PC + 1 + I>(s), true)) || ...))
+		return ret;
+
+	/* Not found, continue after the last CASE */
+	return exec<Prog, PC + 1 + sizeof...(I)>(s);
+}
+
+template <typename Prog, unsigned int PC, typename S>
+inline __attribute__((always_inline)) int exec(S &s)
+{
+	constexpr struct panda_bc_insn insn = Prog::insns[PC];
+
+	if constexpr (insn.op == PANDA_BC_OP_RET) {
+		return (int)insn.k;
+	} else if constexpr (insn.op == PANDA_BC_OP_TABLE) {
+		return table<Prog, PC>(s, std::make_index_sequence<insn.k>{});
+	} else if constexpr (insn.op == PANDA_BC_OP_CASE ||
+			     insn.op == PANDA_BC_OP_NEXT) {
+		if constexpr (!insn.size) {
+			/* Move over current header */
+			s.hdr += s.hlen;
+			s.len -= s.hlen;
+		}
+		return node<Prog, insn.off>(s);
+	} else {
+		if constexpr (insn.op == PANDA_BC_OP_NODE) {
+			if (s.len < insn.k)
+				return PANDA_STOP_LENGTH;
+			s.hlen = s.min_len = insn.k;
+		} else if constexpr (insn.op == PANDA_BC_OP_LEN) {
+			if (s.len < s.acc || s.acc < s.min_len)
+				return PANDA_STOP_LENGTH;
+			s.hlen = s.acc;
+		} else if constexpr (insn.op == PANDA_BC_OP_LD) {
+			if constexpr (insn.size == 1)
+				s.acc = s.hdr[insn.k];
+			else if constexpr (insn.size == 2)
+				s.acc = load<__u16>(s.hdr + insn.k);
+			else
+				s.acc = load<__u32>(s.hdr + insn.k);
+		} else if constexpr (insn.op == PANDA_BC_OP_LDI) {
+			s.acc = insn.k;
+		} else if constexpr (insn.op == PANDA_BC_OP_AND) {
+			s.acc &= insn.k;
+		} else if constexpr (insn.op == PANDA_BC_OP_ADD) {
+			s.acc += insn.k;
+		} else if constexpr (insn.op == PANDA_BC_OP_SHL) {
+			s.acc <<= insn.k;
+		} else if constexpr (insn.op == PANDA_BC_OP_SHR) {
+			s.acc >>= insn.k;
+		} else if constexpr (insn.op == PANDA_BC_OP_JEQ) {
+			if (s.acc == insn.k)
+				return exec<Prog, insn.off>(s);
+		} else if constexpr (insn.op == PANDA_BC_OP_JNE) {
+			if (s.acc != insn.k)
+				return exec<Prog, insn.off>(s);
+		} else if constexpr (insn.op == PANDA_BC_OP_JGE) {
+			if (s.acc >= insn.k)
+				return exec<Prog, insn.off>(s);
+		} else if constexpr (insn.op == PANDA_BC_OP_JSET) {
+			if (s.acc & insn.k)
+				return exec<Prog, insn.off>(s);
+		} else if constexpr (insn.op == PANDA_BC_OP_EXTRACT) {
+			extract<insn.k>(s.hdr, *s.frame, s.hdr - s.base);
+		} else if constexpr (insn.op == PANDA_BC_OP_ENCAP) {
+			int ret = encap(s);
+
+			if (ret != PANDA_OKAY)
+				return ret;
+		} else {
+			static_assert(!sizeof(Prog), "Unknown opcode");
+		}
+
+		return exec<Prog, PC + 1>(s);
+	}
+}
+
+/* A parse node, the NODE instruction at PC. Nodes are functions since
+ * parse graphs can have cycles
+ */
+template <typename Prog, unsigned int PC, typename S>
+int node(S &s)
+{
+	static_assert(Prog::insns[PC].op == PANDA_BC_OP_NODE,
+		      "Target is not a parse node");
+
+	return exec<Prog, PC>(s);
+}
+
+} // namespace detail
+
+/* Parse a packet with the parser Prog. Arguments and return codes are the
+ * same as for panda_parse
+ */
+template <typename Prog, typename Frame, unsigned int N>
+inline int parse(const void *hdr, size_t len, metadata<Frame, N> &md,
+		 unsigned int flags, unsigned int max_encaps)
+{
+	detail::state<Frame, N> s = {
+		.hdr = (const __u8 *)hdr,
+		.len = len,
+		.hlen = 0,
+		.min_len = 0,
+		.acc = 0,
+		.base = (const __u8 *)hdr,
+		.md = &md,
+		.frame = md.frame,
+		.frame_num = 0,
+		.flags = flags,
+		.max_encaps = max_encaps,
+	};
+
+	return detail::node<Prog, 0>(s);
+}
+
+} // namespace panda
+
+#endif /* __PANDA_PARSER_HPP__ */
@@ -87,13 +87,6 @@
 #define PANDA_METADATA_eth_proto	__be16	eth_proto
 #define PANDA_METADATA_eth_addrs	__u8 eth_addrs[2 * ETH_ALEN]
 
-enum panda_addr_types {
-	PANDA_ADDR_TYPE_INVALID = 0, /* Invalid addr type */
-	PANDA_ADDR_TYPE_IPV4,
-	PANDA_ADDR_TYPE_IPV6,
-	PANDA_ADDR_TYPE_TIPC,
-};
-
 #define	PANDA_METADATA_addr_type	__u8 addr_type
 #define PANDA_METADATA_addrs						\
 	union {								\
@@ -247,6 +240,11 @@ struct panda_metadata_all {
 	offsetof(struct panda_metadata_all,			\
 		 PANDA_HASH_START_FIELD_ALL)
 
+/* Compare two IPv6 addresses for canonicalization. The compiler inlines the
+ * fixed size compare
+ */
+#define panda_ipv6_addr_cmp(A, B) memcmp(A, B, sizeof(struct in6_addr))
+
 /* Template for hash consistentify. Sort the source and destination IP (and the
  * ports if the IP address are the same) to have consistent hash within the two
  * directions.
@@ -268,9 +266,9 @@ struct panda_metadata_all {
 		}							\
 		break;							\
 	case PANDA_ADDR_TYPE_IPV6:					\
-		addr_diff = memcmp(&(FRAME)->addrs.v6_addrs[1],		\
-				   &(FRAME)->addrs.v6_addrs[0],		\
-				   sizeof((FRAME)->addrs.v6_addrs[1]));	\
+		addr_diff = panda_ipv6_addr_cmp(			\
+				&(FRAME)->addrs.v6_addrs[1],		\
+				&(FRAME)->addrs.v6_addrs[0]);		\
 		if ((addr_diff < 0) ||					\
 		    (addr_diff == 0 && ((FRAME)->port16[1] <		\
 					(FRAME)->port16[0]))) {		\
@@ -314,6 +312,161 @@ struct panda_metadata_all {
 	sizeof(*(FRAME)) - diff;					\
 })
 
+/* Compact flow key
+ *
+ * A fixed layout, eight byte aligned, key that holds the canonical flow
+ * tuple: address type, IP protocol, ports, addresses, and an optional tunnel
+ * key id. Parsers fill the key directly using the PANDA_METADATA_TEMP_flow_key*
+ * templates so that flow tables can use it as an exact match key without
+ * copying fields out of a metadata frame.
+ *
+ * The significant length of the key is 16 bytes for IPv4 and 40 bytes for
+ * IPv6 (8 bytes if no address type is set). If a tunnel key id is set, as
+ * indicated by PANDA_FLOW_KEY_F_KEYID, then the key id immediately follows
+ * the addresses and the length is increased by four bytes. Bytes not
+ * written by the parser must be zero (i.e. the frame is zeroed before
+ * parsing) so that keys can be compared with memcmp.
+ */
+
+/* Flow key flags */
+#define PANDA_FLOW_KEY_F_KEYID		(1 << 0)
+
+struct panda_flow_key {
+	__u8 addr_type;
+	__u8 ip_proto;
+	__u8 flags;
+	__u8 rsvd;
+	PANDA_METADATA_ports;
+	union {
+		struct {
+			__be32 saddr;
+			__be32 daddr;
+			__be32 keyid;
+		} v4;
+		struct {
+			struct in6_addr saddr;
+			struct in6_addr daddr;
+			__be32 keyid;
+		} v6;
+	};
+} __aligned(8);
+
+#define PANDA_METADATA_flow_key	struct panda_flow_key flow_key
+
+/* Return the significant length of a flow key */
+static inline size_t panda_flow_key_len(const struct panda_flow_key *key)
+{
+	size_t len;
+
+	switch (key->addr_type) {
+	case PANDA_ADDR_TYPE_IPV4:
+		len = offsetof(struct panda_flow_key, v4.keyid);
+		break;
+	case PANDA_ADDR_TYPE_IPV6:
+		len = offsetof(struct panda_flow_key, v6.keyid);
+		break;
+	default:
+		return offsetof(struct panda_flow_key, v4);
+	}
+
+	if (key->flags & PANDA_FLOW_KEY_F_KEYID)
+		len += sizeof(__be32);
+
+	return len;
+}
+
+/* Set the address type of a flow key. Frames are reused once max_frame_num
+ * is reached, so the key id of a previous key in the frame is cleared
+ */
+static inline void panda_flow_key_set_addr_type(struct panda_flow_key *key,
+						__u8 addr_type)
+{
+	key->addr_type = addr_type;
+	key->flags &= ~PANDA_FLOW_KEY_F_KEYID;
+
+	switch (addr_type) {
+	case PANDA_ADDR_TYPE_IPV4:
+		key->v4.keyid = 0;
+		break;
+	case PANDA_ADDR_TYPE_IPV6:
+		key->v6.keyid = 0;
+		break;
+	}
+}
+
+/* Set the tunnel key id in a flow key. The position of the key id depends
+ * on the address type so this must be called after addresses are set
+ */
+static inline void panda_flow_key_set_keyid(struct panda_flow_key *key,
+					    __be32 keyid)
+{
+	switch (key->addr_type) {
+	case PANDA_ADDR_TYPE_IPV4:
+		key->v4.keyid = keyid;
+		break;
+	case PANDA_ADDR_TYPE_IPV6:
+		key->v6.keyid = keyid;
+		break;
+	default:
+		return;
+	}
+
+	key->flags |= PANDA_FLOW_KEY_F_KEYID;
+}
+
+/* Compare two flow keys. Returns true if the keys are equal */
+static inline bool panda_flow_key_equal(const struct panda_flow_key *key1,
+					const struct panda_flow_key *key2)
+{
+	size_t len = panda_flow_key_len(key1);
+
+	return len == panda_flow_key_len(key2) && !memcmp(key1, key2, len);
+}
+
+/* Consistentify a flow key. Sort the source and destination addresses (and
+ * the ports if the addresses are the same) so that both directions of a flow
+ * have the same key. This is the flow key analogue of
+ * PANDA_HASH_CONSISTENTIFY
+ */
+static inline void panda_flow_key_consistentify(struct panda_flow_key *key)
+{
+	int addr_diff, i;
+
+	switch (key->addr_type) {
+	case PANDA_ADDR_TYPE_IPV4:
+		addr_diff = key->v4.daddr - key->v4.saddr;
+		if (addr_diff < 0 ||
+		    (addr_diff == 0 && key->port16[1] < key->port16[0])) {
+			PANDA_SWAP(key->v4.saddr, key->v4.daddr);
+			PANDA_SWAP(key->port16[0], key->port16[1]);
+		}
+		break;
+	case PANDA_ADDR_TYPE_IPV6:
+		addr_diff = panda_ipv6_addr_cmp(&key->v6.daddr,
+						&key->v6.saddr);
+		if (addr_diff < 0 ||
+		    (addr_diff == 0 && key->port16[1] < key->port16[0])) {
+			for (i = 0; i < 4; i++)
+				PANDA_SWAP(key->v6.saddr.s6_addr32[i],
+					   key->v6.daddr.s6_addr32[i]);
+			PANDA_SWAP(key->port16[0], key->port16[1]);
+		}
+		break;
+	}
+}
+
+#ifndef __KERNEL__
+
+/* Compute the hash over the significant bytes of a flow key. The key is
+ * eight byte aligned as required by siphash
+ */
+static inline __u32 panda_flow_key_hash(const struct panda_flow_key *key)
+{
+	return panda_compute_hash(key, panda_flow_key_len(key));
+}
+
+#endif /* __KERNEL__ */
+
 /* Helpers to extract common metadata */
 
 /* Meta data helper for Ethernet.
@@ -843,6 +996,102 @@ static void NAME(const void *vdata, void *iframe,			\
 	frame->gre_pptp.ack = *(__u32 *)vdata;				\
 }
 
+/* Meta data helpers to fill a compact flow key */
+
+/* Meta data helper for IPv4 flow key.
+ * Uses common metadata field: flow_key
+ */
+#define PANDA_METADATA_TEMP_flow_key_ipv4(NAME, STRUCT)			\
+static void NAME(const void *viph, void *iframe,			\
+		 struct panda_ctrl_data ctrl)				\
+{									\
+	struct STRUCT *frame = iframe;					\
+	const struct iphdr *iph = viph;					\
+									\
+	panda_flow_key_set_addr_type(&frame->flow_key,			\
+				     PANDA_ADDR_TYPE_IPV4);		\
+	frame->flow_key.ip_proto = iph->protocol;			\
+	frame->flow_key.v4.saddr = iph->saddr;				\
+	frame->flow_key.v4.daddr = iph->daddr;				\
+}
+
+/* Meta data helper for IPv6 flow key.
+ * Uses common metadata field: flow_key
+ */
+#define PANDA_METADATA_TEMP_flow_key_ipv6(NAME, STRUCT)			\
+static void NAME(const void *viph, void *iframe,			\
+		 struct panda_ctrl_data ctrl)				\
+{									\
+	struct STRUCT *frame = iframe;					\
+	const struct ipv6hdr *iph = viph;				\
+									\
+	panda_flow_key_set_addr_type(&frame->flow_key,			\
+				     PANDA_ADDR_TYPE_IPV6);		\
+	frame->flow_key.ip_proto = iph->nexthdr;			\
+	memcpy(&frame->flow_key.v6.saddr, &iph->saddr,			\
+	       2 * sizeof(frame->flow_key.v6.saddr));			\
+}
+
+/* Meta data helper for flow key in Routing, DestOpt, and Hop-by-Hop
+ * extension headers.
+ * Uses common metadata field: flow_key
+ */
+#define PANDA_METADATA_TEMP_flow_key_ipv6_eh(NAME, STRUCT)		\
+static void NAME(const void *vopt, void *iframe,			\
+		 struct panda_ctrl_data ctrl)				\
+{									\
+	((struct STRUCT *)iframe)->flow_key.ip_proto =			\
+			((struct ipv6_opt_hdr *)vopt)->nexthdr;		\
+}
+
+/* Meta data helper for flow key in Fragmentation extension header.
+ * Uses common metadata field: flow_key
+ */
+#define PANDA_METADATA_TEMP_flow_key_ipv6_frag(NAME, STRUCT)		\
+static void NAME(const void *vfrag, void *iframe,			\
+		 struct panda_ctrl_data ctrl)				\
+{									\
+	((struct STRUCT *)iframe)->flow_key.ip_proto =			\
+			((struct ipv6_frag_hdr *)vfrag)->nexthdr;	\
+}
+
+/* Meta data helper for transport ports in a flow key.
+ * Uses common metadata field: flow_key
+ */
+#define PANDA_METADATA_TEMP_flow_key_ports(NAME, STRUCT)		\
+static void NAME(const void *vphdr, void *iframe,			\
+		 struct panda_ctrl_data ctrl)				\
+{									\
+	struct STRUCT *frame = iframe;					\
+									\
+	frame->flow_key.ports = ((struct port_hdr *)vphdr)->ports;	\
+}
+
+/* Meta data helper for GRE keyid in a flow key.
+ * Uses common metadata field: flow_key
+ */
+#define PANDA_METADATA_TEMP_flow_key_gre_keyid(NAME, STRUCT)		\
+static void NAME(const void *vdata, void *iframe,			\
+		 struct panda_ctrl_data ctrl)				\
+{									\
+	struct STRUCT *frame = iframe;					\
+									\
+	panda_flow_key_set_keyid(&frame->flow_key, *(__u32 *)vdata);	\
+}
+
+/* Meta data helper for GRE-PPTP key in a flow key.
+ * Uses common metadata field: flow_key
+ */
+#define PANDA_METADATA_TEMP_flow_key_gre_pptp_key(NAME, STRUCT)		\
+static void NAME(const void *vdata, void *iframe,			\
+		 struct panda_ctrl_data ctrl)				\
+{									\
+	struct STRUCT *frame = iframe;					\
+									\
+	panda_flow_key_set_keyid(&frame->flow_key,			\
+			((struct panda_pptp_id *)vdata)->val32);	\
+}
+
 /* Helper function to define a function to print common metadata */
 #define PANDA_PRINT_METADATA(FRAME) do {				\
 	char a4buf[INET_ADDRSTRLEN];					\
@@ -33,9 +33,39 @@
 #include <stdbool.h>
 
 #include <linux/types.h>
+#ifndef __KERNEL__
+#include <sys/types.h>
+#endif
 
 #include "panda/compiler_helpers.h"
 
+/* Panda parser return codes */
+enum {
+	PANDA_OKAY = 0,			/* Okay and continue */
+	PANDA_STOP_OKAY = -1,		/* Okay and stop parsing */
+
+	/* Parser failure */
+	PANDA_STOP_FAIL = -2,
+	PANDA_STOP_LENGTH = -3,
+	PANDA_STOP_UNKNOWN_PROTO = -4,
+	PANDA_STOP_ENCAP_DEPTH = -5,
+	PANDA_STOP_UNKNOWN_TLV = -6,
+	PANDA_STOP_TLV_LENGTH = -7,
+	PANDA_STOP_BAD_FLAG = -8,
+};
+
+/* Flags to Panda parser functions */
+#define PANDA_F_DEBUG			(1 << 0)
+#define PANDA_F_OUTER_INNER		(1 << 1)
+
+/* Address types of the addr_type metadata field */
+enum panda_addr_types {
+	PANDA_ADDR_TYPE_INVALID = 0, /* Invalid addr type */
+	PANDA_ADDR_TYPE_IPV4,
+	PANDA_ADDR_TYPE_IPV6,
+	PANDA_ADDR_TYPE_TIPC,
+};
+
 /* Panda parser type codes */
 enum panda_parser_type {
 	/* Use non-optimized loop panda parser algorithm */
@@ -100,6 +130,19 @@ struct panda_proto_node {
 	const struct panda_parse_ops ops;
 };
 
+/* Summary of one encapsulation layer
+ *
+ *	proto_node: Protocol node of the encapsulating protocol (e.g. GRE)
+ *	offset: Offset of the encapsulating header in the packet
+ *	keyid: Tunnel key from the current metadata frame, zero if there is
+ *		no key or frames don't have a keyid (see keyid_offset below)
+ */
+struct panda_encap_summary {
+	const struct panda_proto_node *proto_node;
+	__u32 offset;
+	__be32 keyid;
+};
+
 /* Panda generic metadata
  *
  * Contains an array of parser specific (user defined) metadata structures.
@@ -112,12 +155,27 @@ struct panda_proto_node {
  *		level of encapulation. When the number of encapsulation
  *		layers exceeds this value the last frame is reuse used
  *	frame_size: The size in bytes of each metadata frame
+ *	encap_summary: Optional array with a summary of each encapsulation
+ *		layer. Layers beyond max_encap_summary are not recorded
+ *	max_encap_summary: Number of entries in encap_summary
+ *	keyid_offset: Offset plus one of a __be32 keyid in a metadata frame,
+ *		zero if frames don't have a keyid. Set by
+ *		PANDA_METADATA_SET_KEYID_OFFSET
  *	frame_data: Contains max_frame_num metadata frames
+ *
+ * With the PANDA_F_OUTER_INNER parse flag exactly two frames are used: the
+ * first frame holds the outermost layer and the second frame holds the
+ * innermost one. The second frame is cleared at each new encapsulation layer
+ * so that it only contains metadata for the innermost layer. max_frame_num
+ * must be at least one in this mode.
  */
 struct panda_metadata {
 	unsigned int encaps;
 	unsigned int max_frame_num;
 	size_t frame_size;
+	struct panda_encap_summary *encap_summary;
+	unsigned int max_encap_summary;
+	unsigned int keyid_offset;
 
 	/* Application specific metadata frames */
 	__u8 frame_data[0] __aligned(8);
@@ -219,6 +277,20 @@ typedef int (*panda_parser_xdp_entry_point)(struct panda_ctx *ctx,
 					    const void *hdr_end,
 					    bool tailcall);
 
+#ifdef __KERNEL__
+struct sk_buff;
+
+/* Panda entry-point for kernel module parsers that parse the packet of an
+ * skb in place, starting at offset from skb->data
+ */
+typedef int (*panda_parser_skb_entry_point)(const struct panda_parser *parser,
+					    const struct sk_buff *skb,
+					    int offset,
+					    struct panda_metadata *metadata,
+					    unsigned int flags,
+					    unsigned int max_encaps);
+#endif
+
 /* Definition of a PANDA parser. Fields are:
  *
  * name: Text name for the parser
@@ -231,6 +303,10 @@ struct panda_parser {
 	enum panda_parser_type parser_type;
 	panda_parser_opt_entry_point parser_entry_point;
 	panda_parser_xdp_entry_point parser_xdp_entry_point;
+#ifdef __KERNEL__
+	panda_parser_skb_entry_point parser_skb_entry_point;
+#endif
+	const struct panda_parser *const *numa_replicas;
 };
 
 /* One entry in a parser table:
@@ -38,6 +38,8 @@
 
 #include "panda/parser_metadata.h"
 
+#define PANDA_PARSER_BIG_ENCAP_DEPTH	4
+
 /* Meta data structure for multiple frames (i.e. to retrieve metadata
  * for multiple levels of encapsulation)
  */
@@ -52,6 +54,31 @@ struct panda_parser_big_metadata_one {
 	struct panda_metadata_all frame;
 };
 
+/* Meta data structure for outermost and innermost frames plus a summary of
+ * each encapsulation layer. Used with the PANDA_F_OUTER_INNER parse flag so
+ * that the size of metadata is constant regardless of encapsulation depth.
+ * Initialize with panda_parser_big_init_outer_inner
+ */
+struct panda_parser_big_metadata_outer_inner {
+	struct panda_metadata panda_data;
+	struct panda_metadata_all frame[2];
+	struct panda_encap_summary encap_summary[PANDA_PARSER_BIG_ENCAP_DEPTH];
+};
+
+static inline void panda_parser_big_init_outer_inner(
+		struct panda_parser_big_metadata_outer_inner *mdata)
+{
+	memset(mdata, 0, sizeof(*mdata));
+
+	mdata->panda_data.max_frame_num = 1;
+	mdata->panda_data.frame_size = sizeof(mdata->frame[0]);
+	mdata->panda_data.encap_summary = mdata->encap_summary;
+	mdata->panda_data.max_encap_summary =
+				ARRAY_SIZE(mdata->encap_summary);
+	PANDA_METADATA_SET_KEYID_OFFSET(&mdata->panda_data,
+					panda_metadata_all);
+}
+
 /* Externs for parsers defined by big parsers. Note there are two parser,
  * one to parse a packet containing an Ethernet header, and one containing
  * and IP header.
@@ -66,8 +93,6 @@ PANDA_PARSER_EXTERN(panda_parser_big_ip_opt);
 void panda_parser_big_print_frame(struct panda_metadata_all *frame);
 void panda_parser_big_print_hash_input(struct panda_metadata_all *frame);
 
-#define PANDA_PARSER_BIG_ENCAP_DEPTH	4
-
 /* Utility functions for various ways to parse packets and compute packet
  * hashes using the parsers for big parser
  */
@@ -80,6 +105,18 @@ static inline bool panda_parser_big_parse_ether(void *p, size_t len,
 			   0, PANDA_PARSER_BIG_ENCAP_DEPTH) == PANDA_STOP_OKAY);
 }
 
+/* Parse packet starting with Ethernet header keeping only the outermost and
+ * innermost frames. mdata must be initialized by
+ * panda_parser_big_init_outer_inner
+ */
+static inline bool panda_parser_big_parse_ether_outer_inner(void *p,
+		size_t len, struct panda_parser_big_metadata_outer_inner *mdata)
+{
+	return (panda_parse(panda_parser_big_ether, p, len, &mdata->panda_data,
+			    PANDA_F_OUTER_INNER,
+			    PANDA_PARSER_BIG_ENCAP_DEPTH) == PANDA_STOP_OKAY);
+}
+
 /* Parse packet starting with a known layer 3 protocol. Determine start
  * node by performing a protocol look up on the root node of the Ethernet
  * parser (i.e. get the start node by looking up the Ethertype in the
@@ -39,26 +39,23 @@
 #include "panda/parser_metadata.h"
 #include "panda/utility.h"
 
-/* Meta data structure for multiple frames (i.e. to retrieve metadata
- * for multiple levels of encapsulation)
+/* Meta data frame for the simple hash parser. The hash input starts at
+ * eth_proto and runs to the end of the used part of the compact flow key
  */
-#define PANDA_SIMPLE_HASH_START_FIELD_HASH eth_proto
-struct panda_parser_simple_hash_metadata {
-	struct panda_metadata panda_data;
-
-	PANDA_METADATA_addr_type;
-
+struct panda_parser_simple_hash_frame {
 	PANDA_METADATA_eth_proto __aligned(8);
-	PANDA_METADATA_ip_proto;
 	PANDA_METADATA_flow_label;
-	PANDA_METADATA_ports;
 
-	PANDA_METADATA_addrs; /* Must be last */
+	PANDA_METADATA_flow_key; /* Must be last */
 };
 
-#define PANDA_SIMPLE_HASH_OFFSET_HASH				\
-	offsetof(struct panda_parser_simple_hash_metadata,	\
-		 PANDA_SIMPLE_HASH_START_FIELD_HASH)
+/* Meta data structure for the simple hash parser. Encapsulation is not
+ * supported so there is only one frame
+ */
+struct panda_parser_simple_hash_metadata {
+	struct panda_metadata panda_data;
+	struct panda_parser_simple_hash_frame frame;
+};
 
 /* Externs for simple hash parser */
 PANDA_PARSER_EXTERN(panda_parser_simple_hash_ether);
@@ -71,14 +68,18 @@ static inline __u32 panda_parser_hash_hash_ether(const void *p, size_t len)
 {
 	struct panda_parser_simple_hash_metadata mdata;
 
+	memset(&mdata, 0, sizeof(mdata));
+
 	if (panda_parse(panda_parser_simple_hash_ether, p, len,
 			&mdata.panda_data, 0, 0) != PANDA_STOP_OKAY)
 		return 0;
 
-	PANDA_HASH_CONSISTENTIFY(&mdata);
+	panda_flow_key_consistentify(&mdata.frame.flow_key);
 
-	return PANDA_COMMON_COMPUTE_HASH(&mdata,
-					 PANDA_SIMPLE_HASH_START_FIELD_HASH);
+	return panda_compute_hash(&mdata.frame.eth_proto,
+			offsetof(struct panda_parser_simple_hash_frame,
+				 flow_key) +
+			panda_flow_key_len(&mdata.frame.flow_key));
 }
 
 #endif /* __PANDA_PARSER_HASH_H__ */
@@ -24,7 +24,11 @@
  * SUCH DAMAGE.
  */
 
-/* Include for all defined proto nodes */
+/* Include for all defined proto nodes
+ *
+ * C++ code, such as the parsers of panda/parser.hpp, only sees the protocol
+ * header definitions. The protocol nodes and their functions are C
+ */
 
 #include "panda/proto_nodes/proto_ether.h"
 #include "panda/proto_nodes/proto_pppoe.h"
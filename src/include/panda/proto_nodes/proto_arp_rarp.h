@@ -33,7 +33,9 @@
 
 #include <linux/if_arp.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 /* ARP and RARP node definitions */
 
@@ -45,6 +47,8 @@ struct earphdr {
 	__u8 ar_tip[4];
 };
 
+#ifndef __cplusplus
+
 static inline ssize_t arp_len_check(const void *vearp)
 {
 	const struct earphdr *earp = vearp;
@@ -61,6 +65,8 @@ static inline ssize_t arp_len_check(const void *vearp)
 	return sizeof(struct earphdr);
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_ARP_RARP_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
@@ -29,7 +29,9 @@
 
 #include <linux/if_ether.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 /* ARP and RARP node definitions */
 
@@ -69,6 +71,8 @@ struct batadv_eth {
 	struct ethhdr eth;
 };
 
+#ifndef __cplusplus
+
 static inline ssize_t batman_len_check(const void *vbeth)
 {
 	const struct batadv_eth *beth = vbeth;
@@ -85,6 +89,8 @@ static inline int batman_proto(const void *vbeth)
 	return ((struct batadv_eth *)vbeth)->eth.h_proto;
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_BATMAN_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
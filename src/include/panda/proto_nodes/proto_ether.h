@@ -31,6 +31,7 @@
 
 #include <linux/if_ether.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
 
 static inline int ether_proto(const void *veth)
@@ -38,6 +39,8 @@ static inline int ether_proto(const void *veth)
 	return ((struct ethhdr *)veth)->h_proto;
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_ETHER_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
@@ -27,7 +27,9 @@
 #ifndef __PANDA_PROTO_FCOE_H__
 #define __PANDA_PROTO_FCOE_H__
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 /* Generic FCOE node definitions */
 
@@ -35,7 +35,9 @@
 
 #include <linux/ip.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 /* Define common GRE constants. These normally come from linux/if_tunnel.h,
  * however that include file has a lot of other definitions beyond just GRE
@@ -82,6 +84,8 @@
 #define GRE_PPTP_KEY_MASK	__cpu_to_be32(0xffff)
 #endif
 
+#ifndef __cplusplus
+
 /* GRE flag-field definitions */
 static const struct panda_flag_fields gre_flag_fields = {
 	.fields = {
@@ -222,6 +226,8 @@ static inline int gre_v1_proto(const void *vgre)
 	return 0;
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_GRE_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
@@ -32,6 +32,7 @@
 #include <linux/icmp.h>
 #include <linux/icmpv6.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
 
 static inline bool icmp_has_id(__u8 type)
@@ -49,6 +50,8 @@ static inline bool icmp_has_id(__u8 type)
 	return false;
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_ICMP_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
@@ -31,7 +31,9 @@
 
 #include <linux/igmp.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 #endif /* __PANDA_PROTO_IGMP_H__ */
 
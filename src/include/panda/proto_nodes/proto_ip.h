@@ -27,7 +27,9 @@
 #ifndef __PANDA_PROTO_IP_H__
 #define __PANDA_PROTO_IP_H__
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 /* IP overlay node definitions */
 
@@ -45,6 +47,8 @@ struct ip_hdr_byte {
 #endif
 };
 
+#ifndef __cplusplus
+
 static inline int ip_proto(const void *viph)
 {
 	return ((struct ip_hdr_byte *)viph)->version;
@@ -55,6 +59,8 @@ static inline size_t ip_min_len(const void *viph)
 	return sizeof(struct ip_hdr_byte);
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_IP_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
@@ -35,11 +35,15 @@
 
 #include <linux/ip.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 #define IP_MF		0x2000	/* Flag: "More Fragments"   */
 #define IP_OFFSET	0x1FFF	/* "Fragment Offset" part   */
 
+#ifndef __cplusplus
+
 static inline size_t ipv4_len(const void *viph)
 {
 	return ((struct iphdr *)viph)->ihl * 4;
@@ -89,6 +93,8 @@ static inline ssize_t ipv4_length_check(const void *viph)
 	return ipv4_len(viph);
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PROTO_IPV4_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
@@ -31,6 +31,7 @@
 
 #include <linux/ip.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
 
 static inline int ipv4_proto_default(const void *viph)
@@ -38,6 +39,8 @@ static inline int ipv4_proto_default(const void *viph)
 	return 0; /* Indicates IPv4 */
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_IPV4IP_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
@@ -35,12 +35,16 @@
 
 #include <linux/ipv6.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 #define ipv6_optlen(p)  (((p)->hdrlen+1) << 3)
 
 #define IPV6_FLOWLABEL_MASK	htonl(0x000FFFFF)
 
+#ifndef __cplusplus
+
 static inline __be32 ip6_flowlabel(const struct ipv6hdr *hdr)
 {
 	return *(__be32 *)hdr & IPV6_FLOWLABEL_MASK;
@@ -73,6 +77,8 @@ static inline ssize_t ipv6_length_check(const void *viph)
 	return sizeof(struct ipv6hdr);
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_IPV6_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
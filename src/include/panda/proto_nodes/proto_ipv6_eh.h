@@ -35,7 +35,9 @@
 
 #include <linux/ipv6.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 struct ipv6_frag_hdr {
 	__u8    nexthdr;
@@ -47,6 +49,8 @@ struct ipv6_frag_hdr {
 #define IP6_MF		0x0001
 #define IP6_OFFSET	0xFFF8
 
+#ifndef __cplusplus
+
 static inline int ipv6_eh_proto(const void *vopt)
 {
 	return ((struct ipv6_opt_hdr *)vopt)->nexthdr;
@@ -69,6 +73,8 @@ static inline int ipv6_frag_proto(const void *vfraghdr)
 	return fraghdr->nexthdr;
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_IPV6_EH_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
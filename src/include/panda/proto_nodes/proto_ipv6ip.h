@@ -31,6 +31,7 @@
 
 #include <linux/ipv6.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
 
 static inline int ipv6_proto_default(const void *viph)
@@ -38,6 +39,8 @@ static inline int ipv6_proto_default(const void *viph)
 	return 0; /* Indicates IPv6 */
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_IPV6IP_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
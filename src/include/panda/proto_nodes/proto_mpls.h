@@ -31,7 +31,9 @@
 
 #include <linux/mpls.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 #endif /* __PANDA_PROTO_MPLS_H__ */
 
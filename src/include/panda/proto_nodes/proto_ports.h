@@ -27,7 +27,9 @@
 #ifndef __PANDA_PROTO_PORTS_H__
 #define __PANDA_PROTO_PORTS_H__
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 /* Transport nodes with ports definitions */
 
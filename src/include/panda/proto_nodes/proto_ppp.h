@@ -29,7 +29,9 @@
 
 #include <linux/ppp_defs.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 /* PPP node definitions */
 
@@ -39,11 +41,15 @@ struct ppp_hdr {
 	__be16 protocol;
 };
 
+#ifndef __cplusplus
+
 static inline int ppp_proto(const void *vppp)
 {
 	return ((struct ppp_hdr *)vppp)->protocol;
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_PPP_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
@@ -27,7 +27,9 @@
 #ifndef __PANDA_PROTO_PPPOE_H__
 #define __PANDA_PROTO_PPPOE_H__
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 struct pppoe_hdr {
 #if defined(__LITTLE_ENDIAN_BITFIELD)
@@ -47,12 +49,16 @@ struct pppoe_hdr {
 
 //int static_assert_global_v[sizeof(struct pppoe_hdr) == 6 ? -1 : 1];
 
+#ifndef __cplusplus
+
 /* PPP node definitions */
 static inline int pppoe_proto(const void *vppp)
 {
 	return ((struct pppoe_hdr*)vppp)->protocol;
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_PPP_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
@@ -29,7 +29,9 @@
 
 #include <linux/tcp.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 /* TCP node definitions */
 
@@ -72,6 +74,8 @@ struct tcp_opt_union {
 	} __attribute__((packed));
 } __attribute__((packed));
 
+#ifndef __cplusplus
+
 static inline ssize_t tcp_len(const void *vtcp)
 {
 	return ((struct tcphdr *)vtcp)->doff * 4;
@@ -92,6 +96,8 @@ static inline size_t tcp_tlvs_start_offset(const void *hdr)
 	return sizeof(struct tcphdr);
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_TCP_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
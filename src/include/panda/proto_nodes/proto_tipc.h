@@ -31,7 +31,9 @@
 
 #include <linux/ppp_defs.h>
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 /* LINK_PROTOCOL + MSG_IS_KEEPALIVE */
 #define TIPC_KEEPALIVE_MSG_MASK		0x0e080000
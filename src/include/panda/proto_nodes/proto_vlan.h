@@ -27,7 +27,9 @@
 #ifndef __PANDA_PROTO_VLAN_H__
 #define __PANDA_PROTO_VLAN_H__
 
+#ifndef __cplusplus
 #include "panda/parser.h"
+#endif
 
 #define VLAN_PRIO_MASK		0xe000 /* Priority Code Point */
 #define VLAN_PRIO_SHIFT		13
@@ -42,11 +44,15 @@ struct vlan_hdr {
 };
 #endif
 
+#ifndef __cplusplus
+
 static inline int vlan_proto(const void *vvlan)
 {
 	return ((struct vlan_hdr *)vvlan)->h_vlan_encapsulated_proto;
 }
 
+#endif /* __cplusplus */
+
 #endif /* __PANDA_PROTO_VLAN_H__ */
 
 #ifdef PANDA_DEFINE_PARSE_NODE
@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2020,2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __PANDA_TC_BPF_TMPL_H__
+#define __PANDA_TC_BPF_TMPL_H__
+
+/* Templates for TC BPF programs (cls_bpf in direct action mode, or
+ * act_bpf) with a parser generated by panda-compiler in a .tc.h file. The
+ * same program can be attached at ingress and egress
+ */
+
+#include <linux/bpf.h>
+#include <linux/pkt_cls.h>
+#include <bpf/bpf_helpers.h>
+
+#include "panda/parser.h"
+#include "panda/parser_metadata.h"
+
+/* Export the flow of a metadata frame in skb->cb for the programs and
+ * actions that follow:
+ *
+ *	cb[0]: addr_type | ip_proto << 8 | l4_off << 16
+ *	cb[1]: ports, as in the packet
+ *	cb[2], cb[3]: source and destination IPv4 address, or the last word
+ *		of the IPv6 addresses
+ */
+#define PANDA_TC_SET_CB(SKB, FRAME) do {				\
+	(SKB)->cb[0] = (FRAME)->addr_type | (FRAME)->ip_proto << 8 |	\
+		       (FRAME)->l4_off << 16;				\
+	(SKB)->cb[1] = (FRAME)->ports;					\
+	switch ((FRAME)->addr_type) {					\
+	case PANDA_ADDR_TYPE_IPV4:					\
+		(SKB)->cb[2] = (FRAME)->addrs.v4.saddr;			\
+		(SKB)->cb[3] = (FRAME)->addrs.v4.daddr;			\
+		break;							\
+	case PANDA_ADDR_TYPE_IPV6:					\
+		(SKB)->cb[2] = (FRAME)->addrs.v6.saddr.s6_addr32[3];	\
+		(SKB)->cb[3] = (FRAME)->addrs.v6.daddr.s6_addr32[3];	\
+		break;							\
+	default:							\
+		(SKB)->cb[2] = 0;					\
+		(SKB)->cb[3] = 0;					\
+		break;							\
+	}								\
+} while (0)
+
+/* Make the TC program tc_prog for PARSER. STRUCT is the parser context, a
+ * struct panda_ctx followed by the metadata frame. PROCESS(skb, ctx) is
+ * called when the packet is parsed and PARSER_FAIL(rc, skb, ctx) on an
+ * error, both return the TC action
+ */
+#define PANDA_TC_MAKE_BPF_PROGRAM(PARSER, STRUCT, FRAME_SIZE, PROCESS,	\
+				  PARSER_FAIL)				\
+struct panda_tc_ctx {							\
+	STRUCT ctx;							\
+	__u8 buf[2 * PANDA_TC_HDR_LEN];					\
+};									\
+									\
+struct {								\
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);			\
+	__uint(max_entries, 1);						\
+	__type(key, __u32);						\
+	__type(value, struct panda_tc_ctx);				\
+} panda_tc_ctx_map SEC(".maps");					\
+									\
+SEC("tc")								\
+int tc_prog(struct __sk_buff *skb)					\
+{									\
+	struct panda_tc_ctx *tc_ctx;					\
+	__u32 key = 0;							\
+	int rc;								\
+									\
+	tc_ctx = bpf_map_lookup_elem(&panda_tc_ctx_map, &key);		\
+	if (!tc_ctx)							\
+		return PARSER_FAIL(PANDA_STOP_FAIL, skb, NULL);		\
+									\
+	__builtin_memset(&tc_ctx->ctx, 0, sizeof(tc_ctx->ctx));	\
+	tc_ctx->ctx.ctx.metadata.frame_size = FRAME_SIZE;		\
+	tc_ctx->ctx.ctx.metadata.max_frame_num = 0;			\
+									\
+	rc = PANDA_PARSE_TC(PARSER, skb, &tc_ctx->ctx.ctx,		\
+			    tc_ctx->buf);				\
+	if (rc != PANDA_OKAY && rc != PANDA_STOP_OKAY)			\
+		return PARSER_FAIL(rc, skb, &tc_ctx->ctx);		\
+									\
+	return PROCESS(skb, &tc_ctx->ctx);				\
+}
+
+#endif /* __PANDA_TC_BPF_TMPL_H__ */
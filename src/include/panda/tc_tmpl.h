@@ -29,6 +29,39 @@
 
 #include <linux/module.h>
 
+/* Set the match key of the PANDA classifier from a frame of common metadata
+ * (struct panda_metadata_all). The key must be zeroed before
+ */
+#define PANDA_TC_SET_KEY(KEY, FRAME) do {				\
+	(KEY)->addr_type = (FRAME)->addr_type;				\
+	(KEY)->ip_proto = (FRAME)->ip_proto;				\
+	(KEY)->eth_proto = (FRAME)->eth_proto;				\
+	(KEY)->src_port = (FRAME)->src_port;				\
+	(KEY)->dst_port = (FRAME)->dst_port;				\
+	if ((FRAME)->vlan_count)					\
+		(KEY)->vlan_id = (FRAME)->vlan[0].id;			\
+	(KEY)->keyid = (FRAME)->keyid;					\
+	switch ((FRAME)->addr_type) {					\
+	case TC_CLS_PANDA_ADDR_IPV4:					\
+		(KEY)->addrs.v4.saddr = (FRAME)->addrs.v4.saddr;	\
+		(KEY)->addrs.v4.daddr = (FRAME)->addrs.v4.daddr;	\
+		break;							\
+	case TC_CLS_PANDA_ADDR_IPV6:					\
+		(KEY)->addrs.v6.saddr = (FRAME)->addrs.v6.saddr;	\
+		(KEY)->addrs.v6.daddr = (FRAME)->addrs.v6.daddr;	\
+		break;							\
+	}								\
+} while (0)
+
+/* Set the header offsets for the PANDA classifier from a frame of common
+ * metadata, the offsets are from the start of the parse which must be the
+ * MAC header
+ */
+#define PANDA_TC_SET_INFO(INFO, FRAME) do {				\
+	(INFO)->l3_off = (FRAME)->l3_off;				\
+	(INFO)->l4_off = (FRAME)->l4_off;				\
+} while (0)
+
 #define PANDA_TC_MAKE_PARSER_PROGRAM(NAME, FUNC)			\
 static struct tc_cls_panda_ops ops = {					\
 	.name = NAME,							\
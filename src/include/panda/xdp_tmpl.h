@@ -34,6 +34,41 @@
 
 #define PROG_MAP_ID 0xcafe
 
+/* Tail called program PROG of a parser, parsing continues at ctx->next */
+#define __PANDA_XDP_PARSER_PROG(PROG, PARSER, STRUCT, PROCESS,		\
+				PARSER_FAIL)				\
+SEC("0xcafe/" #PROG)							\
+int parser_prog_##PROG(struct xdp_md *ctx)				\
+{									\
+	STRUCT *parser_ctx = __panda_get_ctx();				\
+	void *data_end = (void *)(long)ctx->data_end;			\
+	void *data = (void *)(long)ctx->data;				\
+	void *original = data;						\
+	int rc = PANDA_OKAY;						\
+									\
+	if (!parser_ctx)						\
+		return PARSER_FAIL(rc, ctx, NULL);			\
+									\
+	rc = PANDA_PARSE_XDP_PROG(PARSER, PROG, &parser_ctx->ctx,	\
+				  (const void **)&data, data_end);	\
+	if (rc != PANDA_OKAY && rc != PANDA_STOP_OKAY) {		\
+		rc = PARSER_FAIL(rc, ctx, parser_ctx);			\
+		bpf_xdp_adjust_head(ctx, -parser_ctx->ctx.offset);	\
+		return rc;						\
+	}								\
+	if (parser_ctx->ctx.next != CODE_IGNORE) {			\
+		parser_ctx->ctx.offset += data - original;		\
+		bpf_xdp_adjust_head(ctx, data - original);		\
+		bpf_tail_call(ctx, &parsers,				\
+			PANDA_XDP_PROG(PARSER, parser_ctx->ctx.next));	\
+	}								\
+									\
+	rc = PROCESS(ctx, parser_ctx);					\
+									\
+	bpf_xdp_adjust_head(ctx, -parser_ctx->ctx.offset);		\
+	return rc;							\
+}
+
 #define PANDA_XDP_MAKE_PARSER_PROGRAM(PARSER, STRUCT, FRAME_SIZE,	\
 				      PROCESS, PARSER_FAIL)		\
 struct bpf_elf_map SEC("maps") ctx_map = {				\
@@ -48,7 +83,7 @@ struct bpf_elf_map SEC("maps") parsers = {				\
 	.type = BPF_MAP_TYPE_PROG_ARRAY,				\
 	.size_key = sizeof(__u32),					\
 	.size_value = sizeof(__u32),					\
-	.max_elem = 1,							\
+	.max_elem = PANDA_XDP_NUM_PROGS(PARSER),			\
 	.pinning = PIN_GLOBAL_NS,					\
 	.id = PROG_MAP_ID,						\
 };									\
@@ -63,36 +98,8 @@ static __always_inline STRUCT *__panda_get_ctx(void)			\
 	return bpf_map_lookup_elem(&ctx_map, &key);			\
 }									\
 									\
-SEC("0xcafe/0")								\
-int parser_prog(struct xdp_md *ctx)					\
-{									\
-	STRUCT *parser_ctx = __panda_get_ctx();				\
-	void *data_end = (void *)(long)ctx->data_end;			\
-	void *data = (void *)(long)ctx->data;				\
-	void *original = data;						\
-	int rc = PANDA_OKAY;						\
-									\
-	if (!parser_ctx)						\
-		return PARSER_FAIL(rc, ctx, NULL);			\
-									\
-	rc = PANDA_PARSE_XDP(PARSER, &parser_ctx->ctx,			\
-			     (const void **)&data, data_end, true);	\
-	if (rc != PANDA_OKAY && rc != PANDA_STOP_OKAY) {		\
-		rc = PARSER_FAIL(rc, ctx, parser_ctx);			\
-		bpf_xdp_adjust_head(ctx, -parser_ctx->ctx.offset);	\
-		return rc;						\
-	}								\
-	if (parser_ctx->ctx.next != CODE_IGNORE) {			\
-		parser_ctx->ctx.offset += data - original;		\
-		bpf_xdp_adjust_head(ctx, data - original);		\
-		bpf_tail_call(ctx, &parsers, 0);			\
-	}								\
-									\
-	rc = PROCESS(ctx, parser_ctx);					\
-									\
-	bpf_xdp_adjust_head(ctx, -parser_ctx->ctx.offset);		\
-	return rc;							\
-}									\
+PANDA_XDP_FOR_EACH_PROG(PARSER, __PANDA_XDP_PARSER_PROG, PARSER,	\
+			STRUCT, PROCESS, PARSER_FAIL)			\
 									\
 SEC("prog")								\
 int xdp_prog(struct xdp_md *ctx)					\
@@ -119,7 +126,8 @@ int xdp_prog(struct xdp_md *ctx)					\
 	if (parser_ctx->ctx.next != CODE_IGNORE) {			\
 		parser_ctx->ctx.offset = data - original;		\
 		bpf_xdp_adjust_head(ctx, parser_ctx->ctx.offset);	\
-		bpf_tail_call(ctx, &parsers, 0);			\
+		bpf_tail_call(ctx, &parsers,				\
+			PANDA_XDP_PROG(PARSER, parser_ctx->ctx.next));	\
 	}								\
 									\
 	return PROCESS(ctx, parser_ctx);				\
@@ -32,16 +32,54 @@
 #include <linux/rtnetlink.h>
 #include <linux/skbuff.h>
 #include <linux/idr.h>
+#include <linux/ktime.h>
+#include <linux/if_vlan.h>
+#include <linux/random.h>
+#include <linux/rhashtable.h>
+#include <linux/siphash.h>
+#include <linux/u64_stats_sync.h>
 #include <net/netlink.h>
 #include <net/act_api.h>
 #include <net/pkt_cls.h>
 
 #include "kernel/cls_panda.h"
 
+/* Filters are kept in a hash table per mask (tuple space search). A packet is
+ * parsed once to get its key, then for each mask the masked key is looked up
+ * in the hash table of the mask. The number of lookups is the number of
+ * distinct masks and not the number of filters
+ */
+struct panda_mask {
+	struct tc_cls_panda_key key;
+	struct rhashtable ht;
+	struct list_head list;
+	refcount_t refcnt;
+	struct rcu_work rwork;
+};
+
+/* Statistics are per CPU so that panda_classify() doesn't write to any
+ * shared cache line, they are summed for dumps
+ */
+struct panda_cpu_stats {
+	u64_stats_t packets;
+	u64_stats_t nomatch;
+	u64_stats_t errors[TC_CLS_PANDA_NUM_STOP];
+	u64_stats_t hist[TC_CLS_PANDA_NUM_HIST];
+	struct u64_stats_sync syncp;
+};
+
+struct panda_filter_stats {
+	u64_stats_t matches;
+	struct u64_stats_sync syncp;
+};
+
 struct panda_head {
 	struct tc_cls_panda_ops *ops;
 	struct list_head filters;
+	struct list_head masks;
 	struct idr handle_idr;
+	struct panda_cpu_stats __percpu *stats;
+	unsigned int num_hist; /* Filters with the hist flag */
 	struct rcu_head rcu;
 };
 
@@ -49,9 +87,33 @@ struct panda_filter {
 	u32 handle;
 	struct list_head list;
 	struct tcf_result res;
+	struct tc_cls_panda_key mkey; /* Key masked by the mask */
+	struct panda_mask *mask;
+	struct rhash_head ht_node;
+	bool publish;
+	bool hist;
+	struct panda_filter_stats __percpu *stats;
 	struct rcu_work rwork;
 };
 
+/* Key of the last packet published on a CPU */
+struct panda_flow_rec {
+	const struct sk_buff *skb;
+	u32 hash;
+	struct tc_cls_panda_key key;
+};
+
+static DEFINE_PER_CPU(struct panda_flow_rec, panda_flow_rec);
+
+static siphash_key_t panda_hash_key __read_mostly;
+
+static const struct rhashtable_params panda_ht_params = {
+	.key_offset = offsetof(struct panda_filter, mkey),
+	.head_offset = offsetof(struct panda_filter, ht_node),
+	.key_len = sizeof(struct tc_cls_panda_key),
+	.automatic_shrinking = true,
+};
+
 static LIST_HEAD(ops_list);
 static DEFINE_RWLOCK(ops_mod_lock);
 
@@ -120,40 +182,251 @@ EXPORT_SYMBOL_GPL(unregister_panda_ops);
 static const struct nla_policy panda_policy[TCA_PANDA_MAX + 1] = {
 	[TCA_PANDA_CLASSID] = { .type = NLA_U32 },
 	[TCA_PANDA_PARSER] = { .type = NLA_NUL_STRING, .len = 255 },
+	[TCA_PANDA_KEY_ETH_PROTO] = { .type = NLA_U16 },
+	[TCA_PANDA_KEY_IP_PROTO] = { .type = NLA_U8 },
+	[TCA_PANDA_KEY_IPV4_SRC] = { .type = NLA_U32 },
+	[TCA_PANDA_KEY_IPV4_SRC_MASK] = { .type = NLA_U32 },
+	[TCA_PANDA_KEY_IPV4_DST] = { .type = NLA_U32 },
+	[TCA_PANDA_KEY_IPV4_DST_MASK] = { .type = NLA_U32 },
+	[TCA_PANDA_KEY_IPV6_SRC] = { .len = sizeof(struct in6_addr) },
+	[TCA_PANDA_KEY_IPV6_SRC_MASK] = { .len = sizeof(struct in6_addr) },
+	[TCA_PANDA_KEY_IPV6_DST] = { .len = sizeof(struct in6_addr) },
+	[TCA_PANDA_KEY_IPV6_DST_MASK] = { .len = sizeof(struct in6_addr) },
+	[TCA_PANDA_KEY_SRC_PORT] = { .type = NLA_U16 },
+	[TCA_PANDA_KEY_DST_PORT] = { .type = NLA_U16 },
+	[TCA_PANDA_KEY_VLAN_ID] = { .type = NLA_U16 },
+	[TCA_PANDA_KEY_KEYID] = { .type = NLA_U32 },
+	[TCA_PANDA_PUBLISH] = { .type = NLA_FLAG },
+	[TCA_PANDA_HIST] = { .type = NLA_FLAG },
 };
 
 static int panda_init(struct tcf_proto *tp)
 {
 	struct panda_head *head;
+	int cpu;
 
 	head = kzalloc(sizeof(*head), GFP_KERNEL);
 	if (head == NULL)
 		return -ENOBUFS;
+	head->stats = alloc_percpu(struct panda_cpu_stats);
+	if (!head->stats) {
+		kfree(head);
+		return -ENOBUFS;
+	}
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(head->stats, cpu)->syncp);
 	INIT_LIST_HEAD(&head->filters);
+	INIT_LIST_HEAD(&head->masks);
 	idr_init(&head->handle_idr);
 	rcu_assign_pointer(tp->root, head);
 
 	return 0;
 }
 
+static void panda_mask_key(struct tc_cls_panda_key *mkey,
+			   const struct tc_cls_panda_key *key,
+			   const struct tc_cls_panda_key *mask)
+{
+	const long *lkey = (const long *)key;
+	const long *lmask = (const long *)mask;
+	long *lmkey = (long *)mkey;
+	int i;
+
+	for (i = 0; i < sizeof(*key); i += sizeof(long))
+		*lmkey++ = *lkey++ & *lmask++;
+}
+
+/* Sort the addresses (and the ports if the addresses are the same) so that
+ * both directions of a flow have the same hash, as PANDA_HASH_CONSISTENTIFY
+ */
+static void panda_key_consistentify(struct tc_cls_panda_key *key)
+{
+	int addr_diff;
+
+	switch (key->addr_type) {
+	case TC_CLS_PANDA_ADDR_IPV4:
+		addr_diff = key->addrs.v4.daddr - key->addrs.v4.saddr;
+		if (addr_diff < 0 ||
+		    (addr_diff == 0 && key->dst_port < key->src_port)) {
+			swap(key->addrs.v4.saddr, key->addrs.v4.daddr);
+			swap(key->src_port, key->dst_port);
+		}
+		break;
+	case TC_CLS_PANDA_ADDR_IPV6:
+		addr_diff = memcmp(&key->addrs.v6.daddr, &key->addrs.v6.saddr,
+				   sizeof(key->addrs.v6.daddr));
+		if (addr_diff < 0 ||
+		    (addr_diff == 0 && key->dst_port < key->src_port)) {
+			swap(key->addrs.v6.saddr, key->addrs.v6.daddr);
+			swap(key->src_port, key->dst_port);
+		}
+		break;
+	}
+}
+
+/* Publish the parse results into the skb so that later stages don't run the
+ * flow dissector again: the canonical hash of the key is set as the skb hash,
+ * the network and transport headers are set from the header offsets, and the
+ * key is kept as the flow key of the packet
+ */
+static void panda_publish(struct sk_buff *skb,
+			  const struct tc_cls_panda_key *key,
+			  const struct tc_cls_panda_info *info)
+{
+	struct panda_flow_rec *rec = this_cpu_ptr(&panda_flow_rec);
+	struct tc_cls_panda_key hkey = *key;
+	u32 hash;
+
+	if (!skb_mac_header_was_set(skb))
+		return;
+
+	if (info->l3_off)
+		skb_set_network_header(skb, skb_mac_offset(skb) +
+					    info->l3_off);
+	if (info->l4_off)
+		skb_set_transport_header(skb, skb_mac_offset(skb) +
+					      info->l4_off);
+
+	panda_key_consistentify(&hkey);
+	hash = siphash(&hkey, sizeof(hkey), &panda_hash_key) ? : 1;
+	__skb_set_sw_hash(skb, hash, !!info->l4_off);
+
+	rec->skb = skb;
+	rec->hash = hash;
+	rec->key = *key;
+}
+
+bool tc_cls_panda_flow_key(const struct sk_buff *skb,
+			   struct tc_cls_panda_key *key)
+{
+	const struct panda_flow_rec *rec = this_cpu_ptr(&panda_flow_rec);
+
+	if (rec->skb != skb || !skb->sw_hash || rec->hash != skb->hash)
+		return false;
+
+	*key = rec->key;
+
+	return true;
+}
+EXPORT_SYMBOL_GPL(tc_cls_panda_flow_key);
+
 static int panda_classify(struct sk_buff *skb, const struct tcf_proto *tp,
 			  struct tcf_result *res)
 {
 	struct panda_head *head = rcu_dereference_bh(tp->root);
-	struct panda_filter *filter;
+	struct panda_filter *filter, *best = NULL;
+	bool hist = READ_ONCE(head->num_hist);
+	struct tc_cls_panda_info info = {};
+	struct tc_cls_panda_key key, mkey;
+	struct panda_filter_stats *fstats;
+	struct panda_cpu_stats *stats;
+	struct panda_mask *mask;
+	u64 start = 0;
+	int ret;
+
+	/* The parser is set before the first filter is added */
+	if (list_empty(&head->masks))
+		return -1;
+
+	/* Parse once, all filters match on the same key */
+	memset(&key, 0, sizeof(key));
+	if (hist)
+		start = ktime_get_ns();
+	ret = head->ops->parse(skb, &key, &info);
+	if (hist)
+		start = ktime_get_ns() - start;
+
+	/* If filters with different masks match the one with the lowest
+	 * handle wins
+	 */
+	if (ret >= 0) {
+		list_for_each_entry_rcu(mask, &head->masks, list) {
+			panda_mask_key(&mkey, &key, &mask->key);
+			filter = rhashtable_lookup_fast(&mask->ht, &mkey,
+							panda_ht_params);
+			if (filter && (!best || filter->handle < best->handle))
+				best = filter;
+		}
+	}
 
-	list_for_each_entry_rcu(filter, &head->filters, list) {
-		int ret = head->ops->parse(skb);
+	stats = this_cpu_ptr(head->stats);
+	u64_stats_update_begin(&stats->syncp);
+	u64_stats_inc(&stats->packets);
+	if (hist)
+		u64_stats_inc(&stats->hist[min_t(int, fls64(start),
+						 TC_CLS_PANDA_NUM_HIST - 1)]);
+	if (ret < 0)
+		u64_stats_inc(&stats->errors[-ret < TC_CLS_PANDA_NUM_STOP ?
+					     -ret : 0]);
+	else if (!best)
+		u64_stats_inc(&stats->nomatch);
+	u64_stats_update_end(&stats->syncp);
 
-		if (ret < 0)
-			continue;
-		/* TODO: return something else */
-		return 0;
-	}
+	if (!best)
+		return -1;
+
+	fstats = this_cpu_ptr(best->stats);
+	u64_stats_update_begin(&fstats->syncp);
+	u64_stats_inc(&fstats->matches);
+	u64_stats_update_end(&fstats->syncp);
+
+	*res = best->res;
+
+	if (best->publish)
+		panda_publish(skb, &key, &info);
 
 	return 0;
 }
 
+static void panda_mask_free_work(struct work_struct *work)
+{
+	struct panda_mask *mask =
+		container_of(to_rcu_work(work), struct panda_mask, rwork);
+
+	rhashtable_destroy(&mask->ht);
+	kfree(mask);
+}
+
+/* Get the mask with the key, a new mask is made if there is none */
+static struct panda_mask *panda_mask_get(struct panda_head *head,
+					 const struct tc_cls_panda_key *key)
+{
+	struct panda_mask *mask;
+	int err;
+
+	list_for_each_entry(mask, &head->masks, list) {
+		if (!memcmp(&mask->key, key, sizeof(*key))) {
+			refcount_inc(&mask->refcnt);
+			return mask;
+		}
+	}
+
+	mask = kzalloc(sizeof(*mask), GFP_KERNEL);
+	if (!mask)
+		return ERR_PTR(-ENOBUFS);
+
+	err = rhashtable_init(&mask->ht, &panda_ht_params);
+	if (err) {
+		kfree(mask);
+		return ERR_PTR(err);
+	}
+
+	mask->key = *key;
+	refcount_set(&mask->refcnt, 1);
+	list_add_tail_rcu(&mask->list, &head->masks);
+
+	return mask;
+}
+
+static void panda_mask_put(struct panda_mask *mask)
+{
+	if (!refcount_dec_and_test(&mask->refcnt))
+		return;
+
+	list_del_rcu(&mask->list);
+	tcf_queue_work(&mask->rwork, panda_mask_free_work);
+}
+
 static void *panda_get(struct tcf_proto *tp, u32 handle)
 {
 	struct panda_head *head = rtnl_dereference(tp->root);
@@ -167,15 +440,29 @@ static void *panda_get(struct tcf_proto *tp, u32 handle)
 	return NULL;
 }
 
+static void panda_free_filter(struct panda_filter *filter)
+{
+	free_percpu(filter->stats);
+	kfree(filter);
+}
+
 static void panda_delete_filter_work(struct work_struct *work)
 {
 	struct panda_filter *filter =
 		container_of(to_rcu_work(work), struct panda_filter, rwork);
 	rtnl_lock();
-	kfree(filter);
+	panda_free_filter(filter);
 	rtnl_unlock();
 }
 
+static void panda_free_head_rcu(struct rcu_head *rcu)
+{
+	struct panda_head *head = container_of(rcu, struct panda_head, rcu);
+
+	free_percpu(head->stats);
+	kfree(head);
+}
+
 static void panda_destroy(struct tcf_proto *tp, bool rtnl_held,
 			  struct netlink_ext_ack *extack)
 {
@@ -184,13 +471,16 @@ static void panda_destroy(struct tcf_proto *tp, bool rtnl_held,
 
 	list_for_each_entry_safe(filter, tmp, &head->filters, list) {
 		list_del_rcu(&filter->list);
+		rhashtable_remove_fast(&filter->mask->ht, &filter->ht_node,
+				       panda_ht_params);
+		panda_mask_put(filter->mask);
 		tcf_unbind_filter(tp, &filter->res);
 		idr_remove(&head->handle_idr, filter->handle);
-		kfree(filter);
+		tcf_queue_work(&filter->rwork, panda_delete_filter_work);
 		module_put(head->ops->owner);
 	}
 	idr_destroy(&head->handle_idr);
-	kfree_rcu(head, rcu);
+	call_rcu(&head->rcu, panda_free_head_rcu);
 }
 
 static int panda_delete(struct tcf_proto *tp, void *arg, bool *last,
@@ -200,11 +490,17 @@ static int panda_delete(struct tcf_proto *tp, void *arg, bool *last,
 	struct panda_filter *filter = arg;
 
 	list_del_rcu(&filter->list);
+	rhashtable_remove_fast(&filter->mask->ht, &filter->ht_node,
+			       panda_ht_params);
+	panda_mask_put(filter->mask);
 	tcf_unbind_filter(tp, &filter->res);
 
 	idr_remove(&head->handle_idr, filter->handle);
 	module_put(head->ops->owner);
 
+	if (filter->hist)
+		WRITE_ONCE(head->num_hist, head->num_hist - 1);
+
 	*last = list_empty(&head->filters);
 
 	tcf_queue_work(&filter->rwork, panda_delete_filter_work);
@@ -212,6 +508,83 @@ static int panda_delete(struct tcf_proto *tp, void *arg, bool *last,
 	return 0;
 }
 
+static void panda_set_key_val(struct nlattr **tb, void *val, int val_type,
+			      void *mask, int mask_type, int len)
+{
+	if (!tb[val_type])
+		return;
+	nla_memcpy(val, tb[val_type], len);
+	if (mask_type == TCA_PANDA_UNSPEC || !tb[mask_type])
+		memset(mask, 0xff, len);
+	else
+		nla_memcpy(mask, tb[mask_type], len);
+}
+
+/* Set the match key and mask of a filter. Fields without an attribute are
+ * wildcards, a filter without any is a catch-all
+ */
+static int panda_set_key(struct nlattr **tb, struct tc_cls_panda_key *key,
+			 struct tc_cls_panda_key *mask)
+{
+	bool v4 = tb[TCA_PANDA_KEY_IPV4_SRC] || tb[TCA_PANDA_KEY_IPV4_DST];
+	bool v6 = tb[TCA_PANDA_KEY_IPV6_SRC] || tb[TCA_PANDA_KEY_IPV6_DST];
+
+	if (v4 && v6)
+		return -EINVAL;
+
+	panda_set_key_val(tb, &key->eth_proto, TCA_PANDA_KEY_ETH_PROTO,
+			  &mask->eth_proto, TCA_PANDA_UNSPEC,
+			  sizeof(key->eth_proto));
+	panda_set_key_val(tb, &key->ip_proto, TCA_PANDA_KEY_IP_PROTO,
+			  &mask->ip_proto, TCA_PANDA_UNSPEC,
+			  sizeof(key->ip_proto));
+	panda_set_key_val(tb, &key->src_port, TCA_PANDA_KEY_SRC_PORT,
+			  &mask->src_port, TCA_PANDA_UNSPEC,
+			  sizeof(key->src_port));
+	panda_set_key_val(tb, &key->dst_port, TCA_PANDA_KEY_DST_PORT,
+			  &mask->dst_port, TCA_PANDA_UNSPEC,
+			  sizeof(key->dst_port));
+	panda_set_key_val(tb, &key->vlan_id, TCA_PANDA_KEY_VLAN_ID,
+			  &mask->vlan_id, TCA_PANDA_UNSPEC,
+			  sizeof(key->vlan_id));
+	panda_set_key_val(tb, &key->keyid, TCA_PANDA_KEY_KEYID,
+			  &mask->keyid, TCA_PANDA_UNSPEC,
+			  sizeof(key->keyid));
+
+	if (key->vlan_id & ~VLAN_VID_MASK)
+		return -EINVAL;
+
+	if (v4) {
+		key->addr_type = TC_CLS_PANDA_ADDR_IPV4;
+		mask->addr_type = ~0;
+		panda_set_key_val(tb, &key->addrs.v4.saddr,
+				  TCA_PANDA_KEY_IPV4_SRC,
+				  &mask->addrs.v4.saddr,
+				  TCA_PANDA_KEY_IPV4_SRC_MASK,
+				  sizeof(key->addrs.v4.saddr));
+		panda_set_key_val(tb, &key->addrs.v4.daddr,
+				  TCA_PANDA_KEY_IPV4_DST,
+				  &mask->addrs.v4.daddr,
+				  TCA_PANDA_KEY_IPV4_DST_MASK,
+				  sizeof(key->addrs.v4.daddr));
+	} else if (v6) {
+		key->addr_type = TC_CLS_PANDA_ADDR_IPV6;
+		mask->addr_type = ~0;
+		panda_set_key_val(tb, &key->addrs.v6.saddr,
+				  TCA_PANDA_KEY_IPV6_SRC,
+				  &mask->addrs.v6.saddr,
+				  TCA_PANDA_KEY_IPV6_SRC_MASK,
+				  sizeof(key->addrs.v6.saddr));
+		panda_set_key_val(tb, &key->addrs.v6.daddr,
+				  TCA_PANDA_KEY_IPV6_DST,
+				  &mask->addrs.v6.daddr,
+				  TCA_PANDA_KEY_IPV6_DST_MASK,
+				  sizeof(key->addrs.v6.daddr));
+	}
+
+	return 0;
+}
+
 static int panda_set_params(struct tcf_proto *tp, struct nlattr **tb,
 			    struct panda_head *head,
 			    struct panda_filter *filter, unsigned long base,
@@ -249,6 +622,9 @@ static int panda_set_params(struct tcf_proto *tp, struct nlattr **tb,
 		goto out;
 	}
 
+	filter->publish = nla_get_flag(tb[TCA_PANDA_PUBLISH]);
+	filter->hist = nla_get_flag(tb[TCA_PANDA_HIST]);
+
 	if (tb[TCA_PANDA_CLASSID]) {
 		filter->res.classid = nla_get_u32(tb[TCA_PANDA_CLASSID]);
 		tcf_bind_filter(tp, &filter->res, base);
@@ -265,10 +641,12 @@ static int panda_change(struct net *net, struct sk_buff *in_skb,
 			bool rtnl_held, struct netlink_ext_ack *extack)
 {
 	struct panda_head *head = rtnl_dereference(tp->root);
+	struct tc_cls_panda_key key = {}, mask_key = {};
 	struct panda_filter *fold = *arg;
-	struct panda_filter *fnew;
 	struct nlattr *tb[TCA_PANDA_MAX + 1];
-	int err;
+	struct panda_filter *fnew;
+	struct panda_mask *mask;
+	int err, cpu;
 
 	if (tca[TCA_OPTIONS] == NULL)
 		return -EINVAL;
@@ -286,10 +664,22 @@ static int panda_change(struct net *net, struct sk_buff *in_skb,
 			return -EINVAL;
 	}
 
+	err = panda_set_key(tb, &key, &mask_key);
+	if (err < 0)
+		return err;
+
 	fnew = kzalloc(sizeof(*fnew), GFP_KERNEL);
 	if (!fnew)
 		return -ENOBUFS;
 
+	fnew->stats = alloc_percpu(struct panda_filter_stats);
+	if (!fnew->stats) {
+		err = -ENOBUFS;
+		goto err;
+	}
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(fnew->stats, cpu)->syncp);
+
 	if (!handle) {
 		handle = 1;
 		err = idr_alloc_u32(&head->handle_idr, fnew, &handle, INT_MAX,
@@ -304,17 +694,42 @@ static int panda_change(struct net *net, struct sk_buff *in_skb,
 	fnew->handle = handle;
 
 	err = panda_set_params(tp, tb, head, fnew, base, rtnl_held);
-	if (err < 0) {
-		if (!fold)
-			idr_remove(&head->handle_idr, fnew->handle);
-		goto err;
+	if (err < 0)
+		goto err_idr;
+
+	mask = panda_mask_get(head, &mask_key);
+	if (IS_ERR(mask)) {
+		err = PTR_ERR(mask);
+		goto err_unbind;
+	}
+	fnew->mask = mask;
+	panda_mask_key(&fnew->mkey, &key, &mask->key);
+
+	/* The old filter is removed first, the new one may have the same key */
+	if (fold)
+		rhashtable_remove_fast(&fold->mask->ht, &fold->ht_node,
+				       panda_ht_params);
+
+	err = rhashtable_lookup_insert_fast(&mask->ht, &fnew->ht_node,
+					    panda_ht_params);
+	if (err) {
+		if (fold)
+			rhashtable_insert_fast(&fold->mask->ht,
+					       &fold->ht_node,
+					       panda_ht_params);
+		panda_mask_put(mask);
+		goto err_unbind;
 	}
 
 	*arg = fnew;
 
+	WRITE_ONCE(head->num_hist, head->num_hist + fnew->hist -
+				   (fold ? fold->hist : 0));
+
 	if (fold) {
 		idr_replace(&head->handle_idr, fnew, fnew->handle);
 		list_replace_rcu(&fold->list, &fnew->list);
+		panda_mask_put(fold->mask);
 		tcf_unbind_filter(tp, &fold->res);
 		tcf_queue_work(&fold->rwork, panda_delete_filter_work);
 	} else {
@@ -322,8 +737,13 @@ static int panda_change(struct net *net, struct sk_buff *in_skb,
 	}
 
 	return 0;
+err_unbind:
+	tcf_unbind_filter(tp, &fnew->res);
+err_idr:
+	if (!fold)
+		idr_remove(&head->handle_idr, fnew->handle);
 err:
-	kfree(fnew);
+	panda_free_filter(fnew);
 	return err;
 }
 
@@ -359,10 +779,130 @@ static void panda_bind_class(void *fh, u32 classid, unsigned long cl, void *q,
 	}
 }
 
+static int panda_dump_key_val(struct sk_buff *skb, void *val, int val_type,
+			      void *mask, int mask_type, int len)
+{
+	if (!memchr_inv(mask, 0, len))
+		return 0;
+	if (nla_put(skb, val_type, len, val))
+		return -1;
+	if (mask_type != TCA_PANDA_UNSPEC &&
+	    nla_put(skb, mask_type, len, mask))
+		return -1;
+
+	return 0;
+}
+
+static int panda_dump_key(struct sk_buff *skb, struct panda_filter *filter)
+{
+	struct tc_cls_panda_key *mask = &filter->mask->key;
+	struct tc_cls_panda_key *key = &filter->mkey;
+
+	if (panda_dump_key_val(skb, &key->eth_proto, TCA_PANDA_KEY_ETH_PROTO,
+			       &mask->eth_proto, TCA_PANDA_UNSPEC,
+			       sizeof(key->eth_proto)) ||
+	    panda_dump_key_val(skb, &key->ip_proto, TCA_PANDA_KEY_IP_PROTO,
+			       &mask->ip_proto, TCA_PANDA_UNSPEC,
+			       sizeof(key->ip_proto)) ||
+	    panda_dump_key_val(skb, &key->src_port, TCA_PANDA_KEY_SRC_PORT,
+			       &mask->src_port, TCA_PANDA_UNSPEC,
+			       sizeof(key->src_port)) ||
+	    panda_dump_key_val(skb, &key->dst_port, TCA_PANDA_KEY_DST_PORT,
+			       &mask->dst_port, TCA_PANDA_UNSPEC,
+			       sizeof(key->dst_port)) ||
+	    panda_dump_key_val(skb, &key->vlan_id, TCA_PANDA_KEY_VLAN_ID,
+			       &mask->vlan_id, TCA_PANDA_UNSPEC,
+			       sizeof(key->vlan_id)) ||
+	    panda_dump_key_val(skb, &key->keyid, TCA_PANDA_KEY_KEYID,
+			       &mask->keyid, TCA_PANDA_UNSPEC,
+			       sizeof(key->keyid)))
+		return -1;
+
+	switch (key->addr_type) {
+	case TC_CLS_PANDA_ADDR_IPV4:
+		if (panda_dump_key_val(skb, &key->addrs.v4.saddr,
+				       TCA_PANDA_KEY_IPV4_SRC,
+				       &mask->addrs.v4.saddr,
+				       TCA_PANDA_KEY_IPV4_SRC_MASK,
+				       sizeof(key->addrs.v4.saddr)) ||
+		    panda_dump_key_val(skb, &key->addrs.v4.daddr,
+				       TCA_PANDA_KEY_IPV4_DST,
+				       &mask->addrs.v4.daddr,
+				       TCA_PANDA_KEY_IPV4_DST_MASK,
+				       sizeof(key->addrs.v4.daddr)))
+			return -1;
+		break;
+	case TC_CLS_PANDA_ADDR_IPV6:
+		if (panda_dump_key_val(skb, &key->addrs.v6.saddr,
+				       TCA_PANDA_KEY_IPV6_SRC,
+				       &mask->addrs.v6.saddr,
+				       TCA_PANDA_KEY_IPV6_SRC_MASK,
+				       sizeof(key->addrs.v6.saddr)) ||
+		    panda_dump_key_val(skb, &key->addrs.v6.daddr,
+				       TCA_PANDA_KEY_IPV6_DST,
+				       &mask->addrs.v6.daddr,
+				       TCA_PANDA_KEY_IPV6_DST_MASK,
+				       sizeof(key->addrs.v6.daddr)))
+			return -1;
+		break;
+	}
+
+	return 0;
+}
+
+/* Sum the per CPU statistics of the parser and of a filter */
+static void panda_sum_stats(struct panda_head *head,
+			    struct panda_filter *filter,
+			    struct tc_cls_panda_stats *stats, u64 *hist,
+			    u64 *matches)
+{
+	unsigned int start;
+	u64 m;
+	int cpu, i;
+
+	memset(stats, 0, sizeof(*stats));
+	memset(hist, 0, sizeof(*hist) * TC_CLS_PANDA_NUM_HIST);
+	*matches = 0;
+
+	for_each_possible_cpu(cpu) {
+		const struct panda_cpu_stats *cs =
+					per_cpu_ptr(head->stats, cpu);
+		const struct panda_filter_stats *fs =
+					per_cpu_ptr(filter->stats, cpu);
+		struct tc_cls_panda_stats s;
+		u64 h[TC_CLS_PANDA_NUM_HIST];
+
+		do {
+			start = u64_stats_fetch_begin(&cs->syncp);
+			s.packets = u64_stats_read(&cs->packets);
+			s.nomatch = u64_stats_read(&cs->nomatch);
+			for (i = 0; i < TC_CLS_PANDA_NUM_STOP; i++)
+				s.errors[i] = u64_stats_read(&cs->errors[i]);
+			for (i = 0; i < TC_CLS_PANDA_NUM_HIST; i++)
+				h[i] = u64_stats_read(&cs->hist[i]);
+		} while (u64_stats_fetch_retry(&cs->syncp, start));
+
+		do {
+			start = u64_stats_fetch_begin(&fs->syncp);
+			m = u64_stats_read(&fs->matches);
+		} while (u64_stats_fetch_retry(&fs->syncp, start));
+
+		stats->packets += s.packets;
+		stats->nomatch += s.nomatch;
+		for (i = 0; i < TC_CLS_PANDA_NUM_STOP; i++)
+			stats->errors[i] += s.errors[i];
+		for (i = 0; i < TC_CLS_PANDA_NUM_HIST; i++)
+			hist[i] += h[i];
+		*matches += m;
+	}
+}
+
 static int panda_dump(struct net *net, struct tcf_proto *tp, void *fh,
 		      struct sk_buff *skb, struct tcmsg *t, bool rtnl_held)
 {
 	struct panda_head *head = rtnl_dereference(tp->root);
+	u64 hist[TC_CLS_PANDA_NUM_HIST], matches;
+	struct tc_cls_panda_stats stats;
 	struct panda_filter *filter = fh;
 	struct nlattr *nest;
 
@@ -382,6 +922,26 @@ static int panda_dump(struct net *net, struct tcf_proto *tp, void *fh,
 	if (nla_put_string(skb, TCA_PANDA_PARSER, head->ops->name))
 		goto nla_put_failure;
 
+	if (panda_dump_key(skb, filter))
+		goto nla_put_failure;
+
+	if (filter->publish && nla_put_flag(skb, TCA_PANDA_PUBLISH))
+		goto nla_put_failure;
+
+	panda_sum_stats(head, filter, &stats, hist, &matches);
+
+	if (nla_put_64bit(skb, TCA_PANDA_STATS, sizeof(stats), &stats,
+			  TCA_PANDA_PAD) ||
+	    nla_put_u64_64bit(skb, TCA_PANDA_MATCHES, matches,
+			      TCA_PANDA_PAD))
+		goto nla_put_failure;
+
+	if (filter->hist &&
+	    (nla_put_flag(skb, TCA_PANDA_HIST) ||
+	     nla_put_64bit(skb, TCA_PANDA_LATENCY, sizeof(hist), hist,
+			   TCA_PANDA_PAD)))
+		goto nla_put_failure;
+
 	nla_nest_end(skb, nest);
 
 	return skb->len;
@@ -407,6 +967,8 @@ static struct tcf_proto_ops cls_basic_ops __read_mostly = {
 
 static int __init init_panda(void)
 {
+	get_random_bytes(&panda_hash_key, sizeof(panda_hash_key));
+
 	return register_tcf_proto_ops(&cls_basic_ops);
 }
 
@@ -0,0 +1,502 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Bytecode parser interpreter */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "panda/bytecode.h"
+#include "panda/parser.h"
+#include "panda/parser_metadata.h"
+#include "panda/proto_nodes.h"
+
+/* Built in metadata extractors */
+
+PANDA_METADATA_TEMP_ether(panda_bc_ether, panda_metadata_all)
+PANDA_METADATA_TEMP_ether_off(panda_bc_ether_off, panda_metadata_all)
+PANDA_METADATA_TEMP_ether_noaddrs(panda_bc_ether_noaddrs, panda_metadata_all)
+PANDA_METADATA_TEMP_ipv4(panda_bc_ipv4, panda_metadata_all)
+PANDA_METADATA_TEMP_ipv4_addrs(panda_bc_ipv4_addrs, panda_metadata_all)
+PANDA_METADATA_TEMP_ipv6(panda_bc_ipv6, panda_metadata_all)
+PANDA_METADATA_TEMP_ipv6_addrs(panda_bc_ipv6_addrs, panda_metadata_all)
+PANDA_METADATA_TEMP_ports(panda_bc_ports, panda_metadata_all)
+PANDA_METADATA_TEMP_ports_off(panda_bc_ports_off, panda_metadata_all)
+PANDA_METADATA_TEMP_ip_overlay(panda_bc_ip_overlay, panda_metadata_all)
+PANDA_METADATA_TEMP_ipv6_eh(panda_bc_ipv6_eh, panda_metadata_all)
+PANDA_METADATA_TEMP_ipv6_frag(panda_bc_ipv6_frag, panda_metadata_all)
+PANDA_METADATA_TEMP_ipv6_frag_noinfo(panda_bc_ipv6_frag_noinfo,
+				     panda_metadata_all)
+PANDA_METADATA_TEMP_arp_rarp(panda_bc_arp_rarp, panda_metadata_all)
+PANDA_METADATA_TEMP_vlan_8021AD(panda_bc_vlan_8021AD, panda_metadata_all)
+PANDA_METADATA_TEMP_vlan_8021Q(panda_bc_vlan_8021Q, panda_metadata_all)
+PANDA_METADATA_TEMP_icmp(panda_bc_icmp, panda_metadata_all)
+PANDA_METADATA_TEMP_mpls(panda_bc_mpls, panda_metadata_all)
+PANDA_METADATA_TEMP_tipc(panda_bc_tipc, panda_metadata_all)
+
+/* Number of bytes of the header read by each extractor */
+static const unsigned int panda_bc_extract_len[PANDA_BC_EXTRACT_NUM] = {
+	[PANDA_BC_EXTRACT_ether] = sizeof(struct ethhdr),
+	[PANDA_BC_EXTRACT_ether_off] = sizeof(struct ethhdr),
+	[PANDA_BC_EXTRACT_ether_noaddrs] = sizeof(struct ethhdr),
+	[PANDA_BC_EXTRACT_ipv4] = sizeof(struct iphdr),
+	[PANDA_BC_EXTRACT_ipv4_addrs] = sizeof(struct iphdr),
+	[PANDA_BC_EXTRACT_ipv6] = sizeof(struct ipv6hdr),
+	[PANDA_BC_EXTRACT_ipv6_addrs] = sizeof(struct ipv6hdr),
+	[PANDA_BC_EXTRACT_ports] = sizeof(struct port_hdr),
+	[PANDA_BC_EXTRACT_ports_off] = sizeof(struct port_hdr),
+	[PANDA_BC_EXTRACT_ip_overlay] = sizeof(struct ip_hdr_byte),
+	[PANDA_BC_EXTRACT_ipv6_eh] = sizeof(struct ipv6_opt_hdr),
+	[PANDA_BC_EXTRACT_ipv6_frag] = sizeof(struct ipv6_frag_hdr),
+	[PANDA_BC_EXTRACT_ipv6_frag_noinfo] = sizeof(struct ipv6_frag_hdr),
+	[PANDA_BC_EXTRACT_arp_rarp] = sizeof(struct earphdr),
+	[PANDA_BC_EXTRACT_vlan_8021AD] = sizeof(struct vlan_hdr),
+	[PANDA_BC_EXTRACT_vlan_8021Q] = sizeof(struct vlan_hdr),
+	[PANDA_BC_EXTRACT_icmp] = sizeof(struct icmphdr),
+	/* The entropy label is read from the second label */
+	[PANDA_BC_EXTRACT_mpls] = 2 * sizeof(struct mpls_label),
+	[PANDA_BC_EXTRACT_tipc] = sizeof(struct tipc_basic_hdr),
+};
+
+static inline __attribute__((always_inline)) void panda_bc_extract(
+		unsigned int temp, const void *hdr, void *frame,
+		const struct panda_ctrl_data ctrl)
+{
+	switch (temp) {
+	case PANDA_BC_EXTRACT_ether:
+		panda_bc_ether(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ether_off:
+		panda_bc_ether_off(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ether_noaddrs:
+		panda_bc_ether_noaddrs(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ipv4:
+		panda_bc_ipv4(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ipv4_addrs:
+		panda_bc_ipv4_addrs(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ipv6:
+		panda_bc_ipv6(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ipv6_addrs:
+		panda_bc_ipv6_addrs(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ports:
+		panda_bc_ports(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ports_off:
+		panda_bc_ports_off(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ip_overlay:
+		panda_bc_ip_overlay(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ipv6_eh:
+		panda_bc_ipv6_eh(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ipv6_frag:
+		panda_bc_ipv6_frag(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_ipv6_frag_noinfo:
+		panda_bc_ipv6_frag_noinfo(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_arp_rarp:
+		panda_bc_arp_rarp(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_vlan_8021AD:
+		panda_bc_vlan_8021AD(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_vlan_8021Q:
+		panda_bc_vlan_8021Q(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_icmp:
+		panda_bc_icmp(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_mpls:
+		panda_bc_mpls(hdr, frame, ctrl);
+		break;
+	case PANDA_BC_EXTRACT_tipc:
+		panda_bc_tipc(hdr, frame, ctrl);
+		break;
+	}
+}
+
+/* Load a header field in host byte order */
+static inline __u32 panda_bc_load_field(const void *p, unsigned int size)
+{
+	__u16 v16;
+	__u32 v32;
+
+	switch (size) {
+	case 1:
+		return *(__u8 *)p;
+	case 2:
+		memcpy(&v16, p, sizeof(v16));
+		return v16;
+	default:
+		memcpy(&v32, p, sizeof(v32));
+		return v32;
+	}
+}
+
+int panda_bc_parse(const struct panda_bc_prog *prog, const void *hdr,
+		   size_t len, struct panda_metadata *metadata,
+		   unsigned int flags, unsigned int max_encaps)
+{
+	const struct panda_bc_insn *insns = prog->insns;
+	const struct panda_bc_insn *insn = insns;
+	void *frame = metadata->frame_data;
+	unsigned int frame_num = 0;
+	const void *base_hdr = hdr;
+	struct panda_ctrl_data ctrl;
+	unsigned int i, num_nodes = 0;
+	size_t hlen = 0, min_len = 0;
+	__u32 acc = 0;
+	int ret;
+
+	do {
+		switch (insn->op) {
+		case PANDA_BC_OP_NODE:
+			if (++num_nodes > PANDA_BC_MAX_NODES)
+				return PANDA_STOP_FAIL;
+			if (len < insn->k)
+				return PANDA_STOP_LENGTH;
+			hlen = min_len = insn->k;
+			break;
+		case PANDA_BC_OP_LEN:
+			if (len < acc || acc < min_len)
+				return PANDA_STOP_LENGTH;
+			hlen = acc;
+			break;
+		case PANDA_BC_OP_LD:
+			acc = panda_bc_load_field(hdr + insn->k, insn->size);
+			break;
+		case PANDA_BC_OP_LDI:
+			acc = insn->k;
+			break;
+		case PANDA_BC_OP_AND:
+			acc &= insn->k;
+			break;
+		case PANDA_BC_OP_ADD:
+			acc += insn->k;
+			break;
+		case PANDA_BC_OP_SHL:
+			acc <<= insn->k;
+			break;
+		case PANDA_BC_OP_SHR:
+			acc >>= insn->k;
+			break;
+		case PANDA_BC_OP_JEQ:
+			if (acc == insn->k) {
+				insn = &insns[insn->off];
+				continue;
+			}
+			break;
+		case PANDA_BC_OP_JNE:
+			if (acc != insn->k) {
+				insn = &insns[insn->off];
+				continue;
+			}
+			break;
+		case PANDA_BC_OP_JGE:
+			if (acc >= insn->k) {
+				insn = &insns[insn->off];
+				continue;
+			}
+			break;
+		case PANDA_BC_OP_JSET:
+			if (acc & insn->k) {
+				insn = &insns[insn->off];
+				continue;
+			}
+			break;
+		case PANDA_BC_OP_RET:
+			return (int)insn->k;
+		case PANDA_BC_OP_EXTRACT:
+			ctrl.hdr_len = hlen;
+			ctrl.hdr_offset = hdr - base_hdr;
+			panda_bc_extract(insn->k, hdr, frame, ctrl);
+			break;
+		case PANDA_BC_OP_ENCAP:
+			ret = panda_parse_encap_layer(metadata, max_encaps,
+						      &frame, &frame_num, NULL,
+						      hdr - base_hdr, flags);
+			if (ret != PANDA_OKAY)
+				return ret;
+			break;
+		case PANDA_BC_OP_TABLE:
+			for (i = 1; i <= insn->k; i++) {
+				if (insn[i].k == acc) {
+					insn += i;
+					goto next_node;
+				}
+			}
+			insn += insn->k;
+			break;
+		case PANDA_BC_OP_CASE:
+		case PANDA_BC_OP_NEXT:
+next_node:
+			if (!insn->size) {
+				/* Move over current header */
+				hdr += hlen;
+				len -= hlen;
+			}
+			insn = &insns[insn->off];
+			continue;
+		default:
+			/* Not reached for a valid program */
+			return PANDA_STOP_FAIL;
+		}
+
+		insn++;
+	} while (1);
+}
+
+/* Validation */
+
+int panda_bc_validate(const struct panda_bc_prog *prog)
+{
+	const struct panda_bc_insn *insns = prog->insns;
+	unsigned int num = prog->num_insns;
+	unsigned int i, j, min_len = 0;
+
+	if (!num || num > 1 << 16 || insns[0].op != PANDA_BC_OP_NODE)
+		return -1;
+
+	for (i = 0; i < num; i++) {
+		const struct panda_bc_insn *insn = &insns[i];
+
+		switch (insn->op) {
+		case PANDA_BC_OP_NODE:
+			min_len = insn->k;
+			break;
+		case PANDA_BC_OP_LD:
+			if ((insn->size != 1 && insn->size != 2 &&
+			     insn->size != 4) ||
+			    insn->k > min_len || min_len - insn->k < insn->size)
+				return -1;
+			break;
+		case PANDA_BC_OP_SHL:
+		case PANDA_BC_OP_SHR:
+			if (insn->k >= 32)
+				return -1;
+			break;
+		case PANDA_BC_OP_JEQ:
+		case PANDA_BC_OP_JNE:
+		case PANDA_BC_OP_JGE:
+		case PANDA_BC_OP_JSET:
+			/* Forward and within the node */
+			if (insn->off <= i || insn->off >= num)
+				return -1;
+			for (j = i + 1; j <= insn->off; j++)
+				if (insns[j].op == PANDA_BC_OP_NODE)
+					return -1;
+			break;
+		case PANDA_BC_OP_EXTRACT:
+			if (insn->k >= PANDA_BC_EXTRACT_NUM ||
+			    panda_bc_extract_len[insn->k] > min_len)
+				return -1;
+			break;
+		case PANDA_BC_OP_TABLE:
+			if (insn->k >= num - i)
+				return -1;
+			for (j = 1; j <= insn->k; j++) {
+				if (insn[j].op != PANDA_BC_OP_CASE ||
+				    insn[j].off >= num ||
+				    insns[insn[j].off].op != PANDA_BC_OP_NODE)
+					return -1;
+			}
+			i += insn->k;
+			break;
+		case PANDA_BC_OP_NEXT:
+			if (insn->off >= num ||
+			    insns[insn->off].op != PANDA_BC_OP_NODE)
+				return -1;
+			break;
+		case PANDA_BC_OP_LEN:
+		case PANDA_BC_OP_LDI:
+		case PANDA_BC_OP_AND:
+		case PANDA_BC_OP_ADD:
+		case PANDA_BC_OP_RET:
+		case PANDA_BC_OP_ENCAP:
+			break;
+		default:
+			/* Unknown opcode, or a CASE outside of a table */
+			return -1;
+		}
+
+		/* A node must not fall through to the next one */
+		if ((i + 1 == num || insns[i + 1].op == PANDA_BC_OP_NODE) &&
+		    insns[i].op != PANDA_BC_OP_RET &&
+		    insns[i].op != PANDA_BC_OP_NEXT)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Saving and loading */
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define PANDA_BC_F_HOST		PANDA_BC_F_BIG_ENDIAN
+#else
+#define PANDA_BC_F_HOST		0
+#endif
+
+/* Loaded program, the instructions follow the program */
+struct panda_bc_loaded {
+	struct panda_bc_prog prog;
+	char name[PANDA_BC_NAME_LEN + 1];
+	struct panda_bc_insn insns[];
+};
+
+size_t panda_bc_image_size(const struct panda_bc_prog *prog)
+{
+	return sizeof(struct panda_bc_image_hdr) +
+		prog->num_insns * sizeof(struct panda_bc_insn);
+}
+
+ssize_t panda_bc_save(const struct panda_bc_prog *prog, void *buf,
+		      size_t size)
+{
+	struct panda_bc_image_hdr hdr;
+
+	if (size < panda_bc_image_size(prog))
+		return -1;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = PANDA_BC_MAGIC;
+	hdr.version = PANDA_BC_VERSION;
+	hdr.flags = PANDA_BC_F_HOST;
+	hdr.num_insns = prog->num_insns;
+	if (prog->name)
+		strncpy(hdr.name, prog->name, sizeof(hdr.name) - 1);
+
+	memcpy(buf, &hdr, sizeof(hdr));
+	memcpy(buf + sizeof(hdr), prog->insns,
+	       prog->num_insns * sizeof(struct panda_bc_insn));
+
+	return panda_bc_image_size(prog);
+}
+
+struct panda_bc_prog *panda_bc_load(const void *buf, size_t size)
+{
+	struct panda_bc_image_hdr hdr;
+	struct panda_bc_loaded *loaded;
+
+	if (size < sizeof(hdr))
+		return NULL;
+
+	memcpy(&hdr, buf, sizeof(hdr));
+
+	if (hdr.magic != PANDA_BC_MAGIC || hdr.version != PANDA_BC_VERSION ||
+	    hdr.flags != PANDA_BC_F_HOST ||
+	    size != sizeof(hdr) +
+		    (size_t)hdr.num_insns * sizeof(struct panda_bc_insn))
+		return NULL;
+
+	loaded = calloc(1, sizeof(*loaded) +
+			hdr.num_insns * sizeof(struct panda_bc_insn));
+	if (!loaded)
+		return NULL;
+
+	memcpy(loaded->name, hdr.name, sizeof(hdr.name));
+	memcpy(loaded->insns, buf + sizeof(hdr),
+	       hdr.num_insns * sizeof(struct panda_bc_insn));
+
+	loaded->prog.name = loaded->name;
+	loaded->prog.insns = loaded->insns;
+	loaded->prog.num_insns = hdr.num_insns;
+
+	if (panda_bc_validate(&loaded->prog)) {
+		free(loaded);
+		return NULL;
+	}
+
+	return &loaded->prog;
+}
+
+void panda_bc_free(struct panda_bc_prog *prog)
+{
+	free(prog);
+}
+
+int panda_bc_save_file(const struct panda_bc_prog *prog, const char *path)
+{
+	size_t size = panda_bc_image_size(prog);
+	void *buf;
+	FILE *f;
+	int ret = -1;
+
+	buf = malloc(size);
+	if (!buf)
+		return -1;
+
+	panda_bc_save(prog, buf, size);
+
+	f = fopen(path, "wb");
+	if (f) {
+		if (fwrite(buf, size, 1, f) == 1)
+			ret = 0;
+		if (fclose(f))
+			ret = -1;
+	}
+
+	free(buf);
+
+	return ret;
+}
+
+struct panda_bc_prog *panda_bc_load_file(const char *path)
+{
+	struct panda_bc_prog *prog = NULL;
+	void *buf = NULL;
+	long size;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (!f)
+		return NULL;
+
+	if (fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 ||
+	    fseek(f, 0, SEEK_SET))
+		goto out;
+
+	buf = malloc(size ? : 1);
+	if (!buf || fread(buf, 1, size, f) != size)
+		goto out;
+
+	prog = panda_bc_load(buf, size);
+
+out:
+	free(buf);
+	fclose(f);
+
+	return prog;
+}
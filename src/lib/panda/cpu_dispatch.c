@@ -0,0 +1,236 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Runtime CPU feature dispatch for PANDA library kernels */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "panda/cpu_dispatch.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define PANDA_CPU_X86_64
+#include <immintrin.h>
+
+/* Target features of the x86-64 microarchitecture levels */
+#define PANDA_CPU_TARGET_X86_64_V2 "sse4.2,popcnt"
+#define PANDA_CPU_TARGET_X86_64_V3 "sse4.2,popcnt,avx2,bmi,bmi2"
+#define PANDA_CPU_TARGET_X86_64_V4 "sse4.2,popcnt,avx2,bmi,bmi2,"	\
+				   "avx512f,avx512bw,avx512vl"
+#endif
+
+/* Baseline kernels. The bodies are always inlined so that they are also
+ * compiled for the target of the level specific variants below
+ */
+
+static inline __attribute__((always_inline)) size_t tlv_skip_pad_body(
+		const __u8 *cp, size_t len, __u8 pad)
+{
+	size_t i;
+
+	for (i = 0; i < len && cp[i] == pad; i++);
+
+	return i;
+}
+
+static size_t tlv_skip_pad_baseline(const __u8 *cp, size_t len, __u8 pad)
+{
+	return tlv_skip_pad_body(cp, len, pad);
+}
+
+#ifdef PANDA_CPU_X86_64
+
+/* x86-64 v2: SSE4.2 and POPCNT */
+
+__attribute__((target(PANDA_CPU_TARGET_X86_64_V2)))
+static size_t tlv_skip_pad_v2(const __u8 *cp, size_t len, __u8 pad)
+{
+	const __m128i vpad = _mm_set1_epi8(pad);
+	unsigned int mask;
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+			_mm_loadu_si128((const __m128i *)&cp[i]), vpad));
+		if (mask != 0xffff)
+			return i + __builtin_ctz(~mask);
+	}
+
+	return i + tlv_skip_pad_body(&cp[i], len - i, pad);
+}
+
+/* x86-64 v3: AVX2 and BMI2 */
+
+__attribute__((target(PANDA_CPU_TARGET_X86_64_V3)))
+static size_t tlv_skip_pad_v3(const __u8 *cp, size_t len, __u8 pad)
+{
+	const __m256i vpad = _mm256_set1_epi8(pad);
+	unsigned int mask;
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *)&cp[i]), vpad));
+		if (mask != 0xffffffff)
+			return i + _tzcnt_u32(~mask);
+	}
+
+	return i + tlv_skip_pad_v2(&cp[i], len - i, pad);
+}
+
+/* x86-64 v4: AVX-512. Masked loads don't fault past the end of the data so
+ * there is no scalar tail
+ */
+
+__attribute__((target(PANDA_CPU_TARGET_X86_64_V4)))
+static size_t tlv_skip_pad_v4(const __u8 *cp, size_t len, __u8 pad)
+{
+	const __m512i vpad = _mm512_set1_epi8(pad);
+	__mmask64 load, eq;
+	size_t i;
+
+	for (i = 0; i < len; i += 64) {
+		load = len - i >= 64 ? ~0ULL : (1ULL << (len - i)) - 1;
+		eq = _mm512_mask_cmpeq_epi8_mask(load, vpad,
+				_mm512_maskz_loadu_epi8(load, &cp[i]));
+		if (eq != load)
+			return i + _tzcnt_u64(~eq);
+	}
+
+	return len;
+}
+
+#endif /* PANDA_CPU_X86_64 */
+
+static const struct panda_cpu_ops panda_cpu_ops_levels[PANDA_CPU_LEVEL_NUM] = {
+	[PANDA_CPU_LEVEL_BASELINE] = {
+		.tlv_skip_pad = tlv_skip_pad_baseline,
+	},
+#ifdef PANDA_CPU_X86_64
+	[PANDA_CPU_LEVEL_V2] = {
+		.tlv_skip_pad = tlv_skip_pad_v2,
+	},
+	[PANDA_CPU_LEVEL_V3] = {
+		.tlv_skip_pad = tlv_skip_pad_v3,
+	},
+	[PANDA_CPU_LEVEL_V4] = {
+		.tlv_skip_pad = tlv_skip_pad_v4,
+	},
+#endif
+};
+
+/* Baseline until panda_cpu_dispatch_init is called */
+struct panda_cpu_ops panda_cpu_ops = {
+	.tlv_skip_pad = tlv_skip_pad_baseline,
+};
+
+static enum panda_cpu_level panda_cpu_level_selected;
+
+static const char *panda_cpu_level_names[PANDA_CPU_LEVEL_NUM] = {
+	[PANDA_CPU_LEVEL_BASELINE] = "baseline",
+	[PANDA_CPU_LEVEL_V2] = "v2",
+	[PANDA_CPU_LEVEL_V3] = "v3",
+	[PANDA_CPU_LEVEL_V4] = "v4",
+};
+
+const char *panda_cpu_level_name(enum panda_cpu_level level)
+{
+	if (level >= PANDA_CPU_LEVEL_NUM)
+		return "unknown";
+
+	return panda_cpu_level_names[level];
+}
+
+enum panda_cpu_level panda_cpu_level_detect(void)
+{
+#ifdef PANDA_CPU_X86_64
+	__builtin_cpu_init();
+
+	if (!__builtin_cpu_supports("sse4.2") ||
+	    !__builtin_cpu_supports("popcnt"))
+		return PANDA_CPU_LEVEL_BASELINE;
+
+	if (!__builtin_cpu_supports("avx2") ||
+	    !__builtin_cpu_supports("bmi") ||
+	    !__builtin_cpu_supports("bmi2"))
+		return PANDA_CPU_LEVEL_V2;
+
+	if (!__builtin_cpu_supports("avx512f") ||
+	    !__builtin_cpu_supports("avx512bw") ||
+	    !__builtin_cpu_supports("avx512vl"))
+		return PANDA_CPU_LEVEL_V3;
+
+	return PANDA_CPU_LEVEL_V4;
+#else
+	return PANDA_CPU_LEVEL_BASELINE;
+#endif
+}
+
+enum panda_cpu_level panda_cpu_level_get(void)
+{
+	return panda_cpu_level_selected;
+}
+
+/* Parse the level from the environment, either a level number or name.
+ * Returns -1 if not set or invalid
+ */
+static int panda_cpu_level_from_env(void)
+{
+	const char *env = getenv(PANDA_CPU_LEVEL_ENV);
+	char *end;
+	long val;
+	int i;
+
+	if (!env || !*env)
+		return -1;
+
+	for (i = 0; i < PANDA_CPU_LEVEL_NUM; i++)
+		if (!strcasecmp(env, panda_cpu_level_names[i]))
+			return i;
+
+	val = strtol(env, &end, 0);
+	if (*end || val < 0)
+		return -1;
+
+	return val;
+}
+
+enum panda_cpu_level panda_cpu_dispatch_init(int level)
+{
+	enum panda_cpu_level max_level = panda_cpu_level_detect();
+
+	if (level < 0)
+		level = panda_cpu_level_from_env();
+
+	if (level < 0 || level > max_level)
+		level = max_level;
+
+	panda_cpu_ops = panda_cpu_ops_levels[level];
+	panda_cpu_level_selected = level;
+
+	return level;
+}
@@ -0,0 +1,673 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/* NUMA replication of parser graphs and the hash key */
+
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "panda/flag_fields.h"
+#include "panda/numa.h"
+#include "panda/parser_types.h"
+#include "panda/tlvs.h"
+
+#define NUMA_SYSFS_NODE		"/sys/devices/system/node"
+#define NUMA_CHUNK_SIZE		(64 * 1024)
+
+/* Chunk of node local memory that replicated objects are allocated from */
+struct numa_chunk {
+	struct numa_chunk *next;
+	size_t size;
+	size_t used;
+	bool frozen;
+	__u8 data[] __aligned(8);
+};
+
+/* Map from an original object to its replica */
+struct numa_map_ent {
+	const void *orig;
+	void *copy;
+};
+
+/* State for one replica */
+struct numa_replica {
+	int node;
+	siphash_key_t *hash_key;
+	struct numa_chunk *chunks;
+	struct numa_map_ent *map;
+	size_t map_cnt;
+	size_t map_size;
+	bool error;
+};
+
+/* Allocation state of a replica, to release what was allocated after it */
+struct numa_mark {
+	struct numa_chunk *chunks;
+	size_t used;
+	size_t map_cnt;
+};
+
+unsigned int __panda_numa_num_nodes;
+siphash_key_t **__panda_numa_hash_keys;
+__thread int __panda_numa_node = -1;
+
+static struct numa_replica *numa_replicas;
+static unsigned int numa_num_replicas;
+
+/* Replica index for each node, nodes not in use map to the first replica */
+static unsigned int *numa_node_replica;
+
+static void numa_bind(void *addr, size_t len, int node)
+{
+	unsigned long mask[CPU_SETSIZE / (8 * sizeof(unsigned long))];
+
+	memset(mask, 0, sizeof(mask));
+	mask[node / (8 * sizeof(unsigned long))] |=
+				1UL << (node % (8 * sizeof(unsigned long)));
+
+	/* Best effort. If binding fails, e.g. NUMA is not supported by the
+	 * kernel, memory is placed on first touch
+	 */
+	syscall(SYS_mbind, addr, len, MPOL_PREFERRED, mask,
+		8 * sizeof(mask), 0);
+}
+
+static void *numa_mmap(int node, size_t size)
+{
+	void *addr;
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED)
+		return NULL;
+
+	numa_bind(addr, size, node);
+
+	return addr;
+}
+
+static void *numa_alloc(struct numa_replica *rep, size_t size)
+{
+	struct numa_chunk *chunk = rep->chunks;
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t csize;
+	void *addr;
+
+	size = (size + 7) & ~7UL;
+
+	if (!chunk || chunk->used + size > chunk->size) {
+		csize = sizeof(*chunk) + size;
+		if (csize < NUMA_CHUNK_SIZE)
+			csize = NUMA_CHUNK_SIZE;
+		csize = (csize + page_size - 1) & ~(page_size - 1);
+
+		chunk = numa_mmap(rep->node, csize);
+		if (!chunk) {
+			rep->error = true;
+			return NULL;
+		}
+
+		chunk->next = rep->chunks;
+		chunk->size = csize - sizeof(*chunk);
+		chunk->used = 0;
+		chunk->frozen = false;
+		rep->chunks = chunk;
+	}
+
+	addr = &chunk->data[chunk->used];
+	chunk->used += size;
+
+	return addr;
+}
+
+static void numa_mark(struct numa_replica *rep, struct numa_mark *mark)
+{
+	mark->chunks = rep->chunks;
+	mark->used = rep->chunks ? rep->chunks->used : 0;
+	mark->map_cnt = rep->map_cnt;
+}
+
+/* Release everything allocated in a replica since a mark */
+static void numa_release(struct numa_replica *rep,
+			 const struct numa_mark *mark)
+{
+	struct numa_chunk *chunk;
+
+	while (rep->chunks != mark->chunks) {
+		chunk = rep->chunks;
+		rep->chunks = chunk->next;
+		munmap(chunk, sizeof(*chunk) + chunk->size);
+	}
+
+	if (rep->chunks)
+		rep->chunks->used = mark->used;
+
+	rep->map_cnt = mark->map_cnt;
+	rep->error = false;
+}
+
+/* Return the replica of an object. If the object hasn't been replicated yet
+ * it is copied and added is set to true so that the caller can replicate
+ * the objects it references
+ */
+static void *numa_dup(struct numa_replica *rep, const void *orig, size_t size,
+		      bool *added)
+{
+	struct numa_map_ent *map;
+	void *copy;
+	size_t i;
+
+	*added = false;
+
+	for (i = 0; i < rep->map_cnt; i++)
+		if (rep->map[i].orig == orig)
+			return rep->map[i].copy;
+
+	if (rep->map_cnt == rep->map_size) {
+		size_t map_size = rep->map_size ? 2 * rep->map_size : 64;
+
+		map = realloc(rep->map, map_size * sizeof(*map));
+		if (!map) {
+			rep->error = true;
+			return NULL;
+		}
+		rep->map = map;
+		rep->map_size = map_size;
+	}
+
+	copy = numa_alloc(rep, size);
+	if (!copy)
+		return NULL;
+
+	memcpy(copy, orig, size);
+
+	rep->map[rep->map_cnt].orig = orig;
+	rep->map[rep->map_cnt].copy = copy;
+	rep->map_cnt++;
+
+	*added = true;
+
+	return copy;
+}
+
+/* Replicate an object that doesn't reference other objects */
+static void *numa_dup_leaf(struct numa_replica *rep, const void *orig,
+			   size_t size)
+{
+	bool added;
+
+	if (!orig)
+		return NULL;
+
+	return numa_dup(rep, orig, size, &added);
+}
+
+static const struct panda_parse_node *numa_copy_parse_node(
+				struct numa_replica *rep,
+				const struct panda_parse_node *node);
+
+static const struct panda_parse_tlv_node *numa_copy_tlv_node(
+				struct numa_replica *rep,
+				const struct panda_parse_tlv_node *node);
+
+static const struct panda_proto_table *numa_copy_proto_table(
+				struct numa_replica *rep,
+				const struct panda_proto_table *table)
+{
+	struct panda_proto_table_entry *entries;
+	struct panda_proto_table *copy;
+	bool added;
+	int i;
+
+	if (!table)
+		return NULL;
+
+	copy = numa_dup(rep, table, sizeof(*table), &added);
+	if (!added || !table->num_ents)
+		return copy;
+
+	entries = numa_dup(rep, table->entries,
+			   table->num_ents * sizeof(*entries), &added);
+	copy->entries = entries;
+	if (!added)
+		return copy;
+
+	for (i = 0; i < table->num_ents; i++)
+		entries[i].node = numa_copy_parse_node(rep, entries[i].node);
+
+	return copy;
+}
+
+static const struct panda_proto_tlvs_table *numa_copy_tlvs_table(
+				struct numa_replica *rep,
+				const struct panda_proto_tlvs_table *table)
+{
+	struct panda_proto_tlvs_table_entry *entries;
+	struct panda_proto_tlvs_table *copy;
+	bool added;
+	int i;
+
+	if (!table)
+		return NULL;
+
+	copy = numa_dup(rep, table, sizeof(*table), &added);
+	if (!added || !table->num_ents)
+		return copy;
+
+	entries = numa_dup(rep, table->entries,
+			   table->num_ents * sizeof(*entries), &added);
+	copy->entries = entries;
+	if (!added)
+		return copy;
+
+	for (i = 0; i < table->num_ents; i++)
+		entries[i].node = numa_copy_tlv_node(rep, entries[i].node);
+
+	return copy;
+}
+
+static const struct panda_parse_tlv_node *numa_copy_tlv_node(
+				struct numa_replica *rep,
+				const struct panda_parse_tlv_node *node)
+{
+	struct panda_parse_tlv_node *copy;
+	bool added;
+
+	if (!node)
+		return NULL;
+
+	copy = numa_dup(rep, node, sizeof(*node), &added);
+	if (!added)
+		return copy;
+
+	copy->proto_tlv_node = numa_dup_leaf(rep, node->proto_tlv_node,
+				sizeof(struct panda_proto_tlv_node));
+	copy->overlay_table = numa_copy_tlvs_table(rep, node->overlay_table);
+	copy->overlay_wildcard_node = numa_copy_tlv_node(rep,
+						node->overlay_wildcard_node);
+
+	return copy;
+}
+
+static const struct panda_proto_flag_fields_table *
+numa_copy_flag_fields_table(struct numa_replica *rep,
+			    const struct panda_proto_flag_fields_table *table)
+{
+	struct panda_proto_flag_fields_table_entry *entries;
+	struct panda_proto_flag_fields_table *copy;
+	bool added;
+	int i;
+
+	if (!table)
+		return NULL;
+
+	copy = numa_dup(rep, table, sizeof(*table), &added);
+	if (!added || !table->num_ents)
+		return copy;
+
+	entries = numa_dup(rep, table->entries,
+			   table->num_ents * sizeof(*entries), &added);
+	copy->entries = entries;
+	if (!added)
+		return copy;
+
+	for (i = 0; i < table->num_ents; i++)
+		entries[i].node = numa_dup_leaf(rep, entries[i].node,
+				sizeof(struct panda_parse_flag_field_node));
+
+	return copy;
+}
+
+/* Replicate a protocol node. The type of the protocol node is given by the
+ * parse node that references it
+ */
+static const struct panda_proto_node *numa_copy_proto_node(
+				struct numa_replica *rep,
+				const struct panda_proto_node *proto_node,
+				enum panda_parser_node_type node_type)
+{
+	struct panda_proto_flag_fields_node *proto_ff_node;
+	const struct panda_flag_fields *flag_fields;
+	void *copy;
+	bool added;
+
+	if (!proto_node)
+		return NULL;
+
+	switch (node_type) {
+	case PANDA_NODE_TYPE_TLVS:
+		return numa_dup_leaf(rep, proto_node,
+				     sizeof(struct panda_proto_tlvs_node));
+	case PANDA_NODE_TYPE_FLAG_FIELDS:
+		copy = numa_dup(rep, proto_node,
+				sizeof(struct panda_proto_flag_fields_node),
+				&added);
+		if (!added)
+			return copy;
+
+		proto_ff_node = copy;
+		flag_fields = proto_ff_node->flag_fields;
+		if (flag_fields)
+			proto_ff_node->flag_fields = numa_dup_leaf(rep,
+				flag_fields, sizeof(*flag_fields) +
+				flag_fields->num_idx *
+					sizeof(flag_fields->fields[0]));
+		return copy;
+	default:
+		return numa_dup_leaf(rep, proto_node, sizeof(*proto_node));
+	}
+}
+
+static const struct panda_parse_node *numa_copy_parse_node(
+				struct numa_replica *rep,
+				const struct panda_parse_node *node)
+{
+	struct panda_parse_flag_fields_node *flag_fields_node;
+	struct panda_parse_tlvs_node *tlvs_node;
+	struct panda_parse_node *copy;
+	size_t size;
+	bool added;
+
+	if (!node)
+		return NULL;
+
+	switch (node->node_type) {
+	case PANDA_NODE_TYPE_TLVS:
+		size = sizeof(struct panda_parse_tlvs_node);
+		break;
+	case PANDA_NODE_TYPE_FLAG_FIELDS:
+		size = sizeof(struct panda_parse_flag_fields_node);
+		break;
+	default:
+		size = sizeof(struct panda_parse_node);
+		break;
+	}
+
+	copy = numa_dup(rep, node, size, &added);
+	if (!added)
+		return copy;
+
+	copy->proto_node = numa_copy_proto_node(rep, node->proto_node,
+						node->node_type);
+	copy->proto_table = numa_copy_proto_table(rep, node->proto_table);
+	copy->wildcard_node = numa_copy_parse_node(rep, node->wildcard_node);
+
+	switch (node->node_type) {
+	case PANDA_NODE_TYPE_TLVS:
+		tlvs_node = (struct panda_parse_tlvs_node *)copy;
+		tlvs_node->tlv_proto_table = numa_copy_tlvs_table(rep,
+						tlvs_node->tlv_proto_table);
+		tlvs_node->tlv_wildcard_node = numa_copy_tlv_node(rep,
+						tlvs_node->tlv_wildcard_node);
+		break;
+	case PANDA_NODE_TYPE_FLAG_FIELDS:
+		flag_fields_node = (struct panda_parse_flag_fields_node *)copy;
+		flag_fields_node->flag_fields_proto_table =
+			numa_copy_flag_fields_table(rep,
+				flag_fields_node->flag_fields_proto_table);
+		break;
+	default:
+		break;
+	}
+
+	return copy;
+}
+
+/* Parse a sysfs list such as "0-3,8-11" */
+static int numa_read_list(const char *path, cpu_set_t *set)
+{
+	unsigned long first, last;
+	char buf[4096], *p, *end;
+	FILE *f;
+
+	CPU_ZERO(set);
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	p = fgets(buf, sizeof(buf), f);
+	fclose(f);
+	if (!p)
+		return -1;
+
+	while (*p && *p != '\n') {
+		first = strtoul(p, &end, 10);
+		if (end == p)
+			return -1;
+
+		last = first;
+		if (*end == '-') {
+			p = end + 1;
+			last = strtoul(p, &end, 10);
+			if (end == p)
+				return -1;
+		}
+
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, set);
+
+		p = end;
+		if (*p == ',')
+			p++;
+	}
+
+	return 0;
+}
+
+int __panda_numa_node_lookup(void)
+{
+	unsigned int cpu, node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) ||
+	    node >= __panda_numa_num_nodes)
+		node = 0;
+
+	__panda_numa_node = node;
+
+	return node;
+}
+
+int panda_numa_init(const siphash_key_t *key)
+{
+	cpu_set_t possible, affinity, node_cpus;
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	unsigned int num_nodes = 0, node, i;
+	siphash_key_t **hash_keys;
+	char path[64];
+
+	if (__panda_numa_num_nodes)
+		return 0;
+
+	if (!numa_read_list(NUMA_SYSFS_NODE "/possible", &possible)) {
+		for (node = 0; node < CPU_SETSIZE; node++)
+			if (CPU_ISSET(node, &possible))
+				num_nodes = node + 1;
+	}
+	if (!num_nodes) {
+		CPU_SET(0, &possible);
+		num_nodes = 1;
+	}
+
+	if (sched_getaffinity(0, sizeof(affinity), &affinity)) {
+		for (i = 0; i < CPU_SETSIZE; i++)
+			CPU_SET(i, &affinity);
+	}
+
+	numa_replicas = calloc(num_nodes, sizeof(*numa_replicas));
+	numa_node_replica = calloc(num_nodes, sizeof(*numa_node_replica));
+	hash_keys = calloc(num_nodes, sizeof(*hash_keys));
+	if (!numa_replicas || !numa_node_replica || !hash_keys)
+		goto fail;
+
+	/* A replica is made for each node that has CPUs the process may
+	 * run on
+	 */
+	for (node = 0; node < num_nodes; node++) {
+		if (!CPU_ISSET(node, &possible))
+			continue;
+
+		snprintf(path, sizeof(path), NUMA_SYSFS_NODE "/node%u/cpulist",
+			 node);
+		if (numa_read_list(path, &node_cpus))
+			continue;
+
+		CPU_AND(&node_cpus, &node_cpus, &affinity);
+		if (!CPU_COUNT(&node_cpus))
+			continue;
+
+		numa_node_replica[node] = numa_num_replicas;
+		numa_replicas[numa_num_replicas++].node = node;
+	}
+
+	/* Topology unknown, use one replica */
+	if (!numa_num_replicas)
+		numa_num_replicas = 1;
+
+	/* Hash keys are in their own pages since the graphs are made read
+	 * only
+	 */
+	for (i = 0; i < numa_num_replicas; i++) {
+		numa_replicas[i].hash_key = numa_mmap(numa_replicas[i].node,
+						      page_size);
+		if (!numa_replicas[i].hash_key)
+			goto fail;
+		*numa_replicas[i].hash_key = *key;
+	}
+
+	for (node = 0; node < num_nodes; node++)
+		hash_keys[node] = numa_replicas[numa_node_replica[node]].hash_key;
+
+	__panda_numa_num_nodes = num_nodes;
+	__panda_numa_hash_keys = hash_keys;
+
+	return 0;
+
+fail:
+	for (i = 0; numa_replicas && i < numa_num_replicas; i++)
+		if (numa_replicas[i].hash_key)
+			munmap(numa_replicas[i].hash_key, page_size);
+	free(numa_replicas);
+	free(numa_node_replica);
+	free(hash_keys);
+	numa_replicas = NULL;
+	numa_node_replica = NULL;
+	numa_num_replicas = 0;
+
+	return -1;
+}
+
+int panda_numa_replicate_parser(struct panda_parser *parser)
+{
+	const struct panda_parser **replicas;
+	struct panda_parser *copy;
+	struct numa_replica *rep;
+	struct numa_mark *marks;
+	unsigned int node, i;
+
+	if (!__panda_numa_num_nodes)
+		return -1;
+
+	/* Optimized parsers reference their parse nodes directly from code */
+	if (parser->parser_type != PANDA_GENERIC || parser->numa_replicas)
+		return 0;
+
+	replicas = calloc(__panda_numa_num_nodes, sizeof(*replicas));
+	marks = calloc(numa_num_replicas, sizeof(*marks));
+	if (!replicas || !marks)
+		goto fail;
+
+	for (i = 0; i < numa_num_replicas; i++)
+		numa_mark(&numa_replicas[i], &marks[i]);
+
+	for (i = 0; i < numa_num_replicas; i++) {
+		rep = &numa_replicas[i];
+
+		copy = numa_alloc(rep, sizeof(*copy));
+		if (!copy)
+			goto fail;
+
+		*copy = *parser;
+		copy->root_node = numa_copy_parse_node(rep, parser->root_node);
+		if (rep->error)
+			goto fail;
+
+		replicas[rep->node] = copy;
+	}
+
+	for (node = 0; node < __panda_numa_num_nodes; node++)
+		replicas[node] =
+			replicas[numa_replicas[numa_node_replica[node]].node];
+
+	parser->numa_replicas = replicas;
+	free(marks);
+
+	return 0;
+
+fail:
+	/* Release the copies made for all replicas */
+	for (i = 0; marks && i < numa_num_replicas; i++)
+		numa_release(&numa_replicas[i], &marks[i]);
+	free(marks);
+	free(replicas);
+	return -1;
+}
+
+void panda_numa_freeze(void)
+{
+	struct numa_chunk *chunk;
+	unsigned int i;
+
+	for (i = 0; i < numa_num_replicas; i++) {
+		for (chunk = numa_replicas[i].chunks; chunk;
+		     chunk = chunk->next) {
+			if (chunk->frozen)
+				continue;
+
+			/* Nothing more is allocated from a frozen chunk */
+			chunk->frozen = true;
+			chunk->used = chunk->size;
+			mprotect(chunk, sizeof(*chunk) + chunk->size,
+				 PROT_READ);
+		}
+	}
+}
+
+void panda_numa_set_hash_key(const siphash_key_t *key)
+{
+	unsigned int i;
+
+	for (i = 0; i < numa_num_replicas; i++)
+		*numa_replicas[i].hash_key = *key;
+}
@@ -33,6 +33,11 @@
 #include "panda/parser.h"
 #include "siphash/siphash.h"
 
+/* Number of consecutive one byte pads in TLVs that are skipped inline before
+ * the rest of the run is scanned by the CPU dispatched kernel
+ */
+#define PANDA_TLV_PAD_INLINE	4
+
 /* Lookup a type in a node table*/
 static const struct panda_parse_node *lookup_node(int type,
 				    const struct panda_proto_table *table)
@@ -150,6 +155,7 @@ static int panda_parse_tlvs(const struct panda_parse_node *parse_node,
 	const struct panda_parse_tlv_node *parse_tlv_node;
 	size_t off, len, offset = ctrl.hdr_offset;
 	struct panda_ctrl_data tlv_ctrl;
+	size_t pad;
 	const __u8 *cp = hdr;
 	ssize_t tlv_len;
 	int type, ret;
@@ -170,10 +176,21 @@ static int panda_parse_tlvs(const struct panda_parse_node *parse_node,
 	while (len > 0) {
 		if (proto_tlvs_node->pad1_enable &&
 		   *cp == proto_tlvs_node->pad1_val) {
-			/* One byte padding, just advance */
-			cp++;
-			offset++;
-			len--;
+			/* One byte padding, just advance. Pad runs are usually
+			 * a few bytes (e.g. TCP NOPs for alignment) so check
+			 * those inline and only call the dispatched kernel for
+			 * a long run
+			 */
+			for (pad = 1; pad < len && pad < PANDA_TLV_PAD_INLINE &&
+			     cp[pad] == proto_tlvs_node->pad1_val; pad++);
+
+			if (pad == PANDA_TLV_PAD_INLINE && pad < len)
+				pad += panda_cpu_ops.tlv_skip_pad(&cp[pad],
+						len - pad,
+						proto_tlvs_node->pad1_val);
+			cp += pad;
+			offset += pad;
+			len -= pad;
 			continue;
 		}
 
@@ -434,13 +451,12 @@ int __panda_parse(const struct panda_parser *parser, const void *hdr,
 			 * number of encap layers allowed and also
 			 * if we need a new metadata frame.
 			 */
-			if (++metadata->encaps > max_encaps)
-				return PANDA_STOP_ENCAP_DEPTH;
-
-			if (metadata->max_frame_num > frame_num) {
-				frame += metadata->frame_size;
-				frame_num++;
-			}
+			ret = panda_parse_encap_layer(metadata, max_encaps,
+						      &frame, &frame_num,
+						      proto_node,
+						      hdr - base_hdr, flags);
+			if (ret != PANDA_OKAY)
+				return ret;
 		}
 
 		if (proto_node->ops.next_proto && parse_node->proto_table) {
@@ -524,6 +540,10 @@ struct panda_parser *panda_parser_opt_create(const char *name,
 
 void panda_parser_destroy(struct panda_parser *parser)
 {
+	if (!parser)
+		return;
+
+	free((void *)parser->numa_replicas);
 	free(parser);
 }
 
@@ -539,6 +559,9 @@ void panda_hash_secret_init(siphash_key_t *init_key)
 		for (i = 0; i < sizeof(__panda_hash_key); i++)
 			bytes[i] = rand();
 	}
+
+	if (__panda_numa_hash_keys)
+		panda_numa_set_hash_key(&__panda_hash_key);
 }
 
 void panda_print_hash_input(const void *start, size_t len)
@@ -555,12 +578,21 @@ void panda_print_hash_input(const void *start, size_t len)
 /* Create a dummy parser to ensure that the section is defined */
 static struct panda_parser_def PANDA_SECTION_ATTR(panda_parsers) dummy_parser;
 
-int panda_parser_init(void)
+int panda_parser_init_flags(unsigned int flags)
 {
 	const struct panda_parser_def *def_base =
 					panda_section_base_panda_parsers();
 	int i, j;
 
+	/* Select CPU specific variants of library kernels */
+	panda_cpu_dispatch_init(-1);
+
+	if ((flags & PANDA_PARSER_INIT_F_NUMA) &&
+	    panda_numa_init(&__panda_hash_key) < 0) {
+		fprintf(stderr, "NUMA initialization failed\n");
+		return -1;
+	}
+
 	for (i = 0; i < panda_section_array_size_panda_parsers(); i++) {
 		const struct panda_parser_def *def = &def_base[i];
 
@@ -590,16 +622,35 @@ int panda_parser_init(void)
 		default:
 			goto fail;
 		}
+
+		if ((flags & PANDA_PARSER_INIT_F_NUMA) &&
+		    panda_numa_replicate_parser(*def->parser) < 0) {
+			fprintf(stderr, "Replicate parser \"%s\" failed\n",
+				def->name);
+			i++;
+			goto fail;
+		}
 	}
 
+	if (flags & PANDA_PARSER_INIT_F_NUMA)
+		panda_numa_freeze();
+
 	return 0;
 
 fail:
 	for (j = 0; j < i; j++) {
-		const struct panda_parser_def *def = &def_base[i];
+		const struct panda_parser_def *def = &def_base[j];
+
+		if (!def->parser)
+			continue;
 
 		panda_parser_destroy(*def->parser);
 		*def->parser = NULL;
 	}
 	return -1;
 }
+
+int panda_parser_init(void)
+{
+	return panda_parser_init_flags(0);
+}
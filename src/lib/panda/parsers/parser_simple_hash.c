@@ -49,11 +49,29 @@
  */
 
 PANDA_METADATA_TEMP_ether_noaddrs(ether_metadata,
-				   panda_parser_simple_hash_metadata)
-PANDA_METADATA_TEMP_ipv4_addrs(ipv4_metadata,
-				panda_parser_simple_hash_metadata)
-PANDA_METADATA_TEMP_ipv6_addrs(ipv6_metadata, panda_parser_simple_hash_metadata)
-PANDA_METADATA_TEMP_ports(ports_metadata, panda_parser_simple_hash_metadata)
+				   panda_parser_simple_hash_frame)
+PANDA_METADATA_TEMP_flow_key_ipv4(ipv4_metadata,
+				  panda_parser_simple_hash_frame)
+PANDA_METADATA_TEMP_flow_key_ipv6(ipv6_key_metadata,
+				  panda_parser_simple_hash_frame)
+PANDA_METADATA_TEMP_flow_key_ipv6_eh(ipv6_eh_metadata,
+				     panda_parser_simple_hash_frame)
+PANDA_METADATA_TEMP_flow_key_ipv6_frag(ipv6_frag_metadata,
+				       panda_parser_simple_hash_frame)
+PANDA_METADATA_TEMP_flow_key_ports(ports_metadata,
+				   panda_parser_simple_hash_frame)
+
+/* The flow label is part of the hash input, when it is set parsing stops
+ * at the IPv6 header and the label stands in for the ports
+ */
+static void ipv6_metadata(const void *viph, void *iframe,
+			  struct panda_ctrl_data ctrl)
+{
+	struct panda_parser_simple_hash_frame *frame = iframe;
+
+	ipv6_key_metadata(viph, iframe, ctrl);
+	frame->flow_label = ntohl(ip6_flowlabel((const struct ipv6hdr *)viph));
+}
 
 
 /* Parse nodes. Parse nodes are composed of the common PANDA Parser protocol
@@ -71,10 +89,10 @@ PANDA_MAKE_PARSE_NODE(ipv6_check_node, panda_parse_ip, NULL, NULL,
 		      ipv6_check_table);
 PANDA_MAKE_PARSE_NODE(ipv6_node, panda_parse_ipv6_stopflowlabel,
 		      ipv6_metadata, NULL, ipv6_table);
-PANDA_MAKE_PARSE_NODE(ipv6_eh_node, panda_parse_ipv6_eh, NULL, NULL,
-		      ipv6_table);
-PANDA_MAKE_PARSE_NODE(ipv6_frag_node, panda_parse_ipv6_frag_eh, NULL, NULL,
-		      ipv6_table);
+PANDA_MAKE_PARSE_NODE(ipv6_eh_node, panda_parse_ipv6_eh, ipv6_eh_metadata,
+		      NULL, ipv6_table);
+PANDA_MAKE_PARSE_NODE(ipv6_frag_node, panda_parse_ipv6_frag_eh,
+		      ipv6_frag_metadata, NULL, ipv6_table);
 
 PANDA_MAKE_LEAF_PARSE_NODE(ports_node, panda_parse_ports, ports_metadata, NULL);
 
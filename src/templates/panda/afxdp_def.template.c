@@ -0,0 +1,74 @@
+<!--(if 0)-->
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 by Mojatatu Networks.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+<!--(end)-->
+
+/* AF_XDP receive functions. The packets of an AF_XDP socket are parsed in
+ * place in the UMEM frames with the parser above
+ */
+
+#include "panda/afxdp.h"
+
+<!--(macro generate_afxdp_rx_function)-->
+static inline unsigned int panda_afxdp_rx_@!parser_name!@(
+		struct panda_afxdp_sock *s,
+		struct panda_metadata *const metadatas[],
+		size_t metadata_len, unsigned int flags,
+		unsigned int max_encaps, panda_afxdp_process_t process,
+		void *arg)
+{
+	const void *hdrs[PANDA_AFXDP_BATCH];
+	size_t lens[PANDA_AFXDP_BATCH];
+	int rets[PANDA_AFXDP_BATCH];
+	unsigned int i, num;
+	__u32 idx;
+
+	num = panda_afxdp_rx_peek(s, hdrs, lens, &idx);
+	if (!num)
+		return 0;
+
+	for (i = 0; i < num; i++)
+		memset(metadatas[i], 0, metadata_len);
+
+	for (i = 0; i < num; i++)
+		rets[i] = @!parser_name!@_panda_parse_@!root_name!@(
+			@!parser_name!@_@!'lean' if lean else 'opt'!@,
+			hdrs[i], lens[i], metadatas[i], flags, max_encaps);
+
+	for (i = 0; i < num; i++)
+		process(arg, hdrs[i], lens[i], metadatas[i], rets[i]);
+
+	panda_afxdp_rx_release(s, idx, num);
+
+	return num;
+}
+<!--(end)-->
+
+<!--(for parser_name,root_name,parser_add,parser_ext in roots)-->
+	<!--(if not parser_add)-->
+@!generate_afxdp_rx_function(parser_name=parser_name,root_name=root_name)!@
+	<!--(end)-->
+<!--(end)-->
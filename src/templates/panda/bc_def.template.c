@@ -0,0 +1,56 @@
+<!--(if 0)-->
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+<!--(end)-->
+
+/* Bytecode programs for the PANDA bytecode interpreter, see
+ * panda/bytecode.h
+ */
+
+#include "panda/bytecode.h"
+#include "panda/parser.h"
+#include "panda/parser_metadata.h"
+#include "panda/proto_nodes_def.h"
+
+#include "@!filename!@"
+
+<!--(for prog in bytecode)-->
+static const struct panda_bc_insn __@!prog['name']!@_insns[] = {
+	<!--(for pc, line in enumerate(prog['lines']))-->
+		<!--(if line[1])-->
+	/* @!pc!@: @!line[1]!@ */
+		<!--(end)-->
+		<!--(if line[2])-->
+	@!line[0]!@,	/* @!line[2]!@ */
+		<!--(else)-->
+	@!line[0]!@,
+		<!--(end)-->
+	<!--(end)-->
+};
+
+PANDA_BC_PROG(@!prog['name']!@, __@!prog['name']!@_insns);
+
+<!--(end)-->
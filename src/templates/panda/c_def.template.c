@@ -32,6 +32,14 @@
 #include "panda/parser.h"
 #include "panda/proto_nodes_def.h"
 #include "@!filename!@"
+<!--(if lean)-->
+#include "@!lean['header']!@"
+
+/* Metadata extractors specialized for the lean metadata frame */
+	<!--(for lname,temp,args in lean['extractors'])-->
+PANDA_METADATA_TEMP_@!temp!@(@!lname!@, @!lean['frame']!@@!args!@)
+	<!--(end)-->
+<!--(end)-->
 
 static inline __attribute__((always_inline)) int check_pkt_len(const void* hdr,
 		const struct panda_proto_node *pnode, size_t len, ssize_t* hlen)
@@ -55,29 +63,111 @@ static inline __attribute__((always_inline)) int check_pkt_len(const void* hdr,
 	return PANDA_OKAY;
 }
 
-static inline __attribute__((always_inline)) int panda_encap_layer(
-		struct panda_metadata *metadata, unsigned max_encaps,
-		void **frame, unsigned *frame_num)
+/* Length check for a node whose minimum length was covered by a fused length
+ * check, only a variable header length needs to be checked
+ */
+static inline __attribute__((always_inline)) int check_pkt_len_fused(
+		const void *hdr, const struct panda_proto_node *pnode,
+		size_t len, ssize_t *hlen)
 {
-	/* New encapsulation layer. Check against number of encap layers
-	 * allowed and also if we need a new metadata frame.
-	 */
-	if (++metadata->encaps > max_encaps)
-		return PANDA_STOP_ENCAP_DEPTH;
-
-	if (metadata->max_frame_num > *frame_num) {
-		*frame += metadata->frame_size;
-		*frame_num = (*frame_num) + 1;
+	if (pnode->ops.len) {
+		*hlen = pnode->ops.len(hdr);
+		if (len < *hlen)
+			return PANDA_STOP_LENGTH;
+		if (*hlen < pnode->min_len)
+			return *hlen < 0 ? *hlen : PANDA_STOP_LENGTH;
+	} else {
+		*hlen = pnode->min_len;
 	}
 
 	return PANDA_OKAY;
 }
+
+/* A fused length check continues to the next nodes if the offset of the next
+ * header is known at compile time
+ */
+static inline __attribute__((always_inline)) bool panda_fuse_len_next(
+		const struct panda_proto_node *pnode)
+{
+	return pnode->overlay || !pnode->ops.len;
+}
+
+/* A node collapsed into the dispatch of its parents must be an overlay without
+ * a len function or encapsulation, and the packet must cover its minimum
+ * length
+ */
+static inline __attribute__((always_inline)) bool panda_collapse_node(
+		const struct panda_proto_node *pnode, size_t len)
+{
+	return pnode->overlay && !pnode->ops.len && !pnode->encap &&
+	       len >= pnode->min_len;
+}
+<!--(if dispatch == 'musttail')-->
+
+/* Guaranteed tail calls between parse nodes if the C compiler supports them,
+ * else the parse nodes are compiled as one function with labels
+ */
+#if defined(__has_attribute)
+#if __has_attribute(musttail)
+#define PANDA_MUSTTAIL __attribute__((musttail))
+#endif
+#endif
+<!--(end)-->
+<!--(if hot_paths)-->
+
+/* Return value of a hot path function if the packet doesn't match the
+ * path. PANDA return codes are zero or negative
+ */
+#define PANDA_HOT_PATH_MISS	1
+
+/* Minimum number of bytes a node advances on a hot path */
+static inline __attribute__((always_inline)) size_t panda_hot_path_min_len(
+		const struct panda_parse_node *parse_node)
+{
+	return parse_node->proto_node->overlay ? 0 :
+					parse_node->proto_node->min_len;
+}
+<!--(end)-->
+
 @!generate_panda_parse_tlv_function!@
 <!--(for node in graph)-->
+	<!--(if not graph[node]['pruned'] and graph[node]['impl'] == node)-->
 @!generate_protocol_parse_function_decl(name=node)!@
+	<!--(end)-->
 <!--(end)-->
 <!--(for node in graph)-->
-@!generate_protocol_parse_function(name=node)!@
+	<!--(if not graph[node]['pruned'] and graph[node]['impl'] == node)-->
+@!generate_protocol_helper_functions(name=node)!@
+	<!--(end)-->
+<!--(end)-->
+<!--(if dispatch == 'goto')-->
+@!generate_goto_parse_function()!@
+<!--(else)-->
+	<!--(if dispatch == 'musttail')-->
+#ifdef PANDA_MUSTTAIL
+	<!--(end)-->
+	<!--(for node in graph)-->
+		<!--(if not compact and not graph[node]['pruned'] and graph[node]['impl'] == node)-->
+@!generate_protocol_parse_function_checked_decl(name=node)!@
+		<!--(end)-->
+	<!--(end)-->
+	<!--(for node in graph)-->
+		<!--(if not graph[node]['pruned'] and graph[node]['impl'] == node)-->
+			<!--(if node in fragments)-->
+$!fragments[node]!$
+			<!--(else)-->
+$!fragment(node, generate_protocol_parse_function(name=node,mode=dispatch))!$
+			<!--(end)-->
+		<!--(end)-->
+	<!--(end)-->
+	<!--(if dispatch == 'musttail')-->
+#else
+@!generate_goto_parse_function()!@
+#endif /* PANDA_MUSTTAIL */
+	<!--(end)-->
+<!--(end)-->
+<!--(for path in hot_paths)-->
+@!generate_hot_path_function(path=path)!@
 <!--(end)-->
 <!--(for parser_name,root_name,parser_add,parser_ext in roots)-->
 @!generate_entry_parse_function(parser_name=parser_name,root_name=root_name,parser_add=parser_add,parser_ext=parser_ext)!@
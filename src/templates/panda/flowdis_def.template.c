@@ -0,0 +1,151 @@
+<!--(if 0)-->
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 by Mojatatu Networks.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+<!--(end)-->
+
+/* BPF flow dissector (BPF_PROG_TYPE_FLOW_DISSECTOR) for the parser, built on
+ * the bpf_loop parser above. Parsing starts at the node for skb->protocol in
+ * the protocol table of the root, and the flow keys are set from the common
+ * metadata of the innermost frame, or of the outermost frame with
+ * BPF_FLOW_DISSECTOR_F_STOP_AT_ENCAP
+ */
+
+/* Metadata frame of the parser, it must have the common metadata fields
+ * addr_type, addrs, ip_proto, ports, flow_label, is_fragment, first_frag,
+ * l3_off, and l4_off
+ */
+#ifndef PANDA_FLOWDIS_FRAME
+#define PANDA_FLOWDIS_FRAME struct panda_metadata_all
+#endif
+
+/* Outermost and innermost frames */
+struct panda_flowdis_ctx {
+	struct panda_ctx ctx;
+	PANDA_FLOWDIS_FRAME frame[2];
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, __u32);
+	__type(value, struct panda_flowdis_ctx);
+} panda_flowdis_ctx_map SEC(".maps");
+
+/* Set the flow keys from a frame. thoff is the offset where parsing stopped,
+ * used when the frame has no transport offset
+ */
+static __always_inline void panda_flowdis_set_keys(
+		struct bpf_flow_keys *keys, const PANDA_FLOWDIS_FRAME *frame,
+		__u16 thoff)
+{
+	if (frame->l3_off)
+		keys->nhoff = frame->l3_off;
+	keys->thoff = frame->l4_off ? : thoff;
+	keys->is_frag = frame->is_fragment;
+	keys->is_first_frag = frame->first_frag;
+	keys->ip_proto = frame->ip_proto;
+	keys->sport = frame->src_port;
+	keys->dport = frame->dst_port;
+	keys->flow_label = htonl(frame->flow_label);
+
+	switch (frame->addr_type) {
+	case PANDA_ADDR_TYPE_IPV4:
+		keys->addr_proto = ETH_P_IP;
+		keys->n_proto = htons(ETH_P_IP);
+		keys->ipv4_src = frame->addrs.v4.saddr;
+		keys->ipv4_dst = frame->addrs.v4.daddr;
+		break;
+	case PANDA_ADDR_TYPE_IPV6:
+		keys->addr_proto = ETH_P_IPV6;
+		keys->n_proto = htons(ETH_P_IPV6);
+		__builtin_memcpy(keys->ipv6_src, &frame->addrs.v6.saddr,
+				 sizeof(keys->ipv6_src));
+		__builtin_memcpy(keys->ipv6_dst, &frame->addrs.v6.daddr,
+				 sizeof(keys->ipv6_dst));
+		break;
+	}
+}
+
+<!--(macro generate_flowdis_entry_function)-->
+SEC("flow_dissector")
+int panda_flowdis_@!parser_name!@(struct __sk_buff *skb)
+{
+	const void *data = (void *)(long)skb->data;
+	const void *data_end = (void *)(long)skb->data_end;
+	struct bpf_flow_keys *keys = skb->flow_keys;
+	const void *hdr = data + keys->nhoff;
+	PANDA_FLOWDIS_FRAME *frame;
+	struct panda_flowdis_ctx *fctx;
+	__u32 key = 0;
+	int ret;
+
+	fctx = bpf_map_lookup_elem(&panda_flowdis_ctx_map, &key);
+	if (!fctx)
+		return BPF_DROP;
+
+	__builtin_memset(fctx, 0, sizeof(*fctx));
+	fctx->ctx.metadata.frame_size = sizeof(fctx->frame[0]);
+	fctx->ctx.metadata.max_frame_num = 1;
+	fctx->ctx.offset = keys->nhoff;
+
+	switch (skb->protocol) {
+	<!--(for edge_target in graph[root_name]['out_edges'])-->
+		<!--(for e in graph[root_name]['out_edges'][edge_target])-->
+	case @!e['macro_name']!@:
+		<!--(end)-->
+		fctx->ctx.next = CODE_@!edge_target!@;
+		break;
+	<!--(end)-->
+	default:
+		/* Not parsed, keep the keys of the network header */
+		return BPF_OK;
+	}
+
+	ret = panda_xdp_parser_@!parser_name!@_prog(0, &fctx->ctx, &hdr,
+						    data_end);
+
+	/* As the kernel dissector, report the keys up to a protocol that
+	 * isn't parsed
+	 */
+	if (ret != PANDA_OKAY && ret != PANDA_STOP_OKAY &&
+	    ret != PANDA_STOP_UNKNOWN_PROTO)
+		return BPF_DROP;
+
+	frame = &fctx->frame[0];
+	if (fctx->ctx.frame_num &&
+	    !(keys->flags & BPF_FLOW_DISSECTOR_F_STOP_AT_ENCAP))
+		frame = &fctx->frame[1];
+
+	keys->is_encap = !!fctx->ctx.metadata.encaps;
+	panda_flowdis_set_keys(keys, frame, hdr - data);
+
+	return BPF_OK;
+}
+<!--(end)-->
+
+<!--(for parser_name,root_name,parser_add,parser_ext in roots)-->
+@!generate_flowdis_entry_function(parser_name=parser_name,root_name=root_name)!@
+<!--(end)-->
@@ -0,0 +1,239 @@
+<!--(if 0)-->
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 by Mojatatu Networks.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+<!--(end)-->
+
+/* Benchmark and fuzz harness generated by panda-compiler for the parsers in
+ * @!filename!@ (see panda/harness.h). Build with -DPANDA_HARNESS_FUZZ and
+ * -fsanitize=fuzzer for a libFuzzer target
+ */
+
+/* Parser sources can leave out their main function if this is defined */
+#define PANDA_HARNESS
+
+#include <unistd.h>
+
+#include "@!filename!@"
+#include "panda/harness.h"
+#include "panda/pcap.h"
+
+/* Maximum number of synthesized packets */
+#ifndef PANDA_HARNESS_MAX_SYNTH
+#define PANDA_HARNESS_MAX_SYNTH 256
+#endif
+
+#ifndef PANDA_HARNESS_MAX_PKT_LEN
+#define PANDA_HARNESS_MAX_PKT_LEN 9216
+#endif
+
+struct panda_harness_parser {
+	const char *name;
+	const struct panda_parser *parser;
+	const struct panda_parser *opt;
+};
+
+#define PANDA_HARNESS_NUM_PARSERS @!len(roots)!@
+
+/* The generic parser and the optimized parser of each root. Parsers made
+ * with PANDA_PARSER_ADD are set by panda_parser_init
+ */
+static unsigned int panda_harness_parsers(
+		struct panda_harness_parser *parsers)
+{
+	unsigned int num = 0;
+
+<!--(for parser_name,root_name,parser_add,parser_ext in roots)-->
+	parsers[num].name = "@!parser_name!@";
+	parsers[num].parser = @!parser_name!@;
+	parsers[num++].opt = @!parser_name!@_opt;
+<!--(end)-->
+
+	return num;
+}
+
+static struct panda_harness panda_harness;
+
+#ifdef PANDA_HARNESS_FUZZ
+
+/* libFuzzer entry point, the parsers must agree on each input */
+int LLVMFuzzerTestOneInput(const __u8 *data, size_t size)
+{
+	struct panda_harness_parser parsers[PANDA_HARNESS_NUM_PARSERS];
+	int generic_ret, opt_ret;
+	static bool init;
+	unsigned int i, num;
+
+	if (!init) {
+		if (panda_parser_init() < 0)
+			abort();
+		init = true;
+	}
+
+	num = panda_harness_parsers(parsers);
+	for (i = 0; i < num; i++) {
+		if (panda_harness_compare(&panda_harness, parsers[i].parser,
+					  parsers[i].opt, data, size,
+					  &generic_ret, &opt_ret))
+			continue;
+
+		fprintf(stderr, "%s: generic parser %d, optimized parser %d%s\n",
+			parsers[i].name, generic_ret, opt_ret,
+			generic_ret == opt_ret ? ", metadata differs" : "");
+		abort();
+	}
+
+	return 0;
+}
+
+#else
+
+static const struct panda_harness_node panda_harness_nodes[] = {
+<!--(for name in graph)-->
+	{ (const struct panda_parse_node *)&@!name!@, "@!name!@" },
+<!--(end)-->
+};
+
+static __u8 panda_harness_pkts[PANDA_HARNESS_MAX_SYNTH]
+			      [PANDA_HARNESS_SYNTH_LEN];
+static __u8 panda_harness_pkt[PANDA_HARNESS_MAX_PKT_LEN];
+
+static void panda_harness_usage(const char *prog)
+{
+	fprintf(stderr, "%s [-r <repeat>] [-p <profile>] [-v] [pcap_file]\n",
+		prog);
+	exit(-1);
+}
+
+static void panda_harness_pcap(struct panda_harness *h,
+			       const struct panda_harness_parser *p,
+			       const char *file)
+{
+	struct panda_pcap_file *pf;
+	size_t plen;
+	ssize_t len;
+
+	pf = panda_pcap_init(file);
+	if (!pf) {
+		fprintf(stderr, "PANDA pcap init failed\n");
+		exit(-1);
+	}
+
+	panda_harness_edges(h, p->parser->root_node);
+	while ((len = panda_pcap_readpkt(pf, panda_harness_pkt,
+					 sizeof(panda_harness_pkt),
+					 &plen)) >= 0)
+		panda_harness_run(h, p->parser, p->opt, panda_harness_pkt,
+				  len);
+
+	panda_pcap_close(pf);
+}
+
+static void panda_harness_synthesized(struct panda_harness *h,
+				      const struct panda_harness_parser *p)
+{
+	unsigned int i, num;
+
+	num = panda_harness_synth(h, p->parser->root_node,
+				  panda_harness_pkts,
+				  PANDA_HARNESS_MAX_SYNTH);
+	for (i = 0; i < num; i++)
+		panda_harness_run(h, p->parser, p->opt, panda_harness_pkts[i],
+				  PANDA_HARNESS_SYNTH_LEN);
+}
+
+/* Run the parsers on the packets of a pcap file, or on synthesized packets,
+ * and report the cycles per packet of each path. Returns 1 if the parsers
+ * disagree on any packet
+ */
+int main(int argc, char *argv[])
+{
+	struct panda_harness_parser parsers[PANDA_HARNESS_NUM_PARSERS];
+	struct panda_harness *h = &panda_harness;
+	unsigned long mismatches = 0;
+	unsigned int repeat = 100;
+	const char *profile = NULL;
+	unsigned int i, num;
+	bool verbose = false;
+	FILE *pf = NULL;
+	int c;
+
+	while ((c = getopt(argc, argv, "r:p:v")) != -1) {
+		switch (c) {
+		case 'r':
+			repeat = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			profile = optarg;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			panda_harness_usage(argv[0]);
+		}
+	}
+	if (optind < argc - 1)
+		panda_harness_usage(argv[0]);
+
+	if (panda_parser_init() < 0) {
+		fprintf(stderr, "panda_parser_init failed\n");
+		exit(-1);
+	}
+
+	if (profile) {
+		pf = fopen(profile, "w");
+		if (!pf) {
+			perror(profile);
+			exit(-1);
+		}
+	}
+
+	num = panda_harness_parsers(parsers);
+	for (i = 0; i < num; i++) {
+		memset(h, 0, sizeof(*h));
+		h->names = panda_harness_nodes;
+		h->num_names = ARRAY_SIZE(panda_harness_nodes);
+		h->repeat = repeat;
+		h->verbose = verbose;
+
+		if (optind < argc)
+			panda_harness_pcap(h, &parsers[i], argv[optind]);
+		else
+			panda_harness_synthesized(h, &parsers[i]);
+
+		panda_harness_report(h, parsers[i].name, stdout);
+		if (pf)
+			panda_harness_profile(h, pf);
+		mismatches += h->mismatches;
+	}
+
+	if (pf)
+		fclose(pf);
+
+	return mismatches ? 1 : 0;
+}
+
+#endif
@@ -26,6 +26,8 @@
  */
 <!--(end)-->
 
+#include <linux/skbuff.h>
+
 #include "panda/parser.h"
 #include "panda/parser_metadata.h"
 #include "panda/proto_nodes_def.h"
@@ -44,11 +46,52 @@ CODE_@!node!@,
 CODE_IGNORE
 };
 
-/* Parser control */
-static long next = CODE_IGNORE;
+/* Size of the on-stack bounce buffer for headers of an skb that aren't in
+ * its linear data. A longer header is only parsed if it's in the linear data
+ */
+#ifndef PANDA_KMOD_HDR_LEN
+#define PANDA_KMOD_HDR_LEN 256
+#endif
+
+/* Parser control for one invocation of the parser, on the stack of the
+ * caller so that parsers running on different CPUs don't share any state:
+ *	data: linear buffer being parsed, or
+ *	skb, offset: packet of an skb starting at offset from skb->data
+ *	buf: bounce buffer for headers of the skb
+ *	next: node to resume parsing at after a back edge
+ */
+struct panda_kmod_ctx {
+	const void *data;
+	const struct sk_buff *skb;
+	int offset;
+	void *buf;
+	int next;
+};
+
+/* Return a pointer to len bytes of header at offset in the packet. Headers of
+ * an skb are accessed in place with skb_header_pointer, or copied to the
+ * bounce buffer if the skb is non-linear there. The buffer holds one header
+ * at a time
+ */
+static inline __attribute__((always_inline)) const void *panda_kmod_hdr(
+		const struct panda_kmod_ctx *ctx, size_t offset, size_t len)
+{
+	int off = ctx->offset + (int)offset;
+
+	if (!ctx->skb)
+		return ctx->data + offset;
 
-static inline __attribute__((always_inline)) int check_pkt_len(const void *hdr,
-		const struct panda_proto_node *pnode, size_t len, ssize_t *hlen)
+	if (len > PANDA_KMOD_HDR_LEN &&
+	    off + (int)len > (int)skb_headlen(ctx->skb))
+		return NULL;
+
+	return skb_header_pointer(ctx->skb, off, len, ctx->buf);
+}
+
+static inline __attribute__((always_inline)) int check_pkt_len(
+		const struct panda_kmod_ctx *ctx, size_t offset,
+		const struct panda_proto_node *pnode, size_t len,
+		const void **hdr, ssize_t *hlen)
 {
 	*hlen = pnode->min_len;
 
@@ -56,32 +99,23 @@ static inline __attribute__((always_inline)) int check_pkt_len(const void *hdr,
 	if (len < *hlen)
 		return PANDA_STOP_LENGTH;
 
+	*hdr = panda_kmod_hdr(ctx, offset, *hlen);
+	if (!*hdr)
+		return PANDA_STOP_LENGTH;
+
 	if (pnode->ops.len) {
-		*hlen = pnode->ops.len(hdr);
+		*hlen = pnode->ops.len(*hdr);
 		if (len < *hlen)
 			return PANDA_STOP_LENGTH;
 		if (*hlen < pnode->min_len)
 			return *hlen < 0 ? *hlen : PANDA_STOP_LENGTH;
-	} else {
-		*hlen = pnode->min_len;
-	}
 
-	return PANDA_OKAY;
-}
-
-static inline __attribute__((always_inline)) int panda_encap_layer(
-		struct panda_metadata *metadata, unsigned int max_encaps,
-		void **frame, unsigned int *frame_num)
-{
-	/* New encapsulation layer. Check against number of encap layers
-	 * allowed and also if we need a new metadata frame.
-	 */
-	if (++metadata->encaps > max_encaps)
-		return PANDA_STOP_ENCAP_DEPTH;
-
-	if (metadata->max_frame_num > *frame_num) {
-		*frame += metadata->frame_size;
-		*frame_num = (*frame_num) + 1;
+		/* Get the rest of a variable length header */
+		if (*hlen > pnode->min_len) {
+			*hdr = panda_kmod_hdr(ctx, offset, *hlen);
+			if (!*hdr)
+				return PANDA_STOP_LENGTH;
+		}
 	}
 
 	return PANDA_OKAY;
@@ -115,30 +149,32 @@ static inline __attribute__((always_inline)) int panda_parse_tlv(
 }
 
 <!--(macro generate_entry_parse_function)-->
-static inline int @!parser_name!@_panda_parse_@!root_name!@(
+static inline int @!parser_name!@_panda_parse_ctx_@!root_name!@(
 		const struct panda_parser *parser,
-		const void *hdr, size_t len,
+		struct panda_kmod_ctx *ctx, size_t len,
 		struct panda_metadata *metadata,
 		unsigned int flags, unsigned int max_encaps)
 {
 	void *frame = metadata->frame_data;
 	unsigned int frame_num = 0;
 	int ret = PANDA_STOP_OKAY;
-	size_t offset;
+	size_t offset = 0;
 	int i;
 
-	ret = __@!root_name!@_panda_parse_impl(parser, &hdr,
+	ctx->next = CODE_IGNORE;
+	ret = __@!root_name!@_panda_parse_impl(parser, ctx,
 		len, &offset, metadata, flags, max_encaps, frame, frame_num);
 
 	for (i = 0; i < PANDA_LOOP_COUNT; i++) {
 		if (ret != PANDA_STOP_OKAY)
 			break;
-		switch (next) {
+		switch (ctx->next) {
 		case CODE_IGNORE:
-			break;
+			return ret;
 		<!--(for node in graph)-->
 		case CODE_@!node!@:
-			ret = __@!node!@_panda_parse_impl(parser, &hdr, len,
+			ret = __@!node!@_panda_parse_impl(parser, ctx,
+							  len - offset,
 							  &offset, metadata,
 							  flags, max_encaps,
 							  frame, frame_num);
@@ -152,11 +188,46 @@ static inline int @!parser_name!@_panda_parse_@!root_name!@(
 	return ret;
 }
 
+/* Parse a linear buffer */
+static int @!parser_name!@_panda_parse_@!root_name!@(
+		const struct panda_parser *parser,
+		const void *hdr, size_t len,
+		struct panda_metadata *metadata,
+		unsigned int flags, unsigned int max_encaps)
+{
+	struct panda_kmod_ctx ctx = { .data = hdr };
+
+	return @!parser_name!@_panda_parse_ctx_@!root_name!@(parser, &ctx, len,
+			metadata, flags, max_encaps);
+}
+
+/* Parse the packet of an skb in place starting at offset from skb->data */
+static int @!parser_name!@_panda_parse_skb_@!root_name!@(
+		const struct panda_parser *parser,
+		const struct sk_buff *skb, int offset,
+		struct panda_metadata *metadata,
+		unsigned int flags, unsigned int max_encaps)
+{
+	__u8 buf[PANDA_KMOD_HDR_LEN];
+	struct panda_kmod_ctx ctx = {
+		.skb = skb,
+		.offset = offset,
+		.buf = buf,
+	};
+
+	if ((int)skb->len < offset)
+		return PANDA_STOP_LENGTH;
+
+	return @!parser_name!@_panda_parse_ctx_@!root_name!@(parser, &ctx,
+			(int)skb->len - offset, metadata, flags, max_encaps);
+}
+
 PANDA_PARSER_KMOD(
       @!parser_name!@,
       "",
       &@!root_name!@,
-      @!parser_name!@_panda_parse_@!root_name!@
+      @!parser_name!@_panda_parse_@!root_name!@,
+      @!parser_name!@_panda_parse_skb_@!root_name!@
     );
 <!--(end)-->
 
@@ -169,7 +240,7 @@ PANDA_PARSER_KMOD(
 	<!--(end)-->
 static __always_inline int __@!name!@_panda_parse_impl(
 		const struct panda_parser *parser,
-		const void **hdr, size_t len, size_t *offset,
+		struct panda_kmod_ctx *ctx, size_t len, size_t *offset,
 		struct panda_metadata *metadata,
 		unsigned int flags, unsigned int max_encaps,
 		void *frame, unsigned frame_num)
@@ -178,10 +249,12 @@ static __always_inline int __@!name!@_panda_parse_impl(
 		(const struct panda_parse_node *)&@!name!@;
 	const struct panda_proto_node *proto_node = parse_node->proto_node;
 	struct panda_ctrl_data ctrl;
+	const void *hdr;
 	ssize_t hlen;
 	int ret;
 
-	ret = check_pkt_len(*hdr, parse_node->proto_node, len, &hlen);
+	ret = check_pkt_len(ctx, *offset, parse_node->proto_node, len, &hdr,
+			    &hlen);
 	if (ret != PANDA_OKAY)
 		return ret;
 
@@ -189,37 +262,37 @@ static __always_inline int __@!name!@_panda_parse_impl(
 	ctrl.hdr_offset = *offset;
 
 	if (parse_node->ops.extract_metadata)
-		parse_node->ops.extract_metadata(*hdr, frame, ctrl);
+		parse_node->ops.extract_metadata(hdr, frame, ctrl);
 
 	<!--(if len(graph[name]['tlv_nodes']) != 0)-->
-	ret = __@!name!@_panda_parse_tlvs(parse_node, *hdr, frame, ctrl);
+	ret = __@!name!@_panda_parse_tlvs(parse_node, hdr, frame, ctrl);
 	if (ret != PANDA_OKAY)
 		return ret;
 	<!--(end)-->
 
 	<!--(if len(graph[name]['flag_fields_nodes']) != 0)-->
 	ret = __@!name!@_panda_parse_flag_fields(
-					parse_node, *hdr, frame, ctrl);
+					parse_node, hdr, frame, ctrl);
 	if (ret != PANDA_OKAY)
 		return ret;
 	<!--(end)-->
 
 	if (proto_node->encap) {
-		ret = panda_encap_layer(metadata, max_encaps, &frame,
-					&frame_num);
+		ret = panda_parse_encap_layer(metadata, max_encaps, &frame,
+					      &frame_num, proto_node, *offset,
+					      flags);
 		if (ret != PANDA_OKAY)
 			return ret;
 	}
 
 	<!--(if len(graph[name]['out_edges']) != 0)-->
 	{
-	int type = proto_node->ops.next_proto(*hdr);
+	int type = proto_node->ops.next_proto(hdr);
 
 	if (type < 0)
 		return type;
 
 	if (!proto_node->overlay) {
-		*hdr += hlen;
 		*offset += hlen;
 		len -= hlen;
 	}
@@ -229,11 +302,11 @@ static __always_inline int __@!name!@_panda_parse_impl(
 			<!--(for e in graph[name]['out_edges'][edge_target])-->
 	case @!e['macro_name']!@:
 				<!--(if e['back'])-->
-		next = CODE_@!edge_target!@;
+		ctx->next = CODE_@!edge_target!@;
 		return PANDA_STOP_OKAY;
 				<!--(else)-->
 		return __@!edge_target!@_panda_parse(
-			parser, hdr, len, offset, metadata, flags, max_encaps,
+			parser, ctx, len, offset, metadata, flags, max_encaps,
 			frame, frame_num);
 				<!--(end)-->
 			<!--(end)-->
@@ -242,14 +315,14 @@ static __always_inline int __@!name!@_panda_parse_impl(
 	/* Unknown protocol */
 		<!--(if len(graph[name]['wildcard_proto_node']) != 0)-->
 	return __@!graph[name]['wildcard_proto_node']!@_panda_parse(
-		parser, *hdr, len, offset, metadata, flags, max_encaps,
+		parser, ctx, len, offset, metadata, flags, max_encaps,
 		frame, frame_num);
 		<!--(else)-->
 	return PANDA_STOP_UNKNOWN_PROTO;
 		<!--(end)-->
 	}
 	<!--(else)-->
-	next = CODE_IGNORE;
+	ctx->next = CODE_IGNORE;
 	return PANDA_STOP_OKAY;
 	<!--(end)-->
 }
@@ -258,16 +331,16 @@ static __always_inline int __@!name!@_panda_parse_impl(
 <!--(macro generate_protocol_parse_function_decl)-->
 static __always_inline int __@!name!@_panda_parse_impl(
 		const struct panda_parser *parser,
-		const void **hdr, size_t len, size_t *offset,
+		struct panda_kmod_ctx *ctx, size_t len, size_t *offset,
 		struct panda_metadata *metadata, unsigned int flags,
 		unsigned int max_encaps, void *frame, unsigned frame_num);
 __attribute__((unused)) static int
 	__@!name!@_panda_parse(const struct panda_parser *parser,
-		const void **hdr, size_t len, size_t *offset,
+		struct panda_kmod_ctx *ctx, size_t len, size_t *offset,
 		struct panda_metadata *metadata, unsigned int flags,
 		unsigned int max_encaps, void *frame, unsigned int frame_num)
 {
-	return __@!name!@_panda_parse_impl(parser, hdr, len, offset, metadata,
+	return __@!name!@_panda_parse_impl(parser, ctx, len, offset, metadata,
 					   flags, max_encaps, frame, frame_num);
 }
 <!--(end)-->
@@ -0,0 +1,73 @@
+<!--(if 0)-->
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 by Mojatatu Networks.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+<!--(end)-->
+
+/* TC BPF (sched_cls and sched_act) parser, built on the bpf_loop parser
+ * above. Headers in the linear data of the skb are parsed with direct packet
+ * access, if the linear data is shorter than the headers they are copied
+ * with bpf_skb_load_bytes
+ */
+
+/* Length of the headers copied if they aren't in the linear data. The
+ * buffer they are copied to is twice as long, offsets into it are masked
+ * with PANDA_TC_HDR_LEN - 1 for the verifier (see panda_xdp_hdr)
+ */
+#define PANDA_TC_HDR_LEN PANDA_XDP_BUF_LEN
+
+<!--(macro generate_tc_entry_function)-->
+/* Parse a packet of an skb. buf is a buffer of 2 * PANDA_TC_HDR_LEN bytes
+ * for headers that aren't in the linear data
+ */
+static __always_inline int panda_tc_parser_@!parser_name!@(
+		struct __sk_buff *skb, struct panda_ctx *ctx, void *buf)
+{
+	const void *hdr = (void *)(long)skb->data;
+	const void *hdr_end = (void *)(long)skb->data_end;
+	const void *copied = NULL;
+	__u32 len = skb->len;
+
+	if (hdr_end - hdr < len && hdr_end - hdr < PANDA_TC_HDR_LEN) {
+		if (len > PANDA_TC_HDR_LEN)
+			len = PANDA_TC_HDR_LEN;
+		if (!len || bpf_skb_load_bytes(skb, 0, buf, len) < 0)
+			return PANDA_STOP_LENGTH;
+		hdr = buf;
+		hdr_end = buf + len;
+		copied = buf;
+	}
+
+	ctx->next = CODE_@!root_name!@;
+	ctx->offset = 0;
+
+	return __panda_xdp_parser_@!parser_name!@_prog(0, ctx, &hdr, hdr_end,
+						       copied);
+}
+<!--(end)-->
+
+<!--(for parser_name,root_name,parser_add,parser_ext in roots)-->
+@!generate_tc_entry_function(parser_name=parser_name,root_name=root_name)!@
+<!--(end)-->
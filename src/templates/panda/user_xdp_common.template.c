@@ -35,8 +35,22 @@ static inline int @!parser_name!@_panda_parse_@!root_name!@(
 {
 	void *frame = metadata->frame_data;
 	unsigned frame_num = 0;
+	<!--(if len([path for path in hot_paths if path['root'] == root_name]))-->
+	int ret;
+	<!--(end)-->
+
+	<!--(if len([path for path in hot_paths if path['root'] == root_name]))-->
+		<!--(for path in hot_paths)-->
+			<!--(if path['root'] == root_name)-->
+	ret = @!path['name']!@(parser, hdr, len, metadata,
+			flags, max_encaps);
+	if (ret != PANDA_HOT_PATH_MISS)
+		return ret;
 
-	return __@!root_name!@_panda_parse(parser, hdr,
+			<!--(end)-->
+		<!--(end)-->
+	<!--(end)-->
+	return __@!graph[root_name]['impl']!@_panda_parse(parser, hdr,
 		len, 0, metadata, flags, max_encaps, frame, frame_num);
 }
 	<!--(if parser_add and parser_ext)-->
@@ -48,7 +62,11 @@ PANDA_PARSER_OPT_EXT(
 	<!--(elif not parser_add and not parser_ext)-->
 PANDA_PARSER_OPT(
 	<!--(end)-->
+	<!--(if lean)-->
+      @!parser_name!@_lean,
+	<!--(else)-->
       @!parser_name!@_opt,
+	<!--(end)-->
       "",
       &@!root_name!@,
       @!parser_name!@_panda_parse_@!root_name!@
@@ -79,12 +97,18 @@ static inline __attribute__((always_inline)) int
 		mask = flag_field->mask ? flag_field->mask : flag_field->flag;
 		if ((flags & mask) == flag_field->flag) {
 			ctrl.hdr_len = flag_field->size;
+		<!--(if lean)-->
+			<!--(if flag['lean_metadata'])-->
+			@!flag['lean_metadata']!@(cp, frame, ctrl);
+			<!--(end)-->
+		<!--(else)-->
 			if (@!flag['name']!@.ops.extract_metadata)
 				@!flag['name']!@.ops.extract_metadata(
 						cp, frame, ctrl);
 			if(@!flag['name']!@.ops.handle_flag_field)
 				@!flag['name']!@.ops.handle_flag_field(
 						cp, frame, ctrl);
+		<!--(end)-->
 			cp += flag_field->size;
 			ctrl.hdr_offset += flag_field->size;
 		}
@@ -160,8 +184,14 @@ static inline __attribute__((always_inline)) int __@!name!@_panda_parse_tlvs(
 		<!--(if len(tlv['overlay_nodes']) != 0)-->
 			ops = &parse_tlv_node->tlv_ops;
 		<!--(end)-->
+		<!--(if lean)-->
+			ret = panda_parse_tlv_lean(parse_tlvs_node,
+					parse_tlv_node, cp, frame, tlv_ctrl,
+					@!tlv['lean_metadata'] or 'NULL'!@);
+		<!--(else)-->
 			ret = panda_parse_tlv(parse_tlvs_node, parse_tlv_node,
 					      cp, frame, tlv_ctrl);
+		<!--(end)-->
 			if (ret != PANDA_OKAY)
 				return ret;
 
@@ -176,9 +206,15 @@ static inline __attribute__((always_inline)) int __@!name!@_panda_parse_tlvs(
 			<!--(for overlay in tlv['overlay_nodes'])-->
 			case @!overlay['type']!@:
 				parse_tlv_node = &@!overlay['name']!@;
+				<!--(if lean)-->
+				ret = panda_parse_tlv_lean(parse_tlvs_node,
+					parse_tlv_node, cp, frame, tlv_ctrl,
+					@!overlay['lean_metadata'] or 'NULL'!@);
+				<!--(else)-->
 				ret = panda_parse_tlv(parse_tlvs_node,
 						      parse_tlv_node, cp,
 						      frame, tlv_ctrl);
+				<!--(end)-->
 				if (ret != PANDA_OKAY)
 					return ret;
 				break;
@@ -193,6 +229,12 @@ static inline __attribute__((always_inline)) int __@!name!@_panda_parse_tlvs(
 	<!--(end)-->
 		default:
 		{
+	<!--(if lean)-->
+			/* Wildcard TLV outputs are not consumed */
+			if (!parse_tlvs_node->tlv_wildcard_node &&
+			    parse_tlvs_node->unknown_tlv_type_ret != PANDA_OKAY)
+				return parse_tlvs_node->unknown_tlv_type_ret;
+	<!--(else)-->
 			struct panda_ctrl_data tlv_ctrl =
 						{ tlv_len, ctrl.hdr_offset };
 
@@ -203,6 +245,7 @@ static inline __attribute__((always_inline)) int __@!name!@_panda_parse_tlvs(
 						       cp, frame, tlv_ctrl);
 			else if (parse_tlvs_node->unknown_tlv_type_ret != PANDA_OKAY)
 				return parse_tlvs_node->unknown_tlv_type_ret;
+	<!--(end)-->
 		}
 		}
 
@@ -215,26 +258,123 @@ static inline __attribute__((always_inline)) int __@!name!@_panda_parse_tlvs(
 }
 <!--(end)-->
 
+<!--(macro generate_node_call)-->
+	<!--(if mode == 'goto')-->
+@!indent!@goto __@!graph[target]['impl']!@_panda_parse@!sfx!@_label;
+	<!--(elif mode == 'musttail')-->
+@!indent!@PANDA_MUSTTAIL return __@!graph[target]['impl']!@_panda_parse@!sfx!@(
+@!indent!@	parser, hdr, len, offset, metadata,
+@!indent!@	flags, max_encaps, frame, frame_num);
+	<!--(else)-->
+@!indent!@return __@!graph[target]['impl']!@_panda_parse@!sfx!@(
+@!indent!@	parser, hdr, len, offset, metadata,
+@!indent!@	flags, max_encaps, frame, frame_num);
+	<!--(end)-->
+<!--(end)-->
+<!--(macro generate_edge_parse_call)-->
+	<!--(if graph[edge_target]['pruned'])-->
+		return PANDA_STOP_OKAY;
+	<!--(else)-->
+		<!--(if graph[edge_target]['collapse'])-->
+		/* @!edge_target!@ collapsed into this dispatch */
+		if (panda_collapse_node(((const struct panda_parse_node *)
+				&@!edge_target!@)->proto_node, len)) {
+			int next_type = ((const struct panda_parse_node *)
+				&@!edge_target!@)->proto_node->ops.next_proto(hdr);
+
+			<!--(if graph[edge_target]['single_entry'])-->
+				<!--(for next in graph[edge_target]['out_edges'])-->
+			if (next_type == @!graph[edge_target]['single_entry']!@)
+$!generate_collapsed_parse_call(next=next,mode=mode).rstrip()!$
+				<!--(end)-->
+			<!--(else)-->
+			switch (next_type) {
+				<!--(for next in graph[edge_target]['out_edges'])-->
+					<!--(for e in graph[edge_target]['out_edges'][next])-->
+			case @!e['macro_name']!@:
+					<!--(end)-->
+$!generate_collapsed_parse_call(next=next,mode=mode).rstrip()!$
+				<!--(end)-->
+			}
+			<!--(end)-->
+		}
+		<!--(end)-->
+		<!--(if checked and edge_target in graph[name]['fused_next'])-->
+		if (panda_fuse_len_next(proto_node))
+$!generate_node_call(target=edge_target,sfx='_checked',indent='\t\t\t',mode=mode).rstrip()!$
+		<!--(end)-->
+$!generate_node_call(target=edge_target,sfx='',indent='\t\t',mode=mode).rstrip()!$
+	<!--(end)-->
+<!--(end)-->
+<!--(macro generate_collapsed_parse_call)-->
+	<!--(if graph[next]['pruned'])-->
+				return PANDA_STOP_OKAY;
+	<!--(else)-->
+$!generate_node_call(target=next,sfx='',indent='\t\t\t\t',mode=mode).rstrip()!$
+	<!--(end)-->
+<!--(end)-->
+<!--(macro generate_wildcard_parse_call)-->
+	<!--(if len(graph[name]['wildcard_proto_node']) == 0)-->
+	return @!default!@;
+	<!--(elif graph[graph[name]['wildcard_proto_node']]['pruned'])-->
+	return PANDA_STOP_OKAY;
+	<!--(else)-->
+		<!--(if checked and graph[name]['wildcard_proto_node'] in graph[name]['fused_next'])-->
+	if (panda_fuse_len_next(proto_node))
+$!generate_node_call(target=graph[name]['wildcard_proto_node'],sfx='_checked',indent='\t\t',mode=mode).rstrip()!$
+		<!--(end)-->
+$!generate_node_call(target=graph[name]['wildcard_proto_node'],sfx='',indent='\t',mode=mode).rstrip()!$
+	<!--(end)-->
+<!--(end)-->
+
 <!--(macro generate_protocol_parse_function_decl)-->
-static inline int __@!name!@_panda_parse(const struct panda_parser *parser,
+@!'static __attribute__((noinline))' if compact and not graph[name]['inline'] else 'static inline'!@ int
+	__@!name!@_panda_parse(const struct panda_parser *parser,
 		const void *hdr, size_t len, size_t offset,
 		struct panda_metadata *metadata, unsigned int flags,
 		unsigned int max_encaps, void *frame, unsigned frame_num);
+static inline __attribute__((always_inline)) size_t
+	__@!name!@_panda_fused_len(void);
 <!--(end)-->
 
-<!--(macro generate_protocol_parse_function)-->
+<!--(macro generate_protocol_parse_function_checked_decl)-->
+static inline int __@!name!@_panda_parse_checked(
+		const struct panda_parser *parser,
+		const void *hdr, size_t len, size_t offset,
+		struct panda_metadata *metadata, unsigned int flags,
+		unsigned int max_encaps, void *frame, unsigned frame_num);
+<!--(end)-->
+
+<!--(macro generate_protocol_helper_functions)-->
 	<!--(if len(graph[name]['tlv_nodes']) != 0)-->
 @!generate_protocol_tlvs_parse_function(name=name)!@
 	<!--(end)-->
 	<!--(if len(graph[name]['flag_fields_nodes']) != 0)-->
 @!generate_protocol_fields_parse_function(name=name)!@
 	<!--(end)-->
-static inline int __@!name!@_panda_parse(const struct panda_parser *parser,
-		const void *hdr, size_t len, size_t offset,
-		struct panda_metadata *metadata,
-		unsigned int flags, unsigned int max_encaps,
-		void *frame, unsigned frame_num)
+/* Bytes from the start of the header covered by a fused length check */
+static inline __attribute__((always_inline)) size_t
+	__@!name!@_panda_fused_len(void)
 {
+	const struct panda_proto_node *proto_node =
+		((const struct panda_parse_node *)&@!name!@)->proto_node;
+	size_t next = 0;
+
+	<!--(if len(graph[name]['fused_next']) != 0)-->
+	if (panda_fuse_len_next(proto_node)) {
+		<!--(for next in graph[name]['fused_next'])-->
+		next = panda_max(next,
+				 __@!graph[next]['impl']!@_panda_fused_len());
+		<!--(end)-->
+	}
+
+	<!--(end)-->
+	return proto_node->overlay ? panda_max(proto_node->min_len, next) :
+				     proto_node->min_len + next;
+}
+<!--(end)-->
+
+<!--(macro generate_protocol_parse_body)-->
 	const struct panda_parse_node *parse_node =
 		(const struct panda_parse_node*)&@!name!@;
 	const struct panda_proto_node *proto_node = parse_node->proto_node;
@@ -242,15 +382,27 @@ static inline int __@!name!@_panda_parse(const struct panda_parser *parser,
 	ssize_t hlen;
 	int ret;
 
-	ret = check_pkt_len(hdr, parse_node->proto_node, len, &hlen);
+	<!--(if checked)-->
+	ret = check_pkt_len_fused(hdr, proto_node, len, &hlen);
+	<!--(else)-->
+	ret = check_pkt_len(hdr, proto_node, len, &hlen);
+	<!--(end)-->
 	if (ret != PANDA_OKAY)
 		return ret;
 
 	ctrl.hdr_len = hlen;
 	ctrl.hdr_offset = offset;
 
+	<!--(if lean)-->
+		<!--(if graph[name]['lean_metadata'])-->
+	@!graph[name]['lean_metadata']!@(hdr, frame, ctrl);
+		<!--(else)-->
+	(void)ctrl;
+		<!--(end)-->
+	<!--(else)-->
 	if (parse_node->ops.extract_metadata)
 		parse_node->ops.extract_metadata(hdr, frame, ctrl);
+	<!--(end)-->
 
 	<!--(if len(graph[name]['tlv_nodes']) != 0)-->
 	ret = __@!name!@_panda_parse_tlvs(parse_node, hdr, frame, ctrl);
@@ -266,8 +418,9 @@ static inline int __@!name!@_panda_parse(const struct panda_parser *parser,
 	<!--(end)-->
 
 	if (proto_node->encap) {
-		ret = panda_encap_layer(metadata, max_encaps, &frame,
-					&frame_num);
+		ret = panda_parse_encap_layer(metadata, max_encaps, &frame,
+					      &frame_num, proto_node, offset,
+					      flags);
 		if (ret != PANDA_OKAY)
 			return ret;
 	}
@@ -285,33 +438,224 @@ static inline int __@!name!@_panda_parse(const struct panda_parser *parser,
 		len -= hlen;
 	}
 
+		<!--(if graph[name]['single_entry'])-->
+			<!--(for edge_target in graph[name]['out_edges'])-->
+	if (type == @!graph[name]['single_entry']!@) {
+$!generate_edge_parse_call(name=name,edge_target=edge_target,checked=checked,mode=mode).rstrip()!$
+	}
+			<!--(end)-->
+		<!--(else)-->
 	switch (type) {
-		<!--(for edge_target in graph[name]['out_edges'])-->
-			<!--(for e in graph[name]['out_edges'][edge_target])-->
+			<!--(for edge_target in graph[name]['out_edges'])-->
+				<!--(for e in graph[name]['out_edges'][edge_target])-->
 	case @!e['macro_name']!@:
-		return __@!edge_target!@_panda_parse(
-			parser, hdr, len, offset, metadata, flags, max_encaps,
-			frame, frame_num);
+				<!--(end)-->
+$!generate_edge_parse_call(name=name,edge_target=edge_target,checked=checked,mode=mode).rstrip()!$
 			<!--(end)-->
+	}
 		<!--(end)-->
+$!generate_wildcard_parse_call(name=name,checked=checked,mode=mode,default='PANDA_STOP_UNKNOWN_PROTO').rstrip()!$
 	}
-		<!--(if len(graph[name]['wildcard_proto_node']) != 0)-->
-	return __@!graph[name]['wildcard_proto_node']!@_panda_parse(
-		parser, hdr, len, offset, metadata, flags, max_encaps,
-		frame, frame_num);
+	<!--(else)-->
+$!generate_wildcard_parse_call(name=name,checked=checked,mode=mode,default='PANDA_STOP_OKAY').rstrip()!$
+	<!--(end)-->
+<!--(end)-->
+
+<!--(macro generate_protocol_parse_function)-->
+	<!--(if compact)-->
+/* Compact code, one parse function shared by all the callers of the node */
+@!'static __attribute__((noinline))' if compact and not graph[name]['inline'] else 'static inline'!@ int
+	__@!name!@_panda_parse(const struct panda_parser *parser,
+		const void *hdr, size_t len, size_t offset,
+		struct panda_metadata *metadata,
+		unsigned int flags, unsigned int max_encaps,
+		void *frame, unsigned frame_num)
+{
+$!generate_protocol_parse_body(name=name,checked=False,mode=mode).rstrip()!$
+}
+	<!--(else)-->
+/* Minimum length of the node was checked by a fused length check */
+static inline int __@!name!@_panda_parse_checked(
+		const struct panda_parser *parser,
+		const void *hdr, size_t len, size_t offset,
+		struct panda_metadata *metadata,
+		unsigned int flags, unsigned int max_encaps,
+		void *frame, unsigned frame_num)
+{
+$!generate_protocol_parse_body(name=name,checked=True,mode=mode).rstrip()!$
+}
+
+static inline int __@!name!@_panda_parse(const struct panda_parser *parser,
+		const void *hdr, size_t len, size_t offset,
+		struct panda_metadata *metadata,
+		unsigned int flags, unsigned int max_encaps,
+		void *frame, unsigned frame_num)
+{
+	/* Fused length check for the node and the nodes that follow */
+	if (len >= __@!name!@_panda_fused_len())
+$!generate_node_call(target=name,sfx='_checked',indent='\t\t',mode=mode).rstrip()!$
+
+$!generate_protocol_parse_body(name=name,checked=False,mode=mode).rstrip()!$
+}
+	<!--(end)-->
+<!--(end)-->
+<!--(macro generate_goto_parse_function)-->
+/* Parse nodes as labelled blocks of one function, a node dispatches to the
+ * next with a goto. start is the node where parsing starts
+ */
+enum {
+	<!--(for node in graph)-->
+		<!--(if not graph[node]['pruned'] and graph[node]['impl'] == node)-->
+	__@!node!@_panda_goto,
+		<!--(end)-->
+	<!--(end)-->
+};
+
+static int __panda_parse_goto(const struct panda_parser *parser,
+		const void *hdr, size_t len, size_t offset,
+		struct panda_metadata *metadata,
+		unsigned int flags, unsigned int max_encaps,
+		void *frame, unsigned frame_num, int start)
+{
+	switch (start) {
+	<!--(for node in graph)-->
+		<!--(if not graph[node]['pruned'] and graph[node]['impl'] == node)-->
+	case __@!node!@_panda_goto:
+		goto __@!node!@_panda_parse_label;
+		<!--(end)-->
+	<!--(end)-->
+	default:
+		return PANDA_STOP_FAIL;
+	}
+	<!--(for node in graph)-->
+		<!--(if not graph[node]['pruned'] and graph[node]['impl'] == node)-->
+
+__@!node!@_panda_parse_label:
+	/* Fused length check for the node and the nodes that follow */
+	if (len >= __@!node!@_panda_fused_len())
+		goto __@!node!@_panda_parse_checked_label;
+	{
+$!generate_protocol_parse_body(name=node,checked=False,mode='goto').rstrip()!$
+	}
+
+__@!node!@_panda_parse_checked_label:
+	{
+$!generate_protocol_parse_body(name=node,checked=True,mode='goto').rstrip()!$
+	}
+		<!--(end)-->
+	<!--(end)-->
+}
+	<!--(for node in graph)-->
+		<!--(if not graph[node]['pruned'] and graph[node]['impl'] == node)-->
+
+static inline int __@!node!@_panda_parse(const struct panda_parser *parser,
+		const void *hdr, size_t len, size_t offset,
+		struct panda_metadata *metadata,
+		unsigned int flags, unsigned int max_encaps,
+		void *frame, unsigned frame_num)
+{
+	return __panda_parse_goto(parser, hdr, len, offset, metadata, flags,
+				  max_encaps, frame, frame_num,
+				  __@!node!@_panda_goto);
+}
+		<!--(end)-->
+	<!--(end)-->
+<!--(end)-->
+<!--(macro generate_hot_path_function)-->
+/* Hot path @!path['desc']!@
+ *
+ * Lengths and next protocols of all the nodes on the path are checked
+ * before any metadata is written. If they don't match the path then
+ * PANDA_HOT_PATH_MISS is returned and the packet is parsed by the graph
+ */
+static inline __attribute__((always_inline)) int @!path['name']!@(
+		const struct panda_parser *parser,
+		const void *hdr, size_t len,
+		struct panda_metadata *metadata,
+		unsigned int flags, unsigned int max_encaps)
+{
+	const struct panda_parse_node *parse_node;
+	size_t offset[@!len(path['nodes']) + 1!@] = { 0 };
+	ssize_t hlen[@!len(path['nodes'])!@];
+	void *frame = metadata->frame_data;
+	unsigned frame_num = 0;
+	struct panda_ctrl_data ctrl;
+	int type, ret;
+
+	/* Combined check of the minimum header lengths */
+	if (len <
+	<!--(for i,node in enumerate(path['nodes']))-->
+	    panda_hot_path_min_len(
+		(const struct panda_parse_node *)&@!node['name']!@)@!' +' if i + 1 < len(path['nodes']) else ')'!@
+	<!--(end)-->
+		return PANDA_HOT_PATH_MISS;
+
+	<!--(for i,node in enumerate(path['nodes']))-->
+	parse_node = (const struct panda_parse_node *)&@!node['name']!@;
+	if (offset[@!i!@] > len ||
+	    check_pkt_len(hdr + offset[@!i!@], parse_node->proto_node,
+			  len - offset[@!i!@], &hlen[@!i!@]) != PANDA_OKAY)
+		return PANDA_HOT_PATH_MISS;
+		<!--(if len(node['types']) != 0)-->
+
+	type = parse_node->proto_node->ops.next_proto(hdr + offset[@!i!@]);
+	switch (type) {
+			<!--(for t in node['types'])-->
+	case @!t!@:
+			<!--(end)-->
+		break;
+	default:
+		return PANDA_HOT_PATH_MISS;
+	}
+
+	offset[@!i + 1!@] = offset[@!i!@] +
+		(parse_node->proto_node->overlay ? 0 : hlen[@!i!@]);
+		<!--(end)-->
+
+	<!--(end)-->
+	/* Path matched, run the nodes back to back */
+	<!--(for i,node in enumerate(path['nodes']))-->
+	parse_node = (const struct panda_parse_node *)&@!node['name']!@;
+	ctrl.hdr_len = hlen[@!i!@];
+	ctrl.hdr_offset = offset[@!i!@];
+		<!--(if lean)-->
+			<!--(if graph[node['name']]['lean_metadata'])-->
+	@!graph[node['name']]['lean_metadata']!@(hdr + offset[@!i!@], frame, ctrl);
+			<!--(end)-->
 		<!--(else)-->
-	return PANDA_STOP_UNKNOWN_PROTO;
+	if (parse_node->ops.extract_metadata)
+		parse_node->ops.extract_metadata(hdr + offset[@!i!@], frame,
+						 ctrl);
+		<!--(end)-->
+		<!--(if len(graph[node['name']]['tlv_nodes']) != 0)-->
+	ret = __@!node['name']!@_panda_parse_tlvs(parse_node,
+			hdr + offset[@!i!@], frame, ctrl);
+	if (ret != PANDA_OKAY)
+		return ret;
+		<!--(end)-->
+		<!--(if len(graph[node['name']]['flag_fields_nodes']) != 0)-->
+	ret = __@!node['name']!@_panda_parse_flag_fields(parse_node,
+			hdr + offset[@!i!@], frame, ctrl);
+	if (ret != PANDA_OKAY)
+		return ret;
 		<!--(end)-->
+	if (parse_node->proto_node->encap) {
+		ret = panda_parse_encap_layer(metadata, max_encaps, &frame,
+					      &frame_num, parse_node->proto_node,
+					      offset[@!i!@], flags);
+		if (ret != PANDA_OKAY)
+			return ret;
 	}
-	<!--(else)-->
 
-		<!--(if len(graph[name]['wildcard_proto_node']) != 0)-->
-	return __@!graph[name]['wildcard_proto_node']!@_panda_parse(
-		parser, hdr, len, offset, metadata, flags, max_encaps,
+	<!--(end)-->
+	<!--(if path['tail'] == 'graph')-->
+	return __@!graph[path['next']]['impl']!@_panda_parse(parser,
+		hdr + offset[@!len(path['nodes'])!@],
+		len - offset[@!len(path['nodes'])!@],
+		offset[@!len(path['nodes'])!@], metadata, flags, max_encaps,
 		frame, frame_num);
-		<!--(else)-->
+	<!--(else)-->
 	return PANDA_STOP_OKAY;
-		<!--(end)-->
 	<!--(end)-->
 }
 <!--(end)-->
@@ -337,6 +681,30 @@ static inline __attribute__((always_inline)) int panda_parse_wildcard_tlv(
 	return PANDA_OKAY;
 }
 
+	<!--(if lean)-->
+/* TLV processing for lean parsers. extract is the specialized extraction
+ * function for the TLV, or NULL if the TLV's outputs are not consumed
+ */
+static inline __attribute__((always_inline)) int panda_parse_tlv_lean(
+		const struct panda_parse_tlvs_node *parse_node,
+		const struct panda_parse_tlv_node *parse_tlv_node,
+		const __u8 *cp, void *frame, struct panda_ctrl_data tlv_ctrl,
+		void (*extract)(const void *hdr, void *frame,
+				const struct panda_ctrl_data ctrl)) {
+	const struct panda_proto_tlv_node *proto_tlv_node =
+					parse_tlv_node->proto_tlv_node;
+
+	if (proto_tlv_node && (tlv_ctrl.hdr_len < proto_tlv_node->min_len))
+		return parse_node->tlv_wildcard_node ? PANDA_OKAY :
+					parse_node->unknown_tlv_type_ret;
+
+	if (extract)
+		extract(cp, frame, tlv_ctrl);
+
+	return PANDA_OKAY;
+}
+
+	<!--(end)-->
 static inline __attribute__((always_inline)) int panda_parse_tlv(
 		const struct panda_parse_tlvs_node *parse_node,
 		const struct panda_parse_tlv_node *parse_tlv_node,
@@ -161,6 +161,22 @@ static __always_inline int panda_xdp_parser_@!parser_name!@(
 	return @!parser_name!@_panda_parse_@!root_name!@(ictx,
 							hdr, hdr_end, tailcall);
 }
+
+/* One program, see xdp_loop_def for parsers split in several programs */
+#define PANDA_XDP_NUM_PROGS_@!parser_name!@ 1
+
+#define PANDA_XDP_FOR_EACH_PROG_@!parser_name!@(M, ...) M(0, __VA_ARGS__)
+
+static __always_inline __u32 panda_xdp_prog_@!parser_name!@(__u32 next)
+{
+	return 0;
+}
+
+static __always_inline int panda_xdp_parser_@!parser_name!@_prog(__u32 prog,
+		struct panda_ctx *ctx, const void **hdr, const void *hdr_end)
+{
+	return panda_xdp_parser_@!parser_name!@(ctx, hdr, hdr_end, true);
+}
 <!--(end)-->
 
 <!--(macro generate_protocol_tlvs_parse_function)-->
@@ -0,0 +1,546 @@
+<!--(if 0)-->
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 by Mojatatu Networks.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+<!--(end)-->
+
+/* XDP parser with the parse nodes as BPF subprograms and the TLVs parsed
+ * by bpf_loop callbacks (Linux 5.17 or later). panda-compiler --xdp-loop
+ * splits the nodes over programs that tail call each other
+ */
+
+#include <linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+#include "panda/proto_nodes_def.h"
+#include "panda/bpf.h"
+
+#include "panda/parser.h"
+#include "panda/parser_metadata.h"
+#include "@!filename!@"
+
+/* Maximum number of nodes parsed in one pass of a program */
+#ifndef PANDA_LOOP_COUNT
+#define PANDA_LOOP_COUNT 32
+#endif
+
+/* Maximum number of TLVs parsed in one node */
+#ifndef PANDA_XDP_MAX_TLVS
+#define PANDA_XDP_MAX_TLVS 40
+#endif
+
+/* Bound of the TLVs of a header, for the verifier */
+#ifndef PANDA_XDP_MAX_TLVS_LEN
+#define PANDA_XDP_MAX_TLVS_LEN 2048
+#endif
+
+#ifndef PANDA_MAX_ENCAPS
+#define PANDA_MAX_ENCAPS 40
+#endif
+
+/* Length of a buffer in a map value for headers copied out of the packet,
+ * as by TC parsers for headers beyond the linear data of an skb. This is a
+ * power of two, the buffer is twice as long (see panda_xdp_hdr)
+ */
+#ifndef PANDA_XDP_BUF_LEN
+#define PANDA_XDP_BUF_LEN 256
+#endif
+
+enum {
+<!--(for node in graph)-->
+CODE_@!node!@,
+<!--(end)-->
+CODE_IGNORE
+};
+
+/* State of a pass of the parser, shared by the dispatch loop and the node
+ * subprograms
+ */
+struct panda_xdp_state {
+	struct panda_ctx *ctx;
+	const void *hdr;
+	const void *hdr_end;
+	const __u8 *buf;
+	void *frame;
+	size_t offset;
+	int ret;
+};
+
+/* State of the TLV loop of a node. off is the offset of the current TLV
+ * from hdr, len the remaining length of the TLVs
+ */
+struct panda_xdp_tlvs_state {
+	const __u8 *hdr;
+	const void *hdr_end;
+	const __u8 *buf;
+	void *frame;
+	size_t off, len, hdr_offset;
+	int ret;
+};
+
+/* Header at offset of the packet to read. hdr is checked against hdr_end,
+ * which doesn't bound a pointer into a map value for the verifier. Headers
+ * in buf are read at the offset masked to PANDA_XDP_BUF_LEN, this is the
+ * same offset once hdr is checked, and a header of up to PANDA_XDP_BUF_LEN
+ * bytes at a masked offset is in the buffer
+ */
+static __always_inline const void *panda_xdp_hdr(const __u8 *buf,
+		const void *hdr, size_t offset)
+{
+	if (buf)
+		return buf + (offset & (PANDA_XDP_BUF_LEN - 1));
+
+	return hdr;
+}
+
+static __always_inline int panda_xdp_check_pkt_len(const void *hdr,
+		const void *hdr_end, const __u8 *buf, size_t offset,
+		const struct panda_proto_node *pnode, ssize_t *hlen)
+{
+	*hlen = pnode->min_len;
+
+	/* Protocol node length checks */
+	if (panda_bpf_check_pkt(hdr, *hlen, hdr_end))
+		return PANDA_STOP_LENGTH;
+
+	if (pnode->ops.len) {
+		*hlen = pnode->ops.len(panda_xdp_hdr(buf, hdr, offset));
+		if (*hlen < 0)
+			return PANDA_STOP_LENGTH;
+		if (*hlen < pnode->min_len)
+			return PANDA_STOP_LENGTH;
+		if (panda_bpf_check_pkt(hdr, *hlen, hdr_end))
+			return PANDA_STOP_LENGTH;
+	}
+
+	return PANDA_OKAY;
+}
+
+static __always_inline int panda_xdp_encap_layer(struct panda_xdp_state *s)
+{
+	struct panda_metadata *metadata = &s->ctx->metadata;
+
+	/* New encapsulation layer. Check against number of encap layers
+	 * allowed and also if we need a new metadata frame
+	 */
+	if (++metadata->encaps > PANDA_MAX_ENCAPS)
+		return PANDA_STOP_ENCAP_DEPTH;
+
+	if (metadata->max_frame_num > s->ctx->frame_num) {
+		s->frame += metadata->frame_size;
+		s->ctx->frame_num++;
+	}
+
+	return PANDA_OKAY;
+}
+
+/* Parse a TLV. tlv is checked against hdr_end, cp is the TLV to read (see
+ * panda_xdp_hdr)
+ */
+static __always_inline int panda_xdp_parse_tlv(
+		const struct panda_parse_tlvs_node *parse_tlvs_node,
+		const struct panda_parse_tlv_node *parse_tlv_node,
+		const __u8 *tlv, const __u8 *cp, const void *hdr_end,
+		void *frame, struct panda_ctrl_data tlv_ctrl)
+{
+	const struct panda_proto_tlv_node *proto_tlv_node =
+					parse_tlv_node->proto_tlv_node;
+	const struct panda_parse_tlv_node_ops *ops;
+
+	if (proto_tlv_node &&
+	    (tlv_ctrl.hdr_len < proto_tlv_node->min_len ||
+	     panda_bpf_check_pkt(tlv, proto_tlv_node->min_len, hdr_end))) {
+		/* Treat check length error as an unrecognized TLV */
+		parse_tlv_node = parse_tlvs_node->tlv_wildcard_node;
+		if (!parse_tlv_node)
+			return parse_tlvs_node->unknown_tlv_type_ret;
+
+		proto_tlv_node = parse_tlv_node->proto_tlv_node;
+		if (proto_tlv_node &&
+		    (tlv_ctrl.hdr_len < proto_tlv_node->min_len ||
+		     panda_bpf_check_pkt(tlv, proto_tlv_node->min_len,
+					 hdr_end)))
+			return parse_tlvs_node->unknown_tlv_type_ret;
+	}
+
+	ops = &parse_tlv_node->tlv_ops;
+
+	if (ops->extract_metadata)
+		ops->extract_metadata(cp, frame, tlv_ctrl);
+
+	if (ops->handle_tlv)
+		return ops->handle_tlv(cp, frame, tlv_ctrl);
+
+	return PANDA_OKAY;
+}
+
+<!--(macro generate_xdp_tlv_parse_call)-->
+@!indent!@t->ret = panda_xdp_parse_tlv(parse_tlvs_node,
+@!indent!@		$!tlv_node!$, tlv, cp,
+@!indent!@		t->hdr_end, t->frame, tlv_ctrl);
+<!--(end)-->
+
+<!--(macro generate_xdp_tlvs_parse_function)-->
+/* Parse one TLV of @!name!@, bpf_loop callback */
+static long __@!name!@_panda_xdp_parse_tlv(__u32 index, void *arg)
+{
+	const struct panda_parse_tlvs_node *parse_tlvs_node =
+				(const struct panda_parse_tlvs_node *)&@!name!@;
+	const struct panda_proto_tlvs_node *proto_tlvs_node =
+		(const struct panda_proto_tlvs_node *)
+				parse_tlvs_node->parse_node.proto_node;
+	const struct panda_parse_tlv_node *parse_tlv_node;
+	struct panda_xdp_tlvs_state *t = arg;
+	struct panda_ctrl_data tlv_ctrl;
+	const __u8 *cp, *tlv;
+	ssize_t tlv_len;
+	int type;
+
+	if (!t->len || t->off > PANDA_XDP_MAX_TLVS_LEN)
+		return 1;
+
+	tlv = t->hdr + t->off;
+	if (panda_bpf_check_pkt(tlv, 1, t->hdr_end)) {
+		t->ret = PANDA_STOP_LENGTH;
+		return 1;
+	}
+	cp = panda_xdp_hdr(t->buf, tlv, t->hdr_offset);
+
+	if (proto_tlvs_node->pad1_enable &&
+	    *cp == proto_tlvs_node->pad1_val) {
+		/* One byte padding, just advance */
+		t->off++;
+		t->hdr_offset++;
+		t->len--;
+		return 0;
+	}
+
+	/* Hit EOL, we're done */
+	if (proto_tlvs_node->eol_enable && *cp == proto_tlvs_node->eol_val)
+		return 1;
+
+	if (t->len < proto_tlvs_node->min_len) {
+		t->ret = PANDA_STOP_TLV_LENGTH;
+		return 1;
+	}
+
+	if (panda_bpf_check_pkt(tlv, proto_tlvs_node->min_len, t->hdr_end)) {
+		t->ret = PANDA_STOP_LENGTH;
+		return 1;
+	}
+
+	if (proto_tlvs_node->ops.len) {
+		tlv_len = proto_tlvs_node->ops.len(cp);
+		if (!tlv_len || t->len < tlv_len) {
+			t->ret = PANDA_STOP_TLV_LENGTH;
+			return 1;
+		}
+		if (tlv_len < proto_tlvs_node->min_len) {
+			t->ret = tlv_len < 0 ? tlv_len : PANDA_STOP_TLV_LENGTH;
+			return 1;
+		}
+	} else {
+		tlv_len = proto_tlvs_node->min_len;
+	}
+
+	tlv_ctrl.hdr_len = tlv_len;
+	tlv_ctrl.hdr_offset = t->hdr_offset;
+
+	type = proto_tlvs_node->ops.type(cp);
+	switch (type) {
+	<!--(for tlv in graph[name]['tlv_nodes'])-->
+	case @!tlv['type']!@:
+		parse_tlv_node = &@!tlv['name']!@;
+$!generate_xdp_tlv_parse_call(tlv_node='parse_tlv_node',indent='\t\t').rstrip()!$
+		<!--(if len(tlv['overlay_nodes']) != 0)-->
+		if (t->ret != PANDA_OKAY)
+			break;
+
+		/* TLV overlay node */
+		switch (parse_tlv_node->tlv_ops.overlay_type ?
+			parse_tlv_node->tlv_ops.overlay_type(cp) :
+			tlv_ctrl.hdr_len) {
+			<!--(for overlay in tlv['overlay_nodes'])-->
+		case @!overlay['type']!@:
+$!generate_xdp_tlv_parse_call(tlv_node='&' + overlay['name'],indent='\t\t\t').rstrip()!$
+			break;
+			<!--(end)-->
+		default:
+			if (parse_tlv_node->overlay_wildcard_node)
+$!generate_xdp_tlv_parse_call(tlv_node='parse_tlv_node->overlay_wildcard_node',indent='\t\t\t\t').rstrip()!$
+			else
+				t->ret = parse_tlv_node->unknown_overlay_ret;
+			break;
+		}
+		<!--(end)-->
+		break;
+	<!--(end)-->
+	default:
+		/* Unknown TLV, returning PANDA_OKAY means skip */
+		if (parse_tlvs_node->tlv_wildcard_node)
+$!generate_xdp_tlv_parse_call(tlv_node='parse_tlvs_node->tlv_wildcard_node',indent='\t\t\t').rstrip()!$
+		else
+			t->ret = parse_tlvs_node->unknown_tlv_type_ret;
+		break;
+	}
+
+	if (t->ret != PANDA_OKAY)
+		return 1;
+
+	/* Move over current TLV */
+	t->off += tlv_len;
+	t->hdr_offset += tlv_len;
+	t->len -= tlv_len;
+
+	return 0;
+}
+
+<!--(end)-->
+
+<!--(macro generate_xdp_parse_function)-->
+	<!--(if len(graph[name]['tlv_nodes']) != 0)-->
+@!generate_xdp_tlvs_parse_function(name=name)!@
+	<!--(end)-->
+	<!--(if len(graph[name]['flag_fields_nodes']) != 0)-->
+@!generate_protocol_fields_parse_function(name=name)!@
+	<!--(end)-->
+/* Parse node @!name!@, about @!graph[name]['xdp_size']!@ insns */
+static __noinline int __@!name!@_panda_xdp_parse(struct panda_xdp_state *s)
+{
+	const struct panda_parse_node *parse_node =
+				(const struct panda_parse_node *)&@!name!@;
+	const struct panda_proto_node *proto_node = parse_node->proto_node;
+	const void *hdr = s->hdr;
+	struct panda_ctrl_data ctrl;
+	int ret, type;
+	ssize_t hlen;
+
+	(void)type;
+
+	ret = panda_xdp_check_pkt_len(hdr, s->hdr_end, s->buf, s->offset,
+				      proto_node, &hlen);
+	if (ret != PANDA_OKAY)
+		return ret;
+
+	/* From here hdr is only read */
+	hdr = panda_xdp_hdr(s->buf, hdr, s->offset);
+
+	ctrl.hdr_len = hlen;
+	ctrl.hdr_offset = s->offset;
+
+	if (parse_node->ops.extract_metadata)
+		parse_node->ops.extract_metadata(hdr, s->frame, ctrl);
+
+	<!--(if len(graph[name]['tlv_nodes']) != 0)-->
+	{
+		const struct panda_proto_tlvs_node *proto_tlvs_node =
+			(const struct panda_proto_tlvs_node *)proto_node;
+		struct panda_xdp_tlvs_state t = {
+			.hdr = s->hdr,
+			.hdr_end = s->hdr_end,
+			.buf = s->buf,
+			.frame = s->frame,
+			.ret = PANDA_OKAY,
+		};
+
+		/* Assume hlen marks end of TLVs */
+		t.off = proto_tlvs_node->ops.start_offset(hdr);
+		t.len = hlen - t.off;
+		t.hdr_offset = ctrl.hdr_offset + t.off;
+
+		bpf_loop(PANDA_XDP_MAX_TLVS, __@!name!@_panda_xdp_parse_tlv,
+			 &t, 0);
+		if (t.ret != PANDA_OKAY)
+			return t.ret;
+	}
+
+	<!--(end)-->
+	<!--(if len(graph[name]['flag_fields_nodes']) != 0)-->
+	ret = __@!name!@_panda_parse_flag_fields(parse_node, hdr, s->frame,
+						 ctrl);
+	if (ret != PANDA_OKAY)
+		return ret;
+
+	<!--(end)-->
+	if (proto_node->encap) {
+		ret = panda_xdp_encap_layer(s);
+		if (ret != PANDA_OKAY)
+			return ret;
+	}
+
+	<!--(if len(graph[name]['out_edges']) != 0 or len(graph[name]['wildcard_proto_node']) != 0)-->
+	type = proto_node->ops.next_proto(hdr);
+	if (type < 0)
+		return type;
+
+	if (!proto_node->overlay) {
+		s->hdr += hlen;
+		s->offset += hlen;
+	}
+
+	switch (type) {
+		<!--(for edge_target in graph[name]['out_edges'])-->
+			<!--(for e in graph[name]['out_edges'][edge_target])-->
+	case @!e['macro_name']!@:
+			<!--(end)-->
+		s->ctx->next = CODE_@!edge_target!@;
+		return PANDA_OKAY;
+		<!--(end)-->
+	}
+
+	/* Unknown protocol */
+		<!--(if len(graph[name]['wildcard_proto_node']) != 0)-->
+	s->ctx->next = CODE_@!graph[name]['wildcard_proto_node']!@;
+	return PANDA_OKAY;
+		<!--(else)-->
+	return PANDA_STOP_UNKNOWN_PROTO;
+		<!--(end)-->
+	<!--(else)-->
+	s->ctx->next = CODE_IGNORE;
+	return PANDA_STOP_OKAY;
+	<!--(end)-->
+}
+
+<!--(end)-->
+
+<!--(macro generate_xdp_entry_function)-->
+/* Programs of the parser. Nodes of a program are parsed by a bpf_loop over
+ * ctx->next, the loop ends when parsing is done or the next node is in
+ * another program
+ */
+#define PANDA_XDP_NUM_PROGS_@!parser_name!@ @!nprogs!@
+
+#define PANDA_XDP_FOR_EACH_PROG_@!parser_name!@(M, ...)	\
+	<!--(for prog in range(nprogs))-->
+	M(@!prog!@, __VA_ARGS__)	\
+	<!--(end)-->
+
+	<!--(for prog in range(nprogs))-->
+static long @!parser_name!@_panda_xdp_prog@!prog!@(__u32 index,
+		void *arg)
+{
+	struct panda_xdp_state *s = arg;
+
+	switch (s->ctx->next) {
+		<!--(for node in graph)-->
+			<!--(if graph[node]['xdp_size'] and graph[node]['xdp_prog'] == prog)-->
+	case CODE_@!node!@:
+		s->ret = __@!node!@_panda_xdp_parse(s);
+		break;
+			<!--(end)-->
+		<!--(end)-->
+	default:
+		/* Done, or the node is in another program */
+		return 1;
+	}
+
+	return s->ret != PANDA_OKAY || s->ctx->next == CODE_IGNORE;
+}
+
+	<!--(end)-->
+/* Program to tail call for the next node */
+static __always_inline __u32 panda_xdp_prog_@!parser_name!@(
+		__u32 next)
+{
+	switch (next) {
+	<!--(for node in graph)-->
+		<!--(if graph[node]['xdp_size'] and graph[node]['xdp_prog'])-->
+	case CODE_@!node!@:
+		return @!graph[node]['xdp_prog']!@;
+		<!--(end)-->
+	<!--(end)-->
+	default:
+		return 0;
+	}
+}
+
+/* Parse nodes of program prog, starting at ctx->next. buf is NULL for
+ * direct packet access, else the packet is in buf (see panda_xdp_hdr)
+ */
+static __always_inline int __panda_xdp_parser_@!parser_name!@_prog(
+		__u32 prog, struct panda_ctx *ctx, const void **hdr,
+		const void *hdr_end, const void *buf)
+{
+	struct panda_xdp_state s = {
+		.ctx = ctx,
+		.hdr = *hdr,
+		.hdr_end = hdr_end,
+		.buf = buf,
+		.frame = ctx->metadata.frame_data +
+			 ctx->frame_num * ctx->metadata.frame_size,
+		.offset = ctx->offset,
+		.ret = PANDA_OKAY,
+	};
+
+	switch (prog) {
+	<!--(for prog in range(nprogs))-->
+	case @!prog!@:
+		bpf_loop(PANDA_LOOP_COUNT,
+			 @!parser_name!@_panda_xdp_prog@!prog!@, &s, 0);
+		break;
+	<!--(end)-->
+	default:
+		return PANDA_STOP_FAIL;
+	}
+
+	*hdr = s.hdr;
+
+	return s.ret;
+}
+
+static __always_inline int panda_xdp_parser_@!parser_name!@_prog(
+		__u32 prog, struct panda_ctx *ctx, const void **hdr,
+		const void *hdr_end)
+{
+	return __panda_xdp_parser_@!parser_name!@_prog(prog, ctx, hdr,
+						       hdr_end, NULL);
+}
+
+static __always_inline int panda_xdp_parser_@!parser_name!@(
+		struct panda_ctx *ctx, const void **hdr,
+		const void *hdr_end, bool tailcall)
+{
+	if (!tailcall) {
+		ctx->next = CODE_@!root_name!@;
+		ctx->offset = 0;
+
+		return panda_xdp_parser_@!parser_name!@_prog(0, ctx, hdr,
+							     hdr_end);
+	}
+
+	return panda_xdp_parser_@!parser_name!@_prog(
+			panda_xdp_prog_@!parser_name!@(ctx->next), ctx, hdr,
+			hdr_end);
+}
+<!--(end)-->
+
+<!--(for node in graph)-->
+	<!--(if graph[node]['xdp_size'])-->
+@!generate_xdp_parse_function(name=node)!@
+	<!--(end)-->
+<!--(end)-->
+
+<!--(for parser_name,root_name,parser_add,parser_ext in roots)-->
+@!generate_xdp_entry_function(parser_name=parser_name,root_name=root_name,nprogs=max([graph[n]['xdp_prog'] for n in graph]) + 1)!@
+<!--(end)-->
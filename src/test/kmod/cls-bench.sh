@@ -0,0 +1,69 @@
+#! /bin/sh
+#Benchmark of publishing the parse results of the PANDA classifier, this needs
+#root, a tc patched with src/tc/tc.patch, the cls_panda and panda_big modules
+#loaded, pktgen, and the ftrace function profiler.
+#
+#pktgen sends UDP packets of many flows through the egress classifier of one
+#end of a veth pair. The other end has RPS enabled so the skb hash is needed
+#for each received packet. Without publish the flow dissector is run to get
+#the hash, with publish the hash set by the classifier is used. The number of
+#runs of the flow dissector and the time spent in it are reported for both
+COUNT=${COUNT:-1000000}
+PARSER=${PARSER:-big}
+NS=panda-bench
+TRACING=/sys/kernel/tracing
+[ -d $TRACING/trace_stat ] || TRACING=/sys/kernel/debug/tracing
+
+cleanup() {
+	echo 0 > $TRACING/function_profile_enabled
+	echo > $TRACING/set_ftrace_filter
+	ip netns del $NS 2> /dev/null
+}
+
+pgset() {
+	ip netns exec $NS sh -c "echo '$2' > /proc/net/pktgen/$1"
+}
+
+echo "running cls_panda publish benchmark"
+modprobe pktgen || exit 1
+ip netns add $NS || exit 1
+trap cleanup EXIT
+
+ip -n $NS link add veth0 type veth peer name veth1
+ip -n $NS link set veth0 up
+ip -n $NS link set veth1 up
+ip netns exec $NS sh -c \
+	"echo ff > /sys/class/net/veth1/queues/rx-0/rps_cpus"
+MAC=`ip netns exec $NS cat /sys/class/net/veth1/address`
+ip netns exec $NS tc qdisc add dev veth0 clsact
+
+echo __skb_flow_dissect > $TRACING/set_ftrace_filter || exit 1
+
+for publish in "" publish; do
+	ip netns exec $NS tc filter replace dev veth0 egress prio 1 handle 1 \
+		panda parser $PARSER $publish classid 1:1 || exit 1
+
+	pgset kpktgend_0 "rem_device_all"
+	pgset kpktgend_0 "add_device veth0"
+	pgset veth0 "xmit_mode queue_xmit"
+	pgset veth0 "count $COUNT"
+	pgset veth0 "pkt_size 64"
+	pgset veth0 "dst_mac $MAC"
+	pgset veth0 "dst 10.0.0.2"
+	pgset veth0 "udp_src_min 1024"
+	pgset veth0 "udp_src_max 65535"
+	pgset veth0 "flag UDPSRC_RND"
+
+	#enabling the profiler resets it
+	echo 0 > $TRACING/function_profile_enabled
+	echo 1 > $TRACING/function_profile_enabled
+	pgset pgctrl "start"
+	echo 0 > $TRACING/function_profile_enabled
+
+	#trace_stat has Function, Hit, Time, ... columns per CPU
+	cat $TRACING/trace_stat/function* | \
+		awk -v mode="${publish:-no publish}" -v count=$COUNT '
+		$1 == "__skb_flow_dissect" { hits += $2; us += $3 }
+		END { printf "cls_panda %s: %d packets, %d flow dissections, %.0f us\n",
+			mode, count, hits, us }'
+done
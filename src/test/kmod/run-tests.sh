@@ -0,0 +1,23 @@
+#! /bin/sh
+#Kernel module parser stress test, this needs root and the kernel headers.
+#panda_stress parses the packets of a pcap file from kthreads on 1, 2, 4, ...
+#up to THREADS CPUs, it fails to load if any result differs from that of a
+#single parse of the packet
+THREADS=${THREADS:-`nproc`}
+ITERATIONS=${ITERATIONS:-1000}
+
+echo "running kernel module parser stress tests"
+make -s > /dev/null || exit 1
+START=`dmesg | wc -l`
+insmod panda_stress.ko threads=$THREADS iterations=$ITERATIONS || \
+	echo "panda_stress: wrong results from concurrent parsers"
+rmmod panda_stress 2> /dev/null
+#the speedup over one thread should grow with the number of threads, report
+#runs that are less than half of linear
+dmesg | tail -n +$((START + 1)) | grep "panda_stress: " | \
+	sed -e 's/^\[[^]]*\] //' | tee test-stress.tmp
+awk '/ threads: / { split($0, a, "speedup "); split(a[2], s, ",");
+	if (s[1] * 2 < $2) print "panda_stress: poor scaling with " $2 " threads" }' \
+	test-stress.tmp
+rm -f test-stress.tmp
+make -s clean > /dev/null
@@ -0,0 +1,442 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Multi-CPU stress test for kernel module parsers. The packets of a pcap file
+ * linked into the module are parsed once from a linear buffer to get the
+ * result of each packet, then kthreads on 1, 2, 4, ... up to threads CPUs
+ * parse the packets concurrently from skbs and check each result. Each packet
+ * is in a linear skb and in paged skbs with headers across the linear data
+ * and the frags. The rate of each run is reported to show the scaling.
+ * Loading the module fails if any result is wrong
+ */
+
+#include <linux/crc32.h>
+#include <linux/if_ether.h>
+#include <linux/ipv6.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/udp.h>
+
+#include "panda/parser.h"
+#include "panda/parser_metadata.h"
+
+PANDA_PARSER_KMOD_EXTERN(panda_parser_big_ether);
+
+static unsigned int threads;
+module_param(threads, uint, 0444);
+MODULE_PARM_DESC(threads, "Maximum number of threads (default all CPUs)");
+
+static unsigned int iterations = 1000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Number of times each thread parses the packets");
+
+extern const u8 panda_stress_pcap[], panda_stress_pcap_end[];
+
+#define PANDA_STRESS_PCAP_MAGIC		0xa1b2c3d4
+#define PANDA_STRESS_PCAP_NS_MAGIC	0xa1b23c4d
+
+struct panda_stress_pcap_hdr {
+	u32 magic;
+	u16 version_major;
+	u16 version_minor;
+	s32 thiszone;
+	u32 sigfigs;
+	u32 snaplen;
+	u32 linktype;
+};
+
+struct panda_stress_pcap_rec {
+	u32 ts_sec;
+	u32 ts_usec;
+	u32 caplen;
+	u32 len;
+};
+
+/* Meta data structure for an outer and an inner frame */
+struct panda_stress_metadata {
+	struct panda_metadata panda_data;
+	struct panda_metadata_all frame[2];
+};
+
+/* Layouts of the skbs of a packet, the length of the linear data. The rest
+ * of the packet is in page frags, the first one of PANDA_STRESS_FRAG_LEN
+ * bytes. Lengths that aren't on header boundaries and a short first frag put
+ * headers across the linear data and a frag, and across two frags
+ */
+static const unsigned int panda_stress_headlens[] = { UINT_MAX, 0, 17, 39 };
+
+#define PANDA_STRESS_LAYOUTS	ARRAY_SIZE(panda_stress_headlens)
+#define PANDA_STRESS_FRAG_LEN	29
+
+struct panda_stress_pkt {
+	struct sk_buff *skb[PANDA_STRESS_LAYOUTS];
+	int ret;
+	u32 crc;
+};
+
+static struct panda_stress_pkt *pkts;
+static unsigned int num_pkts;
+
+struct panda_stress_thread {
+	struct task_struct *task;
+	unsigned long errors;
+};
+
+/* Parse a packet from a linear buffer if data is set, else from skb */
+static int panda_stress_parse(const void *data, unsigned int len,
+			      const struct sk_buff *skb, u32 *crc)
+{
+	struct panda_stress_metadata mdata;
+	int ret;
+
+	memset(&mdata, 0, sizeof(mdata));
+
+	if (data)
+		ret = panda_parse(PANDA_PARSER_KMOD_NAME(panda_parser_big_ether),
+				  data, len, &mdata.panda_data, 0, 1);
+	else
+		ret = panda_parse_skb(
+				PANDA_PARSER_KMOD_NAME(panda_parser_big_ether),
+				skb, 0, &mdata.panda_data, 0, 1);
+
+	*crc = crc32_le(~0, (const u8 *)&mdata, sizeof(mdata));
+
+	return ret;
+}
+
+/* Make an skb of a packet with headlen bytes of linear data */
+static struct sk_buff *panda_stress_skb(const u8 *data, unsigned int len,
+					unsigned int headlen)
+{
+	unsigned int off, n, frag_len = PANDA_STRESS_FRAG_LEN;
+	struct sk_buff *skb;
+	struct page *page;
+
+	headlen = min(headlen, len);
+
+	skb = alloc_skb(headlen, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	skb_put_data(skb, data, headlen);
+	skb_reset_mac_header(skb);
+
+	for (off = headlen; off < len; off += n) {
+		n = min(len - off, frag_len);
+		page = skb_shinfo(skb)->nr_frags < MAX_SKB_FRAGS ?
+						alloc_page(GFP_KERNEL) : NULL;
+		if (!page) {
+			kfree_skb(skb);
+			return NULL;
+		}
+		memcpy(page_address(page), data + off, n);
+		skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags, page, 0, n,
+				PAGE_SIZE);
+		frag_len = PAGE_SIZE;
+	}
+
+	return skb;
+}
+
+static void panda_stress_free(void)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < num_pkts; i++)
+		for (j = 0; j < PANDA_STRESS_LAYOUTS; j++)
+			kfree_skb(pkts[i].skb[j]);
+	kfree(pkts);
+}
+
+/* IPv6 packet with a hop-by-hop options header that is longer than the
+ * bounce buffer of the parser (PANDA_KMOD_HDR_LEN, 256 bytes)
+ */
+#define PANDA_STRESS_HOPOPTS_LEN	264
+
+struct panda_stress_long_pkt {
+	struct ethhdr eth;
+	struct ipv6hdr ip6;
+	struct ipv6_opt_hdr hopopts;
+	u8 pad[PANDA_STRESS_HOPOPTS_LEN - sizeof(struct ipv6_opt_hdr)];
+	struct udphdr udp;
+} __packed;
+
+/* A header longer than the bounce buffer is parsed in the linear data, and
+ * stops the parse with PANDA_STOP_LENGTH in the frags
+ */
+static int panda_stress_long_header(void)
+{
+	unsigned int headlen = offsetof(struct panda_stress_long_pkt, hopopts);
+	struct panda_stress_long_pkt *pkt;
+	struct sk_buff *skb;
+	int ret, err = 0;
+	u32 crc, lcrc;
+
+	pkt = kzalloc(sizeof(*pkt), GFP_KERNEL);
+	if (!pkt)
+		return -ENOMEM;
+
+	pkt->eth.h_proto = htons(ETH_P_IPV6);
+	pkt->ip6.version = 6;
+	pkt->ip6.payload_len = htons(sizeof(*pkt) - headlen);
+	pkt->ip6.nexthdr = IPPROTO_HOPOPTS;
+	pkt->ip6.hop_limit = 64;
+	pkt->hopopts.nexthdr = IPPROTO_UDP;
+	pkt->hopopts.hdrlen = PANDA_STRESS_HOPOPTS_LEN / 8 - 1;
+	pkt->udp.source = htons(1234);
+	pkt->udp.dest = htons(5678);
+	pkt->udp.len = htons(sizeof(pkt->udp));
+
+	ret = panda_stress_parse(pkt, sizeof(*pkt), NULL, &lcrc);
+	if (ret == PANDA_STOP_LENGTH)
+		err = -EINVAL;
+
+	/* Options header in the linear data */
+	skb = panda_stress_skb((const u8 *)pkt, sizeof(*pkt),
+			       offsetof(struct panda_stress_long_pkt, udp));
+	if (!skb) {
+		err = -ENOMEM;
+		goto out;
+	}
+	if (panda_stress_parse(NULL, 0, skb, &crc) != ret || crc != lcrc)
+		err = -EINVAL;
+	kfree_skb(skb);
+
+	/* Options header in the frags */
+	skb = panda_stress_skb((const u8 *)pkt, sizeof(*pkt), headlen);
+	if (!skb) {
+		err = -ENOMEM;
+		goto out;
+	}
+	if (panda_stress_parse(NULL, 0, skb, &crc) != PANDA_STOP_LENGTH)
+		err = -EINVAL;
+	kfree_skb(skb);
+
+	if (err == -EINVAL)
+		pr_err("panda_stress: wrong result for a header longer than the bounce buffer\n");
+out:
+	kfree(pkt);
+
+	return err;
+}
+
+/* Make an skb for each packet of the pcap file and parse it once */
+static int panda_stress_load(void)
+{
+	const struct panda_stress_pcap_hdr *hdr = (const void *)panda_stress_pcap;
+	const u8 *end = panda_stress_pcap_end;
+	const struct panda_stress_pcap_rec *rec;
+	const u8 *cp;
+	unsigned int i, j;
+
+	if (panda_stress_pcap + sizeof(*hdr) > end ||
+	    (hdr->magic != PANDA_STRESS_PCAP_MAGIC &&
+	     hdr->magic != PANDA_STRESS_PCAP_NS_MAGIC))
+		goto bad_pcap;
+
+	/* Count the packets, a truncated last packet is left out */
+	for (cp = (const u8 *)(hdr + 1); cp + sizeof(*rec) <= end;
+	     cp += sizeof(*rec) + rec->caplen) {
+		rec = (const void *)cp;
+		if (cp + sizeof(*rec) + rec->caplen > end)
+			break;
+		num_pkts++;
+	}
+	if (!num_pkts)
+		goto bad_pcap;
+
+	pkts = kcalloc(num_pkts, sizeof(*pkts), GFP_KERNEL);
+	if (!pkts)
+		return -ENOMEM;
+
+	for (i = 0, cp = (const u8 *)(hdr + 1); i < num_pkts;
+	     i++, cp += sizeof(*rec) + rec->caplen) {
+		rec = (const void *)cp;
+
+		for (j = 0; j < PANDA_STRESS_LAYOUTS; j++) {
+			pkts[i].skb[j] = panda_stress_skb((const u8 *)(rec + 1),
+					rec->caplen, panda_stress_headlens[j]);
+			if (!pkts[i].skb[j]) {
+				num_pkts = i + 1;
+				panda_stress_free();
+				return -ENOMEM;
+			}
+		}
+
+		pkts[i].ret = panda_stress_parse(rec + 1, rec->caplen, NULL,
+						 &pkts[i].crc);
+	}
+
+	return 0;
+
+bad_pcap:
+	pr_err("panda_stress: bad pcap file\n");
+	return -EINVAL;
+}
+
+static int panda_stress_thread(void *arg)
+{
+	struct panda_stress_thread *t = arg;
+	unsigned int i, j, k;
+	u32 crc;
+	int ret;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < num_pkts; j++) {
+			for (k = 0; k < PANDA_STRESS_LAYOUTS; k++) {
+				ret = panda_stress_parse(NULL, 0,
+							 pkts[j].skb[k], &crc);
+				if (ret != pkts[j].ret || crc != pkts[j].crc)
+					t->errors++;
+			}
+		}
+		cond_resched();
+	}
+
+	/* The task must exist until kthread_stop */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+/* Parse the packets with a kthread on each of the first num CPUs, returns
+ * the number of wrong results
+ */
+static unsigned long panda_stress_run(unsigned int num, u64 *ns)
+{
+	struct panda_stress_thread *t;
+	unsigned long errors = 0;
+	unsigned int i = 0;
+	u64 start;
+	int cpu;
+
+	t = kcalloc(num, sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return ULONG_MAX;
+
+	for_each_online_cpu(cpu) {
+		if (i == num)
+			break;
+		t[i].task = kthread_create(panda_stress_thread, &t[i],
+					   "panda_stress/%d", cpu);
+		if (IS_ERR(t[i].task)) {
+			errors = ULONG_MAX;
+			break;
+		}
+		kthread_bind(t[i].task, cpu);
+		i++;
+	}
+
+	if (errors) {
+		/* Threads that haven't run exit when they are stopped */
+		while (i--)
+			kthread_stop(t[i].task);
+		kfree(t);
+		return errors;
+	}
+
+	start = ktime_get_ns();
+	for (i = 0; i < num; i++)
+		wake_up_process(t[i].task);
+	for (i = 0; i < num; i++) {
+		kthread_stop(t[i].task);
+		errors += t[i].errors;
+	}
+	*ns = ktime_get_ns() - start;
+
+	kfree(t);
+
+	return errors;
+}
+
+static int __init panda_stress_init(void)
+{
+	u64 ns, base_rate = 0, rate, total;
+	unsigned long errors = 0, err;
+	unsigned int num;
+	int ret;
+
+	if (!threads || threads > num_online_cpus())
+		threads = num_online_cpus();
+
+	ret = panda_stress_long_header();
+	if (ret)
+		return ret;
+
+	ret = panda_stress_load();
+	if (ret)
+		return ret;
+
+	pr_info("panda_stress: %u packets in %zu skb layouts, %u iterations\n",
+		num_pkts, PANDA_STRESS_LAYOUTS, iterations);
+
+	for (num = 1;; num = min(num * 2, threads)) {
+		err = panda_stress_run(num, &ns);
+		if (err == ULONG_MAX) {
+			ret = -ENOMEM;
+			break;
+		}
+		errors += err;
+
+		total = (u64)num * iterations * num_pkts * PANDA_STRESS_LAYOUTS;
+		rate = div64_u64(total * NSEC_PER_SEC, ns ? : 1);
+		if (num == 1)
+			base_rate = rate ? : 1;
+
+		/* Speedup over one thread in hundredths */
+		pr_info("panda_stress: %u threads: %llu packets in %llu us, %llu pps, speedup %llu.%02llu, %lu errors\n",
+			num, total, div_u64(ns, NSEC_PER_USEC), rate,
+			div64_u64(rate, base_rate),
+			div64_u64(rate * 100, base_rate) % 100, err);
+
+		if (num == threads)
+			break;
+	}
+
+	panda_stress_free();
+
+	if (!ret && errors)
+		ret = -EINVAL;
+
+	return ret;
+}
+
+static void __exit panda_stress_exit(void)
+{
+}
+
+module_init(panda_stress_init);
+module_exit(panda_stress_exit);
+MODULE_AUTHOR("SiPanda");
+MODULE_LICENSE("GPL");
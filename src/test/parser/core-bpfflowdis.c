@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 by Mojatatu Networks.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* BPF flow dissector core. Runs a BPF_PROG_TYPE_FLOW_DISSECTOR program, such
+ * as one generated by panda-compiler in a .flowdis.h file, on each packet
+ * with BPF_PROG_TEST_RUN and reports the flow keys it sets.
+ *
+ * The program is taken from a path in the BPF filesystem, where it is pinned
+ * with "bpftool prog load OBJ PATH type flow_dissector". The keys are
+ * converted to the output as the kernel converts them to the keys of its
+ * flow dissector, so the output can be compared with that of the flowdis
+ * core for the control, basic, addresses, ports, and flow label keys
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "flowdis/flow_dissector.h"
+#include "test-parser-core.h"
+
+#define BPFFLOWDIS_DEFAULT_PATH "/sys/fs/bpf/panda_flowdis"
+
+struct bpfflowdis_priv {
+	int prog_fd;
+};
+
+static void core_bpfflowdis_help(void)
+{
+	fprintf(stderr,
+		"For the `bpfflowdis' core, the argument is the path of a "
+		"pinned BPF flow\n"
+		"dissector program (default " BPFFLOWDIS_DEFAULT_PATH ").\n\n"
+		"This core runs the program with BPF_PROG_TEST_RUN, pin it "
+		"with\n"
+		"\"bpftool prog load <object> <path> type flow_dissector\".\n");
+}
+
+static void *core_bpfflowdis_init(const char *args)
+{
+	struct bpfflowdis_priv *p;
+	union bpf_attr attr;
+
+	p = calloc(1, sizeof(struct bpfflowdis_priv));
+	if (!p) {
+		fprintf(stderr, "BPF flow dissector init failed\n");
+		exit(-1);
+	}
+
+	memset(&attr, 0, sizeof(attr));
+	attr.pathname = (__u64)(unsigned long)(args && *args ? args :
+					       BPFFLOWDIS_DEFAULT_PATH);
+
+	p->prog_fd = syscall(__NR_bpf, BPF_OBJ_GET, &attr, sizeof(attr));
+	if (p->prog_fd < 0) {
+		fprintf(stderr, "BPF flow dissector %s: %s\n",
+			(char *)(unsigned long)attr.pathname, strerror(errno));
+		exit(-1);
+	}
+
+	return p;
+}
+
+static const char *core_bpfflowdis_process(void *pv, void *data, size_t len,
+					   struct test_parser_out *out,
+					   unsigned int flags, long long *time)
+{
+	struct bpfflowdis_priv *p = pv;
+	struct bpf_flow_keys keys;
+	union bpf_attr attr;
+
+	memset(&keys, 0, sizeof(keys));
+	memset(out, 0, sizeof(*out));
+
+	if (flags & CORE_F_NOCORE)
+		return NULL;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.test.prog_fd = p->prog_fd;
+	attr.test.data_in = (__u64)(unsigned long)data;
+	attr.test.data_size_in = len;
+	attr.test.data_out = (__u64)(unsigned long)&keys;
+	attr.test.data_size_out = sizeof(keys);
+	attr.test.repeat = 1;
+
+	if (syscall(__NR_bpf, BPF_PROG_TEST_RUN, &attr, sizeof(attr)) < 0)
+		return strerror(errno);
+
+	*time += attr.test.duration;
+
+	if (attr.test.retval != BPF_OK)
+		return "BPF flow dissector failed";
+
+	out->k_control.thoff = keys.thoff;
+	if (keys.is_frag)
+		out->k_control.flags |= FLOW_DIS_IS_FRAGMENT;
+	if (keys.is_first_frag)
+		out->k_control.flags |= FLOW_DIS_FIRST_FRAG;
+	if (keys.is_encap)
+		out->k_control.flags |= FLOW_DIS_ENCAPSULATION;
+
+	out->k_basic.n_proto = keys.n_proto;
+	out->k_basic.ip_proto = keys.ip_proto;
+
+	switch (keys.addr_proto) {
+	case ETH_P_IP:
+		out->k_control.addr_type = ADDR_TYPE_IPv4;
+		out->k_ipv4_addrs.src = keys.ipv4_src;
+		out->k_ipv4_addrs.dst = keys.ipv4_dst;
+		break;
+	case ETH_P_IPV6:
+		out->k_control.addr_type = ADDR_TYPE_IPv6;
+		memcpy(out->k_ipv6_addrs.src, keys.ipv6_src,
+		       sizeof(out->k_ipv6_addrs.src));
+		memcpy(out->k_ipv6_addrs.dst, keys.ipv6_dst,
+		       sizeof(out->k_ipv6_addrs.dst));
+		break;
+	}
+
+	out->k_ports.src = keys.sport;
+	out->k_ports.dst = keys.dport;
+	out->k_flow_label.flow_label = ntohl(keys.flow_label);
+
+	return NULL;
+}
+
+static void core_bpfflowdis_done(void *pv)
+{
+	struct bpfflowdis_priv *p = pv;
+
+	close(p->prog_fd);
+	free(p);
+}
+
+CORE_DECL(bpfflowdis)
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 by Mojatatu Networks.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* BPF TC core. Runs a TC BPF program, such as the tc_classifier sample that
+ * uses a parser generated by panda-compiler in a .tc.h file, on each packet
+ * with BPF_PROG_TEST_RUN and reports the flow the program exports in skb->cb
+ * with PANDA_TC_SET_CB.
+ *
+ * The program is taken from a path in the BPF filesystem, where it is pinned
+ * with "bpftool prog load OBJ PATH type classifier". The output has the
+ * control, basic, IPv4 addresses, and ports keys
+ */
+
+#include <errno.h>
+#include <linux/bpf.h>
+#include <linux/pkt_cls.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "panda/parser_types.h"
+#include "test-parser-core.h"
+
+#define BPFTC_DEFAULT_PATH "/sys/fs/bpf/panda_tc"
+
+struct bpftc_priv {
+	int prog_fd;
+};
+
+static void core_bpftc_help(void)
+{
+	fprintf(stderr,
+		"For the `bpftc' core, the argument is the path of a pinned "
+		"TC BPF program\n"
+		"(default " BPFTC_DEFAULT_PATH ").\n\n"
+		"This core runs the program with BPF_PROG_TEST_RUN, pin it "
+		"with\n"
+		"\"bpftool prog load <object> <path> type classifier\".\n");
+}
+
+static void *core_bpftc_init(const char *args)
+{
+	struct bpftc_priv *p;
+	union bpf_attr attr;
+
+	p = calloc(1, sizeof(struct bpftc_priv));
+	if (!p) {
+		fprintf(stderr, "BPF TC init failed\n");
+		exit(-1);
+	}
+
+	memset(&attr, 0, sizeof(attr));
+	attr.pathname = (__u64)(unsigned long)(args && *args ? args :
+					       BPFTC_DEFAULT_PATH);
+
+	p->prog_fd = syscall(__NR_bpf, BPF_OBJ_GET, &attr, sizeof(attr));
+	if (p->prog_fd < 0) {
+		fprintf(stderr, "BPF TC program %s: %s\n",
+			(char *)(unsigned long)attr.pathname, strerror(errno));
+		exit(-1);
+	}
+
+	return p;
+}
+
+static const char *core_bpftc_process(void *pv, void *data, size_t len,
+				      struct test_parser_out *out,
+				      unsigned int flags, long long *time)
+{
+	struct bpftc_priv *p = pv;
+	struct __sk_buff skb;
+	union bpf_attr attr;
+
+	memset(&skb, 0, sizeof(skb));
+	memset(out, 0, sizeof(*out));
+
+	if (flags & CORE_F_NOCORE)
+		return NULL;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.test.prog_fd = p->prog_fd;
+	attr.test.data_in = (__u64)(unsigned long)data;
+	attr.test.data_size_in = len;
+	attr.test.ctx_in = (__u64)(unsigned long)&skb;
+	attr.test.ctx_size_in = sizeof(skb);
+	attr.test.ctx_out = (__u64)(unsigned long)&skb;
+	attr.test.ctx_size_out = sizeof(skb);
+	attr.test.repeat = 1;
+
+	if (syscall(__NR_bpf, BPF_PROG_TEST_RUN, &attr, sizeof(attr)) < 0)
+		return strerror(errno);
+
+	*time += attr.test.duration;
+
+	if (attr.test.retval == TC_ACT_UNSPEC)
+		return "BPF TC program failed";
+
+	/* Flow exported by PANDA_TC_SET_CB */
+	switch (skb.cb[0] & 0xff) {
+	case PANDA_ADDR_TYPE_IPV4:
+		out->k_control.addr_type = ADDR_TYPE_IPv4;
+		out->k_ipv4_addrs.src = skb.cb[2];
+		out->k_ipv4_addrs.dst = skb.cb[3];
+		break;
+	case PANDA_ADDR_TYPE_IPV6:
+		out->k_control.addr_type = ADDR_TYPE_IPv6;
+		break;
+	}
+
+	out->k_basic.ip_proto = (skb.cb[0] >> 8) & 0xff;
+	out->k_control.thoff = skb.cb[0] >> 16;
+	memcpy(&out->k_ports, &skb.cb[1], sizeof(skb.cb[1]));
+
+	return NULL;
+}
+
+static void core_bpftc_done(void *pv)
+{
+	struct bpftc_priv *p = pv;
+
+	close(p->prog_fd);
+	free(p);
+}
+
+CORE_DECL(bpftc)
@@ -37,43 +37,119 @@
 
 struct panda_priv {
 	struct panda_parser_big_metadata_one md;
+	struct panda_parser_big_metadata_outer_inner md_oi;
+	bool outer_inner;
 };
 
 static void core_panda_help(void)
 {
 	fprintf(stderr,
-		"For the `panda' core, arguments must be either not given or "
-		"zero length.\n\n"
+		"For the `panda' core, arguments must be either not given, "
+		"zero length, `numa', or `outer_inner'.\n\n"
 		"This core uses the panda library which impelements the "
-		"engine for the PANDA Parser.\n");
+		"engine for the PANDA Parser. With `numa' the parse graph "
+		"and hash key are replicated to each NUMA node. With "
+		"`outer_inner' packets are parsed with PANDA_F_OUTER_INNER, "
+		"the outermost frame is output as the enc_ fields and the "
+		"summary of each encapsulation layer is output.\n");
 }
 
 static void *core_panda_init(const char *args)
 {
+	unsigned int init_flags = 0;
+	bool outer_inner = false;
 	struct panda_priv *p;
 
 	if (args && *args) {
-		fprintf(stderr, "The panda core takes no arguments.\n");
-		exit(-1);
+		if (!strcmp(args, "numa")) {
+			init_flags |= PANDA_PARSER_INIT_F_NUMA;
+		} else if (!strcmp(args, "outer_inner")) {
+			outer_inner = true;
+		} else {
+			fprintf(stderr, "The panda core only takes the "
+				"argument `numa' or `outer_inner'.\n");
+			exit(-1);
+		}
 	}
 
 	p = calloc(1, sizeof(struct panda_priv));
-	if (!p || panda_parser_init() < 0) {
+	if (!p || panda_parser_init_flags(init_flags) < 0) {
 		fprintf(stderr, "panda_parser_init failed\n");
 		exit(-11);
 	}
+	p->outer_inner = outer_inner;
 
 	return p;
 }
 
+static unsigned char core_panda_addr_type(unsigned int addr_type)
+{
+	switch (addr_type) {
+	case 0:
+		return 0;
+	case PANDA_ADDR_TYPE_IPV4:
+		return ADDR_TYPE_IPv4;
+	case PANDA_ADDR_TYPE_IPV6:
+		return ADDR_TYPE_IPv6;
+	case PANDA_ADDR_TYPE_TIPC:
+		return ADDR_TYPE_TIPC;
+	default:
+		return ADDR_TYPE_OTHER;
+	}
+}
+
+/* Output the outermost frame and the encapsulation summary of a parse with
+ * PANDA_F_OUTER_INNER
+ */
+static void core_panda_outer_inner(struct panda_priv *p,
+				   struct test_parser_out *out)
+{
+	const struct panda_metadata_all *frame = &p->md_oi.frame[0];
+	const struct panda_encap_summary *summary = p->md_oi.encap_summary;
+	unsigned int i, num;
+
+	if (!p->md_oi.panda_data.encaps)
+		return;
+
+	out->k_enc_control.addr_type = core_panda_addr_type(frame->addr_type);
+
+	switch (frame->addr_type) {
+	case PANDA_ADDR_TYPE_IPV4:
+		out->k_enc_ipv4_addrs.src = frame->addrs.v4_addrs[0];
+		out->k_enc_ipv4_addrs.dst = frame->addrs.v4_addrs[1];
+		break;
+	case PANDA_ADDR_TYPE_IPV6:
+		memcpy(out->k_enc_ipv6_addrs.src, frame->addrs.v6_addrs, 16);
+		memcpy(out->k_enc_ipv6_addrs.dst, &frame->addrs.v6_addrs[1],
+		       16);
+		break;
+	}
+
+	num = panda_min(p->md_oi.panda_data.encaps,
+			panda_min(p->md_oi.panda_data.max_encap_summary,
+				  ARRAY_SIZE(out->k_encap)));
+	for (i = 0; i < num; i++) {
+		out->k_encap[i].proto = summary[i].proto_node->name;
+		out->k_encap[i].offset = summary[i].offset;
+		out->k_encap[i].keyid = summary[i].keyid;
+	}
+}
+
 static const char *core_panda_process(void *pv, void *data, size_t len,
 				      struct test_parser_out *out,
 				      unsigned int flags, long long *time)
 {
 	struct panda_priv *p = pv;
+	struct panda_metadata_all *frame = &p->md.frame;
+	struct panda_metadata *panda_data = &p->md.panda_data;
 	int i, err;
 
-	memset(&p->md, 0, sizeof(p->md));
+	if (p->outer_inner) {
+		panda_parser_big_init_outer_inner(&p->md_oi);
+		panda_data = &p->md_oi.panda_data;
+	} else {
+		memset(&p->md, 0, sizeof(p->md));
+	}
 	memset(out, 0, sizeof(*out));
 
 	err = (int)PANDA_OKAY;
@@ -84,11 +160,13 @@ static const char *core_panda_process(void *pv, void *data, size_t len,
 
 		if (flags & CORE_F_DEBUG)
 			pflags |= PANDA_F_DEBUG;
+		if (p->outer_inner)
+			pflags |= PANDA_F_OUTER_INNER;
 
 		clock_gettime(CLOCK_MONOTONIC_RAW, &begin_tp);
 
 		err = panda_parse(panda_parser_big_ether, data, len,
-				  &p->md.panda_data, pflags,
+				  panda_data, pflags,
 				  PANDA_PARSER_BIG_ENCAP_DEPTH);
 		clock_gettime(CLOCK_MONOTONIC_RAW, &now_tp);
 		*time += (now_tp.tv_sec - begin_tp.tv_sec) * 1000000000 +
@@ -123,39 +201,29 @@ static const char *core_panda_process(void *pv, void *data, size_t len,
 		       (unsigned int)p->md.panda_data.frame_size);
 #endif
 
-	switch (p->md.frame.addr_type) {
-	case 0:
-		break;
-	case PANDA_ADDR_TYPE_IPV4:
-		out->k_control.addr_type = ADDR_TYPE_IPv4;
-		break;
-	case PANDA_ADDR_TYPE_IPV6:
-		out->k_control.addr_type = ADDR_TYPE_IPv6;
-		break;
-	case PANDA_ADDR_TYPE_TIPC:
-		out->k_control.addr_type = ADDR_TYPE_TIPC;
-		break;
-	default:
-		out->k_control.addr_type = ADDR_TYPE_OTHER;
-		break;
+	if (p->outer_inner) {
+		core_panda_outer_inner(p, out);
+		frame = &p->md_oi.frame[panda_data->encaps ? 1 : 0];
 	}
 
+	out->k_control.addr_type = core_panda_addr_type(frame->addr_type);
+
 	/* The out struct has no represantation for fragments. We need
 	 * to add it. For now coment out the printing because it seems
 	 * to confuse AFL
 	 */
 
 #if 0
-	if (p->md.frame.is_fragment)
-		printf("PANDA is_fragment %d\n", (int)p->md.frame.is_fragment);
-	if (p->md.frame.first_frag)
-		printf("PANDA first_frag %d\n", (int)p->md.frame.first_frag);
+	if (frame->is_fragment)
+		printf("PANDA is_fragment %d\n", (int)frame->is_fragment);
+	if (frame->first_frag)
+		printf("PANDA first_frag %d\n", (int)frame->first_frag);
 
-	if (p->md.frame.vlan_count)
-		printf("PANDA vlan_count %d\n", (int)p->md.frame.vlan_count);
+	if (frame->vlan_count)
+		printf("PANDA vlan_count %d\n", (int)frame->vlan_count);
 #endif
 
-	if (ARRAY_SIZE(p->md.frame.eth_addrs) !=
+	if (ARRAY_SIZE(frame->eth_addrs) !=
 	    ARRAY_SIZE(out->k_eth_addrs.src) +
 	    ARRAY_SIZE(out->k_eth_addrs.dst)) {
 		fprintf(stderr, "PANDA and output struct disagree on Ethernet "
@@ -163,109 +231,109 @@ static const char *core_panda_process(void *pv, void *data, size_t len,
 		exit(-1);
 	}
 
-	memcpy(out->k_eth_addrs.dst, p->md.frame.eth_addrs,
+	memcpy(out->k_eth_addrs.dst, frame->eth_addrs,
 	       ARRAY_SIZE(out->k_eth_addrs.dst));
 	memcpy(out->k_eth_addrs.src,
-	       &p->md.frame.eth_addrs[ARRAY_SIZE(out->k_eth_addrs.dst)],
+	       &frame->eth_addrs[ARRAY_SIZE(out->k_eth_addrs.dst)],
 	       ARRAY_SIZE(out->k_eth_addrs.src));
 
-	out->k_mpls.mpls_ttl = p->md.frame.mpls.ttl;
-	out->k_mpls.mpls_bos = p->md.frame.mpls.bos;
-	out->k_mpls.mpls_tc = p->md.frame.mpls.tc;
-	out->k_mpls.mpls_label = p->md.frame.mpls.label;
-	out->k_arp.s_ip = p->md.frame.arp.sip;
-	out->k_arp.t_ip = p->md.frame.arp.tip;
-	out->k_arp.op = p->md.frame.arp.op;
-
-	out->k_gre.flags = p->md.frame.gre.flags;
-	out->k_gre.csum = p->md.frame.gre.csum;
-	out->k_gre.keyid = p->md.frame.gre.keyid;
-	out->k_gre.seq = p->md.frame.gre.seq;
-	out->k_gre.routing = p->md.frame.gre.routing;
-
-	out->k_gre_pptp.flags = p->md.frame.gre_pptp.flags;
-	out->k_gre_pptp.length = p->md.frame.gre_pptp.length;
-	out->k_gre_pptp.callid = p->md.frame.gre_pptp.callid;
-	out->k_gre_pptp.seq = p->md.frame.gre_pptp.seq;
-	out->k_gre_pptp.ack = p->md.frame.gre_pptp.ack;
-
-	memcpy(out->k_arp.s_hw, p->md.frame.arp.sha,
-	       panda_min(ARRAY_SIZE(p->md.frame.arp.sha),
+	out->k_mpls.mpls_ttl = frame->mpls.ttl;
+	out->k_mpls.mpls_bos = frame->mpls.bos;
+	out->k_mpls.mpls_tc = frame->mpls.tc;
+	out->k_mpls.mpls_label = frame->mpls.label;
+	out->k_arp.s_ip = frame->arp.sip;
+	out->k_arp.t_ip = frame->arp.tip;
+	out->k_arp.op = frame->arp.op;
+
+	out->k_gre.flags = frame->gre.flags;
+	out->k_gre.csum = frame->gre.csum;
+	out->k_gre.keyid = frame->gre.keyid;
+	out->k_gre.seq = frame->gre.seq;
+	out->k_gre.routing = frame->gre.routing;
+
+	out->k_gre_pptp.flags = frame->gre_pptp.flags;
+	out->k_gre_pptp.length = frame->gre_pptp.length;
+	out->k_gre_pptp.callid = frame->gre_pptp.callid;
+	out->k_gre_pptp.seq = frame->gre_pptp.seq;
+	out->k_gre_pptp.ack = frame->gre_pptp.ack;
+
+	memcpy(out->k_arp.s_hw, frame->arp.sha,
+	       panda_min(ARRAY_SIZE(frame->arp.sha),
 			 ARRAY_SIZE(out->k_arp.s_hw)));
-	memcpy(out->k_arp.t_hw, p->md.frame.arp.tha,
-	       panda_min(ARRAY_SIZE(p->md.frame.arp.tha),
+	memcpy(out->k_arp.t_hw, frame->arp.tha,
+	       panda_min(ARRAY_SIZE(frame->arp.tha),
 			 ARRAY_SIZE(out->k_arp.t_hw)));
 
-	out->k_tcp_opt.mss = p->md.frame.tcp_options.mss;
-	out->k_tcp_opt.ws = p->md.frame.tcp_options.window_scaling;
-	out->k_tcp_opt.ts_val = p->md.frame.tcp_options.timestamp.value;
-	out->k_tcp_opt.ts_echo = p->md.frame.tcp_options.timestamp.echo;
+	out->k_tcp_opt.mss = frame->tcp_options.mss;
+	out->k_tcp_opt.ws = frame->tcp_options.window_scaling;
+	out->k_tcp_opt.ts_val = frame->tcp_options.timestamp.value;
+	out->k_tcp_opt.ts_echo = frame->tcp_options.timestamp.echo;
 
 	/* We assume that the first SACK element with both edges zero
 	 * indicates the end of the SACK list.
 	 */
-	for (i = 0; (i < ARRAY_SIZE(p->md.frame.tcp_options.sack)) &&
+	for (i = 0; (i < ARRAY_SIZE(frame->tcp_options.sack)) &&
 	     (i < ARRAY_SIZE(out->k_tcp_opt.sack)) &&
-	     (p->md.frame.tcp_options.sack[i].left_edge ||
-	      p->md.frame.tcp_options.sack[i].right_edge); i++) {
+	     (frame->tcp_options.sack[i].left_edge ||
+	      frame->tcp_options.sack[i].right_edge); i++) {
 		out->k_tcp_opt.sack[i].l =
-		    p->md.frame.tcp_options.sack[i].left_edge;
+		    frame->tcp_options.sack[i].left_edge;
 		out->k_tcp_opt.sack[i].r =
-		    p->md.frame.tcp_options.sack[i].right_edge;
+		    frame->tcp_options.sack[i].right_edge;
 	}
 
 	if (i < ARRAY_SIZE(out->k_tcp_opt.sack)) {
 		out->k_tcp_opt.sack[i].l = 0;
 		out->k_tcp_opt.sack[i].r = 0;
 	}
-	out->k_basic.n_proto = p->md.frame.eth_proto;
-	out->k_basic.ip_proto = p->md.frame.ip_proto;
-	out->k_flow_label.flow_label = p->md.frame.flow_label;
+	out->k_basic.n_proto = frame->eth_proto;
+	out->k_basic.ip_proto = frame->ip_proto;
+	out->k_flow_label.flow_label = frame->flow_label;
 
-	switch (p->md.frame.vlan_count) {
+	switch (frame->vlan_count) {
 	case 0:
 		break;
 	case 1:
-		out->k_vlan.vlan_id = p->md.frame.vlan[0].id;
-		out->k_vlan.vlan_dei = p->md.frame.vlan[0].dei;
-		out->k_vlan.vlan_priority = p->md.frame.vlan[0].priority;
-		out->k_vlan.vlan_tpid = p->md.frame.vlan[0].tpid;
+		out->k_vlan.vlan_id = frame->vlan[0].id;
+		out->k_vlan.vlan_dei = frame->vlan[0].dei;
+		out->k_vlan.vlan_priority = frame->vlan[0].priority;
+		out->k_vlan.vlan_tpid = frame->vlan[0].tpid;
 		break;
 	default:
 #if 0
-		printf("PANDA vlan_count %d\n", (int)p->md.frame.vlan_count);
+		printf("PANDA vlan_count %d\n", (int)frame->vlan_count);
 #endif
 		break;
 	}
 
 #if 0
-	if (p->md.frame.keyid)
-	printf("PANDA keyid %08lx\n", (unsigned long)p->md.frame.keyid);
+	if (frame->keyid)
+	printf("PANDA keyid %08lx\n", (unsigned long)frame->keyid);
 #endif
 
-	out->k_ports.src = p->md.frame.src_port;
-	out->k_ports.dst = p->md.frame.dst_port;
-	out->k_icmp.type = p->md.frame.icmp.type;
-	out->k_icmp.code = p->md.frame.icmp.code;
-	out->k_icmp.id = p->md.frame.icmp.id;
+	out->k_ports.src = frame->src_port;
+	out->k_ports.dst = frame->dst_port;
+	out->k_icmp.type = frame->icmp.type;
+	out->k_icmp.code = frame->icmp.code;
+	out->k_icmp.id = frame->icmp.id;
 
-	switch (p->md.frame.addr_type) {
+	switch (frame->addr_type) {
 	case PANDA_ADDR_TYPE_IPV4:
-		out->k_ipv4_addrs.src = p->md.frame.addrs.v4_addrs[0];
-		out->k_ipv4_addrs.dst = p->md.frame.addrs.v4_addrs[1];
+		out->k_ipv4_addrs.src = frame->addrs.v4_addrs[0];
+		out->k_ipv4_addrs.dst = frame->addrs.v4_addrs[1];
 		break;
 	case PANDA_ADDR_TYPE_IPV6:
-		memcpy(out->k_ipv6_addrs.src, p->md.frame.addrs.v6_addrs, 16);
-		memcpy(out->k_ipv6_addrs.dst, &p->md.frame.addrs.v6_addrs[1],
+		memcpy(out->k_ipv6_addrs.src, frame->addrs.v6_addrs, 16);
+		memcpy(out->k_ipv6_addrs.dst, &frame->addrs.v6_addrs[1],
 		       16);
 		break;
 	case PANDA_ADDR_TYPE_TIPC:
-		out->k_tipc.key = p->md.frame.addrs.tipckey;
+		out->k_tipc.key = frame->addrs.tipckey;
 		break;
 	}
 
 	if (flags & CORE_F_HASH)
-		out->k_hash.hash = panda_parser_big_hash_frame(&p->md.frame);
+		out->k_hash.hash = panda_parser_big_hash_frame(frame);
 
 	return 0;
 }
@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 by Mojatatu Networks.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "test-parser-core.h"
+
+/* PANDA C++ parser
+ *
+ * The parser of the pandabc core compiled by panda-compiler to a header only
+ * C++ parser (core-pandabc.hpp, see panda/parser.hpp). The metadata frame
+ * below only has the fields that are output, the extractors skip the other
+ * common metadata (offsets, fragment flags, keyid).
+ *
+ * The output is the same as for `pandabc,scalar'.
+ */
+
+#include "core-pandabc.hpp"
+
+#define PANDACXX_ENCAP_DEPTH	4
+
+struct pandacxx_frame {
+	__be16 eth_proto;
+	__u8 eth_addrs[2 * ETH_ALEN];
+	__u8 addr_type;
+	__u8 ip_proto;
+	__u32 flow_label;
+	union {
+		__be32 v4_addrs[2];
+		struct in6_addr v6_addrs[2];
+		__be32 tipckey;
+	} addrs;
+	union {
+		__be32 ports;
+		struct {
+			__be16 src_port;
+			__be16 dst_port;
+		};
+	};
+	struct {
+		__u8 type;
+		__u8 code;
+		__u16 id;
+	} icmp;
+	struct {
+		__u32 ttl: 8;
+		__u32 bos: 1;
+		__u32 tc: 3;
+		__u32 label: 20;
+	} mpls;
+	struct {
+		__u32 sip;
+		__u32 tip;
+		__u8 op;
+		__u8 sha[ETH_ALEN];
+		__u8 tha[ETH_ALEN];
+	} arp;
+	__u8 vlan_count : 2;
+	struct {
+		__u16 id:12,
+		      dei:1,
+		      priority:3;
+		__be16 tpid;
+	} vlan[2];
+};
+
+struct pandacxx_priv {
+	panda::metadata<struct pandacxx_frame> md;
+};
+
+static void core_pandacxx_help(void)
+{
+	fprintf(stderr,
+		"For the `pandacxx' core, arguments must be either not given "
+		"or zero length.\n\n"
+		"This core uses the compiler tool to compile the parser of "
+		"the `pandabc' core to a header only C++ parser.\n");
+}
+
+static void *core_pandacxx_init(const char *args)
+{
+	struct pandacxx_priv *p;
+
+	if (args && *args) {
+		fprintf(stderr, "The pandacxx core takes no arguments.\n");
+		exit(-1);
+	}
+
+	p = (struct pandacxx_priv *)calloc(1, sizeof(struct pandacxx_priv));
+	if (!p) {
+		fprintf(stderr, "pandacxx_init failed\n");
+		exit(-11);
+	}
+
+	return p;
+}
+
+static const char *core_pandacxx_process(void *pv, void *data, size_t len,
+					 struct test_parser_out *out,
+					 unsigned int flags, long long *time)
+{
+	struct pandacxx_priv *p = (struct pandacxx_priv *)pv;
+	struct pandacxx_frame *frame = &p->md.frame[0];
+	int err;
+
+	memset(out, 0, sizeof(*out));
+	memset((void *)&p->md, 0, sizeof(p->md));
+
+	err = (int)PANDA_OKAY;
+
+	if (!(flags & CORE_F_NOCORE)) {
+		struct timespec begin_tp, now_tp;
+
+		clock_gettime(CLOCK_MONOTONIC, &begin_tp);
+		err = panda::parse<my_panda_parser_bc_ether_cxx>(data, len,
+				p->md, 0, PANDACXX_ENCAP_DEPTH);
+		clock_gettime(CLOCK_MONOTONIC, &now_tp);
+		*time += (now_tp.tv_sec - begin_tp.tv_sec) * 1000000000 +
+			 (now_tp.tv_nsec - begin_tp.tv_nsec);
+	}
+
+	switch (err) {
+	case PANDA_OKAY:
+		break;
+	case PANDA_STOP_OKAY:
+		break;
+	case PANDA_STOP_FAIL:
+		return "PANDA: parse failed";
+	case PANDA_STOP_LENGTH:
+		return "PANDA: STOP_LENGTH";
+	case PANDA_STOP_UNKNOWN_PROTO:
+		return "PANDA: STOP_UNKNOWN_PROTO";
+	case PANDA_STOP_ENCAP_DEPTH:
+		return "PANDA: STOP_ENCAP_DEPTH";
+	}
+
+	switch (frame->addr_type) {
+	case 0:
+		break;
+	case PANDA_ADDR_TYPE_IPV4:
+		out->k_control.addr_type = ADDR_TYPE_IPv4;
+		break;
+	case PANDA_ADDR_TYPE_IPV6:
+		out->k_control.addr_type = ADDR_TYPE_IPv6;
+		break;
+	case PANDA_ADDR_TYPE_TIPC:
+		out->k_control.addr_type = ADDR_TYPE_TIPC;
+		break;
+	default:
+		out->k_control.addr_type = ADDR_TYPE_OTHER;
+		break;
+	}
+
+	memcpy(out->k_eth_addrs.dst, frame->eth_addrs,
+	       sizeof(out->k_eth_addrs.dst));
+	memcpy(out->k_eth_addrs.src,
+	       &frame->eth_addrs[sizeof(out->k_eth_addrs.dst)],
+	       sizeof(out->k_eth_addrs.src));
+
+	out->k_mpls.mpls_ttl = frame->mpls.ttl;
+	out->k_mpls.mpls_bos = frame->mpls.bos;
+	out->k_mpls.mpls_tc = frame->mpls.tc;
+	out->k_mpls.mpls_label = frame->mpls.label;
+	out->k_arp.s_ip = frame->arp.sip;
+	out->k_arp.t_ip = frame->arp.tip;
+	out->k_arp.op = frame->arp.op;
+	memcpy(out->k_arp.s_hw, frame->arp.sha, sizeof(out->k_arp.s_hw));
+	memcpy(out->k_arp.t_hw, frame->arp.tha, sizeof(out->k_arp.t_hw));
+
+	out->k_basic.n_proto = frame->eth_proto;
+	out->k_basic.ip_proto = frame->ip_proto;
+	out->k_flow_label.flow_label = frame->flow_label;
+
+	if (frame->vlan_count == 1) {
+		out->k_vlan.vlan_id = frame->vlan[0].id;
+		out->k_vlan.vlan_dei = frame->vlan[0].dei;
+		out->k_vlan.vlan_priority = frame->vlan[0].priority;
+		out->k_vlan.vlan_tpid = frame->vlan[0].tpid;
+	}
+
+	out->k_ports.src = frame->src_port;
+	out->k_ports.dst = frame->dst_port;
+	out->k_icmp.type = frame->icmp.type;
+	out->k_icmp.code = frame->icmp.code;
+	out->k_icmp.id = frame->icmp.id;
+
+	switch (frame->addr_type) {
+	case PANDA_ADDR_TYPE_IPV4:
+		out->k_ipv4_addrs.src = frame->addrs.v4_addrs[0];
+		out->k_ipv4_addrs.dst = frame->addrs.v4_addrs[1];
+		break;
+	case PANDA_ADDR_TYPE_IPV6:
+		memcpy(out->k_ipv6_addrs.src, &frame->addrs.v6_addrs[0], 16);
+		memcpy(out->k_ipv6_addrs.dst, &frame->addrs.v6_addrs[1], 16);
+		break;
+	case PANDA_ADDR_TYPE_TIPC:
+		out->k_tipc.key = frame->addrs.tipckey;
+		break;
+	}
+
+	return 0;
+}
+
+static void core_pandacxx_done(void *pv)
+{
+	free(pv);
+}
+
+extern "C" {
+CORE_DECL(pandacxx)
+}
@@ -509,4 +509,9 @@ static void core_pandaopt_notcpopts_done(void *pv)
 	free(pv);
 }
 
+#ifdef CORE_ALIAS
+/* Compiled as the core of another panda-compiler dispatch mode */
+CORE_DECL_ALIAS(pandaopt_notcpopts, CORE_ALIAS)
+#else
 CORE_DECL(pandaopt_notcpopts)
+#endif
@@ -25,12 +25,14 @@
  */
 
 #include <getopt.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include "imethod.h"
 #include "omethod.h"
+#include "panda/cpu_dispatch.h"
 #include "panda/utility.h"
 #include "test-parser-out.h"
 #include "test-parser-core.h"
@@ -46,6 +48,7 @@ unsigned char pktdata[MAXPKT] __defaligned();
 ssize_t pktlen;
 static int repeat = 1;
 static unsigned int coreflags;
+static bool show_cpu_level;
 static struct imethod *imethod;
 static void *imarg;
 static struct omethod *omethod;
@@ -309,6 +312,9 @@ static void show_help(void)
 		"-H      Compute/print metadata hashes.\n"
 		"-v      show computation cost\n"
 		"-d      enable debug messages\n"
+		"-L      Print the CPU level selected for PANDA library "
+		"kernels\n"
+		"        (to stderr).\n"
 		"-n N    Repeat each input packet a total of N times "
 		"(default 1)\n"
 		"-i NAME[,ARGS]\n"
@@ -352,13 +358,13 @@ static void show_help(void)
 
 static void usage(char *progname)
 {
-	fprintf(stderr, "Usage: %s [-NHvd] [-n <number>] [-i <type>[,<arg>]] "
+	fprintf(stderr, "Usage: %s [-NHvdL] [-n <number>] [-i <type>[,<arg>]] "
 		"[-o <type>[,<arg>]] [-c <core>]\n", progname);
 
 	exit(-1);
 }
 
-#define ARGS "n:NHi:o:c:hvd"
+#define ARGS "n:NHi:o:c:hvdL"
 
 static struct option long_options[] = {
 	{ "number", required_argument, 0, 'n' },
@@ -369,6 +375,7 @@ static struct option long_options[] = {
 	{ "core", required_argument, 0, 'c' },
 	{ "verbose", no_argument, 0, 'v' },
 	{ "debug", no_argument, 0, 'd' },
+	{ "cpu-level", no_argument, 0, 'L' },
 	{ NULL, 0, 0, 0 },
 };
 
@@ -395,6 +402,9 @@ static void handleargs(int argc, char **argv)
 		case 'd':
 			coreflags |= CORE_F_DEBUG;
 			break;
+		case 'L':
+			show_cpu_level = true;
+			break;
 		case 'i':
 			set_imethod(optarg);
 			break;
@@ -422,6 +432,13 @@ int main(int argc, char **argv)
 
 	handleargs(argc, argv);
 
+	/* Cores that use the PANDA library select the level when they are
+	 * initialized
+	 */
+	if (show_cpu_level)
+		fprintf(stderr, "cpu level: %s\n",
+			panda_cpu_level_name(panda_cpu_level_get()));
+
 	while (readpkt()) {
 		int i;
 
@@ -490,6 +490,16 @@ static void dump_k_hash(struct out_text_priv *p, const char *tag,
 		printf("%s: hash=%08llx\n", tag, k->hash);
 }
 
+static void dump_k_encap(struct out_text_priv *p, const char *tag,
+			 const struct test_parser_out_encap *k, size_t num)
+{
+	size_t i;
+
+	for (i = 0; i < num && k[i].proto; i++)
+		printf("%s[%zu]: proto=%s offset=%u keyid=%08x\n", tag, i,
+		       k[i].proto, k[i].offset, ntohl(k[i].keyid));
+}
+
 static void out_text_help(void)
 {
 	fprintf(stderr,
@@ -622,6 +632,7 @@ static void out_text_post(void *pv, const char *status,
 	dump_k_meta(p, "meta", &out->k_meta);
 	dump_k_ct(p, "ct", &out->k_ct);
 	dump_k_hash(p, "hash", &out->k_hash);
+	dump_k_encap(p, "encap", out->k_encap, ARRAY_SIZE(out->k_encap));
 }
 
 static void out_text_done(void *pv)
@@ -7,7 +7,14 @@ ROOT=../../../data/pcaps
 PCAPS="icmp_ipv4 icmp_ipv6 tcp_ipv4 tcp_ipv6 6in4 6to4 ipip vlan_icmp"
 
 # cores
-CORES="panda pandaopt pandaopt_notcpopts flowdis parselite"
+CORES="panda pandaopt pandaopt_notcpopts pandaopt_goto pandaopt_musttail pandaopt_compact flowdis parselite"
+
+# Code size of the compiler dispatch modes: call, goto, and musttail (goto
+# if the C compiler doesn't support musttail), and of compact code
+echo "code size of optimized parser dispatch modes"
+echo "------------------------------------"
+size core-pandaopt_notcpopts.p.o core-pandaopt_goto.p.o \
+	core-pandaopt_musttail.p.o core-pandaopt_compact.p.o
 for p in $PCAPS
 do
 	f=$ROOT/$p.pcap
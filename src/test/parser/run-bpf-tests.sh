@@ -0,0 +1,71 @@
+#! /bin/sh
+#BPF program tests, these need root, clang, and bpftool. The samples are
+#pinned and run with BPF_PROG_TEST_RUN by the bpfflowdis and bpftc cores.
+#The AF_XDP test also needs libxdp and tcpreplay
+
+#The keys of the flow dissector sample must be the same as those of the
+#flowdis core
+SAMPLE=../../../samples/xdp/flow_dissector
+PIN=/sys/fs/bpf/panda_flowdis_test
+KEYS='^(-------- |control: |basic: |ipv4_addrs: |ipv6_addrs: |ports: |flow_label: )'
+
+echo "running BPF flow dissector validation tests"
+make -s -C $SAMPLE INCDIR=$PWD/../../include \
+	PANDACOMPILER=$PWD/../../tools/compiler > /dev/null || exit 1
+rm -f $PIN
+bpftool prog load $SAMPLE/flow_dissector.bpf.o $PIN type flow_dissector || \
+	exit 1
+for pcap in test-in.pcap ../../../data/pcaps/*.pcap; do
+	./test_parser -i pcap,$pcap -c flowdis -o text | grep -E "$KEYS" \
+		> test-bpfflowdis.tmp
+	./test_parser -i pcap,$pcap -c bpfflowdis,$PIN -o text | \
+		diff -u --label $pcap test-bpfflowdis.tmp -
+done
+rm -f $PIN test-bpfflowdis.tmp
+make -s -C $SAMPLE clean
+
+#The flow of the TC classifier sample must be the same as that of the panda
+#core
+SAMPLE=../../../samples/xdp/tc_classifier
+PIN=/sys/fs/bpf/panda_tc_test
+KEYS='^(-------- |ipv4_addrs: |ports: )'
+
+echo "running BPF TC validation tests"
+make -s -C $SAMPLE INCDIR=$PWD/../../include \
+	PANDACOMPILER=$PWD/../../tools/compiler > /dev/null || exit 1
+rm -f $PIN
+bpftool prog load $SAMPLE/tc_classifier.bpf.o $PIN type classifier || exit 1
+./test_parser -i pcap,test-in.pcap -c panda -o text | grep -E "$KEYS" \
+	> test-bpftc.tmp
+./test_parser -i pcap,test-in.pcap -c bpftc,$PIN -o text | grep -E "$KEYS" | \
+	diff -u test-bpftc.tmp -
+rm -f $PIN test-bpftc.tmp
+make -s -C $SAMPLE clean
+
+#The AF_XDP sample receives the packets of test-in.pcap sent over a veth
+#pair, with generic XDP and in copy mode
+SAMPLE=../../../samples/afxdp/afxdp-app
+NUM=`./test_parser -i pcap,test-in.pcap -c panda -o text | grep -c '^-------- '`
+
+echo "running AF_XDP validation tests"
+make -s -C $SAMPLE INCDIR=$PWD/../../include \
+	PANDACOMPILER=$PWD/../../tools/compiler \
+	LDFLAGS="-L$PWD/../../lib/panda -L$PWD/../../lib/siphash" \
+	> /dev/null || exit 1
+ip link add pandaxdp0 type veth peer name pandaxdp1 || exit 1
+for dev in pandaxdp0 pandaxdp1; do
+	#no packets from the stack
+	sysctl -q -w net.ipv6.conf.$dev.disable_ipv6=1
+	ip link set $dev up
+done
+LD_LIBRARY_PATH=$PWD/../../lib/panda:$PWD/../../lib/siphash \
+	timeout 10 $SAMPLE/panda_afxdp_app -S -c $NUM pandaxdp1 \
+	> test-afxdp.tmp &
+sleep 1
+tcpreplay -q -i pandaxdp0 test-in.pcap > /dev/null
+wait
+grep -q "^$NUM packets," test-afxdp.tmp || \
+	echo "AF_XDP: `cat test-afxdp.tmp`, expected $NUM packets"
+ip link del pandaxdp0
+rm -f test-afxdp.tmp
+make -s -C $SAMPLE clean
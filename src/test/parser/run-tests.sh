@@ -1,4 +1,12 @@
 #! /bin/sh
+#compile a BPF program of a sample with the parser generated in test-bpf.tmp,
+#skipped if there is no clang. Programs are loaded by run-bpf-tests.sh
+bpf_compile() {
+	command -v clang > /dev/null || return 0
+	clang -O2 -g -target bpf -I. -Itest-bpf.tmp -I../../include \
+		-c -o /dev/null $1 || echo "panda-compiler: $1 doesn't compile"
+}
+
 echo "running flowdisector kernel parser basic validation tests"
 #flowdis tests
 ./test_parser -i raw,test-in.raw -c flowdis -o text | diff -u test-out-flowdis.raw -
@@ -25,3 +33,198 @@ echo "running panda optimized parser basic validation tests"
 	diff -u test-out-panda.tcpdump -
 ./test_parser -i fuzz -c pandaopt -o text < test-in.fuzz | diff -u \
 	test-out-panda.fuzz -
+
+echo "running panda lean parser basic validation tests"
+#panda lean tests, TCP options are not consumed
+./test_parser -i raw,test-in.raw -c pandalean -o text | \
+	diff -u test-out-pandalean.raw -
+./test_parser -i pcap,test-in.pcap -c pandalean -o text | \
+	diff -u test-out-pandalean.pcap -
+./test_parser -i tcpdump,test-in.tcpdump -c pandalean -o text | \
+	diff -u test-out-pandalean.tcpdump -
+./test_parser -i fuzz -c pandalean -o text < test-in.fuzz | diff -u \
+	test-out-pandalean.fuzz -
+
+echo "running panda parser outer/inner frame tests"
+#GRE with a key within GRE with and without a key, IP in IP, and no
+#encapsulation parsed with PANDA_F_OUTER_INNER. The innermost frame is output
+#as usual, the outermost one as the enc_ fields, then the encapsulation summary
+./test_parser -i raw,test-in-encap.raw -c panda,outer_inner -o text | \
+	diff -u test-out-encap.raw -
+
+echo "running panda parser unknown protocol tests"
+#GRE with an unknown protocol, with and without a key, then GRE over IPv4.
+#Flag-fields nodes return PANDA_STOP_UNKNOWN_PROTO for an unknown protocol in
+#the generic and the compiled parsers
+for core in panda pandaopt; do
+	./test_parser -i raw,test-in-gre.raw -c $core -o err | \
+		diff -u test-out-gre.err -
+done
+
+echo "running panda optimized parser dispatch mode validation tests"
+#panda tests for the node to node dispatch modes of the compiler and compact
+#code
+for core in pandaopt_goto pandaopt_musttail pandaopt_compact; do
+	./test_parser -i pcap,test-in.pcap -c pandaopt_notcpopts -o text \
+		> test-dispatch.tmp
+	./test_parser -i pcap,test-in.pcap -c $core -o text | \
+		diff -u test-dispatch.tmp -
+	./test_parser -i fuzz -c pandaopt_notcpopts -o text < test-in.fuzz \
+		> test-dispatch.tmp
+	./test_parser -i fuzz -c $core -o text < test-in.fuzz | \
+		diff -u test-dispatch.tmp -
+done
+rm -f test-dispatch.tmp
+
+echo "running panda bytecode parser validation tests"
+#panda tests for the bytecode interpreter, the core also checks each packet
+#against panda_parse of the same parser
+./test_parser -i pcap,test-in.pcap -c pandabc,scalar -o text > test-bc.tmp
+./test_parser -i pcap,test-in.pcap -c pandabc -o text | diff -u test-bc.tmp -
+./test_parser -i fuzz -c pandabc,scalar -o text < test-in.fuzz > test-bc.tmp
+./test_parser -i fuzz -c pandabc -o text < test-in.fuzz | \
+	diff -u test-bc.tmp -
+rm -f test-bc.tmp
+./test_bc || echo "panda_bc_load: unsafe bytecode programs accepted"
+
+echo "running panda flow key tests"
+./test_flowkey || echo "panda_flow_key: flow key tests failed"
+
+echo "running panda C++ parser validation tests"
+#panda tests for the header only C++ parser, the pandacxx core runs the parser
+#of the pandabc core so the output is the same as for its scalar parser
+./test_parser -i pcap,test-in.pcap -c pandabc,scalar -o text > test-cxx.tmp
+./test_parser -i pcap,test-in.pcap -c pandacxx -o text | diff -u test-cxx.tmp -
+./test_parser -i fuzz -c pandabc,scalar -o text < test-in.fuzz > test-cxx.tmp
+./test_parser -i fuzz -c pandacxx -o text < test-in.fuzz | \
+	diff -u test-cxx.tmp -
+rm -f test-cxx.tmp
+
+echo "running panda parser CPU level validation tests"
+#panda tests for each CPU level, levels not supported by the CPU are lowered
+#so the level actually selected is printed. test-in-nops.raw has a run of
+#TCP NOP options long enough to be scanned by the dispatched pad kernel.
+#The hashes must match the baseline ones, and test-in-ipv6.raw has IPv6
+#flows in both directions whose addresses are ordered for the hash
+./test_parser -H -i pcap,test-in.pcap -c panda -o text > test-hash.tmp
+for level in baseline v2 v3 v4; do
+	selected=$(PANDA_CPU_LEVEL=$level ./test_parser -L -N -c panda \
+		-i raw,test-in-ipv6.raw -o null 2>&1)
+	echo "CPU level $level: ${selected#cpu level: } selected"
+	PANDA_CPU_LEVEL=$level ./test_parser -H -i raw,test-in-ipv6.raw \
+		-c panda -o text | diff -u test-out-ipv6.raw -
+	PANDA_CPU_LEVEL=$level ./test_parser -H -i pcap,test-in.pcap \
+		-c panda -o text | diff -u test-hash.tmp -
+	for core in panda pandaopt; do
+		PANDA_CPU_LEVEL=$level ./test_parser -i pcap,test-in.pcap \
+			-c $core -o text | diff -u test-out-panda.pcap -
+		PANDA_CPU_LEVEL=$level ./test_parser -i fuzz -c $core \
+			-o text < test-in.fuzz | diff -u test-out-panda.fuzz -
+		PANDA_CPU_LEVEL=$level ./test_parser -i raw,test-in-nops.raw \
+			-c $core -o text | diff -u test-out-nops.raw -
+	done
+done
+rm -f test-hash.tmp
+
+echo "running panda parser NUMA replication validation tests"
+#panda tests with the parse graph and hash key replicated per NUMA node
+./test_parser -i pcap,test-in.pcap -c panda,numa -o text | \
+	diff -u test-out-panda.pcap -
+./test_parser -i fuzz -c panda,numa -o text < test-in.fuzz | diff -u \
+	test-out-panda.fuzz -
+./test_parser -H -i pcap,test-in.pcap -c panda -o text > test-hash.tmp
+./test_parser -H -i pcap,test-in.pcap -c panda,numa -o text | \
+	diff -u test-hash.tmp -
+rm -f test-hash.tmp
+
+echo "running panda-compiler cost report tests"
+#panda-compiler worst case bounds, the build fails if a budget is exceeded
+../../tools/compiler/panda-compiler --report=test-cost.tmp \
+	--budget=nodes=1000,bytes=1518,encaps=4 core-pandabc.c > /dev/null
+grep -q "max nodes visited" test-cost.tmp || \
+	echo "panda-compiler: no cost report"
+if ../../tools/compiler/panda-compiler --budget=nodes=8 core-pandabc.c \
+	> /dev/null 2>&1; then
+	echo "panda-compiler: nodes budget not enforced"
+fi
+rm -f test-cost.tmp
+
+echo "running panda-compiler XDP loop tests"
+#panda-compiler --xdp-loop splits an XDP parser in tail called programs of up
+#to the budget of estimated insns, print the estimated size of each program
+mkdir -p test-bpf.tmp
+../../tools/compiler/panda-compiler --xdp-loop=400 \
+	../../../samples/xdp/flow_tracker_tlvs/parser.c \
+	test-bpf.tmp/parser.xdp.h | grep "^XDP program"
+grep -q "bpf_loop(PANDA_XDP_MAX_TLVS" test-bpf.tmp/parser.xdp.h || \
+	echo "panda-compiler: TLVs not parsed with bpf_loop"
+grep -q "PANDA_XDP_NUM_PROGS_panda_parser_simple_tuple 2" \
+	test-bpf.tmp/parser.xdp.h || echo "panda-compiler: XDP parser not split"
+bpf_compile ../../../samples/xdp/flow_tracker_tlvs/flow_tracker.xdp.c
+rm -rf test-bpf.tmp
+
+echo "running panda-compiler flow dissector tests"
+#panda-compiler generates a BPF flow dissector program for a parser, the
+#program is run against the flowdis core by run-bpf-tests.sh
+mkdir -p test-bpf.tmp
+../../tools/compiler/panda-compiler \
+	../../../samples/xdp/flow_dissector/parser.c \
+	test-bpf.tmp/parser.flowdis.h > /dev/null
+grep -q 'SEC("flow_dissector")' test-bpf.tmp/parser.flowdis.h || \
+	echo "panda-compiler: no flow dissector program"
+bpf_compile ../../../samples/xdp/flow_dissector/flow_dissector.bpf.c
+rm -rf test-bpf.tmp
+
+echo "running panda-compiler TC tests"
+#panda-compiler generates a TC BPF parser, the tc_classifier sample is run
+#against the panda core by run-bpf-tests.sh
+mkdir -p test-bpf.tmp
+../../tools/compiler/panda-compiler \
+	../../../samples/xdp/tc_classifier/parser.c test-bpf.tmp/parser.tc.h \
+	> /dev/null
+grep -q "bpf_skb_load_bytes" test-bpf.tmp/parser.tc.h || \
+	echo "panda-compiler: no TC parser"
+bpf_compile ../../../samples/xdp/tc_classifier/tc_classifier.bpf.c
+rm -rf test-bpf.tmp
+
+echo "running panda-compiler AF_XDP tests"
+#panda-compiler generates the receive function of the AF_XDP sample, the
+#sample is run over a veth pair by run-bpf-tests.sh
+../../tools/compiler/panda-compiler \
+	../../../samples/afxdp/afxdp-app/main.c test-afxdp.afxdp.c > /dev/null
+grep -q "panda_afxdp_rx_parser(" test-afxdp.afxdp.c || \
+	echo "panda-compiler: no AF_XDP receive function"
+#the sample is userspace code, compiled if the libxdp headers are installed
+if echo "#include <xdp/xsk.h>" | ${CC:-cc} -E - > /dev/null 2>&1; then
+	${CC:-cc} -O2 -I../../include -c -o /dev/null test-afxdp.afxdp.c || \
+		echo "panda-compiler: AF_XDP sample doesn't compile"
+fi
+rm -f test-afxdp.afxdp.c
+
+echo "running panda-compiler cache tests"
+#panda-compiler outputs taken from the cache, or rendered with cached parse
+#functions, must be the same as compiled ones
+rm -rf test-cache.tmp
+../../tools/compiler/panda-compiler core-pandaopt_notcpopts.c \
+	test-nocache.p.c > /dev/null
+for i in 1 2 3; do
+	../../tools/compiler/panda-compiler --cache-dir=test-cache.tmp \
+		core-pandaopt_notcpopts.c test-cache.p.c > /dev/null
+	diff -u test-nocache.p.c test-cache.p.c
+	#drop the saved outputs but keep the rendered parse functions
+	[ $i = 2 ] && rm -rf test-cache.tmp/????????????????
+done
+rm -rf test-cache.tmp test-cache.p.c test-nocache.p.c
+
+echo "running panda-compiler harness tests"
+#the harness generated by panda-compiler --harness checks the compiled big
+#parser against the generic parser on synthesized packets and on the test
+#packets, its path profile is input for --hot-profile
+./test_harness -r 10 -p test-harness.tmp > /dev/null || \
+	echo "panda-compiler: harness parsers disagree on synthesized packets"
+./test_harness -r 10 test-in.pcap > /dev/null || \
+	echo "panda-compiler: harness parsers disagree on test packets"
+../../tools/compiler/panda-compiler --hot-profile=test-harness.tmp \
+	../../lib/panda/parsers/parser_big.c test-harness-hot.p.c > /dev/null || \
+	echo "panda-compiler: harness profile not accepted"
+rm -f test-harness.tmp test-harness-hot.p.c
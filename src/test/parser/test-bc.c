@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Tests of loading bytecode programs. Images of malformed or unsafe
+ * programs must be rejected by panda_bc_load, and programs that loop must
+ * not hang the interpreter. Exits with a non-zero status if a test fails
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "panda/bytecode.h"
+#include "panda/parser.h"
+#include "panda/parser_metadata.h"
+
+/* Meta data structure for just one frame */
+struct test_bc_metadata {
+	struct panda_metadata panda_data;
+	struct panda_metadata_all frame;
+};
+
+static int failures;
+
+#define TEST_BC_CHECK(COND, NAME) do {					\
+	if (!(COND)) {							\
+		fprintf(stderr, "test_bc: %s failed\n", NAME);		\
+		failures++;						\
+	}								\
+} while (0)
+
+/* Save a program to an image and load it again */
+static struct panda_bc_prog *test_bc_reload(const struct panda_bc_prog *prog)
+{
+	size_t size = panda_bc_image_size(prog);
+	struct panda_bc_prog *loaded;
+	void *image;
+
+	image = malloc(size);
+	if (!image || panda_bc_save(prog, image, size) != size) {
+		fprintf(stderr, "test_bc: panda_bc_save failed\n");
+		exit(-1);
+	}
+
+	loaded = panda_bc_load(image, size);
+	free(image);
+
+	return loaded;
+}
+
+/* A valid program: Ethernet, then IPv6 addresses */
+static const struct panda_bc_insn test_bc_good_insns[] = {
+	PANDA_BC_NODE(sizeof(struct ethhdr)),
+	PANDA_BC_EXTRACT(ether),
+	PANDA_BC_NEXT(0, 3),
+	PANDA_BC_NODE(sizeof(struct ipv6hdr)),
+	PANDA_BC_EXTRACT(ipv6_addrs),
+	PANDA_BC_RET(PANDA_STOP_OKAY),
+};
+
+static PANDA_BC_PROG(test_bc_good, test_bc_good_insns);
+
+/* The IPv6 extractor reads 40 bytes of a zero length node */
+static const struct panda_bc_insn test_bc_extract_insns[] = {
+	PANDA_BC_NODE(0),
+	PANDA_BC_EXTRACT(ipv6_addrs),
+	PANDA_BC_RET(PANDA_STOP_OKAY),
+};
+
+static PANDA_BC_PROG(test_bc_extract, test_bc_extract_insns);
+
+/* An overlay node that goes to itself */
+static const struct panda_bc_insn test_bc_loop_insns[] = {
+	PANDA_BC_NODE(0),
+	PANDA_BC_NEXT(1, 0),
+};
+
+static PANDA_BC_PROG(test_bc_loop, test_bc_loop_insns);
+
+/* A load past the minimum length of the node */
+static const struct panda_bc_insn test_bc_load_insns[] = {
+	PANDA_BC_NODE(2),
+	PANDA_BC_LD(4, 0),
+	PANDA_BC_RET(PANDA_STOP_OKAY),
+};
+
+static PANDA_BC_PROG(test_bc_load, test_bc_load_insns);
+
+int main(int argc, char *argv[])
+{
+	struct test_bc_metadata md;
+	struct panda_bc_prog *prog;
+	unsigned char pkt[64];
+
+	memset(pkt, 0, sizeof(pkt));
+
+	prog = test_bc_reload(&test_bc_good);
+	TEST_BC_CHECK(prog, "load of a valid program");
+	if (prog) {
+		memset(&md, 0, sizeof(md));
+		TEST_BC_CHECK(panda_bc_parse(prog, pkt, sizeof(pkt),
+					     &md.panda_data, 0, 1) ==
+						PANDA_STOP_OKAY &&
+			      md.frame.addr_type == PANDA_ADDR_TYPE_IPV6,
+			      "parse of a valid program");
+		panda_bc_free(prog);
+	}
+
+	prog = test_bc_reload(&test_bc_extract);
+	TEST_BC_CHECK(!prog, "extract past the node length rejected");
+	panda_bc_free(prog);
+
+	prog = test_bc_reload(&test_bc_load);
+	TEST_BC_CHECK(!prog, "load past the node length rejected");
+	panda_bc_free(prog);
+
+	/* The loop is well formed, the interpreter stops it */
+	prog = test_bc_reload(&test_bc_loop);
+	TEST_BC_CHECK(prog, "load of a looping program");
+	if (prog) {
+		memset(&md, 0, sizeof(md));
+		TEST_BC_CHECK(panda_bc_parse(prog, pkt, 1, &md.panda_data, 0,
+					     1) == PANDA_STOP_FAIL,
+			      "looping program stopped");
+		panda_bc_free(prog);
+	}
+
+	return failures ? 1 : 0;
+}
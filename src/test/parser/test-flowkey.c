@@ -0,0 +1,248 @@
+// SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+/*
+ * Copyright (c) 2020, 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Tests of the compact flow key helpers and of the simple hash parser that
+ * hashes the flow key. Exits with a non-zero status if a test fails
+ */
+
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "panda/parser.h"
+#include "panda/parser_metadata.h"
+#include "panda/parsers/parser_simple_hash.h"
+
+static int failures;
+
+#define TEST_FLOWKEY_CHECK(COND, NAME) do {				\
+	if (!(COND)) {							\
+		fprintf(stderr, "test_flowkey: %s failed\n", NAME);	\
+		failures++;						\
+	}								\
+} while (0)
+
+/* Make IPv4 and IPv6 flow keys, the key is zeroed first as by the parser */
+static void test_flowkey_ipv4(struct panda_flow_key *key, __u32 saddr,
+			      __u32 daddr, __u16 sport, __u16 dport)
+{
+	memset(key, 0, sizeof(*key));
+	key->addr_type = PANDA_ADDR_TYPE_IPV4;
+	key->ip_proto = IPPROTO_TCP;
+	key->port16[0] = htons(sport);
+	key->port16[1] = htons(dport);
+	key->v4.saddr = htonl(saddr);
+	key->v4.daddr = htonl(daddr);
+}
+
+static void test_flowkey_ipv6(struct panda_flow_key *key, __u32 saddr,
+			      __u32 daddr, __u16 sport, __u16 dport)
+{
+	memset(key, 0, sizeof(*key));
+	key->addr_type = PANDA_ADDR_TYPE_IPV6;
+	key->ip_proto = IPPROTO_TCP;
+	key->port16[0] = htons(sport);
+	key->port16[1] = htons(dport);
+	key->v6.saddr.s6_addr32[0] = htonl(0x20010db8);
+	key->v6.saddr.s6_addr32[3] = htonl(saddr);
+	key->v6.daddr.s6_addr32[0] = htonl(0x20010db8);
+	key->v6.daddr.s6_addr32[3] = htonl(daddr);
+}
+
+/* Check that both directions of a flow have the same key and hash after
+ * consistentify
+ */
+static void test_flowkey_both_ways(struct panda_flow_key *key1,
+				   struct panda_flow_key *key2,
+				   const char *name)
+{
+	TEST_FLOWKEY_CHECK(!panda_flow_key_equal(key1, key2), name);
+
+	panda_flow_key_consistentify(key1);
+	panda_flow_key_consistentify(key2);
+
+	TEST_FLOWKEY_CHECK(panda_flow_key_equal(key1, key2), name);
+	TEST_FLOWKEY_CHECK(panda_flow_key_hash(key1) ==
+			   panda_flow_key_hash(key2), name);
+}
+
+/* Frame with a flow key for the flow key metadata templates */
+struct test_flowkey_frame {
+	PANDA_METADATA_flow_key;
+};
+
+PANDA_METADATA_TEMP_flow_key_ipv6(test_flowkey_ipv6_metadata,
+				  test_flowkey_frame)
+
+/* Make an Ethernet, IPv6, and TCP packet for the simple hash parser */
+#define TEST_FLOWKEY_PKT_LEN (sizeof(struct ethhdr) +			\
+			      sizeof(struct ipv6hdr) + 20)
+
+static void test_flowkey_pkt(unsigned char *pkt, __u32 flow_label,
+			     __u16 sport, __u16 dport)
+{
+	struct ipv6hdr ip6;
+	struct ethhdr eth;
+	__be16 ports[2];
+
+	memset(&eth, 0, sizeof(eth));
+	eth.h_proto = htons(ETH_P_IPV6);
+
+	memset(&ip6, 0, sizeof(ip6));
+	ip6.version = 6;
+	ip6.flow_lbl[0] = (flow_label >> 16) & 0xf;
+	ip6.flow_lbl[1] = flow_label >> 8;
+	ip6.flow_lbl[2] = flow_label;
+	ip6.payload_len = htons(20);
+	ip6.nexthdr = IPPROTO_TCP;
+	ip6.hop_limit = 64;
+	ip6.saddr.s6_addr32[3] = htonl(1);
+	ip6.daddr.s6_addr32[3] = htonl(2);
+
+	ports[0] = htons(sport);
+	ports[1] = htons(dport);
+
+	memset(pkt, 0, TEST_FLOWKEY_PKT_LEN);
+	memcpy(pkt, &eth, sizeof(eth));
+	memcpy(pkt + sizeof(eth), &ip6, sizeof(ip6));
+	memcpy(pkt + sizeof(eth) + sizeof(ip6), ports, sizeof(ports));
+}
+
+int main(int argc, char *argv[])
+{
+	struct panda_flow_key key1, key2;
+	struct test_flowkey_frame frame;
+	struct panda_ctrl_data ctrl;
+	struct ipv6hdr ip6;
+	unsigned char pkt[TEST_FLOWKEY_PKT_LEN];
+	__u32 hash1, hash2;
+
+	if (panda_parser_init()) {
+		fprintf(stderr, "test_flowkey: panda_parser_init failed\n");
+		exit(-1);
+	}
+
+	/* Significant lengths */
+	test_flowkey_ipv4(&key1, 1, 2, 80, 1024);
+	TEST_FLOWKEY_CHECK(panda_flow_key_len(&key1) == 16, "IPv4 length");
+	panda_flow_key_set_keyid(&key1, htonl(7));
+	TEST_FLOWKEY_CHECK(panda_flow_key_len(&key1) == 20 &&
+			   key1.v4.keyid == htonl(7), "IPv4 keyid length");
+
+	test_flowkey_ipv6(&key1, 1, 2, 80, 1024);
+	TEST_FLOWKEY_CHECK(panda_flow_key_len(&key1) == 40, "IPv6 length");
+	panda_flow_key_set_keyid(&key1, htonl(7));
+	TEST_FLOWKEY_CHECK(panda_flow_key_len(&key1) == 44 &&
+			   key1.v6.keyid == htonl(7), "IPv6 keyid length");
+
+	memset(&key1, 0, sizeof(key1));
+	panda_flow_key_set_keyid(&key1, htonl(7));
+	TEST_FLOWKEY_CHECK(panda_flow_key_len(&key1) == 8 && !key1.flags,
+			   "no address length");
+
+	/* Equality */
+	test_flowkey_ipv4(&key1, 1, 2, 80, 1024);
+	test_flowkey_ipv4(&key2, 1, 2, 80, 1024);
+	TEST_FLOWKEY_CHECK(panda_flow_key_equal(&key1, &key2), "equal keys");
+	key2.port16[1] = htons(1025);
+	TEST_FLOWKEY_CHECK(!panda_flow_key_equal(&key1, &key2),
+			   "different ports");
+	test_flowkey_ipv4(&key2, 1, 2, 80, 1024);
+	panda_flow_key_set_keyid(&key2, 0);
+	TEST_FLOWKEY_CHECK(!panda_flow_key_equal(&key1, &key2),
+			   "keyid versus no keyid");
+	test_flowkey_ipv6(&key2, 1, 2, 80, 1024);
+	TEST_FLOWKEY_CHECK(!panda_flow_key_equal(&key1, &key2),
+			   "IPv4 versus IPv6");
+
+	/* Consistentify makes both directions the same */
+	test_flowkey_ipv4(&key1, 1, 2, 80, 1024);
+	test_flowkey_ipv4(&key2, 2, 1, 1024, 80);
+	test_flowkey_both_ways(&key1, &key2, "IPv4 consistentify");
+	TEST_FLOWKEY_CHECK(key1.v4.saddr == htonl(1) &&
+			   key1.port16[0] == htons(80),
+			   "IPv4 consistentify keeps ordered key");
+
+	test_flowkey_ipv4(&key1, 1, 1, 80, 1024);
+	test_flowkey_ipv4(&key2, 1, 1, 1024, 80);
+	test_flowkey_both_ways(&key1, &key2, "IPv4 consistentify same addrs");
+
+	test_flowkey_ipv6(&key1, 1, 2, 80, 1024);
+	test_flowkey_ipv6(&key2, 2, 1, 1024, 80);
+	test_flowkey_both_ways(&key1, &key2, "IPv6 consistentify");
+
+	test_flowkey_ipv6(&key1, 1, 1, 80, 1024);
+	test_flowkey_ipv6(&key2, 1, 1, 1024, 80);
+	test_flowkey_both_ways(&key1, &key2, "IPv6 consistentify same addrs");
+
+	/* An IPv6 key written into a reused frame that held an IPv4 key with
+	 * a key id must not keep the key id
+	 */
+	memset(&ctrl, 0, sizeof(ctrl));
+	memset(&ip6, 0, sizeof(ip6));
+	ip6.nexthdr = IPPROTO_UDP;
+
+	test_flowkey_ipv4(&frame.flow_key, 1, 2, 80, 1024);
+	frame.flow_key.v6.keyid = htonl(9);
+	panda_flow_key_set_keyid(&frame.flow_key, htonl(7));
+	test_flowkey_ipv6_metadata(&ip6, &frame, ctrl);
+	TEST_FLOWKEY_CHECK(panda_flow_key_len(&frame.flow_key) == 40 &&
+			   !frame.flow_key.v6.keyid, "reused frame clears keyid");
+
+	/* The hash only covers the significant bytes */
+	test_flowkey_ipv4(&key1, 1, 2, 80, 1024);
+	hash1 = panda_flow_key_hash(&key1);
+	key1.v4.keyid = htonl(7);
+	TEST_FLOWKEY_CHECK(panda_flow_key_hash(&key1) == hash1,
+			   "hash ignores unused keyid");
+
+	/* Simple hash parser: without a flow label the ports are hashed, with
+	 * one parsing stops at IPv6 and the flow label is hashed
+	 */
+	test_flowkey_pkt(pkt, 0, 80, 1024);
+	hash1 = panda_parser_hash_hash_ether(pkt, sizeof(pkt));
+	test_flowkey_pkt(pkt, 0, 80, 1025);
+	hash2 = panda_parser_hash_hash_ether(pkt, sizeof(pkt));
+	TEST_FLOWKEY_CHECK(hash1 && hash2 && hash1 != hash2,
+			   "simple hash of ports");
+
+	test_flowkey_pkt(pkt, 1, 80, 1024);
+	hash1 = panda_parser_hash_hash_ether(pkt, sizeof(pkt));
+	test_flowkey_pkt(pkt, 1, 80, 1025);
+	hash2 = panda_parser_hash_hash_ether(pkt, sizeof(pkt));
+	TEST_FLOWKEY_CHECK(hash1 && hash1 == hash2,
+			   "simple hash stops at flow label");
+	test_flowkey_pkt(pkt, 2, 80, 1024);
+	hash2 = panda_parser_hash_hash_ether(pkt, sizeof(pkt));
+	TEST_FLOWKEY_CHECK(hash2 && hash1 != hash2,
+			   "simple hash of flow label");
+
+	return failures ? 1 : 0;
+}
@@ -85,6 +85,21 @@ struct test_parser_core {
 		&core_##name##_done,				\
 	};
 
+/* Declare a core named alias that uses the functions of core name. Used
+ * when the same core source is compiled more than once, for instance with
+ * different panda-compiler options
+ */
+#define __CORE_DECL_ALIAS(name, alias)				\
+	struct test_parser_core test_parser_core_##alias = {	\
+		#alias,						\
+		&core_##name##_help,				\
+		&core_##name##_init,				\
+		&core_##name##_process,				\
+		&core_##name##_done,				\
+	};
+
+#define CORE_DECL_ALIAS(name, alias) __CORE_DECL_ALIAS(name, alias)
+
 extern struct test_parser_core *cores[];
 
 #endif
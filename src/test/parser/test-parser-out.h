@@ -169,6 +169,13 @@ struct test_parser_out_gre_pptp {
 	__be32 ack;
 };
 
+/* Summary of an encapsulation layer, proto is the name of the protocol node */
+struct test_parser_out_encap {
+	const char *proto;
+	unsigned int offset;
+	__be32 keyid;
+};
+
 struct test_parser_out {
 	struct test_parser_out_control k_control;
 	struct test_parser_out_basic k_basic;
@@ -201,6 +208,7 @@ struct test_parser_out {
 	struct test_parser_out_hash k_hash;
 	struct test_parser_out_gre k_gre;
 	struct test_parser_out_gre_pptp k_gre_pptp;
+	struct test_parser_out_encap k_encap[4];
 };
 
 #endif
@@ -0,0 +1,294 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PANDAGEN_BYTECODE_H
+#define PANDAGEN_BYTECODE_H
+
+/* Bytecode programs
+ *
+ * Compile the parse graph of each parser into a program for the bytecode
+ * interpreter in the PANDA library (see panda/bytecode.h). The semantics
+ * of the protocol nodes, that is their length and next protocol
+ * functions, are described with the primitive instructions in
+ * pandagen/proto_props.h. A node that uses a protocol node not described
+ * there, a handler, TLVs, flag-fields, or a metadata function that isn't a
+ * canned template for struct panda_metadata_all can't be compiled to
+ * bytecode.
+ *
+ * Instruction operands are C expressions (e.g. sizeof(struct iphdr) or the
+ * protocol table values) so the program is emitted as C, the C compiler
+ * resolves the constants, and the resulting image can then be saved and
+ * loaded without the compiler.
+ */
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "pandagen/graph.h"
+#include "pandagen/lean.h"
+#include "pandagen/proto_props.h"
+
+namespace pandagen
+{
+
+/* Canned metadata templates that are built in extractors of the
+ * interpreter (enum panda_bc_extract)
+ */
+static const std::vector<std::string> bc_extractors = {
+	"ether", "ether_off", "ether_noaddrs", "ipv4", "ipv4_addrs", "ipv6",
+	"ipv6_addrs", "ports", "ports_off", "ip_overlay", "ipv6_eh",
+	"ipv6_frag", "ipv6_frag_noinfo", "arp_rarp", "vlan_8021AD",
+	"vlan_8021Q", "icmp", "mpls", "tipc",
+};
+
+/* A line of a program: the instruction as C, the parse node it starts
+ * (NODE instructions), and the parse node it goes to (CASE and NEXT)
+ */
+struct bc_line {
+	std::string insn, node, target;
+};
+
+struct bc_program {
+	std::string name;
+	std::vector<bc_line> lines;
+};
+
+inline bool bc_is_null(std::string const &s)
+{
+	return s.empty() || s == "NULL";
+}
+
+/* Compile the parse graph of each root. The program of a root is named
+ * after the parser with suffix. Returns false on error
+ */
+template <typename G> bool
+bc_compile(G const &g, std::vector<root_t> const &roots,
+	   std::vector<metadata_extractor> const &extractors,
+	   std::vector<bc_program> &programs,
+	   std::string const &suffix = "_bc")
+{
+	auto const &protos = proto_props_table();
+
+	for (auto &&r : roots) {
+		std::vector<std::vector<bc_line>> bodies;
+		std::map<std::string, size_t> index, start;
+		std::vector<std::string> order;
+		bc_program prog{ std::get<0>(r) + suffix };
+		size_t pc = 0;
+
+		/* Nodes in breadth first order from the root */
+		order.push_back(g[std::get<1>(r)].name);
+		index[order[0]] = 0;
+		for (size_t i = 0; i < order.size(); i++) {
+			auto v = *search_vertex_by_name(g, order[i]);
+			std::vector<std::string> next;
+
+			for (auto &&e : boost::make_iterator_range(
+							out_edges(v, g)))
+				next.push_back(g[target(e, g)].name);
+			if (!g[v].wildcard_proto_node.empty())
+				next.push_back(g[v].wildcard_proto_node);
+
+			for (auto &&n : next) {
+				if (index.count(n))
+					continue;
+				if (!search_vertex_by_name(g, n)) {
+					std::cerr << "Unknown node " << n <<
+						" in " << order[i] << std::endl;
+					return false;
+				}
+				index[n] = order.size();
+				order.push_back(n);
+			}
+		}
+
+		/* Node bodies with node names as targets, resolved once the
+		 * start of each node is known
+		 */
+		for (auto &&name : order) {
+			auto const &v = g[*search_vertex_by_name(g, name)];
+			auto p = protos.find(v.parser_node);
+			std::vector<bc_line> body;
+
+			if (p == protos.end() || p->second.ops) {
+				std::cerr << "Protocol node " << v.parser_node <<
+					" of " << name << " is not supported "
+					"by the bytecode backend" << std::endl;
+				return false;
+			}
+			if (!bc_is_null(v.handler) || !v.tlv_table.empty() ||
+			    !v.flag_fields_table.empty()) {
+				std::cerr << "Node " << name << " has a "
+					"handler, TLVs, or flag-fields, not "
+					"supported by the bytecode backend" <<
+					std::endl;
+				return false;
+			}
+
+			auto const &proto = p->second;
+			auto emit_ops = [&](std::vector<bc_op> const &ops) {
+				for (auto &&op : ops) {
+					if (op.op == "LD")
+						body.push_back({ "PANDA_BC_LD(" +
+							std::to_string(op.size) +
+							", " + op.k + ")" });
+					else if (op.skip)
+						/* Resolved below */
+						body.push_back({ "PANDA_BC_" +
+							op.op + "(" + op.k +
+							", @" + std::to_string(
+							body.size() + 1 +
+							op.skip) + ")" });
+					else
+						body.push_back({ "PANDA_BC_" +
+							op.op + "(" + op.k +
+							")" });
+				}
+			};
+			std::string overlay = proto.overlay ? "1" : "0";
+
+			body.push_back({ "PANDA_BC_NODE(" + proto.min_len + ")",
+					 name });
+			if (!proto.len.empty()) {
+				emit_ops(proto.len);
+				body.push_back({ "PANDA_BC_LEN()" });
+			}
+
+			if (!bc_is_null(v.metadata)) {
+				auto e = std::find_if(extractors.begin(),
+						      extractors.end(),
+						      [&](auto const &e) {
+					return e.name == v.metadata;
+				});
+
+				if (e == extractors.end() ||
+				    !contains(bc_extractors, e->temp) ||
+				    e->args.size() < 2 ||
+				    e->args[1] != "panda_metadata_all") {
+					std::cerr << "Metadata function " <<
+						v.metadata << " of " << name <<
+						" is not a built in extractor "
+						"of the bytecode backend" <<
+						std::endl;
+					return false;
+				}
+				body.push_back({ "PANDA_BC_EXTRACT(" + e->temp +
+						 ")" });
+			}
+
+			if (v.table.empty() && v.wildcard_proto_node.empty()) {
+				/* Leaf parse node */
+				body.push_back({ "PANDA_BC_RET("
+						 "PANDA_STOP_OKAY)" });
+				bodies.push_back(std::move(body));
+				continue;
+			}
+
+			if (proto.encap)
+				body.push_back({ "PANDA_BC_ENCAP()" });
+
+			auto edges = out_edges(*search_vertex_by_name(g, name),
+					       g);
+			size_t num_edges = std::distance(edges.first,
+							 edges.second);
+
+			if (proto.has_next && num_edges) {
+				emit_ops(proto.next);
+				body.push_back({ "PANDA_BC_TABLE(" +
+						 std::to_string(num_edges) +
+						 ")" });
+				for (auto &&e : boost::make_iterator_range(
+								edges))
+					body.push_back({ "PANDA_BC_CASE(" +
+						g[e].macro_name + ", " +
+						overlay + ", %" +
+						g[target(e, g)].name + ")" });
+			}
+
+			if (!v.wildcard_proto_node.empty())
+				body.push_back({ "PANDA_BC_NEXT(" + overlay +
+						 ", %" + v.wildcard_proto_node +
+						 ")" });
+			else
+				body.push_back({ "PANDA_BC_RET(" +
+					(v.unknown_proto_ret.empty() ?
+					 "PANDA_STOP_UNKNOWN_PROTO" :
+					 v.unknown_proto_ret) + ")" });
+
+			bodies.push_back(std::move(body));
+		}
+
+		for (size_t i = 0; i < order.size(); i++) {
+			start[order[i]] = pc;
+			pc += bodies[i].size();
+		}
+
+		if (pc > 1 << 16) {
+			std::cerr << "Bytecode program of " << std::get<0>(r) <<
+				" has too many instructions" << std::endl;
+			return false;
+		}
+
+		/* Resolve targets: "@N" is instruction N of the node and
+		 * "%NAME" is the start of node NAME
+		 */
+		for (size_t i = 0; i < order.size(); i++) {
+			for (auto &&l : bodies[i]) {
+				auto at = l.insn.find('@');
+				auto pct = l.insn.find('%');
+
+				if (at != std::string::npos) {
+					auto n = std::stoul(l.insn.substr(at + 1));
+
+					l.insn = l.insn.substr(0, at) +
+						std::to_string(start[order[i]] +
+							       n) + ")";
+				} else if (pct != std::string::npos) {
+					auto t = l.insn.substr(pct + 1,
+						l.insn.size() - pct - 2);
+
+					l.insn = l.insn.substr(0, pct) +
+						std::to_string(start[t]) + ")";
+					l.target = t;
+				}
+				prog.lines.push_back(l);
+			}
+		}
+
+		std::cout << "Bytecode program " << prog.name << ": " <<
+			order.size() << " nodes, " << pc << " instructions" <<
+			std::endl;
+		programs.push_back(std::move(prog));
+	}
+
+	return true;
+}
+
+} // namespace pandagen
+
+#endif /* PANDAGEN_BYTECODE_H */
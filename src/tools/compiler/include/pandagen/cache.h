@@ -0,0 +1,198 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PANDAGEN_CACHE_H
+#define PANDAGEN_CACHE_H
+
+/* Compilation cache
+ *
+ * With --cache-dir the outputs of a compilation are saved in a directory
+ * under a key that hashes the preprocessed token stream of the source, the
+ * templates, the compiler itself, and the options. If the key is found the
+ * saved outputs are copied and the graph passes and template rendering are
+ * skipped. Whitespace tokens are not hashed, so reformatting the source
+ * doesn't change the key.
+ *
+ * On a miss, the rendered parse function of each node is also looked up in
+ * a fragment cache of the output file, keyed by the node and the nodes it
+ * dispatches to (see generate_parser_function in template.cpp), so only the
+ * parse functions of the nodes affected by a change are rendered again.
+ */
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+namespace pandagen
+{
+
+/* Bump when the layout of the cache changes */
+static const unsigned int cache_version = 1;
+
+/* 64-bit FNV-1a */
+struct cache_hasher {
+	std::uint64_t h = 0xcbf29ce484222325ull;
+
+	void add(char const *data, size_t len)
+	{
+		for (size_t i = 0; i < len; i++) {
+			h ^= static_cast<unsigned char>(data[i]);
+			h *= 0x100000001b3ull;
+		}
+	}
+
+	/* Strings are separated so that "ab","c" and "a","bc" differ */
+	void add(std::string const &s)
+	{
+		add(s.data(), s.size());
+		add("", 1);
+	}
+
+	bool add_file(std::filesystem::path const &path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		char buf[65536];
+
+		if (!file)
+			return false;
+
+		while (file.read(buf, sizeof(buf)) || file.gcount())
+			add(buf, file.gcount());
+		add("", 1);
+
+		return true;
+	}
+
+	std::string hex() const
+	{
+		std::ostringstream os;
+
+		os << std::hex << std::setw(16) << std::setfill('0') << h;
+
+		return os.str();
+	}
+};
+
+/* Create the cache directory if needed */
+inline bool cache_init(std::string const &dir)
+{
+	std::error_code ec;
+
+	std::filesystem::create_directories(dir, ec);
+	if (ec) {
+		std::cerr << "Failed to create cache directory " << dir <<
+			": " << ec.message() << "\n";
+		return false;
+	}
+
+	return true;
+}
+
+/* Saved outputs of key are in dir/key/N for the Nth output */
+inline std::filesystem::path cache_entry(std::string const &dir,
+					 std::string const &key)
+{
+	return std::filesystem::path{ dir } / key;
+}
+
+/* Copy the saved outputs of key. Returns false if key isn't cached */
+inline bool cache_fetch(std::string const &dir, std::string const &key,
+			std::vector<std::string> const &outputs)
+{
+	auto entry = cache_entry(dir, key);
+	std::error_code ec;
+
+	for (size_t i = 0; i < outputs.size(); i++)
+		if (!std::filesystem::is_regular_file(
+				entry / std::to_string(i), ec))
+			return false;
+
+	for (size_t i = 0; i < outputs.size(); i++) {
+		std::filesystem::copy_file(entry / std::to_string(i),
+			outputs[i],
+			std::filesystem::copy_options::overwrite_existing, ec);
+		if (ec) {
+			std::cerr << "Failed to copy cached " << outputs[i] <<
+				": " << ec.message() << "\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Save the outputs under key. The entry is written to a temporary
+ * directory and renamed so that concurrent compilations don't see a
+ * partial entry. Failures only print a warning
+ */
+inline void cache_store(std::string const &dir, std::string const &key,
+			std::vector<std::string> const &outputs)
+{
+	auto entry = cache_entry(dir, key);
+	auto tmp = entry;
+	std::error_code ec;
+
+	tmp += ".tmp" + std::to_string(::getpid());
+	std::filesystem::create_directories(tmp, ec);
+	for (size_t i = 0; !ec && i < outputs.size(); i++)
+		std::filesystem::copy_file(outputs[i],
+			tmp / std::to_string(i),
+			std::filesystem::copy_options::overwrite_existing, ec);
+	if (!ec)
+		std::filesystem::rename(tmp, entry, ec);
+	if (ec) {
+		if (!std::filesystem::exists(entry))
+			std::cerr << "Failed to save " << entry <<
+				" to the cache: " << ec.message() << "\n";
+		std::filesystem::remove_all(tmp, ec);
+	}
+}
+
+/* Fragment cache of an output file */
+inline std::string cache_fragments(std::string const &dir,
+				   std::string const &source,
+				   std::string const &output)
+{
+	cache_hasher h;
+
+	h.add(source);
+	h.add(std::filesystem::path{ output }.filename().string());
+
+	return (std::filesystem::path{ dir } / ("fragments-" + h.hex() +
+						".json")).string();
+}
+
+} // namespace pandagen
+
+#endif /* PANDAGEN_CACHE_H */
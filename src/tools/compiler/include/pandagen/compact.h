@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PANDAGEN_COMPACT_H
+#define PANDAGEN_COMPACT_H
+
+/* Compact code
+ *
+ * The parse functions of the generated parser are static inline, so the C
+ * compiler may inline a chain of nodes into every entry function and into
+ * every parent of a node. With many roots, as in the big parser, the same
+ * node bodies end up duplicated many times. With --compact each parse node
+ * has one parse function, without the variant for a fused length check,
+ * that is shared by all its callers in all the parsers of the file. Only
+ * nodes whose estimated code size is at most a threshold may still be
+ * inlined, the others are noinline.
+ *
+ * The size of a node is the estimate of its instructions, see
+ * pandagen/estimate.h.
+ */
+
+#include <iostream>
+#include <string>
+
+#include "pandagen/estimate.h"
+#include "pandagen/graph.h"
+
+namespace pandagen
+{
+
+/* Default threshold of --compact */
+static const unsigned int compact_inline_default = 64;
+
+/* Mark the parse functions that may be inlined */
+template <typename G> void compact_mark(G &g, unsigned int threshold)
+{
+	size_t funcs = 0, inlined = 0;
+
+	for (auto &&v : boost::make_iterator_range(vertices(g))) {
+		if (g[v].pruned || !g[v].merged_into.empty())
+			continue;
+
+		g[v].compact_inline = estimate_insns(g, v) <= threshold;
+		inlined += g[v].compact_inline;
+		funcs++;
+	}
+
+	std::cout << "Compact code: " << inlined << " of " << funcs <<
+		" parse functions may be inlined" << std::endl;
+}
+
+} // namespace pandagen
+
+#endif /* PANDAGEN_COMPACT_H */
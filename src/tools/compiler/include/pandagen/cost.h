@@ -0,0 +1,407 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PANDAGEN_COST_H
+#define PANDAGEN_COST_H
+
+/* Static cost model and worst case bounds
+ *
+ * For each parser compute upper bounds of the work done to parse one
+ * packet: the number of parse nodes visited, the bytes of the packet that
+ * are inspected, the TLV iterations, the encapsulation depth, and an
+ * estimated instruction count. The bounds are given for a maximum packet
+ * length and a maximum number of encapsulations (the max_encaps argument of
+ * panda_parse), since cycles in the parse graph (e.g. IPv6 extension
+ * headers, or IP in IP) are only bounded by these.
+ *
+ * The header lengths of the protocol nodes are taken from the protocol
+ * properties (see pandagen/proto_props.h), and the instructions of a parse
+ * node from its estimate (see pandagen/estimate.h). A protocol node that
+ * isn't described is assumed to have no minimum length and to inspect the
+ * whole packet, so bounds of parsers using it are loose or unbounded.
+ *
+ * Budgets can be given for the bounds, a parser that exceeds one is an
+ * error.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pandagen/estimate.h"
+#include "pandagen/graph.h"
+#include "pandagen/proto_props.h"
+
+namespace pandagen
+{
+
+static const unsigned long long cost_unbounded = ULLONG_MAX;
+
+/* Bounds of a parser */
+struct cost_bounds {
+	unsigned long long nodes = 0, bytes = 0, tlvs = 0, encaps = 0,
+			   insns = 0;
+};
+
+struct cost_path {
+	std::vector<std::string> nodes;
+	unsigned long long bytes = 0, insns = 0;
+};
+
+struct cost_report {
+	std::string parser, root;
+	cost_bounds bounds;
+	std::vector<cost_path> paths;
+	std::vector<std::string> unknown;
+};
+
+inline unsigned long long cost_add(unsigned long long a,
+				   unsigned long long b)
+{
+	if (a == cost_unbounded || b == cost_unbounded ||
+	    a > cost_unbounded - b)
+		return cost_unbounded;
+
+	return a + b;
+}
+
+inline std::string cost_str(unsigned long long v)
+{
+	return v == cost_unbounded ? "unbounded" : std::to_string(v);
+}
+
+namespace detail
+{
+
+/* A parse node reachable from a root */
+struct cost_node {
+	std::string name;
+	size_t min_len, max_len, advance_min, advance_max;
+	bool encap, leaf;
+	unsigned long long tlvs, insns;
+	std::vector<size_t> next;
+};
+
+/* Longest paths from the state of entering node i at offset off (assuming
+ * the shortest headers before it) with encaps encapsulations. A state that
+ * is entered again before its bounds are known is on a cycle that doesn't
+ * consume any bytes, so parsing may not terminate
+ */
+struct cost_walk {
+	std::vector<cost_node> const &nodes;
+	size_t max_len;
+	unsigned int max_encaps;
+	std::unordered_map<unsigned long long, cost_bounds> memo;
+	std::unordered_map<unsigned long long, bool> active;
+
+	cost_bounds walk(size_t i, size_t off, unsigned int encaps)
+	{
+		unsigned long long key = ((unsigned long long)i *
+					  (max_encaps + 2) + encaps) *
+					 (max_len + 1) + off;
+		auto const &n = nodes[i];
+		cost_bounds b;
+
+		if (memo.count(key))
+			return memo[key];
+		if (active[key]) {
+			b.nodes = b.tlvs = b.insns = cost_unbounded;
+			return b;
+		}
+
+		b.nodes = 1;
+		b.bytes = n.max_len;
+		b.tlvs = n.tlvs;
+		b.insns = n.insns;
+
+		/* Parsing stops with PANDA_STOP_LENGTH, at a leaf, or at the
+		 * encapsulation limit
+		 */
+		if (off + n.min_len > max_len || n.leaf ||
+		    (n.encap && encaps + 1 > max_encaps)) {
+			memo[key] = b;
+			return b;
+		}
+
+		active[key] = true;
+		for (auto &&s : n.next) {
+			auto sb = walk(s, std::min(off + n.advance_min,
+						   max_len),
+				       encaps + n.encap);
+
+			b.nodes = std::max(b.nodes, cost_add(1, sb.nodes));
+			b.bytes = std::max(b.bytes,
+					   cost_add(n.advance_max, sb.bytes));
+			b.tlvs = std::max(b.tlvs, cost_add(n.tlvs, sb.tlvs));
+			b.encaps = std::max(b.encaps, sb.encaps + n.encap);
+			b.insns = std::max(b.insns,
+					   cost_add(n.insns, sb.insns));
+		}
+		active[key] = false;
+
+		memo[key] = b;
+		return b;
+	}
+};
+
+} // namespace detail
+
+/* Compute the report of each root. max_len is the maximum packet length and
+ * max_encaps the maximum number of encapsulations. At most max_paths of the
+ * most expensive paths without a repeated node are listed
+ */
+template <typename G> std::vector<cost_report>
+cost_compute(G const &g, std::vector<root_t> const &roots, size_t max_len,
+	     unsigned int max_encaps, size_t max_paths = 16)
+{
+	auto const &protos = proto_props_table();
+	std::vector<cost_report> reports;
+
+	for (auto &&r : roots) {
+		std::vector<detail::cost_node> nodes;
+		std::map<std::string, size_t> index;
+		std::vector<std::string> order;
+		cost_report report;
+
+		report.parser = std::get<0>(r);
+		report.root = g[std::get<1>(r)].name;
+
+		order.push_back(report.root);
+		index[report.root] = 0;
+		for (size_t i = 0; i < order.size(); i++) {
+			auto v = *search_vertex_by_name(g, order[i]);
+			auto const &vp = g[v];
+			auto p = protos.find(vp.parser_node);
+			detail::cost_node n{ vp.name };
+			std::vector<std::string> next;
+
+			for (auto &&e : boost::make_iterator_range(
+							out_edges(v, g)))
+				next.push_back(g[target(e, g)].name);
+			if (!vp.wildcard_proto_node.empty() &&
+			    search_vertex_by_name(g, vp.wildcard_proto_node))
+				next.push_back(vp.wildcard_proto_node);
+
+			if (p != protos.end()) {
+				auto const &cp = p->second;
+
+				n.min_len = cp.len_min;
+				n.max_len = cp.len_max;
+				n.advance_min = cp.overlay ? 0 : cp.len_min;
+				n.advance_max = cp.overlay ? 0 : cp.len_max;
+				n.encap = cp.encap;
+				n.tlvs = vp.tlv_table.empty() ? 0 : cp.tlvs;
+			} else {
+				if (!contains(report.unknown, vp.parser_node))
+					report.unknown.push_back(
+							vp.parser_node);
+				n.min_len = n.advance_min = 0;
+				n.max_len = n.advance_max = max_len;
+				n.encap = false;
+				n.tlvs = vp.tlv_table.empty() ? 0 : max_len;
+			}
+
+			n.leaf = vp.table.empty() &&
+				 vp.wildcard_proto_node.empty();
+			n.insns = estimate_insns(g, v) +
+				  estimate_insns_tlv * n.tlvs;
+
+			for (auto &&s : next) {
+				if (!index.count(s)) {
+					index[s] = order.size();
+					order.push_back(s);
+				}
+				if (!contains(n.next, index[s]))
+					n.next.push_back(index[s]);
+			}
+			nodes.push_back(std::move(n));
+		}
+
+		detail::cost_walk w{ nodes, max_len, max_encaps };
+
+		report.bounds = w.walk(0, 0, 0);
+		report.bounds.bytes = std::min<unsigned long long>(
+					report.bounds.bytes, max_len);
+
+		/* Paths of one encapsulation layer without a repeated node.
+		 * A path ends at a leaf, at an encapsulation node, or where
+		 * all next nodes are already on the path
+		 */
+		std::vector<size_t> stack{ 0 };
+		std::vector<cost_path> paths;
+		size_t limit = 4096;
+
+		std::function<void(unsigned long long, unsigned long long)>
+			enumerate = [&](unsigned long long bytes,
+					unsigned long long insns) {
+			auto const &n = nodes[stack.back()];
+			bool end = true;
+
+			if (paths.size() >= limit)
+				return;
+
+			insns += n.insns;
+			for (auto &&s : n.next) {
+				if (contains(stack, s) ||
+				    (n.encap && stack.size() > 1))
+					continue;
+				end = false;
+				stack.push_back(s);
+				enumerate(bytes + n.advance_max, insns);
+				stack.pop_back();
+			}
+			if (end) {
+				cost_path p;
+
+				for (auto &&i : stack)
+					p.nodes.push_back(nodes[i].name);
+				p.bytes = std::min<unsigned long long>(
+						bytes + n.max_len, max_len);
+				p.insns = insns;
+				paths.push_back(std::move(p));
+			}
+		};
+		enumerate(0, 0);
+
+		std::stable_sort(paths.begin(), paths.end(),
+				 [](auto const &a, auto const &b) {
+			return a.insns > b.insns;
+		});
+		if (paths.size() > max_paths)
+			paths.resize(max_paths);
+		report.paths = std::move(paths);
+
+		reports.push_back(std::move(report));
+	}
+
+	return reports;
+}
+
+inline void cost_print(std::ostream &os,
+		       std::vector<cost_report> const &reports,
+		       size_t max_len, unsigned int max_encaps)
+{
+	for (auto &&r : reports) {
+		auto const &b = r.bounds;
+
+		os << "Parser " << r.parser << " (root " << r.root << ")\n";
+		os << "  packet length " << max_len << ", encapsulations " <<
+			max_encaps << "\n";
+		os << "  max nodes visited:       " << cost_str(b.nodes) <<
+			"\n";
+		os << "  max bytes inspected:     " << cost_str(b.bytes) <<
+			"\n";
+		os << "  max TLV iterations:      " << cost_str(b.tlvs) <<
+			"\n";
+		os << "  max encapsulation depth: " << cost_str(b.encaps) <<
+			"\n";
+		os << "  max estimated insns:     " << cost_str(b.insns) <<
+			"\n";
+		for (auto &&u : r.unknown)
+			os << "  unknown protocol node:   " << u << "\n";
+		os << "  most expensive paths (estimated insns, bytes, "
+			"path):\n";
+		for (auto &&p : r.paths) {
+			os << "    " << std::setw(6) << p.insns << " " <<
+				std::setw(6) << p.bytes << "  ";
+			for (size_t i = 0; i < p.nodes.size(); i++)
+				os << (i ? "," : "") << p.nodes[i];
+			os << "\n";
+		}
+	}
+}
+
+/* Parse budgets given as KEY=VALUE[,KEY=VALUE...] where KEY is nodes, bytes,
+ * tlvs, encaps, or insns
+ */
+inline bool cost_parse_budget(std::string const &spec,
+			      std::map<std::string, unsigned long long> &budget)
+{
+	auto items = std::istringstream{ spec };
+	std::string item;
+
+	while (std::getline(items, item, ',')) {
+		auto eq = item.find('=');
+		std::string key = item.substr(0, eq);
+
+		if (eq == std::string::npos ||
+		    (key != "nodes" && key != "bytes" && key != "tlvs" &&
+		     key != "encaps" && key != "insns")) {
+			std::cerr << "Invalid budget " << item << std::endl;
+			return false;
+		}
+		try {
+			budget[key] = std::stoull(item.substr(eq + 1));
+		} catch (std::exception const &) {
+			std::cerr << "Invalid budget " << item << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Check the bounds against the budgets. Returns false if a bound exceeds
+ * its budget
+ */
+inline bool cost_check_budget(std::vector<cost_report> const &reports,
+			      std::map<std::string, unsigned long long> const
+								&budget)
+{
+	bool ok = true;
+
+	for (auto &&r : reports) {
+		std::map<std::string, unsigned long long> bounds = {
+			{ "nodes", r.bounds.nodes },
+			{ "bytes", r.bounds.bytes },
+			{ "tlvs", r.bounds.tlvs },
+			{ "encaps", r.bounds.encaps },
+			{ "insns", r.bounds.insns },
+		};
+
+		for (auto &&[key, limit] : budget) {
+			if (bounds[key] <= limit)
+				continue;
+			std::cerr << "Parser " << r.parser << " exceeds the " <<
+				key << " budget: " << cost_str(bounds[key]) <<
+				" > " << limit << std::endl;
+			ok = false;
+		}
+	}
+
+	return ok;
+}
+
+} // namespace pandagen
+
+#endif /* PANDAGEN_COST_H */
@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef PANDAGEN_ESTIMATE_H
+#define PANDAGEN_ESTIMATE_H
+
+/* Estimated instructions of a parse node
+ *
+ * One estimate of the instructions of a parse node is used for the cost
+ * report, for compact code, and for splitting XDP programs. It counts the
+ * length checks and dispatch, the operations of the length and next
+ * protocol functions (see pandagen/proto_props.h), a compare for each
+ * protocol table entry, the metadata and handler calls, the encapsulation
+ * bookkeeping, and the TLV and flag-field loops with a call for each TLV or
+ * flag-field node. The TLV loop is counted once, estimate_insns_tlv is the
+ * cost of one more TLV iteration.
+ */
+
+#include "pandagen/graph.h"
+#include "pandagen/proto_props.h"
+
+namespace pandagen
+{
+
+static const unsigned int estimate_insns_node = 24;
+static const unsigned int estimate_insns_op = 2;
+static const unsigned int estimate_insns_entry = 3;
+static const unsigned int estimate_insns_metadata = 16;
+static const unsigned int estimate_insns_call = 8;
+static const unsigned int estimate_insns_encap = 12;
+static const unsigned int estimate_insns_tlvs = 40;
+static const unsigned int estimate_insns_tlv = 24;
+static const unsigned int estimate_insns_flag_fields = 8;
+static const unsigned int estimate_insns_flag_field = 16;
+
+inline bool estimate_is_null(std::string const &s)
+{
+	return s.empty() || s == "NULL";
+}
+
+/* Estimated instructions of a parse node */
+template <typename G> unsigned int estimate_insns(G const &g,
+		typename boost::graph_traits<G>::vertex_descriptor v)
+{
+	auto const &protos = proto_props_table();
+	auto const &vp = g[v];
+	auto p = protos.find(vp.parser_node);
+	unsigned int insns = estimate_insns_node;
+
+	if (p != protos.end()) {
+		insns += estimate_insns_op * proto_props_ops(p->second);
+		if (p->second.encap)
+			insns += estimate_insns_encap;
+	} else {
+		insns += estimate_insns_call * 2 + estimate_insns_encap;
+	}
+
+	for (auto &&e : boost::make_iterator_range(out_edges(v, g))) {
+		insns += estimate_insns_entry;
+
+		/* A collapsed node is dispatched in its parents */
+		if (g[target(e, g)].collapse)
+			insns += estimate_insns_node / 2 +
+				estimate_insns_entry *
+				out_degree(target(e, g), g);
+	}
+
+	if (!estimate_is_null(vp.metadata))
+		insns += estimate_insns_metadata;
+	if (!estimate_is_null(vp.handler))
+		insns += estimate_insns_call;
+	if (!vp.tlv_nodes.empty()) {
+		insns += estimate_insns_tlvs;
+		for (auto &&t : vp.tlv_nodes)
+			insns += estimate_insns_tlv * (1 + t.tlv_nodes.size());
+	}
+	if (!vp.flag_fields_nodes.empty())
+		insns += estimate_insns_flag_fields +
+			estimate_insns_flag_field *
+			vp.flag_fields_nodes.size();
+
+	return insns;
+}
+
+} // namespace pandagen
+
+#endif /* PANDAGEN_ESTIMATE_H */
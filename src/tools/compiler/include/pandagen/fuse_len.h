@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PANDAGEN_FUSE_LEN_H
+#define PANDAGEN_FUSE_LEN_H
+
+/* Fusion of packet length checks
+ *
+ * Each generated parse function checks that the packet is long enough for
+ * its protocol node before extracting metadata. When a node has a fixed
+ * header length, or is an overlay, the offset of the next node is known at
+ * compile time, so the minimum lengths of the nodes that can follow are
+ * added to the check. A chain of fixed size nodes is then covered by one
+ * compare against the cumulative length, and a variable length node only
+ * checks the length returned by its len function. If the fused check fails
+ * the nodes are checked one by one as before, so return codes and metadata
+ * are unchanged.
+ *
+ * Header lengths are properties of the protocol nodes, which the compiler
+ * doesn't see, so this pass only decides the successors that a node's check
+ * may cover. The generated code computes the fused lengths from the
+ * protocol nodes as constant expressions. A successor is not covered if it
+ * is pruned, or if covering it would close a cycle in the parse graph (for
+ * instance an encapsulation leading back to a root).
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "pandagen/graph.h"
+
+namespace pandagen
+{
+
+/* Successors of a parse node, the targets of its protocol table and its
+ * wildcard node, that are not pruned
+ */
+template <typename G> std::vector<typename
+				boost::graph_traits<G>::vertex_descriptor>
+fuse_len_successors(G const &g,
+		    typename boost::graph_traits<G>::vertex_descriptor v)
+{
+	std::vector<typename boost::graph_traits<G>::vertex_descriptor> succs;
+
+	for (auto &&e : boost::make_iterator_range(out_edges(v, g))) {
+		auto t = target(e, g);
+
+		if (!g[t].pruned && !contains(succs, t))
+			succs.push_back(t);
+	}
+
+	if (!g[v].wildcard_proto_node.empty()) {
+		auto w = search_vertex_by_name(g, g[v].wildcard_proto_node);
+
+		if (w && !g[*w].pruned && !contains(succs, *w))
+			succs.push_back(*w);
+	}
+
+	return succs;
+}
+
+/* Set fused_next of each parse node. A depth first search marks the edges
+ * that close a cycle, the remaining edges form the DAG over which the
+ * fused lengths are computed
+ */
+template <typename G> void fuse_len(G &g)
+{
+	typedef typename boost::graph_traits<G>::vertex_descriptor vertex_t;
+	enum { white, gray, black };
+	std::map<vertex_t, int> color;
+	size_t fused = 0;
+
+	for (auto &&v : boost::make_iterator_range(vertices(g))) {
+		std::vector<std::pair<vertex_t, size_t>> stack;
+
+		if (color[v] != white || g[v].pruned)
+			continue;
+
+		color[v] = gray;
+		stack.emplace_back(v, 0);
+
+		while (!stack.empty()) {
+			auto u = stack.back().first;
+			auto succs = fuse_len_successors(g, u);
+			auto i = stack.back().second++;
+
+			if (i == succs.size()) {
+				color[u] = black;
+				stack.pop_back();
+				continue;
+			}
+
+			if (color[succs[i]] == gray)
+				continue;
+
+			g[u].fused_next.push_back(g[succs[i]].name);
+			fused++;
+
+			if (color[succs[i]] == white) {
+				color[succs[i]] = gray;
+				stack.emplace_back(succs[i], 0);
+			}
+		}
+	}
+
+	std::cout << "Length checks fused over " << fused << " edges" <<
+		std::endl;
+}
+
+} // namespace pandagen
+
+#endif /* PANDAGEN_FUSE_LEN_H */
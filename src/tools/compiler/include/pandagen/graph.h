@@ -56,6 +56,7 @@ namespace pandagen
 struct tlv_node {
 	std::string name, string_name, metadata, handler, type, overlay_table,
 		unknown_overlay_ret, wildcard_node, check_length;
+	std::string lean_metadata;
 
 	std::vector<tlv_node> tlv_nodes;
 
@@ -72,6 +73,7 @@ struct tlv_node {
 
 struct flag_fields_node {
 	std::string name, string_name, metadata, handler, index;
+	std::string lean_metadata;
 };
 
 struct vertex_property {
@@ -80,6 +82,23 @@ struct vertex_property {
 	std::string name, parser_node, metadata, handler, table, tlv_table,
 	flag_fields_table, unknown_proto_ret, wildcard_proto_node;
 
+	// Set by lean specialization
+	std::string lean_metadata;
+	bool pruned = false;
+
+	// Set by graph optimization
+	std::string merged_into, single_entry;
+	bool collapse = false;
+
+	// Set by length check fusion
+	std::vector<std::string> fused_next;
+
+	// Set by compact code marking
+	bool compact_inline = false;
+
+	// Set by XDP program splitting
+	int xdp_prog = 0, xdp_size = 0;
+
 	std::vector<tlv_node> tlv_nodes;
 	std::vector<flag_fields_node> flag_fields_nodes;
 
@@ -0,0 +1,203 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PANDAGEN_GRAPH_OPT_H
+#define PANDAGEN_GRAPH_OPT_H
+
+/* Parse graph optimizations
+ *
+ * These passes reduce the number of dispatch hops and the amount of code in
+ * the generated parser without changing the parsing semantics:
+ *
+ * - Identical node merging: parse nodes with the same protocol node,
+ *   metadata, TLVs, flag-fields, and protocol table entries (to the same or
+ *   merged nodes) share one generated parse function.
+ *
+ * - Single entry table elimination: a protocol table with one entry is
+ *   dispatched with a compare instead of a switch.
+ *
+ * - Overlay collapsing: a node that only discriminates the next protocol,
+ *   like an IP version check between Ethernet and IPv4, is marked as
+ *   collapsible. Its parents then evaluate its next protocol in their own
+ *   dispatch and go to the next node directly (EtherType plus IP version
+ *   in one step). Whether the protocol node is an overlay without a length
+ *   function or encapsulation is known to the C compiler only, so the
+ *   collapsed dispatch is guarded by those constants and by the length
+ *   check of the node. If the guard or the next protocol doesn't match, the
+ *   node's parse function is called as before.
+ */
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "pandagen/graph.h"
+
+namespace pandagen
+{
+
+/* Return true if a node extracts no metadata */
+template <typename G> bool graph_opt_no_metadata(G const &g,
+		typename boost::graph_traits<G>::vertex_descriptor v,
+		bool lean)
+{
+	if (lean)
+		return g[v].lean_metadata.empty();
+
+	return g[v].metadata.empty() || g[v].metadata == "NULL";
+}
+
+/* Name of the node whose parse function implements a node */
+template <typename G> std::string graph_opt_impl(G const &g,
+						 std::string const &name)
+{
+	auto v = search_vertex_by_name(g, name);
+
+	if (!v || g[*v].merged_into.empty())
+		return name;
+
+	return g[*v].merged_into;
+}
+
+/* Key that identifies the structure of a node. Successors are given by the
+ * names of the nodes implementing them
+ */
+template <typename G> std::string graph_opt_node_key(G const &g,
+		typename boost::graph_traits<G>::vertex_descriptor v)
+{
+	std::vector<std::string> edges;
+	std::string key;
+
+	for (auto &&e : boost::make_iterator_range(out_edges(v, g)))
+		edges.push_back(g[e].macro_name + "=" +
+				graph_opt_impl(g, g[target(e, g)].name));
+	std::sort(edges.begin(), edges.end());
+
+	key = g[v].parser_node + ";" + g[v].metadata + ";" +
+		g[v].lean_metadata + ";" + g[v].handler + ";" +
+		g[v].unknown_proto_ret + ";" +
+		(g[v].wildcard_proto_node.empty() ? "" :
+			graph_opt_impl(g, g[v].wildcard_proto_node)) + ";" +
+		g[v].tlv_table + ";" + g[v].flag_fields_table + ";";
+
+	for (auto &&e : edges)
+		key += e + ",";
+
+	return key;
+}
+
+/* Merge structurally identical nodes, repeated until no more nodes merge
+ * since merging the successors of two nodes can make them identical.
+ * Nodes with TLVs or flag-fields tables only merge if the tables are the
+ * same
+ */
+template <typename G> size_t merge_identical_nodes(G &g)
+{
+	size_t merged = 0;
+	bool changed = true;
+
+	while (changed) {
+		std::map<std::string, std::string> keys;
+
+		changed = false;
+		for (auto &&v : boost::make_iterator_range(vertices(g))) {
+			if (!g[v].merged_into.empty() || g[v].pruned ||
+			    g[v].parser_node.empty())
+				continue;
+
+			auto key = graph_opt_node_key(g, v);
+			auto it = keys.find(key);
+
+			if (it == keys.end()) {
+				keys[key] = g[v].name;
+				continue;
+			}
+
+			std::cout << "Merged identical node " << g[v].name <<
+				" into " << it->second << std::endl;
+			g[v].merged_into = it->second;
+			merged++;
+			changed = true;
+		}
+	}
+
+	return merged;
+}
+
+/* Record the single entry of protocol tables that have one entry and no
+ * wildcard node
+ */
+template <typename G> size_t eliminate_single_entry_tables(G &g)
+{
+	size_t eliminated = 0;
+
+	for (auto &&v : boost::make_iterator_range(vertices(g))) {
+		if (out_degree(v, g) != 1 ||
+		    !g[v].wildcard_proto_node.empty())
+			continue;
+
+		g[v].single_entry = g[*out_edges(v, g).first].macro_name;
+		eliminated++;
+	}
+
+	return eliminated;
+}
+
+/* Mark nodes that only discriminate the next protocol: no metadata, TLVs,
+ * or flag-fields, and a protocol table
+ */
+template <typename G> size_t mark_collapsible_nodes(G &g, bool lean)
+{
+	size_t collapsible = 0;
+
+	for (auto &&v : boost::make_iterator_range(vertices(g))) {
+		if (g[v].pruned || !graph_opt_no_metadata(g, v, lean) ||
+		    !g[v].tlv_nodes.empty() || !g[v].flag_fields_nodes.empty() ||
+		    out_degree(v, g) == 0)
+			continue;
+
+		g[v].collapse = true;
+		collapsible++;
+	}
+
+	return collapsible;
+}
+
+template <typename G> void graph_opt(G &g, bool lean)
+{
+	auto merged = merge_identical_nodes(g);
+	auto single = eliminate_single_entry_tables(g);
+	auto collapsible = mark_collapsible_nodes(g, lean);
+
+	std::cout << "Graph optimization: " << merged << " nodes merged, " <<
+		single << " single entry tables, " << collapsible <<
+		" collapsible nodes" << std::endl;
+}
+
+} // namespace pandagen
+
+#endif /* PANDAGEN_GRAPH_OPT_H */
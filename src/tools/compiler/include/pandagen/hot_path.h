@@ -0,0 +1,246 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PANDAGEN_HOT_PATH_H
+#define PANDAGEN_HOT_PATH_H
+
+/* Path specialized fast paths for hot protocol stacks
+ *
+ * A hot path is a sequence of parse nodes starting at a parser root, for
+ * instance ether_node -> ipv4_check_node -> tcp_node. For each hot path a
+ * straight line function is generated that first checks the lengths and
+ * next protocol discriminators of all the nodes on the path, and then runs
+ * their extractors back to back. Packets that don't match the path are
+ * parsed by the normal generated code.
+ *
+ * Hot paths are given explicitly or taken from a profile. A profile is a
+ * text file with one path per line as a packet count followed by the comma
+ * separated node names, lines starting with '#' are comments:
+ *
+ *	# count path
+ *	9120334 ether_node,ipv4_check_node,tcp_node
+ *	2310211 ether_node,ipv6_check_node,ports_node
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "pandagen/graph.h"
+
+namespace pandagen
+{
+
+/* A node processed in line on a hot path. types are the protocol table
+ * values that lead to the next node on the path, empty for the last node
+ */
+struct hot_path_node {
+	std::string name;
+	std::vector<std::string> types;
+};
+
+/* A resolved hot path. tail is how the path ends:
+ *	"leaf": the last node has no next protocol, parsing stops
+ *	"pruned": the next node was pruned from a lean parser, parsing stops
+ *	"graph": parsing continues in the generated code for node next
+ */
+struct hot_path {
+	std::string name, root, desc;
+	std::vector<hot_path_node> nodes;
+	std::string tail, next;
+};
+
+/* Split a comma separated list of node names */
+inline std::vector<std::string> hot_path_split(std::string const &spec)
+{
+	auto names = std::istringstream{ spec };
+	std::vector<std::string> path;
+	std::string name;
+
+	while (std::getline(names, name, ','))
+		if (!name.empty())
+			path.push_back(name);
+
+	return path;
+}
+
+/* Read the top max_paths hot paths from a profile. Returns false on error */
+inline bool
+read_hot_profile(std::string const &filename, size_t max_paths,
+		 std::vector<std::vector<std::string>> &paths)
+{
+	std::vector<std::pair<unsigned long long, std::string>> entries;
+	auto file = std::ifstream{ filename };
+	std::string line;
+	size_t lineno = 0;
+
+	if (!file) {
+		std::cerr << "Can't open hot path profile " << filename <<
+			std::endl;
+		return false;
+	}
+
+	while (std::getline(file, line)) {
+		auto fields = std::istringstream{ line };
+		unsigned long long count;
+		std::string spec;
+
+		lineno++;
+		if (line.find_first_not_of(" \t") == std::string::npos ||
+		    line[line.find_first_not_of(" \t")] == '#')
+			continue;
+
+		if (!(fields >> count >> spec)) {
+			std::cerr << filename << ":" << lineno <<
+				": expected a count and a path" << std::endl;
+			return false;
+		}
+		entries.emplace_back(count, spec);
+	}
+
+	std::stable_sort(entries.begin(), entries.end(),
+			 [](auto const &a, auto const &b) {
+		return a.first > b.first;
+	});
+
+	for (size_t i = 0; i < entries.size() && i < max_paths; i++)
+		paths.push_back(hot_path_split(entries[i].second));
+
+	return true;
+}
+
+/* Resolve hot paths in the graph. Each path must start at a parser root
+ * and each following node must be reached through the protocol table of
+ * the previous node. Runs after lean specialization so that a path is cut
+ * at the first pruned node. Returns false on error
+ */
+template <typename G> bool
+resolve_hot_paths(G const &g, std::vector<root_t> const &roots,
+		  std::vector<std::vector<std::string>> const &specs,
+		  std::vector<hot_path> &hot_paths)
+{
+	for (auto &&spec : specs) {
+		std::vector<std::string> path = spec;
+		hot_path hp;
+
+		if (path.size() < 2) {
+			std::cerr << "Hot path must have at least two nodes" <<
+				std::endl;
+			return false;
+		}
+
+		if (std::none_of(roots.begin(), roots.end(),
+				 [&](root_t const &r) {
+			return g[std::get<1>(r)].name == path[0];
+		})) {
+			std::cerr << "Hot path start " << path[0] <<
+				" is not a parser root" << std::endl;
+			return false;
+		}
+
+		for (size_t i = 0; i < path.size(); i++) {
+			auto v = search_vertex_by_name(g, path[i]);
+
+			if (!v) {
+				std::cerr << "Hot path node " << path[i] <<
+					" not found" << std::endl;
+				return false;
+			}
+
+			if (g[*v].pruned) {
+				if (!i) {
+					std::cerr << "Hot path start " <<
+						path[i] << " is pruned" <<
+						std::endl;
+					return false;
+				}
+				std::cout << "Hot path cut at pruned node " <<
+					path[i] << std::endl;
+				path.resize(i + 1);
+				hp.tail = "pruned";
+				break;
+			}
+
+			hot_path_node hn;
+
+			hn.name = path[i];
+
+			if (i + 1 < path.size()) {
+				for (auto &&e : boost::make_iterator_range(
+							out_edges(*v, g)))
+					if (g[target(e, g)].name == path[i + 1])
+						hn.types.push_back(
+							g[e].macro_name);
+
+				if (hn.types.empty()) {
+					std::cerr << "Hot path node " <<
+						path[i + 1] << " is not in "
+						"the protocol table of " <<
+						path[i] << std::endl;
+					return false;
+				}
+			}
+
+			hp.nodes.push_back(hn);
+		}
+
+		if (hp.tail.empty()) {
+			auto last = *search_vertex_by_name(g, path.back());
+
+			if (out_degree(last, g) == 0 &&
+			    g[last].wildcard_proto_node.empty()) {
+				hp.tail = "leaf";
+			} else {
+				/* The last node continues to other nodes, run
+				 * it with the generated code
+				 */
+				hp.tail = "graph";
+				hp.next = path.back();
+				hp.nodes.pop_back();
+			}
+		}
+
+		hp.root = path[0];
+		hp.name = "__" + hp.root + "_hot_path_" +
+			std::to_string(hot_paths.size());
+
+		for (auto &&n : path)
+			hp.desc += (hp.desc.empty() ? "" : " -> ") + n;
+
+		std::cout << "Hot path " << hp.desc << " (" << hp.tail <<
+			")" << std::endl;
+
+		hot_paths.push_back(hp);
+	}
+
+	return true;
+}
+
+} // namespace pandagen
+
+#endif /* PANDAGEN_HOT_PATH_H */
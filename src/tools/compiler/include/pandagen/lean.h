@@ -0,0 +1,411 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PANDAGEN_LEAN_H
+#define PANDAGEN_LEAN_H
+
+/* Consumer driven specialization of a parser ("lean" parsers)
+ *
+ * Given the list of common metadata fields consumed by the application,
+ * generate a minimal metadata frame structure, drop metadata extractors whose
+ * outputs are not consumed, and prune parse nodes that neither write a
+ * consumed field nor lead to a node that does.
+ *
+ * Specialization works at the granularity of the canned metadata templates
+ * in parser_metadata.h (PANDA_METADATA_TEMP_*). Each template is known to
+ * write a fixed set of common metadata fields, so the template can be
+ * instantiated again for the lean frame structure.
+ */
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "pandagen/graph.h"
+
+namespace pandagen
+{
+
+/* One instance of a canned metadata template, that is
+ * PANDA_METADATA_TEMP_<temp>(<name>, <struct>[, <args>...])
+ */
+struct metadata_extractor {
+	std::string name, temp;
+	std::vector<std::string> args;
+};
+
+/* Common metadata fields written by each of the canned metadata templates.
+ * A field name XX corresponds to the PANDA_METADATA_XX definition
+ */
+static const std::map<std::string, std::vector<std::string>>
+metadata_temp_fields = {
+	{ "ether", { "eth_proto", "eth_addrs" } },
+	{ "ether_off", { "eth_proto", "eth_addrs", "l2_off" } },
+	{ "ether_noaddrs", { "eth_proto" } },
+	{ "ipv4", { "is_fragment", "first_frag", "l3_off", "addr_type",
+		    "ip_proto", "addrs" } },
+	{ "ipv4_addrs", { "addr_type", "ip_proto", "addrs" } },
+	{ "ipv6", { "l3_off", "ip_proto", "addr_type", "flow_label",
+		    "addrs" } },
+	{ "ipv6_addrs", { "ip_proto", "addr_type", "addrs" } },
+	{ "ports", { "ports" } },
+	{ "ports_off", { "ports", "l4_off" } },
+	{ "tcp_option_mss", { "tcp_options" } },
+	{ "tcp_option_window_scaling", { "tcp_options" } },
+	{ "tcp_option_timestamp", { "tcp_options" } },
+	{ "tcp_option_sack_1", { "tcp_options" } },
+	{ "tcp_option_sack_2", { "tcp_options" } },
+	{ "tcp_option_sack_3", { "tcp_options" } },
+	{ "tcp_option_sack_4", { "tcp_options" } },
+	{ "ip_overlay", { "eth_proto" } },
+	{ "ipv6_eh", { "ip_proto" } },
+	{ "ipv6_frag", { "ip_proto", "is_fragment", "first_frag" } },
+	{ "ipv6_frag_noinfo", { "ip_proto" } },
+	{ "arp_rarp", { "arp" } },
+	{ "vlan_set_tpid", { "vlan_count", "vlan" } },
+	{ "vlan_8021AD", { "vlan_count", "vlan" } },
+	{ "vlan_8021Q", { "vlan_count", "vlan" } },
+	{ "icmp", { "icmp" } },
+	{ "mpls", { "mpls", "keyid" } },
+	{ "tipc", { "addr_type", "addrs" } },
+	{ "gre", { "gre" } },
+	{ "gre_pptp", { "gre_pptp" } },
+	{ "gre_checksum", { "gre" } },
+	{ "gre_keyid", { "gre", "keyid" } },
+	{ "gre_seq", { "gre" } },
+	{ "gre_routing", { "gre" } },
+	{ "gre_pptp_key", { "keyid", "gre_pptp" } },
+	{ "gre_pptp_seq", { "gre_pptp" } },
+	{ "gre_pptp_ack", { "gre_pptp" } },
+	{ "flow_key_ipv4", { "flow_key" } },
+	{ "flow_key_ipv6", { "flow_key" } },
+	{ "flow_key_ipv6_eh", { "flow_key" } },
+	{ "flow_key_ipv6_frag", { "flow_key" } },
+	{ "flow_key_ports", { "flow_key" } },
+	{ "flow_key_gre_keyid", { "flow_key" } },
+	{ "flow_key_gre_pptp_key", { "flow_key" } },
+};
+
+/* Parameters of metadata templates that take more than NAME and STRUCT */
+static const std::map<std::string, std::string> metadata_temp_params = {
+	{ "vlan_set_tpid", "NAME, STRUCT, TPID" },
+};
+
+/* Define the canned metadata templates to the preprocessor so that their
+ * instantiations are reported to the macro hook
+ */
+template <typename Context> void
+add_metadata_temp_macros(Context &context)
+{
+	for (auto &&temp : metadata_temp_fields) {
+		auto params = metadata_temp_params.find(temp.first);
+
+		context.add_macro_definition("PANDA_METADATA_TEMP_" +
+			temp.first + "(" +
+			(params != metadata_temp_params.end() ?
+				params->second : "NAME, STRUCT") + ")",
+			true);
+	}
+}
+
+template <typename ContainerT> std::string
+get_string_from_tokens(ContainerT const &c)
+{
+	std::string str;
+
+	for (auto &&t : c) {
+		if (IS_CATEGORY(t, boost::wave::WhiteSpaceTokenType) ||
+		    IS_CATEGORY(t, boost::wave::EOLTokenType))
+			continue;
+
+		auto v = t.get_value();
+
+		str.insert(str.end(), v.begin(), v.end());
+	}
+
+	return str;
+}
+
+template <typename ContainerT> void
+handle_metadata_temp(std::vector<metadata_extractor> &extractors,
+		     std::string const &temp,
+		     std::vector<ContainerT> const &arguments)
+{
+	if (arguments.size() < 2) {
+		std::cerr << "PANDA_METADATA_TEMP_" << temp << " should "
+			     "have at least 2 parameters" << std::endl;
+		return;
+	}
+
+	metadata_extractor e{ get_string_from_tokens(arguments[0]), temp };
+
+	for (auto &&arg : arguments)
+		e.args.push_back(get_string_from_tokens(arg));
+
+	extractors.push_back(e);
+}
+
+/* Result of specialization: the lean frame structure and the metadata
+ * templates that need to be instantiated for it
+ */
+struct lean_info {
+	std::string parser_name, frame_name;
+	std::vector<std::string> consumed;
+	std::vector<std::string> hot_fields, cold_fields;
+	std::vector<metadata_extractor> extractors;
+};
+
+/* Return the fields written by an extraction function. Returns false if the
+ * function is not an instance of a canned metadata template (i.e. it's a
+ * custom function that can't be specialized)
+ */
+inline bool
+lean_extractor_fields(std::vector<metadata_extractor> const &extractors,
+		      std::string const &name,
+		      std::vector<std::string> &fields)
+{
+	fields.clear();
+
+	if (name.empty() || name == "NULL")
+		return true;
+
+	for (auto &&e : extractors) {
+		if (e.name == name) {
+			fields = metadata_temp_fields.at(e.temp);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Specialize the graph for the consumed fields. Sets lean_metadata for
+ * nodes, TLVs, and flag-fields whose extractors are kept and pruned for
+ * nodes that can be removed. Returns false on error
+ */
+template <typename G> bool
+lean_specialize(G &g, std::vector<root_t> const &roots,
+		std::vector<metadata_extractor> const &extractors,
+		std::vector<std::string> const &consume, lean_info &lean)
+{
+	typedef typename boost::graph_traits<G>::vertex_descriptor vertex;
+	std::set<std::string> consumed, known, kept_extractors;
+	std::map<vertex, bool> kept;
+	std::vector<std::string> fields;
+	bool changed;
+
+	for (auto &&temp : metadata_temp_fields)
+		known.insert(temp.second.begin(), temp.second.end());
+
+	for (auto &&f : consume) {
+		if (!known.count(f)) {
+			std::cerr << "Unknown metadata field " << f <<
+				" in consumed fields" << std::endl;
+			return false;
+		}
+		if (consumed.insert(f).second)
+			lean.consumed.push_back(f);
+	}
+
+	/* Returns the name of the lean extractor to call for an extraction
+	 * function, or an empty string if its outputs aren't consumed
+	 */
+	auto specialize = [&](std::string const &name,
+			      std::string const &where) -> optional<std::string> {
+		if (!lean_extractor_fields(extractors, name, fields)) {
+			std::cerr << "Metadata function " << name << " in " <<
+				where << " is not a canned metadata template "
+				"and can't be specialized" << std::endl;
+			return {};
+		}
+
+		for (auto &&f : fields) {
+			if (consumed.count(f)) {
+				kept_extractors.insert(name);
+				return "__" + name + "_lean";
+			}
+		}
+
+		return std::string{};
+	};
+
+	for (auto &&v : boost::make_iterator_range(vertices(g))) {
+		auto &node = g[v];
+		bool tlvs = false, flag_fields = false;
+
+		auto lm = specialize(node.metadata, node.name);
+		if (!lm)
+			return false;
+		node.lean_metadata = *lm;
+
+		for (auto &&t : node.tlv_nodes) {
+			if (!(lm = specialize(t.metadata, t.name)))
+				return false;
+			t.lean_metadata = *lm;
+			tlvs |= !t.lean_metadata.empty();
+
+			for (auto &&o : t.tlv_nodes) {
+				if (!(lm = specialize(o.metadata, o.name)))
+					return false;
+				o.lean_metadata = *lm;
+				tlvs |= !o.lean_metadata.empty();
+			}
+		}
+
+		for (auto &&f : node.flag_fields_nodes) {
+			if (!(lm = specialize(f.metadata, f.name)))
+				return false;
+			f.lean_metadata = *lm;
+			flag_fields |= !f.lean_metadata.empty();
+		}
+
+		/* If no TLV or flag-field writes a consumed field then
+		 * processing of the TLVs or flag-fields is skipped
+		 */
+		if (!tlvs)
+			node.tlv_nodes.clear();
+		if (!flag_fields)
+			node.flag_fields_nodes.clear();
+
+		kept[v] = !node.lean_metadata.empty() || tlvs || flag_fields;
+	}
+
+	for (auto &&r : roots)
+		kept[std::get<1>(r)] = true;
+
+	/* Keep nodes that lead to a kept node */
+	do {
+		changed = false;
+
+		for (auto &&v : boost::make_iterator_range(vertices(g))) {
+			if (kept[v])
+				continue;
+
+			for (auto &&e : boost::make_iterator_range(
+							out_edges(v, g))) {
+				if (kept[target(e, g)]) {
+					kept[v] = true;
+					break;
+				}
+			}
+
+			if (!kept[v] && !g[v].wildcard_proto_node.empty()) {
+				auto w = search_vertex_by_name(g,
+						g[v].wildcard_proto_node);
+
+				if (w && kept[*w])
+					kept[v] = true;
+			}
+
+			changed |= kept[v];
+		}
+	} while (changed);
+
+	for (auto &&v : boost::make_iterator_range(vertices(g))) {
+		g[v].pruned = !kept[v];
+		if (g[v].pruned)
+			std::cout << "Pruning node " << g[v].name << std::endl;
+	}
+
+	/* Hot fields are the consumed fields in the order given. Cold fields
+	 * are other fields written by the kept extractors
+	 */
+	std::set<std::string> written;
+
+	for (auto &&e : extractors) {
+		if (!kept_extractors.count(e.name))
+			continue;
+
+		lean.extractors.push_back(e);
+
+		for (auto &&f : metadata_temp_fields.at(e.temp)) {
+			if (!written.insert(f).second)
+				continue;
+			if (!consumed.count(f))
+				lean.cold_fields.push_back(f);
+		}
+	}
+
+	for (auto &&f : lean.consumed) {
+		if (!written.count(f))
+			std::cerr << "Warning: consumed field " << f <<
+				" is not written by any extractor" <<
+				std::endl;
+		lean.hot_fields.push_back(f);
+	}
+
+	lean.parser_name = std::get<0>(roots[0]);
+	lean.frame_name = lean.parser_name + "_lean_frame";
+
+	return true;
+}
+
+/* Write the header containing the lean frame and metadata structures */
+inline bool
+write_lean_header(std::string const &filename, lean_info const &lean)
+{
+	auto file = std::ofstream{ filename };
+
+	if (!file)
+		return false;
+
+	file << "/* Generated by panda-compiler. Lean metadata frame for "
+		"consumed fields:\n *";
+	for (auto &&f : lean.consumed)
+		file << " " << f;
+	file << "\n */\n\n";
+
+	file << "#ifndef __" << lean.frame_name << "_H__\n" <<
+		"#define __" << lean.frame_name << "_H__\n\n" <<
+		"#include \"panda/parser_metadata.h\"\n\n";
+
+	file << "struct " << lean.frame_name << " {\n" <<
+		"\t/* Consumed fields, hot */\n";
+	for (auto &&f : lean.hot_fields)
+		file << "\tPANDA_METADATA_" << f << ";\n";
+
+	if (!lean.cold_fields.empty()) {
+		file << "\n\t/* Other fields written by kept extractors */\n";
+		for (auto &&f : lean.cold_fields)
+			file << "\tPANDA_METADATA_" << f << ";\n";
+	}
+	file << "};\n\n";
+
+	file << "struct " << lean.parser_name << "_lean_metadata {\n" <<
+		"\tstruct panda_metadata panda_data;\n" <<
+		"\tstruct " << lean.frame_name << " frame;\n" <<
+		"};\n\n";
+
+	file << "#endif /* __" << lean.frame_name << "_H__ */\n";
+
+	return true;
+}
+
+} // namespace pandagen
+
+#endif
@@ -0,0 +1,316 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef PANDAGEN_PROTO_PROPS_H
+#define PANDAGEN_PROTO_PROPS_H
+
+/* Protocol node properties
+ *
+ * The properties of the protocol nodes in include/panda/proto_nodes that
+ * the compiler knows: the header length bounds, whether the node is an
+ * overlay or an encapsulation, and the semantics of the length and next
+ * protocol functions as primitive instructions of the bytecode interpreter
+ * (see panda/bytecode.h). The bytecode backend compiles the instructions,
+ * and the cost model and the code size estimates use the lengths and the
+ * number of operations. A protocol node that isn't described here is
+ * assumed to have no minimum length, to inspect the whole packet, and to
+ * call its functions.
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace pandagen
+{
+
+/* An instruction of a protocol node description. Jumps skip the next skip
+ * instructions of the description
+ */
+struct bc_op {
+	std::string op, k;
+	int size = 0, skip = 0;
+};
+
+inline bc_op bc_ld(int size, std::string const &off)
+{
+	return { "LD", off, size };
+}
+
+inline bc_op bc_alu(std::string const &op, std::string const &k)
+{
+	return { op, k };
+}
+
+inline bc_op bc_jmp(std::string const &op, std::string const &k, int skip)
+{
+	return { op, k, 0, skip };
+}
+
+inline bc_op bc_ret(std::string const &code)
+{
+	return { "RET", code };
+}
+
+/* Check in a len function that a byte (e.g. the IP version) has the value
+ * K. The parser compares the length returned by a len function with the
+ * packet length as an unsigned value, so an error code returned by a len
+ * function stops parsing with PANDA_STOP_LENGTH
+ */
+inline std::vector<bc_op> bc_check8(std::string const &off, int shift,
+				    std::string const &k)
+{
+	std::vector<bc_op> ops = { bc_ld(1, off) };
+
+	if (shift)
+		ops.push_back(bc_alu("SHR", std::to_string(shift)));
+	ops.push_back(bc_jmp("JEQ", k, 1));
+	ops.push_back(bc_ret("PANDA_STOP_LENGTH"));
+
+	return ops;
+}
+
+/* Properties of a protocol node
+ *
+ * min_len is the C expression of the minimum length of the protocol node,
+ * and len_min and len_max bound the header length (the length returned by
+ * the len function, which may be greater than min_len). len computes the
+ * header length into the accumulator (followed by a LEN instruction), and
+ * next computes the next protocol type. tlvs is the maximum number of TLVs
+ * (including pad bytes) in the largest header.
+ *
+ * The length and next protocol functions of a few protocol nodes, e.g. GRE
+ * with flag-fields, aren't described by instructions, ops is then the
+ * number of their operations and the protocol node isn't supported by the
+ * bytecode backend
+ */
+struct proto_props {
+	std::string min_len;
+	size_t len_min, len_max;
+	std::vector<bc_op> len, next;
+	bool has_next = false, overlay = false, encap = false;
+	unsigned int tlvs = 0, ops = 0;
+};
+
+inline std::vector<bc_op> bc_concat(std::vector<std::vector<bc_op>> parts)
+{
+	std::vector<bc_op> ops;
+
+	for (auto &&p : parts)
+		ops.insert(ops.end(), p.begin(), p.end());
+
+	return ops;
+}
+
+inline std::map<std::string, proto_props> const &proto_props_table()
+{
+	static const std::vector<bc_op> ipv4_len = {
+		bc_ld(1, "0"), bc_alu("AND", "0xf"), bc_alu("SHL", "2"),
+	};
+	static const std::vector<bc_op> ipv4_next = {
+		/* Stop at a non-first fragment */
+		bc_ld(2, "offsetof(struct iphdr, frag_off)"),
+		bc_jmp("JSET", "__cpu_to_be16(IP_OFFSET)", 2),
+		bc_ld(1, "offsetof(struct iphdr, protocol)"),
+		bc_jmp("JGE", "0", 1),
+		bc_ret("PANDA_STOP_OKAY"),
+	};
+	static const std::vector<bc_op> ipv4_next_stop1stfrag = {
+		/* Stop at all fragments */
+		bc_ld(2, "offsetof(struct iphdr, frag_off)"),
+		bc_jmp("JSET", "__cpu_to_be16(IP_MF | IP_OFFSET)", 2),
+		bc_ld(1, "offsetof(struct iphdr, protocol)"),
+		bc_jmp("JGE", "0", 1),
+		bc_ret("PANDA_STOP_OKAY"),
+	};
+	static const std::vector<bc_op> ipv6_next = {
+		bc_ld(1, "offsetof(struct ipv6hdr, nexthdr)"),
+	};
+	static const std::vector<bc_op> ipv6_next_stopflowlabel = {
+		/* Don't continue if flowlabel is non-zero */
+		bc_ld(4, "0"),
+		bc_jmp("JSET", "__cpu_to_be32(0x000fffff)", 2),
+		bc_ld(1, "offsetof(struct ipv6hdr, nexthdr)"),
+		bc_jmp("JGE", "0", 1),
+		bc_ret("PANDA_STOP_OKAY"),
+	};
+	static const std::vector<bc_op> ipv6_len_check = bc_concat({
+		bc_check8("0", 4, "6"),
+		{ bc_alu("LDI", "sizeof(struct ipv6hdr)") },
+	});
+	static const std::vector<bc_op> arp_len = {
+		bc_ld(2, "offsetof(struct arphdr, ar_hrd)"),
+		bc_jmp("JNE", "__cpu_to_be16(ARPHRD_ETHER)", 9),
+		bc_ld(2, "offsetof(struct arphdr, ar_pro)"),
+		bc_jmp("JNE", "__cpu_to_be16(ETH_P_IP)", 7),
+		bc_ld(1, "offsetof(struct arphdr, ar_hln)"),
+		bc_jmp("JNE", "ETH_ALEN", 5),
+		bc_ld(1, "offsetof(struct arphdr, ar_pln)"),
+		bc_jmp("JNE", "4", 3),
+		bc_ld(2, "offsetof(struct arphdr, ar_op)"),
+		bc_jmp("JEQ", "__cpu_to_be16(ARPOP_REPLY)", 2),
+		bc_jmp("JEQ", "__cpu_to_be16(ARPOP_REQUEST)", 1),
+		bc_ret("PANDA_STOP_LENGTH"),
+		bc_alu("LDI", "sizeof(struct earphdr)"),
+	};
+	/* doff is the high nibble of byte 12 */
+	static const std::vector<bc_op> tcp_len = {
+		bc_ld(1, "12"), bc_alu("SHR", "4"), bc_alu("SHL", "2"),
+	};
+	static const std::map<std::string, proto_props> protos = {
+		{ "panda_parse_ether", {
+			"sizeof(struct ethhdr)", 14, 14, {},
+			{ bc_ld(2, "offsetof(struct ethhdr, h_proto)") },
+			true } },
+		{ "panda_parse_ip", {
+			"sizeof(struct ip_hdr_byte)", 1, 1, {},
+			{ bc_ld(1, "0"), bc_alu("SHR", "4") },
+			true, true } },
+		{ "panda_parse_ipv4", {
+			"sizeof(struct iphdr)", 20, 60, ipv4_len, ipv4_next,
+			true } },
+		{ "panda_parse_ipv4_stop1stfrag", {
+			"sizeof(struct iphdr)", 20, 60, ipv4_len,
+			ipv4_next_stop1stfrag, true } },
+		{ "panda_parse_ipv4_check", {
+			"sizeof(struct iphdr)", 20, 60,
+			bc_concat({ bc_check8("0", 4, "4"),
+				    ipv4_len }),
+			ipv4_next, true } },
+		{ "panda_parse_ipv4_stop1stfrag_check", {
+			"sizeof(struct iphdr)", 20, 60, ipv4_len,
+			ipv4_next_stop1stfrag, true } },
+		{ "panda_parse_ipv6", {
+			"sizeof(struct ipv6hdr)", 40, 40, {}, ipv6_next,
+			true } },
+		{ "panda_parse_ipv6_stopflowlabel", {
+			"sizeof(struct ipv6hdr)", 40, 40, {},
+			ipv6_next_stopflowlabel, true } },
+		{ "panda_parse_ipv6_check", {
+			"sizeof(struct ipv6hdr)", 40, 40, ipv6_len_check,
+			ipv6_next, true } },
+		{ "panda_parse_ipv6_stopflowlabel_check", {
+			"sizeof(struct ipv6hdr)", 40, 40, ipv6_len_check,
+			ipv6_next_stopflowlabel, true } },
+		/* Length is (hdrlen + 1) * 8 */
+		{ "panda_parse_ipv6_eh", {
+			"sizeof(struct ipv6_opt_hdr)", 8, 2048,
+			{ bc_ld(1, "offsetof(struct ipv6_opt_hdr, hdrlen)"),
+			  bc_alu("ADD", "1"), bc_alu("SHL", "3") },
+			{ bc_ld(1, "offsetof(struct ipv6_opt_hdr, nexthdr)") },
+			true } },
+		{ "panda_parse_ipv6_frag_eh", {
+			"sizeof(struct ipv6_frag_hdr)", 8, 8, {},
+			/* Stop at non-first fragment */
+			{ bc_ld(2, "offsetof(struct ipv6_frag_hdr, frag_off)"),
+			  bc_jmp("JSET", "__cpu_to_be16(IP6_OFFSET)", 2),
+			  bc_ld(1, "offsetof(struct ipv6_frag_hdr, nexthdr)"),
+			  bc_jmp("JGE", "0", 1),
+			  bc_ret("PANDA_STOP_OKAY") },
+			true } },
+		{ "panda_parse_ipv6_frag_eh_stop1stfrag", {
+			"sizeof(struct ipv6_frag_hdr)", 8, 8 } },
+		{ "panda_parse_ipv4ip", {
+			"sizeof(struct iphdr)", 20, 20, {},
+			{ bc_alu("LDI", "0") }, true, true, true } },
+		{ "panda_parse_ipv6ip", {
+			"sizeof(struct ipv6hdr)", 40, 40, {},
+			{ bc_alu("LDI", "0") }, true, true, true } },
+		{ "panda_parse_vlan", {
+			"sizeof(struct vlan_hdr)", 4, 4, {},
+			{ bc_ld(2, "offsetof(struct vlan_hdr, "
+				   "h_vlan_encapsulated_proto)") },
+			true } },
+		{ "panda_parse_ppp", {
+			"sizeof(struct ppp_hdr)", 4, 4, {},
+			{ bc_ld(2, "offsetof(struct ppp_hdr, protocol)") },
+			true } },
+		{ "panda_parse_pppoe", {
+			"sizeof(struct pppoe_hdr)", 8, 8, {},
+			{ bc_ld(2, "offsetof(struct pppoe_hdr, protocol)") },
+			true } },
+		{ "panda_parse_batman", {
+			"sizeof(struct batadv_eth)", 24, 24,
+			bc_concat({
+				bc_check8("offsetof(struct batadv_eth, "
+					  "batadv_unicast.version)", 0,
+					  "BATADV_COMPAT_VERSION"),
+				bc_check8("offsetof(struct batadv_eth, "
+					  "batadv_unicast.packet_type)", 0,
+					  "BATADV_UNICAST"),
+				{ bc_alu("LDI", "sizeof(struct batadv_eth)") },
+			}),
+			{ bc_ld(2, "offsetof(struct batadv_eth, "
+				   "eth.h_proto)") },
+			true, false, true } },
+		{ "panda_parse_arp", {
+			"sizeof(struct earphdr)", 28, 28, arp_len } },
+		{ "panda_parse_rarp", {
+			"sizeof(struct earphdr)", 28, 28, arp_len } },
+		{ "panda_parse_ports", { "sizeof(struct port_hdr)", 4, 4 } },
+		{ "panda_parse_tcp_notlvs", {
+			"sizeof(struct tcphdr)", 20, 60, tcp_len } },
+		/* Up to 40 bytes of options, NOPs are one byte */
+		{ "panda_parse_tcp_tlvs", {
+			"sizeof(struct tcphdr)", 20, 60, tcp_len, {}, false,
+			false, false, 40 } },
+		{ "panda_parse_icmpv4", { "sizeof(struct icmphdr)", 8, 8 } },
+		{ "panda_parse_icmpv6", { "sizeof(struct icmp6hdr)", 8, 8 } },
+		{ "panda_parse_mpls", {
+			"2 * sizeof(struct mpls_label)", 8, 8 } },
+		{ "panda_parse_tipc", {
+			"sizeof(struct tipc_basic_hdr)", 16, 16 } },
+		{ "panda_parse_fcoe", { "FCOE_HEADER_LEN", 38, 38 } },
+		{ "panda_parse_igmp", { "sizeof(struct igmphdr)", 8, 8 } },
+		{ "panda_parse_gre_base", {
+			"sizeof(struct gre_hdr)", 4, 4, {}, {}, true, true,
+			false, 0, 2 } },
+		/* Checksum, key, and sequence number of four bytes each */
+		{ "panda_parse_gre_v0", {
+			"sizeof(struct gre_hdr)", 4, 16, {}, {}, true, false,
+			true, 0, 8 } },
+		/* Length and call ID, sequence, and ack number */
+		{ "panda_parse_gre_v1", {
+			"sizeof(struct gre_hdr)", 4, 20, {}, {}, true, false,
+			true, 0, 8 } },
+	};
+
+	return protos;
+}
+
+/* Number of operations of the length and next protocol functions */
+inline unsigned int proto_props_ops(proto_props const &p)
+{
+	if (p.ops)
+		return p.ops;
+
+	return p.len.size() + !p.len.empty() + p.next.size();
+}
+
+} // namespace pandagen
+
+#endif /* PANDAGEN_PROTO_PROPS_H */
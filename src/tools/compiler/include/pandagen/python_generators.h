@@ -31,16 +31,30 @@
 #ifndef PANDAGEN_PYTHON_GENERATORS_H
 #define PANDAGEN_PYTHON_GENERATORS_H
 
+#include <filesystem>
 #include <vector>
 
 #include <Python.h>
 
+#include "pandagen/bytecode.h"
+#include "pandagen/fuse_len.h"
+#include "pandagen/graph_opt.h"
+#include "pandagen/hot_path.h"
+#include "pandagen/lean.h"
+
 extern const char* pyratempsrc;
 extern const char* template_gen;
 extern const char* user_xdp_common_template_str;
 extern const char* c_def_template_str;
 extern const char *kmod_def_template_str;
 extern const char* xdp_def_template_str;
+extern const char* xdp_loop_def_template_str;
+extern const char *flowdis_def_template_str;
+extern const char *tc_def_template_str;
+extern const char *afxdp_def_template_str;
+extern const char *harness_def_template_str;
+extern const char *bc_def_template_str;
+extern const char *cxx_def_template_str;
 
 namespace pandagen::python {
 
@@ -265,6 +279,7 @@ auto make_python_object(graph_t const& graph, vertex_descriptor_t const& vertex)
 	  tlv.set("type", t.type);
 	  tlv.set("unknown_overlay_ret", t.unknown_overlay_ret);
 	  tlv.set("wildcard_node", t.wildcard_node);
+	  tlv.set("lean_metadata", t.lean_metadata);
 	  {
 		  python::list overlay_nodes;
 		  for (auto&& overlay : t.tlv_nodes) {
@@ -280,6 +295,8 @@ auto make_python_object(graph_t const& graph, vertex_descriptor_t const& vertex)
 					  overlay.unknown_overlay_ret);
 			  tlv_overlay.set("wildcard_node",
 					  overlay.wildcard_node);
+			  tlv_overlay.set("lean_metadata",
+					  overlay.lean_metadata);
 			  overlay_nodes.append(std::move(tlv_overlay));
 		  }
 		  tlv.set("overlay_nodes", std::move(overlay_nodes));
@@ -297,9 +314,15 @@ auto make_python_object(graph_t const& graph, vertex_descriptor_t const& vertex)
 	  flag.set("metadata", f.metadata);
 	  flag.set("handler", f.handler);
 	  flag.set("index", f.index);
+	  flag.set("lean_metadata", f.lean_metadata);
 	  flag_fields_nodes.append(std::move(flag));
   }
 
+  python::list fused_next;
+
+  for (auto&& n : graph[vertex].fused_next)
+	  fused_next.append(n);
+
   auto& v = graph[vertex];
   obj.set("name", v.name);
   obj.set("parser_node", v.parser_node);
@@ -310,6 +333,15 @@ auto make_python_object(graph_t const& graph, vertex_descriptor_t const& vertex)
   obj.set("flag_fields_table", v.flag_fields_table);
   obj.set("unknown_proto_ret", v.unknown_proto_ret);
   obj.set("wildcard_proto_node", v.wildcard_proto_node);
+  obj.set("lean_metadata", v.lean_metadata);
+  obj.set("pruned", v.pruned);
+  obj.set("impl", v.merged_into.empty() ? v.name : v.merged_into);
+  obj.set("single_entry", v.single_entry);
+  obj.set("collapse", v.collapse);
+  obj.set("fused_next", std::move(fused_next));
+  obj.set("inline", v.compact_inline);
+  obj.set("xdp_prog", v.xdp_prog);
+  obj.set("xdp_size", v.xdp_size);
   obj.set("tlv_nodes", std::move(tlv_nodes));
   obj.set("flag_fields_nodes", std::move(flag_fields_nodes));
   obj.set("out_edges", make_edge_list(graph, vertex));
@@ -336,6 +368,75 @@ auto make_python_object(graph_t const& graph) {
   return obj;
 }
 
+/**
+ * Creates a Python Object for the result of lean specialization.
+ *
+ * Object is a dictionary with the lean frame structure name, the name of the
+ * generated header, and the metadata templates to instantiate for the frame
+ * as a list of [name, template, extra arguments].
+ */
+auto make_python_object(lean_info const& lean, std::string const& header) {
+  auto obj = dict{};
+  auto extractors = python::list{};
+
+  for (auto&& e : lean.extractors) {
+    auto l = python::list{};
+    std::string args;
+
+    for (size_t i = 2; i < e.args.size(); i++)
+      args += ", " + e.args[i];
+
+    l.append("__" + e.name + "_lean");
+    l.append(e.temp);
+    l.append(args);
+    extractors.append(std::move(l));
+  }
+
+  obj.set("frame", lean.frame_name);
+  obj.set("header", header);
+  obj.set("extractors", std::move(extractors));
+
+  return obj;
+}
+
+/**
+ * Creates a Python Object for the hot paths.
+ *
+ * Object is a list of dictionaries with the name of the hot path function,
+ * its root node, the nodes processed in line with the protocol table values
+ * leading to the next node, and how the path ends.
+ */
+auto make_python_object(std::vector<hot_path> const& hot_paths) {
+  auto list = python::list{};
+
+  for (auto&& hp : hot_paths) {
+    auto obj = python::dict{};
+    auto nodes = python::list{};
+
+    for (auto&& n : hp.nodes) {
+      auto node = python::dict{};
+      auto types = python::list{};
+
+      for (auto&& t : n.types)
+        types.append(t);
+
+      node.set("name", n.name);
+      node.set("types", std::move(types));
+      nodes.append(std::move(node));
+    }
+
+    obj.set("name", hp.name);
+    obj.set("root", hp.root);
+    obj.set("desc", hp.desc);
+    obj.set("nodes", std::move(nodes));
+    obj.set("tail", hp.tail);
+    obj.set("next", hp.next);
+    list.append(std::move(obj));
+  }
+
+  return list;
+}
+
 struct module {
   auto get_function(std::string const& name) const {
     return make_python_object(ensure_not_null(
@@ -390,12 +491,20 @@ void show_py_exception() {
 int generate_root_parser_c(std::string filename,
 						   std::string output,
 						   graph_t graph,
-						   std::vector<root_t> roots)
+						   std::vector<root_t> roots,
+						   lean_info const* lean = nullptr,
+						   std::vector<hot_path> const& hot_paths = {},
+						   std::string const& dispatch = "call",
+						   bool compact = false,
+						   std::string const& fragments = "",
+						   const char *target_def = "")
 {
 	{
 		auto ptr = [](auto* p) { PyMem_RawFree(p); };
 		auto program_name = decode_locale("main.py", NULL);
-		auto template_str = std::string(user_xdp_common_template_str) + std::string(c_def_template_str);
+		auto template_str = std::string(user_xdp_common_template_str) +
+			std::string(c_def_template_str) +
+			std::string(target_def);
 
 		Py_SetProgramName(program_name.get());
 		Py_Initialize();
@@ -414,6 +523,11 @@ int generate_root_parser_c(std::string filename,
 		{
 			auto py_graph = make_python_object(graph);
 			auto py_roots = make_python_object(graph, roots);
+			auto py_lean = lean ? make_python_object(
+					make_python_object(*lean,
+					std::filesystem::path(output).stem().string() + ".h")) :
+				(Py_INCREF(Py_None), make_python_object(Py_None));
+			auto py_hot_paths = make_python_object(hot_paths);
 
 			call_function(
 						  generate_parser_entry_function,
@@ -421,7 +535,98 @@ int generate_root_parser_c(std::string filename,
 						  output,
 						  py_graph.get(),
 						  py_roots.get(),
-						  template_str.c_str()
+						  template_str.c_str(),
+						  py_lean.get(),
+						  py_hot_paths.get(),
+						  dispatch,
+						  compact ? 1 : 0,
+						  fragments
+						  );
+		}
+	}
+
+	if (Py_FinalizeEx() < 0) {
+		std::cerr << "Error running generation template" << std::endl;
+		return 120;
+	}
+
+	return 0;
+}
+
+auto make_python_object(std::vector<bc_program> const &programs)
+{
+	auto list = python::list{};
+
+	for (auto &&p : programs) {
+		python::dict prog;
+		python::list lines;
+
+		for (auto &&l : p.lines) {
+			python::list line;
+
+			line.append(l.insn);
+			line.append(l.node);
+			line.append(l.target);
+			lines.append(std::move(line));
+		}
+		prog.set("name", p.name);
+		prog.set("lines", std::move(lines));
+		list.append(std::move(prog));
+	}
+
+	return list;
+}
+
+/* Generate the programs of the bytecode compiler with a template */
+int generate_root_parser_bc(std::string filename,
+			    std::string output,
+			    graph_t graph,
+			    std::vector<root_t> roots,
+			    std::vector<bc_program> const &programs,
+			    const char *template_def)
+{
+	{
+		auto ptr = [](auto *p) { PyMem_RawFree(p); };
+		auto program_name = decode_locale("main.py", NULL);
+		auto template_str = std::string(template_def);
+
+		Py_SetProgramName(program_name.get());
+		Py_Initialize();
+
+		auto checker = error_checker{};
+
+		PyRun_SimpleString(pyratempsrc);
+		PyRun_SimpleString(template_gen);
+
+		auto generate_parser_entry_function = make_python_object(
+				ensure_not_null(
+			PyObject_GetAttrString(PyImport_AddModule("__main__"),
+					       "generate_parser_function"),
+			std::string{"Failed to get 'generate_parser_function'"}
+		));
+
+		{
+			auto py_graph = make_python_object(graph);
+			auto py_roots = make_python_object(graph, roots);
+			auto py_none = (Py_INCREF(Py_None),
+					make_python_object(Py_None));
+			auto py_hot_paths = make_python_object(
+					std::vector<hot_path>{});
+			auto py_programs = make_python_object(programs);
+
+			call_function(
+						  generate_parser_entry_function,
+						  filename,
+						  output,
+						  py_graph.get(),
+						  py_roots.get(),
+						  template_str.c_str(),
+						  py_none.get(),
+						  py_hot_paths.get(),
+						  std::string{"call"},
+						  0,
+						  std::string{},
+						  py_programs.get()
 						  );
 		}
 	}
@@ -434,15 +639,52 @@ int generate_root_parser_c(std::string filename,
 	return 0;
 }
 
+int generate_root_parser_bc_c(std::string filename,
+			      std::string output,
+			      graph_t graph,
+			      std::vector<root_t> roots,
+			      std::vector<bc_program> const &programs)
+{
+	return generate_root_parser_bc(filename, output, graph, roots,
+				       programs, bc_def_template_str);
+}
+
+int generate_root_parser_cxx(std::string filename,
+			     std::string output,
+			     graph_t graph,
+			     std::vector<root_t> roots,
+			     std::vector<bc_program> const &programs)
+{
+	return generate_root_parser_bc(filename, output, graph, roots,
+				       programs, cxx_def_template_str);
+}
+
+/* The harness is rendered with the parser graph, filename is the generated
+ * parser it includes
+ */
+int generate_harness_c(std::string filename,
+		       std::string output,
+		       graph_t graph,
+		       std::vector<root_t> roots)
+{
+	return generate_root_parser_bc(filename, output, graph, roots, {},
+				       harness_def_template_str);
+}
+
 int generate_root_parser_xdp_c(std::string filename,
 							   std::string output,
 							   graph_t graph,
-							   std::vector<root_t> roots)
+							   std::vector<root_t> roots,
+							   bool loop = false,
+							   const char *target_def = "")
 {
 	{
 		auto ptr = [](auto* p) { PyMem_RawFree(p); };
 		auto program_name = decode_locale("main.py", NULL);
-		auto template_str = std::string(user_xdp_common_template_str) + std::string(xdp_def_template_str);
+		auto template_str = std::string(user_xdp_common_template_str) +
+			std::string(loop ? xdp_loop_def_template_str :
+					   xdp_def_template_str) +
+			std::string(target_def);
 
 		Py_SetProgramName(program_name.get());
 		Py_Initialize();
@@ -0,0 +1,125 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef PANDAGEN_XDP_SPLIT_H
+#define PANDAGEN_XDP_SPLIT_H
+
+/* XDP program splitting
+ *
+ * With --xdp-loop each parse node of an XDP parser is a BPF subprogram and
+ * TLVs are parsed by a bpf_loop callback, so the size of the BPF program
+ * grows with the number of nodes and not with the number of TLVs that are
+ * parsed. If the parse graph doesn't fit in one program for the verifier
+ * budget, the nodes are split over several programs that tail call each
+ * other: nodes are taken in breadth first order from the root and go to the
+ * current program as long as its estimated size is within the budget.
+ *
+ * The size of the subprogram of a node is the estimate of its
+ * instructions, see pandagen/estimate.h.
+ */
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "pandagen/estimate.h"
+#include "pandagen/graph.h"
+
+namespace pandagen
+{
+
+/* Dispatch loop of a program and the cost of a node in it */
+static const unsigned int xdp_size_prog = 16;
+static const unsigned int xdp_size_dispatch = 4;
+
+/* Default budget of --xdp-loop, BPF_MAXINSNS */
+static const unsigned int xdp_budget_default = 4096;
+
+/* Assign the nodes reachable from the root to programs. Returns the number
+ * of programs, the programs are printed if report is set
+ */
+template <typename G> unsigned int xdp_split(G &g, root_t const &root,
+					     unsigned int budget,
+					     bool report = true)
+{
+	using vertex_t = typename boost::graph_traits<G>::vertex_descriptor;
+	std::vector<unsigned int> sizes{ xdp_size_prog };
+	std::vector<std::vector<std::string>> progs{ {} };
+	std::vector<vertex_t> order{ std::get<1>(root) };
+	std::map<vertex_t, bool> seen{ { std::get<1>(root), true } };
+
+	for (size_t i = 0; i < order.size(); i++) {
+		auto v = order[i];
+		auto size = estimate_insns(g, v);
+		std::vector<vertex_t> next;
+
+		if (sizes.back() + size + xdp_size_dispatch > budget &&
+		    !progs.back().empty()) {
+			sizes.push_back(xdp_size_prog);
+			progs.push_back({});
+		}
+		if (xdp_size_prog + size + xdp_size_dispatch > budget)
+			std::cerr << "Parse node " << g[v].name << " exceeds "
+				"the XDP budget: " << size << " > " << budget <<
+				std::endl;
+
+		g[v].xdp_prog = progs.size() - 1;
+		g[v].xdp_size = size;
+		sizes.back() += size + xdp_size_dispatch;
+		progs.back().push_back(g[v].name);
+
+		for (auto &&e : boost::make_iterator_range(out_edges(v, g)))
+			next.push_back(target(e, g));
+		if (!g[v].wildcard_proto_node.empty()) {
+			auto w = search_vertex_by_name(g,
+						       g[v].wildcard_proto_node);
+
+			if (w)
+				next.push_back(*w);
+		}
+		for (auto &&n : next) {
+			if (seen[n])
+				continue;
+			seen[n] = true;
+			order.push_back(n);
+		}
+	}
+
+	for (size_t i = 0; report && i < progs.size(); i++) {
+		std::cout << "XDP program " << i << ": " << progs[i].size() <<
+			" nodes, " << sizes[i] << " estimated insns (";
+		for (size_t j = 0; j < progs[i].size(); j++)
+			std::cout << (j ? "," : "") << progs[i][j];
+		std::cout << ")" << std::endl;
+	}
+
+	return progs.size();
+}
+
+} // namespace pandagen
+
+#endif /* PANDAGEN_XDP_SPLIT_H */
@@ -28,17 +28,32 @@
  * SUCH DAMAGE.
  */
 
+#include <cerrno>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <numeric>
 #include <string>
 
+#include <getopt.h>
+
 #include <boost/wave.hpp>
 #include <boost/wave/cpplexer/cpp_lex_iterator.hpp>
 
+#include "pandagen/cache.h"
+#include "pandagen/compact.h"
+#include "pandagen/bytecode.h"
+#include "pandagen/cost.h"
+#include "pandagen/fuse_len.h"
 #include "pandagen/graph.h"
+#include "pandagen/graph_opt.h"
+#include "pandagen/hot_path.h"
+#include "pandagen/lean.h"
 #include "pandagen/macro_defs.h"
 #include "pandagen/python_generators.h"
+#include "pandagen/xdp_split.h"
 
 namespace pandagen
 {
@@ -56,6 +71,7 @@ template <typename G> struct MacroOnly :
   std::vector<flag_fields_node> *flag_fields_nodes;
   std::vector<table> *tlv_tables;
   std::vector<table> *flag_fields_tables;
+  std::vector<metadata_extractor> *extractors;
   G *graph;
 
   MacroOnly(G &g, std::vector<table> &parser_tables,
@@ -63,12 +79,13 @@ template <typename G> struct MacroOnly :
       std::vector<table> &flag_fields_tables,
       std::vector<tlv_node> &tlv_nodes,
       std::vector<flag_fields_node> &flag_fields_nodes,
-      std::vector<std::tuple<std::string, vertex_descriptor, bool, bool>> &roots)
+      std::vector<std::tuple<std::string, vertex_descriptor, bool, bool>> &roots,
+      std::vector<metadata_extractor> &extractors)
     : boost::wave::context_policies::default_preprocessing_hooks{},
       graph{ &g }, parser_tables (&parser_tables),
       tlv_tables (&tlv_tables), flag_fields_tables (&flag_fields_tables),
       tlv_nodes{ &tlv_nodes }, flag_fields_nodes{ &flag_fields_nodes },
-      roots (&roots)
+      roots (&roots), extractors{ &extractors }
   {
   }
 
@@ -134,6 +151,9 @@ template <typename G> struct MacroOnly :
       pandagen::handle_parser_xdp(*graph, *roots, arguments);
     } else if (macro_name.get_value() == "PANDA_MAKE_TLV_OVERLAY_PARSE_NODE") {
       pandagen::handle_make_tlv_overlay_node(*tlv_nodes, arguments);
+    } else if (macro.find("PANDA_METADATA_TEMP_") == 0) {
+      pandagen::handle_metadata_temp(*extractors,
+               std::string(macro.begin() + 20, macro.end()), arguments);
 	}
     return true;
   }
@@ -201,7 +221,8 @@ add_panda_macros (Context &context)
 template <typename G> void
 parse_file(G &g, std::vector<std::tuple<std::string,
      typename boost::graph_traits<G>::vertex_descriptor, bool, bool>> &roots,
-     std::string filename)
+     std::string filename, std::vector<metadata_extractor> &extractors,
+     cache_hasher *tokens = nullptr)
 {
   // save current file position for exception handling
   using position_type = boost::wave::util::file_position_type;
@@ -232,11 +253,18 @@ parse_file(G &g, std::vector<std::tuple<std::string,
     context_type context(input.begin(), input.end(),
              filename.c_str (),
              MacroOnly<G>{g, parser_tables, tlv_tables, flag_fields_tables,
-               tlv_nodes, flag_fields_nodes, roots});
+               tlv_nodes, flag_fields_nodes, roots, extractors});
 
     add_panda_macros(context);
-    for (const auto &it : context)
+    add_metadata_temp_macros(context);
+    for (const auto &it : context) {
+      auto id = boost::wave::token_id(it);
+
       current_position = it.get_position();
+      if (tokens && !IS_CATEGORY(id, boost::wave::WhiteSpaceTokenType) &&
+          !IS_CATEGORY(id, boost::wave::EOLTokenType))
+        tokens->add(std::string{ it.get_value().c_str() });
+    }
 
     std::cout << "proto tables size: " << parser_tables.size () <<
       " tlv tables size " << tlv_tables.size () <<
@@ -272,26 +300,303 @@ parse_file(G &g, std::vector<std::tuple<std::string,
 
 } // namespace pandagen
 
-int main (int argc, char *argv[])
+/* Cache key of a compilation: the preprocessed tokens of the source, the
+ * templates, the compiler, and the options other than --cache-dir
+ */
+static std::string cache_key(pandagen::cache_hasher h, int argc,
+                             char *argv[], std::string const &filename,
+                             std::string const &output,
+                             std::string const &hot_profile)
+{
+  h.add(std::to_string(pandagen::cache_version));
+  for (auto &&t : { pyratempsrc, template_gen,
+                    user_xdp_common_template_str, c_def_template_str,
+                    kmod_def_template_str, xdp_def_template_str,
+                    xdp_loop_def_template_str, flowdis_def_template_str,
+                    tc_def_template_str, afxdp_def_template_str,
+                    bc_def_template_str, cxx_def_template_str,
+                    harness_def_template_str })
+    h.add(std::string{ t });
+  h.add_file("/proc/self/exe");
+
+  for (int i = 1; i < optind; i++) {
+    auto arg = std::string{ argv[i] };
+
+    if (arg == "--cache-dir")
+      i++;
+    else if (arg.rfind("--cache-dir=", 0) != 0)
+      h.add(arg);
+  }
+  h.add(filename);
+  h.add(std::filesystem::path{ output }.filename().string());
+  if (!hot_profile.empty())
+    h.add_file(hot_profile);
+
+  return h.hex();
+}
+
+/* Parse the numeric argument of a command line option. Prints an error and
+ * returns false if arg is not a number in the range 0 to max
+ */
+static bool parse_number(const char *option, const char *arg,
+                         unsigned long max, unsigned long &val)
+{
+  char *end;
+
+  errno = 0;
+  val = strtoul(arg, &end, 0);
+  if (errno || end == arg || *end || *arg == '-' || val > max) {
+    std::cerr << "Invalid number " << arg << " for --" << option << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+static bool has_suffix(std::string const &name, std::string const &suffix)
 {
-  if (argc != 2 && argc != 3) {
-    std::cout << "Usage: " << argv[0] << " <source> [OUTPUT]\n"
+  return name.size() >= suffix.size() &&
+    name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/* True if the output is a C parser, i.e. .c (including .afxdp.c) but not a
+ * kernel module or bytecode program
+ */
+static bool is_c_output(std::string const &output)
+{
+  return has_suffix(output, ".c") && !has_suffix(output, ".kmod.c") &&
+    !has_suffix(output, ".bc.c");
+}
+
+static void usage (const char *prog)
+{
+    std::cout << "Usage: " << prog << " [OPTIONS] <source> [OUTPUT]\n"
         << "\n"
            "Where if OUTPUT is provided:\n"
            "  - If OUTPUT extension is .c, "
            "generates C code\n"
            "  - If OUTPUT extension is .xdp, "
            "generates XDP BPF-C code\n"
+           "  - If OUTPUT extension is .flowdis.h, "
+           "generates a BPF flow dissector program\n"
+           "  - If OUTPUT extension is .tc.h, "
+           "generates TC BPF-C code\n"
+           "  - If OUTPUT extension is .afxdp.c, "
+           "generates C code with AF_XDP receive functions\n"
+           "  - If OUTPUT extension is .bc.c, "
+           "generates a bytecode program\n"
+           "  - If OUTPUT extension is .hpp, "
+           "generates a header only C++ parser\n"
            "  - If OUTPUT extension is .dot, "
-           "generates graphviz dot file\n";
+           "generates graphviz dot file\n"
+           "\n"
+           "Options:\n"
+           "  --consume=FIELD[,FIELD...]  generate a lean parser that only "
+           "extracts\n"
+           "                              the listed metadata fields "
+           "(.c output only)\n"
+           "  --hot-path=NODE,NODE[,...]  generate a straight line fast "
+           "path for a\n"
+           "                              protocol stack starting at a "
+           "parser root\n"
+           "                              (.c output only, may be "
+           "repeated)\n"
+           "  --hot-profile=FILE          take hot paths from a profile "
+           "of path counts\n"
+           "  --hot-profile-top=N         number of paths taken from the "
+           "profile\n"
+           "                              (default 4)\n"
+           "  --no-graph-opt              don't merge identical nodes or "
+           "collapse\n"
+           "                              overlay nodes into their "
+           "parents (.c output)\n"
+           "  --dispatch=MODE             node to node dispatch: call "
+           "(default),\n"
+           "                              musttail (guaranteed tail "
+           "calls), or goto\n"
+           "                              (one function with labels) "
+           "(.c output)\n"
+           "  --compact[=SIZE]            share one parse function per "
+           "node across\n"
+           "                              all parsers, only inline nodes "
+           "with an\n"
+           "                              estimated size up to SIZE "
+           "(default 64)\n"
+           "                              (.c output)\n"
+           "  --xdp-loop[=INSNS]          parse TLVs with bpf_loop and "
+           "nodes as BPF\n"
+           "                              subprograms, split the parser "
+           "in tail called\n"
+           "                              programs of up to INSNS "
+           "estimated instructions\n"
+           "                              (default 4096) (.xdp.h "
+           "output)\n"
+           "  --harness=FILE              also generate a benchmark and "
+           "fuzz harness\n"
+           "                              that compares the generated "
+           "parsers with\n"
+           "                              the generic parsers (.c "
+           "output)\n"
+           "  --cache-dir=DIR             reuse outputs and rendered parse "
+           "functions\n"
+           "                              of earlier compilations saved "
+           "in DIR\n"
+           "  --report=FILE               write the worst case bounds and "
+           "estimated\n"
+           "                              cost of each parser to FILE "
+           "(- for stdout)\n"
+           "  --report-len=BYTES          packet length for the bounds "
+           "(default 1518)\n"
+           "  --report-encaps=N           encapsulations for the bounds "
+           "(default 4)\n"
+           "  --budget=KEY=N[,KEY=N...]   fail if a bound exceeds its "
+           "budget, KEY is\n"
+           "                              nodes, bytes, tlvs, encaps, or "
+           "insns\n"
+           "  -h, --help                  show this help\n";
+}
+
+int main (int argc, char *argv[])
+{
+  static const struct option long_options[] = {
+    { "consume", required_argument, nullptr, 'c' },
+    { "hot-path", required_argument, nullptr, 'p' },
+    { "hot-profile", required_argument, nullptr, 'P' },
+    { "hot-profile-top", required_argument, nullptr, 't' },
+    { "no-graph-opt", no_argument, nullptr, 'G' },
+    { "dispatch", required_argument, nullptr, 'd' },
+    { "compact", optional_argument, nullptr, 'C' },
+    { "xdp-loop", optional_argument, nullptr, 'X' },
+    { "cache-dir", required_argument, nullptr, 'D' },
+    { "report", required_argument, nullptr, 'r' },
+    { "report-len", required_argument, nullptr, 'L' },
+    { "report-encaps", required_argument, nullptr, 'E' },
+    { "budget", required_argument, nullptr, 'B' },
+    { "harness", required_argument, nullptr, 'H' },
+    { "help", no_argument, nullptr, 'h' },
+    { nullptr, 0, nullptr, 0 },
+  };
+  std::vector<std::string> consume;
+  std::vector<std::vector<std::string>> hot_path_specs;
+  std::string hot_profile;
+  size_t hot_profile_top = 4;
+  std::string dispatch = "call";
+  bool compact = false;
+  unsigned int compact_inline = pandagen::compact_inline_default;
+  bool xdp_loop = false;
+  unsigned int xdp_budget = pandagen::xdp_budget_default;
+  std::string cache_dir;
+  std::string harness;
+  std::string report;
+  size_t report_len = 1518;
+  unsigned int report_encaps = 4;
+  std::map<std::string, unsigned long long> budget;
+  bool graph_opt = true;
+  bool lean = false;
+  unsigned long number;
+  int opt;
+
+  while ((opt = getopt_long(argc, argv, "h", long_options,
+                            nullptr)) != -1) {
+    switch (opt) {
+    case 'c': {
+      auto fields = std::istringstream{ optarg };
+      std::string field;
+
+      while (std::getline(fields, field, ','))
+        if (!field.empty())
+          consume.push_back(field);
+      lean = true;
+      break;
+    }
+    case 'p':
+      hot_path_specs.push_back(pandagen::hot_path_split(optarg));
+      break;
+    case 'P':
+      hot_profile = optarg;
+      break;
+    case 't':
+      if (!parse_number("hot-profile-top", optarg,
+                        std::numeric_limits<size_t>::max(), number))
+        return 1;
+      hot_profile_top = number;
+      break;
+    case 'G':
+      graph_opt = false;
+      break;
+    case 'd':
+      dispatch = optarg;
+      if (dispatch != "call" && dispatch != "musttail" &&
+          dispatch != "goto") {
+        std::cerr << "Unknown dispatch mode " << dispatch << "\n";
+        return 1;
+      }
+      break;
+    case 'C':
+      compact = true;
+      if (optarg) {
+        if (!parse_number("compact", optarg,
+                          std::numeric_limits<unsigned int>::max(), number))
+          return 1;
+        compact_inline = number;
+      }
+      break;
+    case 'X':
+      xdp_loop = true;
+      if (optarg) {
+        if (!parse_number("xdp-loop", optarg,
+                          std::numeric_limits<unsigned int>::max(), number))
+          return 1;
+        xdp_budget = number;
+      }
+      break;
+    case 'D':
+      cache_dir = optarg;
+      break;
+    case 'r':
+      report = optarg;
+      break;
+    case 'L':
+      if (!parse_number("report-len", optarg,
+                        std::numeric_limits<size_t>::max(), number))
+        return 1;
+      report_len = number;
+      break;
+    case 'E':
+      if (!parse_number("report-encaps", optarg,
+                        std::numeric_limits<unsigned int>::max(), number))
+        return 1;
+      report_encaps = number;
+      break;
+    case 'B':
+      if (!pandagen::cost_parse_budget(optarg, budget))
+        return 1;
+      break;
+    case 'H':
+      harness = optarg;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc - optind != 1 && argc - optind != 2) {
+    usage(argv[0]);
     return 1;
   }
 
   pandagen::graph_t graph;
 
   std::vector<pandagen::root_t> roots;
-  std::string filename = argv[1];
-  pandagen::parse_file(graph, roots, filename);
+  std::vector<pandagen::metadata_extractor> extractors;
+  std::string filename = argv[optind];
+  pandagen::cache_hasher tokens;
+  pandagen::parse_file(graph, roots, filename, extractors,
+                       cache_dir.empty() ? nullptr : &tokens);
 
   {
     auto vs = vertices (graph);
@@ -313,8 +618,94 @@ int main (int argc, char *argv[])
     std::cout << "Has cycle? -> " <<
         (back_edges.empty () ? "No" : "Yes") << "\n";
 
-    if (argc == 3) {
-      auto output = std::string{ argv[2] };
+    if (!report.empty() || !budget.empty()) {
+      auto reports = pandagen::cost_compute(graph, roots, report_len,
+                                            report_encaps);
+
+      if (report == "-") {
+        pandagen::cost_print(std::cout, reports, report_len, report_encaps);
+      } else if (!report.empty()) {
+        auto file = std::ofstream{ report };
+
+        if (!file) {
+          std::cerr << "Failed to open " << report << "\n";
+          return 1;
+        }
+        pandagen::cost_print(file, reports, report_len, report_encaps);
+      }
+
+      if (!pandagen::cost_check_budget(reports, budget))
+        return 1;
+    }
+
+    if (argc - optind == 2) {
+      auto output = std::string{ argv[optind + 1] };
+      std::vector<pandagen::hot_path> hot_paths;
+      pandagen::lean_info lean_info;
+      std::vector<std::string> outputs{ output };
+      std::string key;
+
+      if (lean && output.size() >= 2)
+        outputs.push_back(output.substr(0, output.size() - 2) + ".h");
+      if (!harness.empty())
+        outputs.push_back(harness);
+
+      if (!cache_dir.empty()) {
+        if (!pandagen::cache_init(cache_dir))
+          return 1;
+        key = cache_key(tokens, argc, argv, filename, output, hot_profile);
+        if (pandagen::cache_fetch(cache_dir, key, outputs)) {
+          std::cout << "Done, cached " << key << "\n";
+          return 0;
+        }
+      }
+
+      if (lean) {
+        if (!is_c_output(output)) {
+          std::cerr << "--consume is only supported for .c output\n";
+          return 1;
+        }
+        if (consume.empty()) {
+          std::cerr << "--consume requires at least one field\n";
+          return 1;
+        }
+        if (!pandagen::lean_specialize(graph, roots, extractors, consume,
+                                       lean_info))
+          return 1;
+
+        auto header = output.substr(0, output.size() - 2) + ".h";
+
+        if (!pandagen::write_lean_header(header, lean_info)) {
+          std::cerr << "Failed to generate " << header << "\n";
+          return 1;
+        }
+      }
+
+      if (!harness.empty()) {
+        if (!is_c_output(output)) {
+          std::cerr << "--harness is only supported for .c output\n";
+          return 1;
+        }
+        if (lean) {
+          std::cerr << "--harness is not supported with --consume\n";
+          return 1;
+        }
+      }
+
+      if (!hot_profile.empty() &&
+          !pandagen::read_hot_profile(hot_profile, hot_profile_top,
+                                      hot_path_specs))
+        return 1;
+
+      if (!hot_path_specs.empty()) {
+        if (!is_c_output(output)) {
+          std::cerr << "Hot paths are only supported for .c output\n";
+          return 1;
+        }
+        if (!pandagen::resolve_hot_paths(graph, roots, hot_path_specs,
+                                         hot_paths))
+          return 1;
+      }
 
       if (output.substr(std::max(output.size() - 4,
                                  0ul)) == ".dot") {
@@ -342,19 +733,127 @@ int main (int argc, char *argv[])
           std::cerr << "Failed to generate " << output << ": " << e.what() << "\n";
           return 1;
         }
+      } else if (output.substr(std::max(output.size() - 5,
+                               0ul)) == ".bc.c") {
+        std::vector<pandagen::bc_program> programs;
+
+        if (!pandagen::bc_compile(graph, roots, extractors, programs))
+          return 1;
+        try {
+            auto res = pandagen::python::generate_root_parser_bc_c(
+              filename,
+              output,
+              graph,
+              roots,
+              programs
+            );
+            if (res != 0) {
+				std::cout << "failed python gen?" << std::endl;
+              return res;
+            }
+        } catch (std::exception const& e) {
+          std::cerr << "Failed to generate " << output << ": " << e.what() << "\n";
+          return 1;
+        }
+      } else if (output.substr(std::max(output.size() - 4,
+                               0ul)) == ".hpp") {
+        std::vector<pandagen::bc_program> programs;
+
+        if (!pandagen::bc_compile(graph, roots, extractors, programs,
+                                  "_cxx"))
+          return 1;
+        try {
+            auto res = pandagen::python::generate_root_parser_cxx(
+              filename,
+              output,
+              graph,
+              roots,
+              programs
+            );
+            if (res != 0) {
+				std::cout << "failed python gen?" << std::endl;
+              return res;
+            }
+        } catch (std::exception const& e) {
+          std::cerr << "Failed to generate " << output << ": " << e.what() << "\n";
+          return 1;
+        }
+      } else if (output.substr(std::max(output.size() - 10,
+                               0ul)) == ".flowdis.h" ||
+                 output.substr(std::max(output.size() - 5,
+                               0ul)) == ".tc.h") {
+        bool tc = output.substr(output.size() - 5) == ".tc.h";
+
+        if (roots.size() > 1) {
+           std::cout << (tc ? "TC" : "A flow dissector") <<
+             " only supports one root";
+           return 1;
+        }
+        /* One program, nodes are BPF subprograms and TLVs are parsed
+         * with bpf_loop
+         */
+        pandagen::xdp_split(graph, roots[0],
+                            std::numeric_limits<unsigned int>::max(), false);
+        try {
+            auto res = pandagen::python::generate_root_parser_xdp_c(
+              filename,
+              output,
+              graph,
+              roots,
+              true,
+              tc ? tc_def_template_str : flowdis_def_template_str
+            );
+            if (res != 0) {
+				std::cout << "failed python gen?" << std::endl;
+              return res;
+            }
+        } catch (std::exception const& e) {
+          std::cerr << "Failed to generate " << output << ": " << e.what() << "\n";
+          return 1;
+        }
       } else if (output.substr(std::max(output.size() - 2,
              0ul)) == ".c") {
+        bool afxdp = has_suffix(output, ".afxdp.c");
+
+        if (graph_opt)
+          pandagen::graph_opt(graph, lean);
+        pandagen::fuse_len(graph);
+        if (compact)
+          pandagen::compact_mark(graph, compact_inline);
         try {
             auto res = pandagen::python::generate_root_parser_c(
               filename,
               output,
               graph,
-              roots
+              roots,
+              lean ? &lean_info : nullptr,
+              hot_paths,
+              dispatch,
+              compact,
+              cache_dir.empty() ? std::string{} :
+                pandagen::cache_fragments(cache_dir, filename, output),
+              afxdp ? afxdp_def_template_str : ""
             );
             if (res != 0) {
 				std::cout << "failed python gen?" << std::endl;
               return res;
             }
+            if (!harness.empty()) {
+              auto dir = std::filesystem::path(harness).parent_path();
+
+              /* The harness includes the generated parser */
+              res = pandagen::python::generate_harness_c(
+                std::filesystem::path(output).lexically_proximate(
+                  dir.empty() ? "." : dir).string(),
+                harness,
+                graph,
+                roots
+              );
+              if (res != 0) {
+                std::cout << "failed python gen?" << std::endl;
+                return res;
+              }
+            }
         } catch (std::exception const& e) {
           std::cerr << "Failed to generate " << output << ": " << e.what() << "\n";
           return 1;
@@ -367,12 +866,15 @@ int main (int argc, char *argv[])
            std::cout << "XDP only supports one root";
            return 1;
         }
+        if (xdp_loop)
+          pandagen::xdp_split(graph, roots[0], xdp_budget);
 
 		auto res = pandagen::python::generate_root_parser_xdp_c(
               filename,																
               output,
               graph,
-              roots
+              roots,
+              xdp_loop
             );
 		if (res != 0) {
 			std::cout << "failed python gen?" << std::endl;
@@ -383,6 +885,8 @@ int main (int argc, char *argv[])
                "filename " << output << ".\n";
         return 1;
       }
+      if (!cache_dir.empty())
+        pandagen::cache_store(cache_dir, key, outputs);
       std::cout << "Done\n";
     } else {
       std::cout << "Nothing to generate\n";
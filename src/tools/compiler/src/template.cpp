@@ -1240,18 +1240,85 @@ class Template(TemplateBase):
 )";
 
 const char* template_gen = R"(
+import hashlib
+import json
 from textwrap import dedent
 from pathlib import Path
 
+def fragment_keys(graph, common):
+  keys = {}
+
+  # The parse function of a node depends on the node, the nodes it
+  # dispatches to, and the nodes collapsed ones dispatch to
+  for name in graph:
+    node = graph[name]
+    succs = list(node['out_edges']) + [node['wildcard_proto_node']]
+    key = [common, repr(node)]
+
+    for succ in succs:
+      if succ in graph:
+        key.append(repr(graph[succ]))
+        for succ2 in graph[succ]['out_edges']:
+          if succ2 in graph:
+            key.append(repr((succ2, graph[succ2]['impl'],
+                             graph[succ2]['pruned'])))
+    keys[name] = hashlib.sha1('\n'.join(key).encode()).hexdigest()
+
+  return keys
+
 def generate_parser_function(
     filename: str,
     output: str,
     graph,
     roots,
-    template_str: str
+    template_str: str,
+    lean=None,
+    hot_paths=None,
+    dispatch='call',
+    compact=False,
+    fragments='',
+    bytecode=None
 ):
 
+  keys = {}
+  cached = {}
+  rendered = {}
+
+  if fragments:
+    keys = fragment_keys(graph, repr((filename, lean, hot_paths, dispatch,
+                                      compact)))
+    try:
+      with open(fragments) as f:
+        saved = json.load(f)
+    except (OSError, ValueError):
+      saved = {}
+    for name in saved:
+      if name in keys and saved[name][0] == keys[name]:
+        cached[name] = saved[name][1]
+
+  def fragment(name, text):
+    rendered[name] = text
+    return text
+
   with open(Path(output), 'w') as f:
     template = Template(template_str)
-    f.write(dedent(template(roots=roots, graph=graph, filename=filename)))
+    f.write(dedent(template(roots=roots, graph=graph, filename=filename,
+                            lean=lean, hot_paths=hot_paths or [],
+                            dispatch=dispatch,
+                            compact=compact, fragments=cached,
+                            fragment=fragment,
+                            bytecode=bytecode or [])))
+
+  if fragments:
+    print('Rendered %d parse functions, %d cached' %
+          (len(rendered), len(cached)))
+    saved = {}
+    for name in rendered:
+      saved[name] = [keys[name], str(rendered[name])]
+    for name in cached:
+      saved[name] = [keys[name], cached[name]]
+    tmp = fragments + '.tmp'
+    with open(tmp, 'w') as f:
+      json.dump(saved, f)
+    Path(tmp).replace(fragments)
 )";
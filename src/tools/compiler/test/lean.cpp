@@ -0,0 +1,180 @@
+/* SPDX-License-Identifier: BSD-2-Clause-FreeBSD
+ *
+ * Copyright (c) 2021 SiPanda Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Check that the fields of the canned metadata templates listed in
+ * pandagen/lean.h match the templates in parser_metadata.h
+ *
+ * The fields of a template are the members of the frame that its body, and
+ * the body of any metadata helper macro it uses, refers to. Exits with a
+ * non-zero status if a template is missing from either side or if the
+ * fields differ
+ */
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <set>
+#include <string>
+
+#include <boost/wave.hpp>
+
+#include "pandagen/lean.h"
+
+static std::map<std::string, std::string> macro_bodies;
+static std::map<std::string, std::set<std::string>> macro_fields;
+
+/* Read the function-like macro definitions of a header */
+static bool read_macros(const char *filename)
+{
+	static const std::regex define_re(
+		"^#define[ \t]+([A-Za-z_][A-Za-z0-9_]*)\\(");
+	std::ifstream in(filename);
+	std::string line, name, body;
+	std::smatch m;
+
+	if (!in.is_open()) {
+		std::cerr << "Could not open " << filename << "\n";
+		return false;
+	}
+
+	while (std::getline(in, line)) {
+		if (!std::regex_search(line, m, define_re))
+			continue;
+
+		name = m[1];
+		body = line;
+		while (!line.empty() && line.back() == '\\' &&
+		       std::getline(in, line))
+			body += "\n" + line;
+
+		macro_bodies[name] = body;
+	}
+
+	return true;
+}
+
+/* Return the frame members used by a macro, including those of the
+ * metadata helper macros it uses
+ */
+static const std::set<std::string> &fields_of(std::string const &name)
+{
+	static const std::regex field_re(
+		"(?:\\bframe|\\(struct STRUCT \\*\\)\\s*iframe\\))\\s*->\\s*"
+		"([A-Za-z_][A-Za-z0-9_]*)");
+	static const std::regex helper_re(
+		"\\b(PANDA_METADATA_[A-Za-z0-9_]*)\\s*\\(");
+	auto cached = macro_fields.find(name);
+	std::set<std::string> fields;
+	std::smatch m;
+
+	if (cached != macro_fields.end())
+		return cached->second;
+
+	/* Guard against recursion */
+	macro_fields[name];
+
+	auto const &body = macro_bodies[name];
+
+	for (auto it = body.cbegin();
+	     std::regex_search(it, body.cend(), m, field_re);
+	     it = m.suffix().first)
+		fields.insert(m[1]);
+
+	for (auto it = body.cbegin();
+	     std::regex_search(it, body.cend(), m, helper_re);
+	     it = m.suffix().first) {
+		std::string helper = m[1];
+
+		if (helper != name && macro_bodies.count(helper)) {
+			auto const &more = fields_of(helper);
+
+			fields.insert(more.begin(), more.end());
+		}
+	}
+
+	return macro_fields[name] = fields;
+}
+
+static std::string to_string(std::set<std::string> const &fields)
+{
+	std::string str;
+
+	for (auto &&field : fields)
+		str += (str.empty() ? "" : ", ") + field;
+
+	return "{ " + str + " }";
+}
+
+int main(int argc, char *argv[])
+{
+	const std::string prefix = "PANDA_METADATA_TEMP_";
+	int failures = 0;
+
+	if (argc != 2) {
+		std::cerr << "Usage: " << argv[0] << " <parser_metadata.h>\n";
+		return 1;
+	}
+
+	if (!read_macros(argv[1]))
+		return 1;
+
+	for (auto &&macro : macro_bodies) {
+		if (macro.first.compare(0, prefix.size(), prefix))
+			continue;
+
+		auto temp = macro.first.substr(prefix.size());
+		auto entry = pandagen::metadata_temp_fields.find(temp);
+
+		if (entry == pandagen::metadata_temp_fields.end()) {
+			std::cerr << macro.first << " is not in "
+				     "metadata_temp_fields\n";
+			failures++;
+			continue;
+		}
+
+		std::set<std::string> listed(entry->second.begin(),
+					     entry->second.end());
+		auto const &used = fields_of(macro.first);
+
+		if (listed != used) {
+			std::cerr << macro.first << " uses " << to_string(used)
+				  << " but metadata_temp_fields lists "
+				  << to_string(listed) << "\n";
+			failures++;
+		}
+	}
+
+	for (auto &&entry : pandagen::metadata_temp_fields) {
+		if (!macro_bodies.count(prefix + entry.first)) {
+			std::cerr << entry.first << " in metadata_temp_fields "
+				     "is not a template in " << argv[1] << "\n";
+			failures++;
+		}
+	}
+
+	return failures ? 1 : 0;
+}